@@ -0,0 +1,44 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Calculate CRC32 of a buffer, in little endian
+ *
+ * The result is bit-exact with crc32_le function in ROM, so the two can be used
+ * interchangeably, including for data which is already stored in flash.
+ *
+ * With CONFIG_ESP32_CRC32_SLICE_BY_8 enabled, and in host builds, a slice-by-8
+ * table implementation is used, which processes 8 bytes per iteration. Otherwise
+ * this calls the ROM function.
+ *
+ * @param crc  initial CRC value, result of the previous call when the buffer is
+ *             processed in parts
+ * @param buf  buffer to calculate CRC of, no alignment required
+ * @param len  buffer length in bytes
+ *
+ * @return CRC32 value
+ */
+uint32_t esp_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -40,6 +40,7 @@
 #include "esp_spi_flash.h"
 #include "esp_cache_err_int.h"
 #include "esp_app_trace.h"
+#include "esp_log_async.h"
 #include "esp_system_internal.h"
 #include "sdkconfig.h"
 #if CONFIG_SYSVIEW_ENABLE
@@ -578,6 +579,12 @@ static __attribute__((noreturn)) void commonErrorHandler(XtExcFrame *frame)
     }
 #endif //!CONFIG_FREERTOS_UNICORE
 
+#if CONFIG_LOG_ASYNC_PANIC_FLUSH && !CONFIG_ESP32_PANIC_SILENT_REBOOT
+    if (spi_flash_cache_enabled()) { // log records and format strings are formatted from flash
+        esp_log_async_panic_flush();
+    }
+#endif
+
 #if CONFIG_ESP32_APPTRACE_ENABLE
     disableAllWdts();
 #if CONFIG_SYSVIEW_ENABLE
@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "unity.h"
+#include "esp_crc.h"
+#include "esp_timer.h"
+#include "rom/crc.h"
+
+TEST_CASE("esp_crc32_le matches crc32_le in ROM", "[crc]")
+{
+    uint8_t buf[256 + 8];
+    srand(1);
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+        buf[i] = rand();
+    }
+    const uint32_t init_values[] = {0, 0xffffffff, 0x12345678};
+    for (size_t i = 0; i < sizeof(init_values) / sizeof(init_values[0]); ++i) {
+        for (int offset = 0; offset < 8; ++offset) {
+            for (int len = 0; len <= 256; ++len) {
+                TEST_ASSERT_EQUAL_HEX32(crc32_le(init_values[i], buf + offset, len),
+                                        esp_crc32_le(init_values[i], buf + offset, len));
+            }
+        }
+    }
+}
+
+TEST_CASE("esp_crc32_le performance", "[crc]")
+{
+    const size_t sizes[] = {32, 4000};
+    const int iter_count = 100;
+    uint8_t* buf = calloc(1, 4000);
+    TEST_ASSERT_NOT_NULL(buf);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        volatile uint32_t crc = 0;
+        int64_t begin = esp_timer_get_time();
+        for (int j = 0; j < iter_count; ++j) {
+            crc = crc32_le(crc, buf, sizes[i]);
+        }
+        int64_t rom_time = esp_timer_get_time() - begin;
+        begin = esp_timer_get_time();
+        for (int j = 0; j < iter_count; ++j) {
+            crc = esp_crc32_le(crc, buf, sizes[i]);
+        }
+        int64_t time = esp_timer_get_time() - begin;
+        printf("CRC32 of %u bytes: ROM %d ns, esp_crc32_le %d ns\n", (unsigned) sizes[i],
+               (int) (rom_time * 1000 / iter_count), (int) (time * 1000 / iter_count));
+    }
+    free(buf);
+}
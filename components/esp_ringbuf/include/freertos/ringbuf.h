@@ -81,6 +81,28 @@ RingbufHandle_t xRingbufferCreate(size_t xBufferSize, ringbuf_type_t xBufferType
  */
 RingbufHandle_t xRingbufferCreateNoSplit(size_t xItemSize, size_t xItemNum);
 
+/**
+ * @brief       Create a lock-free ring buffer for a single producer and a single consumer
+ *
+ * This API is similar to xRingbufferCreate(), but the ring buffer does not use
+ * a critical section: sending, receiving and returning items only use atomic
+ * accesses to the read and write positions, and the semaphores are only used
+ * to block and wake up the producer or the consumer. The ring buffer types
+ * behave as with xRingbufferCreate().
+ *
+ * @param[in]   xBufferSize Size of the buffer in bytes. Note that items require
+ *              space for overhead in no-split/allow-split buffers
+ * @param[in]   xBufferType Type of ring buffer, see documentation.
+ *
+ * @note    Only one task or ISR (the producer) may send to the ring buffer, and
+ *          only one task or ISR (the consumer) may receive from it and return
+ *          items. They may run on different cores.
+ * @note    The ring buffer can't be added to a queue set.
+ *
+ * @return  A handle to the created ring buffer, or NULL in case of error.
+ */
+RingbufHandle_t xRingbufferCreateSPSC(size_t xBufferSize, ringbuf_type_t xBufferType);
+
 /**
  * @brief       Insert an item into the ring buffer
  *
@@ -90,7 +112,8 @@ RingbufHandle_t xRingbufferCreateNoSplit(size_t xItemSize, size_t xItemNum);
  * @param[in]   xRingbuffer     Ring buffer to insert the item into
  * @param[in]   pvItem          Pointer to data to insert. NULL is allowed if xItemSize is 0.
  * @param[in]   xItemSize       Size of data to insert.
- * @param[in]   xTicksToWait    Ticks to wait for room in the ring buffer.
+ * @param[in]   xTicksToWait    Ticks to wait for room in the ring buffer. With 0, only fails if there is
+ *                              not enough room, even while other tasks are sending.
  *
  * @note    For no-split/allow-split ring buffers, the actual size of memory that
  *          the item will occupy will be rounded up to the nearest 32-bit aligned
@@ -125,6 +148,51 @@ BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size
  */
 BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, BaseType_t *pxHigherPriorityTaskWoken);
 
+/**
+ * @brief       Acquire memory from the ring buffer to be written to by an external source and to be sent later.
+ *
+ * Attempt to allocate buffer for an item to be sent into the ring buffer. This function will block until
+ * enough free space is available or until it timesout.
+ *
+ * The item, as well as the following items ``SendAcquire`` or ``Send`` after it, will not be able to be read from
+ * the ring buffer until this item is actually sent into the ring buffer by xRingbufferSendComplete(). Items
+ * acquired one after another may be completed in any order.
+ *
+ * @param[in]   xRingbuffer     Ring buffer to allocate the memory
+ * @param[out]  ppvItem         Double pointer to memory acquired (set to NULL if no memory was acquired)
+ * @param[in]   xItemSize       Size of item to acquire.
+ * @param[in]   xTicksToWait    Ticks to wait for room in the ring buffer. With 0, only fails if there is
+ *                              not enough room, even while other tasks are sending.
+ *
+ * @note    Only applicable for no-split ring buffers now, the actual size of
+ *          memory that the item will occupy will be rounded up to the nearest 32-bit aligned
+ *          size. This is done to ensure all items are always stored in 32-bit
+ *          aligned fashion.
+ * @note    Not applicable to ring buffers created with xRingbufferCreateSPSC().
+ * @warning Items cannot be read past an acquired item until it is completed. Blocking
+ *          on this function while holding an acquired item may therefore never return.
+ *
+ * @return
+ *      - pdTRUE if succeeded
+ *      - pdFALSE on time-out or when the data is larger than the maximum permissible size of the buffer
+ */
+BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait);
+
+/**
+ * @brief       Actually send an item into the ring buffer allocated before by xRingbufferSendAcquire().
+ *
+ * @param[in]   xRingbuffer     Ring buffer to insert the item into
+ * @param[in]   pvItem          Pointer to item in allocated memory to insert.
+ *
+ * @note    Only applicable for no-split ring buffers. Only call for items
+ *          allocated by xRingbufferSendAcquire(), and only once per item.
+ *
+ * @return
+ *      - pdTRUE if succeeded
+ *      - pdFALSE if pvItem is not an acquired item waiting to be sent
+ */
+BaseType_t xRingbufferSendComplete(RingbufHandle_t xRingbuffer, void *pvItem);
+
 /**
  * @brief   Retrieve an item from the ring buffer
  *
@@ -255,6 +323,27 @@ void *xRingbufferReceiveUpTo(RingbufHandle_t xRingbuffer, size_t *pxItemSize, Ti
  */
 void *xRingbufferReceiveUpToFromISR(RingbufHandle_t xRingbuffer, size_t *pxItemSize, size_t xMaxSize);
 
+/**
+ * @brief   Retrieve several items from a no-split ring buffer
+ *
+ * Attempt to retrieve up to uxMaxItems items from a no-split ring buffer at once.
+ * This function will block until at least one item is available or until it
+ * timesouts, then retrieves all the items available up to uxMaxItems, in the order
+ * they were sent.
+ *
+ * @param[in]   xRingbuffer     Ring buffer to retrieve the items from
+ * @param[out]  ppvItems        Array of at least uxMaxItems pointers, to which pointers to the retrieved items will be written
+ * @param[out]  pxItemSizes     Array of at least uxMaxItems sizes, to which the sizes of the retrieved items will be written
+ * @param[in]   uxMaxItems      Maximum number of items to retrieve
+ * @param[in]   xTicksToWait    Ticks to wait for items in the ring buffer.
+ *
+ * @note    The items retrieved must be returned with vRingbufferReturnItems() or vRingbufferReturnItem().
+ * @note    This function should only be called on no-split buffers
+ *
+ * @return  Number of items retrieved, 0 on timeout.
+ */
+UBaseType_t xRingbufferReceiveItems(RingbufHandle_t xRingbuffer, void **ppvItems, size_t *pxItemSizes, UBaseType_t uxMaxItems, TickType_t xTicksToWait);
+
 /**
  * @brief   Return a previously-retrieved item to the ring buffer
  *
@@ -277,6 +366,20 @@ void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem);
  */
 void vRingbufferReturnItemFromISR(RingbufHandle_t xRingbuffer, void *pvItem, BaseType_t *pxHigherPriorityTaskWoken);
 
+/**
+ * @brief   Return several previously-retrieved items to a no-split ring buffer
+ *
+ * Equivalent to calling vRingbufferReturnItem() for each item, but the ring buffer
+ * is only locked once.
+ *
+ * @param[in]   xRingbuffer Ring buffer the items were retrieved from
+ * @param[in]   ppvItems    Array of items that were received earlier, for example by xRingbufferReceiveItems()
+ * @param[in]   uxItemCount Number of items in ppvItems
+ *
+ * @note    This function should only be called on no-split buffers
+ */
+void vRingbufferReturnItems(RingbufHandle_t xRingbuffer, void **ppvItems, UBaseType_t uxItemCount);
+
 /**
  * @brief   Delete a ring buffer
  *
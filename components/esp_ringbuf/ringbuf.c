@@ -27,11 +27,13 @@
 #define rbALLOW_SPLIT_FLAG          ( ( UBaseType_t ) 1 )   //The ring buffer allows items to be split
 #define rbBYTE_BUFFER_FLAG          ( ( UBaseType_t ) 2 )   //The ring buffer is a byte buffer
 #define rbBUFFER_FULL_FLAG          ( ( UBaseType_t ) 4 )   //The ring buffer is currently full (write pointer == free pointer)
+#define rbSPSC_FLAG                 ( ( UBaseType_t ) 8 )   //The ring buffer has a single producer and a single consumer, and is lock-free
 
 //Item flags
 #define rbITEM_FREE_FLAG            ( ( UBaseType_t ) 1 )   //Item has been retrieved and returned by application, free to overwrite
 #define rbITEM_DUMMY_DATA_FLAG      ( ( UBaseType_t ) 2 )   //Data from here to end of the ring buffer is dummy data. Restart reading at start of head of the buffer
 #define rbITEM_SPLIT_FLAG           ( ( UBaseType_t ) 4 )   //Valid for RINGBUF_TYPE_ALLOWSPLIT, indicating that rest of the data is wrapped around
+#define rbITEM_ACQUIRED_FLAG        ( ( UBaseType_t ) 8 )   //Valid for RINGBUF_TYPE_NOSPLIT, item has been acquired by xRingbufferSendAcquire() but not yet sent
 
 typedef struct {
     //This size of this structure must be 32-bit aligned
@@ -40,6 +42,14 @@ typedef struct {
 } ItemHeader_t;
 
 #define rbHEADER_SIZE     sizeof(ItemHeader_t)
+
+//Accesses to indexes shared between the producer and the consumer of SPSC ring buffers
+#define rbSPSC_LOAD( xIndex )                   __atomic_load_n( &( xIndex ), __ATOMIC_ACQUIRE )
+#define rbSPSC_STORE( xIndex, xValue )          __atomic_store_n( &( xIndex ), ( xValue ), __ATOMIC_RELEASE )
+#define rbSPSC_LOAD_RELAXED( xIndex )           __atomic_load_n( &( xIndex ), __ATOMIC_RELAXED )
+#define rbSPSC_STORE_RELAXED( xIndex, xValue )  __atomic_store_n( &( xIndex ), ( xValue ), __ATOMIC_RELAXED )
+#define rbSPSC_FENCE()                          __atomic_thread_fence( __ATOMIC_SEQ_CST )
+
 typedef struct Ringbuffer_t Ringbuffer_t;
 typedef BaseType_t (*CheckItemFitsFunction_t)(Ringbuffer_t *pxRingbuffer, size_t xItemSize);
 typedef void (*CopyItemFunction_t)(Ringbuffer_t *pxRingbuffer, const uint8_t *pcItem, size_t xItemSize);
@@ -69,6 +79,15 @@ struct Ringbuffer_t {
     SemaphoreHandle_t xFreeSpaceSemaphore;      //Binary semaphore, wakes up writing threads when more free space becomes available or when another thread times out attempting to write
     SemaphoreHandle_t xItemsBufferedSemaphore;  //Binary semaphore, indicates there are new packets in the circular buffer. See remark.
     portMUX_TYPE mux;                           //Spinlock required for SMP
+
+    //Used instead of the pointers and xItemsWaiting above in SPSC ring buffers. See remark.
+    size_t xWriteIndex;                         //Write index, only changed by the producer
+    size_t xReadIndex;                          //Read index, only changed by the consumer
+    size_t xFreeIndex;                          //Free index, only changed by the consumer
+    UBaseType_t uxItemsWritten;                 //Number of items/bytes(for byte buffers) written, only changed by the producer
+    UBaseType_t uxItemsRead;                    //Number of items/bytes(for byte buffers) read, only changed by the consumer
+    BaseType_t xWriterWaiting;                  //Set while the producer is blocked on xFreeSpaceSemaphore
+    BaseType_t xReaderWaiting;                  //Set while the consumer is blocked on xItemsBufferedSemaphore
 };
 
 /*
@@ -76,6 +95,19 @@ Remark: A counting semaphore for items_buffered_sem would be more logical, but c
 FreeRTOS need a maximum count, and allocate more memory the larger the maximum count is. Here, we
 would need to set the maximum to the maximum amount of times a null-byte unit first in the buffer,
 which is quite high and so would waste a fair amount of memory.
+
+Remark: SPSC ring buffers have no lock. Each index is changed by one side only, and published to the other
+side with a release store. The indexes count up to twice the buffer size (the position in the buffer is the
+index modulo xSize), so that a full buffer (write index == free index + xSize) is distinguished from an empty
+one (write index == free index) without a flag shared by both sides. Wrapping around to the start of the
+buffer advances an index to the next multiple of xSize. The semaphores are only given when the other side is
+waiting on them (xWriterWaiting/xReaderWaiting), so tasks block as usual, but sending and receiving without
+blocking never touches them.
+
+Remark: Items acquired by xRingbufferSendAcquire() are allocated at pucWrite like any other item, but their
+header is marked with rbITEM_ACQUIRED_FLAG until xRingbufferSendComplete() is called. Reading stops at the
+first item still marked as acquired, so items are read in the order they were acquired even if they are
+completed out of order. xItemsWaiting counts the completed items, some of which may be behind an acquired one.
 */
 
 /* ------------------------------------------------ Static Declarations ------------------------------------------ */
@@ -97,6 +129,12 @@ static BaseType_t prvCheckItemFitsDefault( Ringbuffer_t *pxRingbuffer, size_t xI
 //Checks if an item will currently fit in a byte buffer
 static BaseType_t prvCheckItemFitsByteBuffer( Ringbuffer_t *pxRingbuffer, size_t xItemSize);
 
+//Acquires space for an item in a no-split ring buffer, returns a pointer to the item data. Only call this function after calling prvCheckItemFitsDefault()
+static uint8_t *prvAcquireItemNoSplit(Ringbuffer_t *pxRingbuffer, size_t xItemSize);
+
+//Marks an item acquired by prvAcquireItemNoSplit() as sent, so that it can be read
+static void prvSendItemDoneNoSplit(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem);
+
 //Copies an item to a no-split ring buffer. Only call this function after calling prvCheckItemFitsDefault()
 static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize);
 
@@ -138,6 +176,67 @@ static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer, void **pvItem1,
 //Generic function used to retrieve an item/data from ring buffers in an ISR
 static BaseType_t prvReceiveGenericFromISR(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize);
 
+//Retrieve up to uxMaxItems items from a no-split ring buffer, blocking until at least one is available or timeout
+static UBaseType_t prvReceiveItemsGeneric(Ringbuffer_t *pxRingbuffer, void **ppvItems, size_t *pxItemSizes, UBaseType_t uxMaxItems, TickType_t xTicksToWait);
+
+/**
+ * Generic function used to send an item to ring buffers. If ppvItem is not NULL,
+ * space for the item is only acquired (no-split buffers) and *ppvItem is set to it,
+ * otherwise pvItem is copied.
+ */
+static BaseType_t prvSendAcquireGeneric(Ringbuffer_t *pxRingbuffer, const void *pvItem, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait);
+
+/*
+ * The following static functions are used instead of the above in SPSC ring
+ * buffers. They don't need a critical section, but functions marked as
+ * producer or consumer must only be called by the producer or the consumer.
+ */
+
+//Checks if an item will currently fit in a no-split/allow-split SPSC ring buffer (producer)
+static BaseType_t prvCheckItemFitsDefaultSPSC(Ringbuffer_t *pxRingbuffer, size_t xItemSize);
+
+//Checks if an item will currently fit in an SPSC byte buffer (producer)
+static BaseType_t prvCheckItemFitsByteBufferSPSC(Ringbuffer_t *pxRingbuffer, size_t xItemSize);
+
+//Copies an item to a no-split SPSC ring buffer. Only call this function after calling prvCheckItemFitsDefaultSPSC() (producer)
+static void prvCopyItemNoSplitSPSC(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize);
+
+//Copies an item to an allow-split SPSC ring buffer. Only call this function after calling prvCheckItemFitsDefaultSPSC() (producer)
+static void prvCopyItemAllowSplitSPSC(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize);
+
+//Copies an item to an SPSC byte buffer. Only call this function after calling prvCheckItemFitsByteBufferSPSC() (producer)
+static void prvCopyItemByteBufSPSC(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize);
+
+//Checks if an item/data is currently available for retrieval from an SPSC ring buffer (consumer)
+static BaseType_t prvCheckItemAvailSPSC(Ringbuffer_t *pxRingbuffer);
+
+//Retrieve item from no-split/allow-split SPSC ring buffer (consumer)
+static void *prvGetItemDefaultSPSC(Ringbuffer_t *pxRingbuffer, BaseType_t *pxIsSplit, size_t xUnusedParam, size_t *pxItemSize);
+
+//Retrieve data from SPSC byte buffer. If xMaxSize is 0, all continuous data is retrieved (consumer)
+static void *prvGetItemByteBufSPSC(Ringbuffer_t *pxRingbuffer, BaseType_t *pxUnusedParam, size_t xMaxSize, size_t *pxItemSize);
+
+//Return an item to a split/no-split SPSC ring buffer (consumer)
+static void prvReturnItemDefaultSPSC(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem);
+
+//Return data to an SPSC byte buffer (consumer)
+static void prvReturnItemByteBufSPSC(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem);
+
+//Get the maximum size an item that can currently have if sent to an SPSC ring buffer of any type (producer)
+static size_t prvGetCurMaxSizeSPSC(Ringbuffer_t *pxRingbuffer);
+
+//Send an item to an SPSC ring buffer, blocking until it fits or timeout (producer)
+static BaseType_t prvSendSPSC(Ringbuffer_t *pxRingbuffer, const void *pvItem, size_t xItemSize, TickType_t xTicksToWait);
+
+//Retrieve an item/data (and the second part of a split item) from an SPSC ring buffer with an item available (consumer)
+static void prvGetItemsSPSC(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize);
+
+//Retrieve an item/data from an SPSC ring buffer, see prvReceiveGeneric() (consumer)
+static BaseType_t prvReceiveGenericSPSC(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize, TickType_t xTicksToWait);
+
+//Retrieve an item/data from an SPSC ring buffer in an ISR (consumer)
+static BaseType_t prvReceiveGenericFromISRSPSC(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize);
+
 /* ------------------------------------------------ Static Definitions ------------------------------------------- */
 
 static size_t prvGetFreeSize(Ringbuffer_t *pxRingbuffer)
@@ -202,7 +301,7 @@ static BaseType_t prvCheckItemFitsByteBuffer( Ringbuffer_t *pxRingbuffer, size_t
     return (xItemSize <= pxRingbuffer->xSize - (pxRingbuffer->pucWrite - pxRingbuffer->pucFree)) ? pdTRUE : pdFALSE;
 }
 
-static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+static uint8_t *prvAcquireItemNoSplit(Ringbuffer_t *pxRingbuffer, size_t xItemSize)
 {
     //Check arguments and buffer state
     size_t xAlignedItemSize = rbALIGN_SIZE(xItemSize);                  //Rounded up aligned item size
@@ -219,13 +318,12 @@ static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucIte
         pxRingbuffer->pucWrite = pxRingbuffer->pucHead;     //Reset write pointer to wrap around
     }
 
-    //Item should be guaranteed to fit at this point. Set item header and copy data
+    //Item should be guaranteed to fit at this point. Set item header, the data is written by the caller
     ItemHeader_t *pxHeader = (ItemHeader_t *)pxRingbuffer->pucWrite;
     pxHeader->xItemLen = xItemSize;
-    pxHeader->uxItemFlags = 0;
+    pxHeader->uxItemFlags = rbITEM_ACQUIRED_FLAG;   //Item cannot be read until prvSendItemDoneNoSplit() is called
     pxRingbuffer->pucWrite += rbHEADER_SIZE;    //Advance pucWrite past header
-    memcpy(pxRingbuffer->pucWrite, pucItem, xItemSize);
-    pxRingbuffer->xItemsWaiting++;
+    uint8_t *pucItem = pxRingbuffer->pucWrite;
     pxRingbuffer->pucWrite += xAlignedItemSize; //Advance pucWrite past item to next aligned address
 
     //If current remaining length can't fit a header, wrap around write pointer
@@ -237,6 +335,28 @@ static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucIte
         //Mark the buffer as full to distinguish with an empty buffer
         pxRingbuffer->uxRingbufferFlags |= rbBUFFER_FULL_FLAG;
     }
+    return pucItem;
+}
+
+static void prvSendItemDoneNoSplit(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
+{
+    //Check arguments and item state
+    configASSERT(rbCHECK_ALIGNED(pucItem));
+    configASSERT(pucItem >= pxRingbuffer->pucHead);
+    configASSERT(pucItem <= pxRingbuffer->pucTail);     //Inclusive of pucTail in the case of zero length item at the very end
+    ItemHeader_t *pxHeader = (ItemHeader_t *)(pucItem - rbHEADER_SIZE);
+    configASSERT(pxHeader->uxItemFlags & rbITEM_ACQUIRED_FLAG);
+
+    //The item can now be read, once the items acquired before it have also been sent
+    pxHeader->uxItemFlags &= ~rbITEM_ACQUIRED_FLAG;
+    pxRingbuffer->xItemsWaiting++;
+}
+
+static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+{
+    uint8_t *pucData = prvAcquireItemNoSplit(pxRingbuffer, xItemSize);
+    memcpy(pucData, pucItem, xItemSize);
+    prvSendItemDoneNoSplit(pxRingbuffer, pucData);
 }
 
 static void prvCopyItemAllowSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
@@ -327,6 +447,16 @@ static BaseType_t prvCheckItemAvail(Ringbuffer_t *pxRingbuffer)
         return pdFALSE;     //Byte buffers do not allow multiple retrievals before return
     }
     if ((pxRingbuffer->xItemsWaiting > 0) && ((pxRingbuffer->pucRead != pxRingbuffer->pucWrite) || (pxRingbuffer->uxRingbufferFlags & rbBUFFER_FULL_FLAG))) {
+        if ((pxRingbuffer->uxRingbufferFlags & (rbALLOW_SPLIT_FLAG | rbBYTE_BUFFER_FLAG)) == 0) {
+            //No-split items must be read in order, the next one may still be acquired (see remark)
+            ItemHeader_t *pxHeader = (ItemHeader_t *)pxRingbuffer->pucRead;
+            if (pxHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
+                pxHeader = (ItemHeader_t *)pxRingbuffer->pucHead;
+            }
+            if (pxHeader->uxItemFlags & rbITEM_ACQUIRED_FLAG) {
+                return pdFALSE;
+            }
+        }
         return pdTRUE;      //Items/data available for retrieval
     } else {
         return pdFALSE;     //No items/data available for retrieval
@@ -351,6 +481,7 @@ static void *prvGetItemDefault(Ringbuffer_t *pxRingbuffer, BaseType_t *pxIsSplit
         pxHeader = (ItemHeader_t *)pxRingbuffer->pucRead;
         configASSERT(pxHeader->xItemLen <= pxRingbuffer->xMaxItemSize);
     }
+    configASSERT((pxHeader->uxItemFlags & rbITEM_ACQUIRED_FLAG) == 0);  //Acquired items should never be read
     pcReturn = pxRingbuffer->pucRead + rbHEADER_SIZE;    //Get pointer to part of item containing data (point past the header)
     if (pxHeader->xItemLen == 0) {
         //Inclusive of pucTail for special case where item of zero length just fits at the end of the buffer
@@ -431,8 +562,10 @@ static void prvReturnItemDefault(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
      * freed or items with dummy data should be skipped over
      */
     pxCurHeader = (ItemHeader_t *)pxRingbuffer->pucFree;
-    //Skip over Items that have already been freed or are dummy items
-    while (((pxCurHeader->uxItemFlags & rbITEM_FREE_FLAG) || (pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG)) && pxRingbuffer->pucFree != pxRingbuffer->pucRead) {
+    //Skip over Items that have already been freed or are dummy items. If the buffer is full, pucFree == pucRead
+    //can also mean that every item has been read, so the free pointer can advance
+    while (((pxCurHeader->uxItemFlags & rbITEM_FREE_FLAG) || (pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG)) &&
+           (pxRingbuffer->pucFree != pxRingbuffer->pucRead || (pxRingbuffer->uxRingbufferFlags & rbBUFFER_FULL_FLAG))) {
         if (pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
             pxCurHeader->uxItemFlags |= rbITEM_FREE_FLAG;   //Mark as freed (not strictly necessary but adds redundancy)
             pxRingbuffer->pucFree = pxRingbuffer->pucHead;    //Wrap around due to dummy data
@@ -448,16 +581,10 @@ static void prvReturnItemDefault(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
             pxRingbuffer->pucFree = pxRingbuffer->pucHead;
         }
         pxCurHeader = (ItemHeader_t *)pxRingbuffer->pucFree;      //Update header to point to item
-    }
-
-    //Check if the buffer full flag should be reset
-    if (pxRingbuffer->uxRingbufferFlags & rbBUFFER_FULL_FLAG) {
-        if (pxRingbuffer->pucFree != pxRingbuffer->pucWrite) {
-            pxRingbuffer->uxRingbufferFlags &= ~rbBUFFER_FULL_FLAG;
-        } else if (pxRingbuffer->pucFree == pxRingbuffer->pucWrite && pxRingbuffer->pucFree == pxRingbuffer->pucRead) {
-            //Special case where a full buffer is completely freed in one go
-            pxRingbuffer->uxRingbufferFlags &= ~rbBUFFER_FULL_FLAG;
-        }
+        //Space has been freed, so the buffer is no longer full. Checking pucFree != pucWrite instead would miss
+        //a full buffer which is completely freed in one go. Items returned out of order must not reset the flag,
+        //as pucFree == pucWrite == pucRead when all items of a full buffer have been read.
+        pxRingbuffer->uxRingbufferFlags &= ~rbBUFFER_FULL_FLAG;
     }
 }
 
@@ -494,12 +621,12 @@ static size_t prvGetCurMaxSizeNoSplit(Ringbuffer_t *pxRingbuffer)
 
     //No-split ring buffer items need space for a header
     xFreeSize -= rbHEADER_SIZE;
-    //Limit free size to be within bounds
-    if (xFreeSize > pxRingbuffer->xMaxItemSize) {
-        xFreeSize = pxRingbuffer->xMaxItemSize;
-    } else if (xFreeSize < 0) {
+    //Limit free size to be within bounds. Check for negative first, as comparing with xMaxItemSize is unsigned
+    if (xFreeSize < 0) {
         //Occurs when free space is less than header size
         xFreeSize = 0;
+    } else if (xFreeSize > pxRingbuffer->xMaxItemSize) {
+        xFreeSize = pxRingbuffer->xMaxItemSize;
     }
     return xFreeSize;
 }
@@ -524,11 +651,11 @@ static size_t prvGetCurMaxSizeAllowSplit(Ringbuffer_t *pxRingbuffer)
                     (rbHEADER_SIZE * 2);
     }
 
-    //Limit free size to be within bounds
-    if (xFreeSize > pxRingbuffer->xMaxItemSize) {
-        xFreeSize = pxRingbuffer->xMaxItemSize;
-    } else if (xFreeSize < 0) {
+    //Limit free size to be within bounds. Check for negative first, as comparing with xMaxItemSize is unsigned
+    if (xFreeSize < 0) {
         xFreeSize = 0;
+    } else if (xFreeSize > pxRingbuffer->xMaxItemSize) {
+        xFreeSize = pxRingbuffer->xMaxItemSize;
     }
     return xFreeSize;
 }
@@ -554,6 +681,10 @@ static size_t prvGetCurMaxSizeByteBuf(Ringbuffer_t *pxRingbuffer)
 
 static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize, TickType_t xTicksToWait)
 {
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return prvReceiveGenericSPSC(pxRingbuffer, pvItem1, pvItem2, xItemSize1, xItemSize2, xMaxSize, xTicksToWait);
+    }
+
     BaseType_t xReturn = pdFALSE;
     BaseType_t xReturnSemaphore = pdFALSE;
     TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
@@ -613,6 +744,10 @@ static BaseType_t prvReceiveGeneric(Ringbuffer_t *pxRingbuffer, void **pvItem1,
 
 static BaseType_t prvReceiveGenericFromISR(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize)
 {
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return prvReceiveGenericFromISRSPSC(pxRingbuffer, pvItem1, pvItem2, xItemSize1, xItemSize2, xMaxSize);
+    }
+
     BaseType_t xReturn = pdFALSE;
     BaseType_t xReturnSemaphore = pdFALSE;
 
@@ -649,9 +784,525 @@ static BaseType_t prvReceiveGenericFromISR(Ringbuffer_t *pxRingbuffer, void **pv
     return xReturn;
 }
 
+static UBaseType_t prvReceiveItemsGeneric(Ringbuffer_t *pxRingbuffer, void **ppvItems, size_t *pxItemSizes, UBaseType_t uxMaxItems, TickType_t xTicksToWait)
+{
+    UBaseType_t uxCount = 0;
+    BaseType_t xIsSplit;
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        //Block for the first item only, then take the items that are already available
+        if (prvReceiveGenericSPSC(pxRingbuffer, &ppvItems[0], NULL, &pxItemSizes[0], NULL, 0, xTicksToWait) != pdTRUE) {
+            return 0;
+        }
+        for (uxCount = 1; uxCount < uxMaxItems && prvCheckItemAvailSPSC(pxRingbuffer) == pdTRUE; uxCount++) {
+            ppvItems[uxCount] = pxRingbuffer->pvGetItem(pxRingbuffer, &xIsSplit, 0, &pxItemSizes[uxCount]);
+        }
+        return uxCount;
+    }
+
+    BaseType_t xReturnSemaphore = pdFALSE;
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    while (xTicksRemaining <= xTicksToWait) {   //xTicksToWait will underflow once xTaskGetTickCount() > ticks_end
+        //Block until more items become available or timeout
+        if (xSemaphoreTake(pxRingbuffer->xItemsBufferedSemaphore, xTicksRemaining) != pdTRUE) {
+            break;      //Timed out attempting to get semaphore
+        }
+
+        //Semaphore obtained, retrieve all available items up to uxMaxItems in the same critical section
+        portENTER_CRITICAL(&pxRingbuffer->mux);
+        while (uxCount < uxMaxItems && prvCheckItemAvail(pxRingbuffer) == pdTRUE) {
+            ppvItems[uxCount] = pxRingbuffer->pvGetItem(pxRingbuffer, &xIsSplit, 0, &pxItemSizes[uxCount]);
+            uxCount++;
+        }
+        if (uxCount > 0) {
+            if (pxRingbuffer->xItemsWaiting > 0) {
+                xReturnSemaphore = pdTRUE;
+            }
+            portEXIT_CRITICAL(&pxRingbuffer->mux);
+            break;
+        }
+        //No item available for retrieval, adjust ticks and take the semaphore again
+        if (xTicksToWait != portMAX_DELAY) {
+            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+        }
+        portEXIT_CRITICAL(&pxRingbuffer->mux);
+    }
+
+    if (xReturnSemaphore == pdTRUE) {
+        xSemaphoreGive(pxRingbuffer->xItemsBufferedSemaphore);  //Give semaphore back so other tasks can retrieve
+    }
+    return uxCount;
+}
+
+static BaseType_t prvSendAcquireGeneric(Ringbuffer_t *pxRingbuffer, const void *pvItem, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait)
+{
+    //Attempt to send an item
+    BaseType_t xReturn = pdFALSE;
+    BaseType_t xReturnSemaphore = pdFALSE;
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    while (xTicksRemaining <= xTicksToWait) {   //xTicksToWait will underflow once xTaskGetTickCount() > ticks_end
+        //Block until more free space becomes available or timeout
+        if (xSemaphoreTake(pxRingbuffer->xFreeSpaceSemaphore, xTicksRemaining) != pdTRUE && xTicksToWait != 0) {
+            xReturn = pdFALSE;
+            break;
+        }
+        /*
+         * Semaphore obtained, check if item can fit. Without a timeout, check even if the semaphore
+         * was not obtained: it may only be held by another task sending at the same time, and the
+         * critical section is enough to allocate the item.
+         */
+        portENTER_CRITICAL(&pxRingbuffer->mux);
+        if(pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) == pdTRUE) {
+            //Item will fit, copy item or acquire space for it
+            if (ppvItem != NULL) {
+                *ppvItem = prvAcquireItemNoSplit(pxRingbuffer, xItemSize);
+            } else {
+                pxRingbuffer->vCopyItem(pxRingbuffer, pvItem, xItemSize);
+            }
+            xReturn = pdTRUE;
+            //Check if the free semaphore should be returned to allow other tasks to send
+            if (prvGetFreeSize(pxRingbuffer) > 0) {
+                xReturnSemaphore = pdTRUE;
+            }
+            portEXIT_CRITICAL(&pxRingbuffer->mux);
+            break;
+        }
+        //Item doesn't fit, adjust ticks and take the semaphore again
+        if (xTicksToWait == 0) {
+            portEXIT_CRITICAL(&pxRingbuffer->mux);
+            break;
+        }
+        if (xTicksToWait != portMAX_DELAY) {
+            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+        }
+        portEXIT_CRITICAL(&pxRingbuffer->mux);
+        /*
+         * Gap between critical section and re-acquiring of the semaphore. If
+         * semaphore is given now, priority inversion might occur (see docs)
+         */
+    }
+
+    if (xReturn == pdTRUE && ppvItem == NULL) {
+        //Indicate item was successfully sent. Acquired items are only readable once completed
+        xSemaphoreGive(pxRingbuffer->xItemsBufferedSemaphore);
+    }
+    if (xReturnSemaphore == pdTRUE) {
+        xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);  //Give back semaphore so other tasks can send
+    }
+    return xReturn;
+}
+
+/* --------------------------------------------- SPSC Static Definitions ----------------------------------------- */
+
+static inline size_t prvGetPositionSPSC(Ringbuffer_t *pxRingbuffer, size_t xIndex)
+{
+    //Indexes count up to twice the buffer size, see remark
+    return (xIndex < pxRingbuffer->xSize) ? xIndex : xIndex - pxRingbuffer->xSize;
+}
+
+static inline size_t prvAdvanceIndexSPSC(Ringbuffer_t *pxRingbuffer, size_t xIndex, size_t xLength)
+{
+    xIndex += xLength;
+    if (xIndex >= pxRingbuffer->xSize * 2) {
+        xIndex -= pxRingbuffer->xSize * 2;
+    }
+    return xIndex;
+}
+
+static inline size_t prvWrapIndexSPSC(Ringbuffer_t *pxRingbuffer, size_t xIndex)
+{
+    //Skip the rest of the buffer, to the start of the buffer in the next lap
+    return (xIndex < pxRingbuffer->xSize) ? pxRingbuffer->xSize : 0;
+}
+
+static inline size_t prvNextItemIndexSPSC(Ringbuffer_t *pxRingbuffer, size_t xIndex, size_t xItemLen)
+{
+    xIndex = prvAdvanceIndexSPSC(pxRingbuffer, xIndex, rbHEADER_SIZE + rbALIGN_SIZE(xItemLen));
+    //Wrap around if the remaining length can't fit a header
+    if (pxRingbuffer->xSize - prvGetPositionSPSC(pxRingbuffer, xIndex) < rbHEADER_SIZE) {
+        xIndex = prvWrapIndexSPSC(pxRingbuffer, xIndex);
+    }
+    return xIndex;
+}
+
+static inline size_t prvGetUsedSizeSPSC(Ringbuffer_t *pxRingbuffer, size_t xWriteIndex, size_t xFreeIndex)
+{
+    size_t xUsedSize = (xWriteIndex >= xFreeIndex) ? xWriteIndex - xFreeIndex : xWriteIndex + pxRingbuffer->xSize * 2 - xFreeIndex;
+    configASSERT(xUsedSize <= pxRingbuffer->xSize);
+    return xUsedSize;
+}
+
+static BaseType_t prvCheckItemFitsDefaultSPSC(Ringbuffer_t *pxRingbuffer, size_t xItemSize)
+{
+    size_t xWriteIndex = pxRingbuffer->xWriteIndex;
+    size_t xFreeIndex = rbSPSC_LOAD(pxRingbuffer->xFreeIndex);
+    size_t xUsedSize = prvGetUsedSizeSPSC(pxRingbuffer, xWriteIndex, xFreeIndex);
+    size_t xWritePos = prvGetPositionSPSC(pxRingbuffer, xWriteIndex);
+    size_t xFreePos = prvGetPositionSPSC(pxRingbuffer, xFreeIndex);
+
+    size_t xTotalItemSize = rbALIGN_SIZE(xItemSize) + rbHEADER_SIZE;    //Rounded up aligned item size with header
+    if (xUsedSize == 0 || xUsedSize == pxRingbuffer->xSize) {
+        //Buffer is either complete empty or completely full
+        return (xUsedSize == 0) ? pdTRUE : pdFALSE;
+    }
+    if (xFreePos > xWritePos) {
+        //Free space does not wrap around
+        return (xTotalItemSize <= xFreePos - xWritePos) ? pdTRUE : pdFALSE;
+    }
+    //Free space wraps around
+    if (xTotalItemSize <= pxRingbuffer->xSize - xWritePos) {
+        return pdTRUE;      //Item fits without wrapping around
+    }
+    //Check if item fits by wrapping
+    if (pxRingbuffer->uxRingbufferFlags & rbALLOW_SPLIT_FLAG) {
+        //Allow split wrapping incurs an extra header
+        return (xTotalItemSize + rbHEADER_SIZE <= pxRingbuffer->xSize - xUsedSize) ? pdTRUE : pdFALSE;
+    } else {
+        return (xTotalItemSize <= xFreePos) ? pdTRUE : pdFALSE;
+    }
+}
+
+static BaseType_t prvCheckItemFitsByteBufferSPSC(Ringbuffer_t *pxRingbuffer, size_t xItemSize)
+{
+    size_t xUsedSize = prvGetUsedSizeSPSC(pxRingbuffer, pxRingbuffer->xWriteIndex, rbSPSC_LOAD(pxRingbuffer->xFreeIndex));
+    return (xItemSize <= pxRingbuffer->xSize - xUsedSize) ? pdTRUE : pdFALSE;
+}
+
+static void prvCopyItemNoSplitSPSC(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+{
+    //Check arguments and buffer state
+    size_t xWriteIndex = pxRingbuffer->xWriteIndex;
+    uint8_t *pucWrite = pxRingbuffer->pucHead + prvGetPositionSPSC(pxRingbuffer, xWriteIndex);
+    size_t xAlignedItemSize = rbALIGN_SIZE(xItemSize);                  //Rounded up aligned item size
+    size_t xRemLen = pxRingbuffer->pucTail - pucWrite;                  //Length from pucWrite until end of buffer
+    configASSERT(rbCHECK_ALIGNED(pucWrite));                            //pucWrite is always aligned in no-split ring buffers
+    configASSERT(xRemLen >= rbHEADER_SIZE);                             //Remaining length must be able to at least fit an item header
+
+    //If remaining length can't fit item, set as dummy data and wrap around
+    if (xRemLen < xAlignedItemSize + rbHEADER_SIZE) {
+        ItemHeader_t *pxDummy = (ItemHeader_t *)pucWrite;
+        pxDummy->uxItemFlags = rbITEM_DUMMY_DATA_FLAG;      //Set remaining length as dummy data
+        pxDummy->xItemLen = 0;                              //Dummy data should have no length
+        xWriteIndex = prvWrapIndexSPSC(pxRingbuffer, xWriteIndex);
+        pucWrite = pxRingbuffer->pucHead;
+    }
+
+    //Item should be guaranteed to fit at this point. Set item header and copy data
+    ItemHeader_t *pxHeader = (ItemHeader_t *)pucWrite;
+    pxHeader->xItemLen = xItemSize;
+    pxHeader->uxItemFlags = 0;
+    memcpy(pucWrite + rbHEADER_SIZE, pucItem, xItemSize);
+    rbSPSC_STORE_RELAXED(pxRingbuffer->uxItemsWritten, pxRingbuffer->uxItemsWritten + 1);
+    //Publish the item to the consumer
+    rbSPSC_STORE(pxRingbuffer->xWriteIndex, prvNextItemIndexSPSC(pxRingbuffer, xWriteIndex, xItemSize));
+}
+
+static void prvCopyItemAllowSplitSPSC(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+{
+    //Check arguments and buffer state
+    size_t xWriteIndex = pxRingbuffer->xWriteIndex;
+    uint8_t *pucWrite = pxRingbuffer->pucHead + prvGetPositionSPSC(pxRingbuffer, xWriteIndex);
+    size_t xAlignedItemSize = rbALIGN_SIZE(xItemSize);                  //Rounded up aligned item size
+    size_t xRemLen = pxRingbuffer->pucTail - pucWrite;                  //Length from pucWrite until end of buffer
+    UBaseType_t uxItemsWritten = pxRingbuffer->uxItemsWritten;
+    configASSERT(rbCHECK_ALIGNED(pucWrite));                            //pucWrite is always aligned in split ring buffers
+    configASSERT(xRemLen >= rbHEADER_SIZE);                             //Remaining length must be able to at least fit an item header
+
+    //Split item if necessary
+    if (xRemLen < xAlignedItemSize + rbHEADER_SIZE) {
+        //Write first part of the item
+        ItemHeader_t *pxFirstHeader = (ItemHeader_t *)pucWrite;
+        pxFirstHeader->uxItemFlags = 0;
+        pxFirstHeader->xItemLen = xRemLen - rbHEADER_SIZE;  //Fill remaining length with first part
+        xRemLen -= rbHEADER_SIZE;
+        if (xRemLen > 0) {
+            memcpy(pucWrite + rbHEADER_SIZE, pucItem, xRemLen);
+            uxItemsWritten++;
+            //Update item arguments to account for data already copied
+            pucItem += xRemLen;
+            xItemSize -= xRemLen;
+            pxFirstHeader->uxItemFlags |= rbITEM_SPLIT_FLAG;        //There must be more data
+        } else {
+            //Remaining length was only large enough to fit header
+            pxFirstHeader->uxItemFlags |= rbITEM_DUMMY_DATA_FLAG;   //Item will completely be stored in 2nd part
+        }
+        xWriteIndex = prvWrapIndexSPSC(pxRingbuffer, xWriteIndex);
+        pucWrite = pxRingbuffer->pucHead;
+    }
+
+    //Item (whole or second part) should be guaranteed to fit at this point
+    ItemHeader_t *pxSecondHeader = (ItemHeader_t *)pucWrite;
+    pxSecondHeader->xItemLen = xItemSize;
+    pxSecondHeader->uxItemFlags = 0;
+    memcpy(pucWrite + rbHEADER_SIZE, pucItem, xItemSize);
+    uxItemsWritten++;
+    rbSPSC_STORE_RELAXED(pxRingbuffer->uxItemsWritten, uxItemsWritten);
+    //Publish both parts to the consumer at once
+    rbSPSC_STORE(pxRingbuffer->xWriteIndex, prvNextItemIndexSPSC(pxRingbuffer, xWriteIndex, xItemSize));
+}
+
+static void prvCopyItemByteBufSPSC(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+{
+    size_t xWriteIndex = pxRingbuffer->xWriteIndex;
+    uint8_t *pucWrite = pxRingbuffer->pucHead + prvGetPositionSPSC(pxRingbuffer, xWriteIndex);
+    size_t xRemLen = pxRingbuffer->pucTail - pucWrite;      //Length from pucWrite until end of buffer
+    if (xRemLen < xItemSize) {
+        //Copy as much as possible into remaining length, and the rest to the start of the buffer
+        memcpy(pucWrite, pucItem, xRemLen);
+        memcpy(pxRingbuffer->pucHead, pucItem + xRemLen, xItemSize - xRemLen);
+    } else {
+        memcpy(pucWrite, pucItem, xItemSize);
+    }
+    rbSPSC_STORE_RELAXED(pxRingbuffer->uxItemsWritten, pxRingbuffer->uxItemsWritten + xItemSize);
+    //Publish the data to the consumer
+    rbSPSC_STORE(pxRingbuffer->xWriteIndex, prvAdvanceIndexSPSC(pxRingbuffer, xWriteIndex, xItemSize));
+}
+
+static BaseType_t prvCheckItemAvailSPSC(Ringbuffer_t *pxRingbuffer)
+{
+    if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) && pxRingbuffer->xReadIndex != pxRingbuffer->xFreeIndex) {
+        return pdFALSE;     //Byte buffers do not allow multiple retrievals before return
+    }
+    //The acquire load makes the data written before the write index visible
+    return (pxRingbuffer->xReadIndex != rbSPSC_LOAD(pxRingbuffer->xWriteIndex)) ? pdTRUE : pdFALSE;
+}
+
+static void *prvGetItemDefaultSPSC(Ringbuffer_t *pxRingbuffer, BaseType_t *pxIsSplit, size_t xUnusedParam, size_t *pxItemSize)
+{
+    //Check arguments and buffer state
+    size_t xReadIndex = pxRingbuffer->xReadIndex;
+    ItemHeader_t *pxHeader = (ItemHeader_t *)(pxRingbuffer->pucHead + prvGetPositionSPSC(pxRingbuffer, xReadIndex));
+    configASSERT(pxIsSplit != NULL);
+    configASSERT(rbCHECK_ALIGNED(pxHeader));                        //Read position is always aligned in split ring buffers
+    configASSERT((pxHeader->xItemLen <= pxRingbuffer->xMaxItemSize) || (pxHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG));
+
+    //Wrap around if dummy data (dummy data indicates wrap around in no-split buffers)
+    if (pxHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
+        xReadIndex = prvWrapIndexSPSC(pxRingbuffer, xReadIndex);
+        //Check for errors with the next item
+        pxHeader = (ItemHeader_t *)pxRingbuffer->pucHead;
+        configASSERT(pxHeader->xItemLen <= pxRingbuffer->xMaxItemSize);
+    }
+    *pxItemSize = pxHeader->xItemLen;   //Get length of item
+    *pxIsSplit = (pxHeader->uxItemFlags & rbITEM_SPLIT_FLAG) ? pdTRUE : pdFALSE;
+
+    rbSPSC_STORE_RELAXED(pxRingbuffer->uxItemsRead, pxRingbuffer->uxItemsRead + 1);
+    rbSPSC_STORE_RELAXED(pxRingbuffer->xReadIndex, prvNextItemIndexSPSC(pxRingbuffer, xReadIndex, pxHeader->xItemLen));
+    return (void *)((uint8_t *)pxHeader + rbHEADER_SIZE);   //Point past the header
+}
+
+static void *prvGetItemByteBufSPSC(Ringbuffer_t *pxRingbuffer, BaseType_t *pxUnusedParam, size_t xMaxSize, size_t *pxItemSize)
+{
+    //Check arguments and buffer state
+    size_t xReadIndex = pxRingbuffer->xReadIndex;
+    size_t xReadPos = prvGetPositionSPSC(pxRingbuffer, xReadIndex);
+    size_t xAvailSize = prvGetUsedSizeSPSC(pxRingbuffer, rbSPSC_LOAD(pxRingbuffer->xWriteIndex), xReadIndex);
+    configASSERT(xAvailSize > 0);
+    configASSERT(xReadIndex == pxRingbuffer->xFreeIndex);
+
+    //Return contiguous data from the read position, up to the buffer tail or xMaxSize
+    size_t xSize = pxRingbuffer->xSize - xReadPos;
+    if (xAvailSize < xSize) {
+        xSize = xAvailSize;
+    }
+    if (xMaxSize != 0 && xMaxSize < xSize) {
+        xSize = xMaxSize;
+    }
+    *pxItemSize = xSize;
+    rbSPSC_STORE_RELAXED(pxRingbuffer->uxItemsRead, pxRingbuffer->uxItemsRead + xSize);
+    rbSPSC_STORE_RELAXED(pxRingbuffer->xReadIndex, prvAdvanceIndexSPSC(pxRingbuffer, xReadIndex, xSize));
+    return (void *)(pxRingbuffer->pucHead + xReadPos);
+}
+
+static void prvReturnItemDefaultSPSC(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
+{
+    //Check arguments and buffer state
+    configASSERT(rbCHECK_ALIGNED(pucItem));
+    configASSERT(pucItem >= pxRingbuffer->pucHead);
+    configASSERT(pucItem <= pxRingbuffer->pucTail);     //Inclusive of pucTail in the case of zero length item at the very end
+
+    //Get and check header of the item
+    ItemHeader_t *pxCurHeader = (ItemHeader_t *)(pucItem - rbHEADER_SIZE);
+    configASSERT(pxCurHeader->xItemLen <= pxRingbuffer->xMaxItemSize);
+    configASSERT((pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) == 0); //Dummy items should never have been read
+    configASSERT((pxCurHeader->uxItemFlags & rbITEM_FREE_FLAG) == 0);       //Indicates item has already been returned before
+    pxCurHeader->uxItemFlags &= ~rbITEM_SPLIT_FLAG;                         //Clear wrap flag if set (not strictly necessary)
+    pxCurHeader->uxItemFlags |= rbITEM_FREE_FLAG;                           //Mark as free
+
+    /*
+     * Move the free index up to the next item that has not been marked as free
+     * or up till the read index, as prvReturnItemDefault() does. Headers past
+     * the read index may be written by the producer, so it is checked first.
+     */
+    size_t xFreeIndex = pxRingbuffer->xFreeIndex;
+    while (xFreeIndex != pxRingbuffer->xReadIndex) {
+        pxCurHeader = (ItemHeader_t *)(pxRingbuffer->pucHead + prvGetPositionSPSC(pxRingbuffer, xFreeIndex));
+        if (pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
+            pxCurHeader->uxItemFlags |= rbITEM_FREE_FLAG;   //Mark as freed (not strictly necessary but adds redundancy)
+            xFreeIndex = prvWrapIndexSPSC(pxRingbuffer, xFreeIndex);  //Wrap around due to dummy data
+        } else if (pxCurHeader->uxItemFlags & rbITEM_FREE_FLAG) {
+            //Item with data that has already been freed, advance free index past this item
+            xFreeIndex = prvNextItemIndexSPSC(pxRingbuffer, xFreeIndex, pxCurHeader->xItemLen);
+        } else {
+            break;
+        }
+    }
+    //Publish the free space to the producer
+    rbSPSC_STORE(pxRingbuffer->xFreeIndex, xFreeIndex);
+}
+
+static void prvReturnItemByteBufSPSC(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
+{
+    //Check pointer points to address inside buffer
+    configASSERT((uint8_t *)pucItem >= pxRingbuffer->pucHead);
+    configASSERT((uint8_t *)pucItem < pxRingbuffer->pucTail);
+    //Free the read memory. Simply moves free index to read index as byte buffers do not allow multiple outstanding reads
+    rbSPSC_STORE(pxRingbuffer->xFreeIndex, pxRingbuffer->xReadIndex);
+}
+
+static size_t prvGetCurMaxSizeSPSC(Ringbuffer_t *pxRingbuffer)
+{
+    size_t xWriteIndex = pxRingbuffer->xWriteIndex;
+    size_t xFreeIndex = rbSPSC_LOAD(pxRingbuffer->xFreeIndex);
+    size_t xUsedSize = prvGetUsedSizeSPSC(pxRingbuffer, xWriteIndex, xFreeIndex);
+    size_t xWritePos = prvGetPositionSPSC(pxRingbuffer, xWriteIndex);
+    size_t xFreePos = prvGetPositionSPSC(pxRingbuffer, xFreeIndex);
+    BaseType_t xFreeSize;
+
+    //Same as prvGetCurMaxSizeNoSplit/AllowSplit/ByteBuf(), with the positions of the indexes
+    if (xUsedSize == pxRingbuffer->xSize) {
+        return 0;
+    }
+    if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+        return pxRingbuffer->xSize - xUsedSize;
+    }
+    if (pxRingbuffer->uxRingbufferFlags & rbALLOW_SPLIT_FLAG) {
+        if (xWritePos == 0 && xFreePos == 0) {
+            xFreeSize = pxRingbuffer->xSize - rbHEADER_SIZE;
+        } else if (xWritePos < xFreePos) {
+            xFreeSize = (xFreePos - xWritePos) - rbHEADER_SIZE;
+        } else {
+            xFreeSize = xFreePos + (pxRingbuffer->xSize - xWritePos) - (rbHEADER_SIZE * 2);
+        }
+    } else {
+        if (xWritePos < xFreePos) {
+            xFreeSize = xFreePos - xWritePos;
+        } else {
+            size_t xSize1 = pxRingbuffer->xSize - xWritePos;
+            xFreeSize = (xSize1 > xFreePos) ? xSize1 : xFreePos;
+        }
+        xFreeSize -= rbHEADER_SIZE;
+    }
+
+    //Limit free size to be within bounds
+    if (xFreeSize < 0) {
+        xFreeSize = 0;
+    } else if (xFreeSize > pxRingbuffer->xMaxItemSize) {
+        xFreeSize = pxRingbuffer->xMaxItemSize;
+    }
+    return xFreeSize;
+}
+
+static BaseType_t prvSendSPSC(Ringbuffer_t *pxRingbuffer, const void *pvItem, size_t xItemSize, TickType_t xTicksToWait)
+{
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    while (pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) != pdTRUE) {
+        if (xTicksRemaining == 0 || xTicksRemaining > xTicksToWait) {   //xTicksRemaining will underflow once xTaskGetTickCount() > xTicksEnd
+            return pdFALSE;
+        }
+        /*
+         * Block until the consumer frees space. Checking again after setting
+         * xWriterWaiting ensures that either the consumer sees the flag after
+         * publishing the free space and gives the semaphore, or the space is seen here
+         */
+        rbSPSC_STORE_RELAXED(pxRingbuffer->xWriterWaiting, pdTRUE);
+        rbSPSC_FENCE();
+        BaseType_t xTaken = pdTRUE;
+        if (pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) != pdTRUE) {
+            xTaken = xSemaphoreTake(pxRingbuffer->xFreeSpaceSemaphore, xTicksRemaining);
+        }
+        rbSPSC_STORE_RELAXED(pxRingbuffer->xWriterWaiting, pdFALSE);
+        if (xTaken != pdTRUE) {
+            return pdFALSE;
+        }
+        //The semaphore may have been given earlier than needed, check again
+        if (xTicksToWait != portMAX_DELAY) {
+            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+        }
+    }
+    pxRingbuffer->vCopyItem(pxRingbuffer, pvItem, xItemSize);
+
+    //Wake up the consumer if it is blocked
+    rbSPSC_FENCE();
+    if (rbSPSC_LOAD_RELAXED(pxRingbuffer->xReaderWaiting)) {
+        xSemaphoreGive(pxRingbuffer->xItemsBufferedSemaphore);
+    }
+    return pdTRUE;
+}
+
+static void prvGetItemsSPSC(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize)
+{
+    BaseType_t xIsSplit = pdFALSE;
+    if (pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) {
+        //Second argument (pxIsSplit) is unused for byte buffers
+        *pvItem1 = pxRingbuffer->pvGetItem(pxRingbuffer, NULL, xMaxSize, xItemSize1);
+    } else {
+        //Third argument (xMaxSize) is unused for no-split/allow-split buffers
+        *pvItem1 = pxRingbuffer->pvGetItem(pxRingbuffer, &xIsSplit, 0, xItemSize1);
+    }
+    //Check for item split if configured to do so. Both parts are published at once
+    if ((pxRingbuffer->uxRingbufferFlags & rbALLOW_SPLIT_FLAG) && (pvItem2 != NULL) && (xItemSize2 != NULL)) {
+        if (xIsSplit == pdTRUE) {
+            *pvItem2 = pxRingbuffer->pvGetItem(pxRingbuffer, &xIsSplit, 0, xItemSize2);
+            configASSERT(*pvItem2 < *pvItem1);  //Check wrap around has occurred
+            configASSERT(xIsSplit == pdFALSE);  //Second part should not have wrapped flag
+        } else {
+            *pvItem2 = NULL;
+        }
+    }
+}
+
+static BaseType_t prvReceiveGenericSPSC(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize, TickType_t xTicksToWait)
+{
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    while (prvCheckItemAvailSPSC(pxRingbuffer) != pdTRUE) {
+        if (xTicksRemaining == 0 || xTicksRemaining > xTicksToWait) {   //xTicksRemaining will underflow once xTaskGetTickCount() > xTicksEnd
+            return pdFALSE;
+        }
+        //Block until the producer sends an item, see prvSendSPSC()
+        rbSPSC_STORE_RELAXED(pxRingbuffer->xReaderWaiting, pdTRUE);
+        rbSPSC_FENCE();
+        BaseType_t xTaken = pdTRUE;
+        if (prvCheckItemAvailSPSC(pxRingbuffer) != pdTRUE) {
+            xTaken = xSemaphoreTake(pxRingbuffer->xItemsBufferedSemaphore, xTicksRemaining);
+        }
+        rbSPSC_STORE_RELAXED(pxRingbuffer->xReaderWaiting, pdFALSE);
+        if (xTaken != pdTRUE) {
+            return pdFALSE;
+        }
+        if (xTicksToWait != portMAX_DELAY) {
+            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+        }
+    }
+    prvGetItemsSPSC(pxRingbuffer, pvItem1, pvItem2, xItemSize1, xItemSize2, xMaxSize);
+    return pdTRUE;
+}
+
+static BaseType_t prvReceiveGenericFromISRSPSC(Ringbuffer_t *pxRingbuffer, void **pvItem1, void **pvItem2, size_t *xItemSize1, size_t *xItemSize2, size_t xMaxSize)
+{
+    if (prvCheckItemAvailSPSC(pxRingbuffer) != pdTRUE) {
+        return pdFALSE;
+    }
+    prvGetItemsSPSC(pxRingbuffer, pvItem1, pvItem2, xItemSize1, xItemSize2, xMaxSize);
+    return pdTRUE;
+}
+
 /* ------------------------------------------------- Public Definitions -------------------------------------------- */
 
-RingbufHandle_t xRingbufferCreate(size_t xBufferSize, ringbuf_type_t xBufferType)
+static RingbufHandle_t prvCreateGeneric(size_t xBufferSize, ringbuf_type_t xBufferType, BaseType_t xIsSPSC)
 {
     //Allocate memory
     Ringbuffer_t *pxRingbuffer = calloc(1, sizeof(Ringbuffer_t));
@@ -713,10 +1364,30 @@ RingbufHandle_t xRingbufferCreate(size_t xBufferSize, ringbuf_type_t xBufferType
         configASSERT(0);
     }
 
+    if (xIsSPSC == pdTRUE) {
+        //Same item formats and maximum item sizes, lock-free functions
+        pxRingbuffer->uxRingbufferFlags |= rbSPSC_FLAG;
+        if (xBufferType == RINGBUF_TYPE_BYTEBUF) {
+            pxRingbuffer->xCheckItemFits = prvCheckItemFitsByteBufferSPSC;
+            pxRingbuffer->vCopyItem = prvCopyItemByteBufSPSC;
+            pxRingbuffer->pvGetItem = prvGetItemByteBufSPSC;
+            pxRingbuffer->vReturnItem = prvReturnItemByteBufSPSC;
+        } else {
+            pxRingbuffer->xCheckItemFits = prvCheckItemFitsDefaultSPSC;
+            pxRingbuffer->vCopyItem = (xBufferType == RINGBUF_TYPE_ALLOWSPLIT) ? prvCopyItemAllowSplitSPSC : prvCopyItemNoSplitSPSC;
+            pxRingbuffer->pvGetItem = prvGetItemDefaultSPSC;
+            pxRingbuffer->vReturnItem = prvReturnItemDefaultSPSC;
+        }
+        pxRingbuffer->xGetCurMaxSize = prvGetCurMaxSizeSPSC;
+    }
+
     if (pxRingbuffer->xFreeSpaceSemaphore == NULL || pxRingbuffer->xItemsBufferedSemaphore == NULL) {
         goto err;
     }
-    xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);
+    if (xIsSPSC != pdTRUE) {
+        //SPSC ring buffers only give the semaphores to wake up a blocked producer/consumer
+        xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);
+    }
     vPortCPUInitializeMutex(&pxRingbuffer->mux);
 
     return (RingbufHandle_t)pxRingbuffer;
@@ -736,6 +1407,16 @@ err:
     return NULL;
 }
 
+RingbufHandle_t xRingbufferCreate(size_t xBufferSize, ringbuf_type_t xBufferType)
+{
+    return prvCreateGeneric(xBufferSize, xBufferType, pdFALSE);
+}
+
+RingbufHandle_t xRingbufferCreateSPSC(size_t xBufferSize, ringbuf_type_t xBufferType)
+{
+    return prvCreateGeneric(xBufferSize, xBufferType, pdTRUE);
+}
+
 RingbufHandle_t xRingbufferCreateNoSplit(size_t xItemSize, size_t xItemNum)
 {
     return xRingbufferCreate((rbALIGN_SIZE(xItemSize) + rbHEADER_SIZE) * xItemNum, RINGBUF_TYPE_NOSPLIT);
@@ -753,49 +1434,50 @@ BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size
     if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) && xItemSize == 0) {
         return pdTRUE;      //Sending 0 bytes to byte buffer has no effect
     }
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return prvSendSPSC(pxRingbuffer, pvItem, xItemSize, xTicksToWait);
+    }
+
+    return prvSendAcquireGeneric(pxRingbuffer, pvItem, NULL, xItemSize, xTicksToWait);
+}
+
+BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(ppvItem != NULL);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbALLOW_SPLIT_FLAG | rbBYTE_BUFFER_FLAG | rbSPSC_FLAG)) == 0);  //Send acquire currently only supported in no-split buffers
+
+    *ppvItem = NULL;
+    if (xItemSize > pxRingbuffer->xMaxItemSize) {
+        return pdFALSE;     //Data will never ever fit in the queue.
+    }
+    return prvSendAcquireGeneric(pxRingbuffer, NULL, ppvItem, xItemSize, xTicksToWait);
+}
+
+BaseType_t xRingbufferSendComplete(RingbufHandle_t xRingbuffer, void *pvItem)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(pvItem != NULL);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbALLOW_SPLIT_FLAG | rbBYTE_BUFFER_FLAG | rbSPSC_FLAG)) == 0);
 
-    //Attempt to send an item
     BaseType_t xReturn = pdFALSE;
-    BaseType_t xReturnSemaphore = pdFALSE;
-    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
-    TickType_t xTicksRemaining = xTicksToWait;
-    while (xTicksRemaining <= xTicksToWait) {   //xTicksToWait will underflow once xTaskGetTickCount() > ticks_end
-        //Block until more free space becomes available or timeout
-        if (xSemaphoreTake(pxRingbuffer->xFreeSpaceSemaphore, xTicksRemaining) != pdTRUE) {
-            xReturn = pdFALSE;
-            break;
-        }
-        //Semaphore obtained, check if item can fit
-        portENTER_CRITICAL(&pxRingbuffer->mux);
-        if(pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) == pdTRUE) {
-            //Item will fit, copy item
-            pxRingbuffer->vCopyItem(pxRingbuffer, pvItem, xItemSize);
-            xReturn = pdTRUE;
-            //Check if the free semaphore should be returned to allow other tasks to send
-            if (prvGetFreeSize(pxRingbuffer) > 0) {
-                xReturnSemaphore = pdTRUE;
-            }
-            portEXIT_CRITICAL(&pxRingbuffer->mux);
-            break;
-        }
-        //Item doesn't fit, adjust ticks and take the semaphore again
-        if (xTicksToWait != portMAX_DELAY) {
-            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
-        }
-        portEXIT_CRITICAL(&pxRingbuffer->mux);
-        /*
-         * Gap between critical section and re-acquiring of the semaphore. If
-         * semaphore is given now, priority inversion might occur (see docs)
-         */
+    portENTER_CRITICAL(&pxRingbuffer->mux);
+    //Check the item is inside the buffer and is waiting to be sent before touching its header
+    if (rbCHECK_ALIGNED(pvItem) && (uint8_t *)pvItem >= pxRingbuffer->pucHead + rbHEADER_SIZE && (uint8_t *)pvItem <= pxRingbuffer->pucTail &&
+        (((ItemHeader_t *)pvItem - 1)->uxItemFlags & rbITEM_ACQUIRED_FLAG)) {
+        prvSendItemDoneNoSplit(pxRingbuffer, (uint8_t *)pvItem);
+        xReturn = pdTRUE;
     }
+    portEXIT_CRITICAL(&pxRingbuffer->mux);
 
     if (xReturn == pdTRUE) {
-        //Indicate item was successfully sent
+        //Indicate item was successfully sent. It may still be behind an item which is being written
         xSemaphoreGive(pxRingbuffer->xItemsBufferedSemaphore);
     }
-    if (xReturnSemaphore == pdTRUE) {
-        xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);  //Give back semaphore so other tasks can send
-    }
     return xReturn;
 }
 
@@ -811,6 +1493,18 @@ BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer, const void *pvIte
     if ((pxRingbuffer->uxRingbufferFlags & rbBYTE_BUFFER_FLAG) && xItemSize == 0) {
         return pdTRUE;      //Sending 0 bytes to byte buffer has no effect
     }
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        if (pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) != pdTRUE) {
+            return pdFALSE;
+        }
+        pxRingbuffer->vCopyItem(pxRingbuffer, pvItem, xItemSize);
+        //Wake up the consumer if it is blocked, see prvSendSPSC()
+        rbSPSC_FENCE();
+        if (rbSPSC_LOAD_RELAXED(pxRingbuffer->xReaderWaiting)) {
+            xSemaphoreGiveFromISR(pxRingbuffer->xItemsBufferedSemaphore, pxHigherPriorityTaskWoken);
+        }
+        return pdTRUE;
+    }
 
     //Attempt to send an item
     BaseType_t xReturn;
@@ -991,12 +1685,37 @@ void *xRingbufferReceiveUpToFromISR(RingbufHandle_t xRingbuffer, size_t *pxItemS
     }
 }
 
+UBaseType_t xRingbufferReceiveItems(RingbufHandle_t xRingbuffer, void **ppvItems, size_t *pxItemSizes, UBaseType_t uxMaxItems, TickType_t xTicksToWait)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(ppvItems != NULL && pxItemSizes != NULL);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbALLOW_SPLIT_FLAG | rbBYTE_BUFFER_FLAG)) == 0);  //Only no-split buffers keep items whole
+    if (uxMaxItems == 0) {
+        return 0;
+    }
+
+    //Attempt to retrieve the items
+    return prvReceiveItemsGeneric(pxRingbuffer, ppvItems, pxItemSizes, uxMaxItems, xTicksToWait);
+}
+
 void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem)
 {
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
     configASSERT(pvItem != NULL);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)pvItem);
+        //Wake up the producer if it is blocked, see prvSendSPSC()
+        rbSPSC_FENCE();
+        if (rbSPSC_LOAD_RELAXED(pxRingbuffer->xWriterWaiting)) {
+            xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);
+        }
+        return;
+    }
+
     portENTER_CRITICAL(&pxRingbuffer->mux);
     pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)pvItem);
     portEXIT_CRITICAL(&pxRingbuffer->mux);
@@ -1009,12 +1728,53 @@ void vRingbufferReturnItemFromISR(RingbufHandle_t xRingbuffer, void *pvItem, Bas
     configASSERT(pxRingbuffer);
     configASSERT(pvItem != NULL);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)pvItem);
+        rbSPSC_FENCE();
+        if (rbSPSC_LOAD_RELAXED(pxRingbuffer->xWriterWaiting)) {
+            xSemaphoreGiveFromISR(pxRingbuffer->xFreeSpaceSemaphore, pxHigherPriorityTaskWoken);
+        }
+        return;
+    }
+
     portENTER_CRITICAL_ISR(&pxRingbuffer->mux);
     pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)pvItem);
     portEXIT_CRITICAL_ISR(&pxRingbuffer->mux);
     xSemaphoreGiveFromISR(pxRingbuffer->xFreeSpaceSemaphore, pxHigherPriorityTaskWoken);
 }
 
+void vRingbufferReturnItems(RingbufHandle_t xRingbuffer, void **ppvItems, UBaseType_t uxItemCount)
+{
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(ppvItems != NULL || uxItemCount == 0);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbALLOW_SPLIT_FLAG | rbBYTE_BUFFER_FLAG)) == 0);
+    if (uxItemCount == 0) {
+        return;
+    }
+
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        for (UBaseType_t i = 0; i < uxItemCount; i++) {
+            configASSERT(ppvItems[i] != NULL);
+            pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)ppvItems[i]);
+        }
+        //Wake up the producer if it is blocked, see prvSendSPSC()
+        rbSPSC_FENCE();
+        if (rbSPSC_LOAD_RELAXED(pxRingbuffer->xWriterWaiting)) {
+            xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);
+        }
+        return;
+    }
+
+    portENTER_CRITICAL(&pxRingbuffer->mux);
+    for (UBaseType_t i = 0; i < uxItemCount; i++) {
+        configASSERT(ppvItems[i] != NULL);
+        pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)ppvItems[i]);
+    }
+    portEXIT_CRITICAL(&pxRingbuffer->mux);
+    xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);
+}
+
 void vRingbufferDelete(RingbufHandle_t xRingbuffer)
 {
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
@@ -1044,6 +1804,10 @@ size_t xRingbufferGetCurFreeSize(RingbufHandle_t xRingbuffer)
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        return pxRingbuffer->xGetCurMaxSize(pxRingbuffer);
+    }
+
     size_t xFreeSize;
     portENTER_CRITICAL(&pxRingbuffer->mux);
     xFreeSize = pxRingbuffer->xGetCurMaxSize(pxRingbuffer);
@@ -1055,6 +1819,7 @@ BaseType_t xRingbufferAddToQueueSetRead(RingbufHandle_t xRingbuffer, QueueSetHan
 {
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) == 0);   //SPSC ring buffers only give the read semaphore to a blocked consumer
 
     BaseType_t xReturn;
     portENTER_CRITICAL(&pxRingbuffer->mux);
@@ -1100,6 +1865,23 @@ void vRingbufferGetInfo(RingbufHandle_t xRingbuffer, UBaseType_t *uxFree, UBaseT
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
 
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        //Not a consistent snapshot if the ring buffer is in use
+        if (uxFree != NULL) {
+            *uxFree = (UBaseType_t)prvGetPositionSPSC(pxRingbuffer, rbSPSC_LOAD_RELAXED(pxRingbuffer->xFreeIndex));
+        }
+        if (uxRead != NULL) {
+            *uxRead = (UBaseType_t)prvGetPositionSPSC(pxRingbuffer, rbSPSC_LOAD_RELAXED(pxRingbuffer->xReadIndex));
+        }
+        if (uxWrite != NULL) {
+            *uxWrite = (UBaseType_t)prvGetPositionSPSC(pxRingbuffer, rbSPSC_LOAD_RELAXED(pxRingbuffer->xWriteIndex));
+        }
+        if (uxItemsWaiting != NULL) {
+            *uxItemsWaiting = rbSPSC_LOAD_RELAXED(pxRingbuffer->uxItemsWritten) - rbSPSC_LOAD_RELAXED(pxRingbuffer->uxItemsRead);
+        }
+        return;
+    }
+
     portENTER_CRITICAL(&pxRingbuffer->mux);
     if (uxFree != NULL) {
         *uxFree = (UBaseType_t)(pxRingbuffer->pucFree - pxRingbuffer->pucHead);
@@ -1120,6 +1902,14 @@ void xRingbufferPrintInfo(RingbufHandle_t xRingbuffer)
 {
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
+    if (pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) {
+        UBaseType_t uxFree, uxRead, uxWrite;
+        vRingbufferGetInfo(xRingbuffer, &uxFree, &uxRead, &uxWrite, NULL);
+        size_t xUsedSize = prvGetUsedSizeSPSC(pxRingbuffer, rbSPSC_LOAD_RELAXED(pxRingbuffer->xWriteIndex), rbSPSC_LOAD_RELAXED(pxRingbuffer->xFreeIndex));
+        printf("Rb size:%d\tfree: %d\trptr: %d\tfreeptr: %d\twptr: %d\n",
+               (int)pxRingbuffer->xSize, (int)(pxRingbuffer->xSize - xUsedSize), (int)uxRead, (int)uxFree, (int)uxWrite);
+        return;
+    }
     printf("Rb size:%d\tfree: %d\trptr: %d\tfreeptr: %d\twptr: %d\n",
            pxRingbuffer->xSize, prvGetFreeSize(pxRingbuffer),
            pxRingbuffer->pucRead - pxRingbuffer->pucHead,
@@ -1135,6 +1925,7 @@ bool xRingbufferIsNextItemWrapped(RingbufHandle_t xRingbuffer)
     //This function is deprecated, use xRingbufferReceiveSplit() instead
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) == 0);
     bool is_wrapped;
 
     portENTER_CRITICAL(&pxRingbuffer->mux);
@@ -1149,6 +1940,7 @@ BaseType_t xRingbufferAddToQueueSetWrite(RingbufHandle_t xRingbuffer, QueueSetHa
     //This function is deprecated. QueueSetWrite no longer supported
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) == 0);
 
     BaseType_t xReturn;
     portENTER_CRITICAL(&pxRingbuffer->mux);
@@ -1168,6 +1960,7 @@ BaseType_t xRingbufferRemoveFromQueueSetWrite(RingbufHandle_t xRingbuffer, Queue
     //This function is deprecated. QueueSetWrite no longer supported
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
     configASSERT(pxRingbuffer);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & rbSPSC_FLAG) == 0);
 
     BaseType_t xReturn;
     portENTER_CRITICAL(&pxRingbuffer->mux);
@@ -0,0 +1,193 @@
+#include "catch.hpp"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <algorithm>
+#include <vector>
+
+/* Benchmark of ring buffers created with xRingbufferCreate() against ones created with xRingbufferCreateSPSC(),
+   with one producer and one consumer thread. The critical sections of the host are only a spinlock, on the
+   target they also disable interrupts.
+   The test is hidden, run it with "make bench" or "./test_ringbuf [bench]".
+*/
+
+static const ringbuf_type_t s_types[] = { RINGBUF_TYPE_NOSPLIT, RINGBUF_TYPE_ALLOWSPLIT, RINGBUF_TYPE_BYTEBUF };
+static const char *s_type_names[] = { "no-split", "allow-split", "byte buf" };
+static const size_t s_message_sizes[] = { 16, 128 };
+
+static const size_t BENCH_BUFFER_SIZE = 4096;
+static const int BENCH_MESSAGES = 200000;
+static const int BENCH_ROUND_TRIPS = 20000;
+static const UBaseType_t BENCH_MAX_BATCH = 16;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Receive a whole message: byte buffers and split items return it in parts */
+static bool receive_message(RingbufHandle_t rb, ringbuf_type_t type, uint8_t *message, size_t size, TickType_t ticks)
+{
+    size_t received = 0;
+    while (received < size) {
+        void *head, *tail = NULL;
+        size_t head_size, tail_size = 0;
+        if (type == RINGBUF_TYPE_ALLOWSPLIT) {
+            xRingbufferReceiveSplit(rb, &head, &tail, &head_size, &tail_size, ticks);
+        } else if (type == RINGBUF_TYPE_BYTEBUF) {
+            head = xRingbufferReceiveUpTo(rb, &head_size, ticks, size - received);
+        } else {
+            head = xRingbufferReceive(rb, &head_size, ticks);
+        }
+        if (head == NULL) {
+            if (received == 0) {
+                return false;
+            }
+            continue;   /* the rest of a byte buffer message is being sent */
+        }
+        memcpy(message + received, head, head_size);
+        received += head_size;
+        vRingbufferReturnItem(rb, head);
+        if (tail != NULL) {
+            memcpy(message + received, tail, tail_size);
+            received += tail_size;
+            vRingbufferReturnItem(rb, tail);
+        }
+    }
+    return true;
+}
+
+typedef struct {
+    RingbufHandle_t rb[2];
+    ringbuf_type_t type;
+    size_t size;
+    UBaseType_t batch;      /* receive up to this many items at once if more than 1 */
+    std::vector<uint32_t> latencies;
+} bench_t;
+
+/* Streaming: messages carry the time they were sent, the consumer records how long they took to arrive */
+static void *stream_producer(void *arg)
+{
+    bench_t *bench = (bench_t *)arg;
+    uint8_t message[128] = { 0 };
+    for (int i = 0; i < BENCH_MESSAGES; i++) {
+        uint64_t sent = now_ns();
+        memcpy(message, &sent, sizeof(sent));
+        xRingbufferSend(bench->rb[0], message, bench->size, portMAX_DELAY);
+    }
+    return NULL;
+}
+
+static void *stream_consumer(void *arg)
+{
+    bench_t *bench = (bench_t *)arg;
+    uint8_t message[128];
+    if (bench->batch > 1) {
+        void *items[BENCH_MAX_BATCH];
+        size_t sizes[BENCH_MAX_BATCH];
+        for (int i = 0; i < BENCH_MESSAGES; ) {
+            UBaseType_t count = xRingbufferReceiveItems(bench->rb[0], items, sizes, bench->batch, portMAX_DELAY);
+            uint64_t received = now_ns();
+            for (UBaseType_t n = 0; n < count; n++, i++) {
+                memcpy(message, items[n], sizes[n]);
+                uint64_t sent;
+                memcpy(&sent, message, sizeof(sent));
+                bench->latencies[i] = received - sent;
+            }
+            vRingbufferReturnItems(bench->rb[0], items, count);
+        }
+        return NULL;
+    }
+    for (int i = 0; i < BENCH_MESSAGES; i++) {
+        receive_message(bench->rb[0], bench->type, message, bench->size, portMAX_DELAY);
+        uint64_t sent;
+        memcpy(&sent, message, sizeof(sent));
+        bench->latencies[i] = now_ns() - sent;
+    }
+    return NULL;
+}
+
+/* Ping-pong: one message in flight, sent back by the other thread. Each thread blocks until the message
+   arrives, so this includes waking up the other thread. */
+static void *pong(void *arg)
+{
+    bench_t *bench = (bench_t *)arg;
+    uint8_t message[128];
+    for (int i = 0; i < BENCH_ROUND_TRIPS; i++) {
+        receive_message(bench->rb[0], bench->type, message, bench->size, portMAX_DELAY);
+        xRingbufferSend(bench->rb[1], message, bench->size, portMAX_DELAY);
+    }
+    return NULL;
+}
+
+static void run_ringbuf_benchmark(ringbuf_type_t type, const char *type_name, size_t size, bool spsc, UBaseType_t batch = 1)
+{
+    bench_t bench;
+    bench.type = type;
+    bench.size = size;
+    bench.batch = batch;
+    for (int n = 0; n < 2; n++) {
+        bench.rb[n] = spsc ? xRingbufferCreateSPSC(BENCH_BUFFER_SIZE, type) : xRingbufferCreate(BENCH_BUFFER_SIZE, type);
+    }
+
+    bench.latencies.resize(BENCH_MESSAGES);
+    pthread_t producer, consumer;
+    uint64_t start = now_ns();
+    pthread_create(&consumer, NULL, stream_consumer, &bench);
+    pthread_create(&producer, NULL, stream_producer, &bench);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    double stream_s = (now_ns() - start) / 1e9;
+    std::sort(bench.latencies.begin(), bench.latencies.end());
+    uint64_t latency_sum = 0;
+    for (int i = 0; i < BENCH_MESSAGES; i++) {
+        latency_sum += bench.latencies[i];
+    }
+
+    char mode[16];
+    snprintf(mode, sizeof(mode), (batch > 1) ? "%s/%u" : "%s", spsc ? "spsc" : "lock", (unsigned)batch);
+    printf("%-12s %6zu %8s %12.0f %12.0f %12u", type_name, size, mode,
+           BENCH_MESSAGES / stream_s, (double)latency_sum / BENCH_MESSAGES, bench.latencies[BENCH_MESSAGES * 99 / 100]);
+
+    if (batch > 1) {
+        printf(" %12s\n", "-");   /* only one message in flight */
+    } else {
+        pthread_create(&consumer, NULL, pong, &bench);
+        uint8_t message[128] = { 0 };
+        start = now_ns();
+        for (int i = 0; i < BENCH_ROUND_TRIPS; i++) {
+            xRingbufferSend(bench.rb[0], message, size, portMAX_DELAY);
+            receive_message(bench.rb[1], type, message, size, portMAX_DELAY);
+        }
+        uint64_t round_trip_ns = now_ns() - start;
+        pthread_join(consumer, NULL);
+        printf(" %12.0f\n", (double)round_trip_ns / BENCH_ROUND_TRIPS);
+    }
+
+    vRingbufferDelete(bench.rb[0]);
+    vRingbufferDelete(bench.rb[1]);
+}
+
+TEST_CASE("ring buffer benchmark", "[ringbuf][bench][.]")
+{
+    printf("streaming: messages per second, latency in ns. ping-pong: round trip in ns\n");
+    printf("%-12s %6s %8s %12s %12s %12s %12s\n", "type", "size", "mode", "messages/s", "mean lat", "99% lat", "round trip");
+    for (int t = 0; t < 3; t++) {
+        for (size_t s = 0; s < sizeof(s_message_sizes) / sizeof(s_message_sizes[0]); s++) {
+            run_ringbuf_benchmark(s_types[t], s_type_names[t], s_message_sizes[s], false);
+            run_ringbuf_benchmark(s_types[t], s_type_names[t], s_message_sizes[s], true);
+        }
+    }
+    /* no-split ring buffers drained with xRingbufferReceiveItems() */
+    for (size_t s = 0; s < sizeof(s_message_sizes) / sizeof(s_message_sizes[0]); s++) {
+        run_ringbuf_benchmark(RINGBUF_TYPE_NOSPLIT, s_type_names[0], s_message_sizes[s], false, BENCH_MAX_BATCH);
+        run_ringbuf_benchmark(RINGBUF_TYPE_NOSPLIT, s_type_names[0], s_message_sizes[s], true, BENCH_MAX_BATCH);
+    }
+}
@@ -0,0 +1,66 @@
+/* Minimal FreeRTOS API for building ringbuf.c on the host, see freertos_host.c */
+#pragma once
+
+#define INC_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <assert.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define portMAX_DELAY           ( TickType_t ) 0xffffffffUL
+#define configTICK_RATE_HZ      1000
+#define portTICK_PERIOD_MS      ( ( TickType_t ) 1000 / configTICK_RATE_HZ )
+#define pdMS_TO_TICKS( xTimeInMs )  ( ( TickType_t ) ( xTimeInMs ) * configTICK_RATE_HZ / 1000 )
+
+/* the target aligns to 4 bytes, the host to the size of a pointer */
+#define portBYTE_ALIGNMENT_MASK ( sizeof( void * ) - 1 )
+
+#define configASSERT( x )       assert( x )
+
+/* Critical sections are a spinlock only: the host has no interrupts to disable */
+typedef struct {
+    volatile int locked;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { .locked = 0 }
+
+static inline void vPortCPUInitializeMutex(portMUX_TYPE *mux)
+{
+    __atomic_store_n(&mux->locked, 0, __ATOMIC_RELEASE);
+}
+
+static inline void vPortCPUAcquireMutex(portMUX_TYPE *mux)
+{
+    while (__atomic_exchange_n(&mux->locked, 1, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(&mux->locked, __ATOMIC_RELAXED)) {
+        }
+    }
+}
+
+static inline void vPortCPUReleaseMutex(portMUX_TYPE *mux)
+{
+    __atomic_store_n(&mux->locked, 0, __ATOMIC_RELEASE);
+}
+
+#define portENTER_CRITICAL( mux )       vPortCPUAcquireMutex( mux )
+#define portEXIT_CRITICAL( mux )        vPortCPUReleaseMutex( mux )
+#define portENTER_CRITICAL_ISR( mux )   vPortCPUAcquireMutex( mux )
+#define portEXIT_CRITICAL_ISR( mux )    vPortCPUReleaseMutex( mux )
+
+#if defined(__cplusplus)
+}
+#endif
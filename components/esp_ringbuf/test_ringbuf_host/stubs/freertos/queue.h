@@ -0,0 +1,19 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* Queue sets are not supported on the host, these always fail */
+typedef void *QueueSetHandle_t;
+typedef void *QueueSetMemberHandle_t;
+
+BaseType_t xQueueAddToSet(QueueSetMemberHandle_t xQueueOrSemaphore, QueueSetHandle_t xQueueSet);
+
+BaseType_t xQueueRemoveFromSet(QueueSetMemberHandle_t xQueueOrSemaphore, QueueSetHandle_t xQueueSet);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* Binary semaphores implemented with pthreads. The ISR variants are the same as the task ones. */
+typedef struct host_semaphore *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime);
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore);
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t xSemaphore, BaseType_t *pxHigherPriorityTaskWoken);
+
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore);
+
+#if defined(__cplusplus)
+}
+#endif
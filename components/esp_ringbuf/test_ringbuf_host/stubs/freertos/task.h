@@ -0,0 +1,14 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* Milliseconds of CLOCK_MONOTONIC */
+TickType_t xTaskGetTickCount(void);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,626 @@
+#include "catch.hpp"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <algorithm>
+#include <vector>
+
+static const ringbuf_type_t s_types[] = { RINGBUF_TYPE_NOSPLIT, RINGBUF_TYPE_ALLOWSPLIT, RINGBUF_TYPE_BYTEBUF };
+static const char *s_type_names[] = { "no-split", "allow-split", "byte buffer" };
+
+static RingbufHandle_t create_ringbuf(size_t size, ringbuf_type_t type, bool spsc)
+{
+    return spsc ? xRingbufferCreateSPSC(size, type) : xRingbufferCreate(size, type);
+}
+
+static void fill_item(uint8_t *item, size_t size, uint32_t seq)
+{
+    for (size_t i = 0; i < size; i++) {
+        item[i] = (uint8_t)(seq * 7 + i);
+    }
+}
+
+static bool check_item(const uint8_t *item, size_t size, uint32_t seq, size_t offset = 0)
+{
+    for (size_t i = 0; i < size; i++) {
+        if (item[i] != (uint8_t)(seq * 7 + offset + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST_CASE("ring buffer send and receive", "[ringbuf]")
+{
+    for (int spsc = 0; spsc < 2; spsc++) {
+        for (int t = 0; t < 3; t++) {
+            INFO("type " << s_type_names[t] << (spsc ? " SPSC" : ""));
+            RingbufHandle_t rb = create_ringbuf(256, s_types[t], spsc);
+            REQUIRE( rb != NULL );
+
+            uint8_t item[64];
+            size_t size;
+            REQUIRE( xRingbufferReceive(rb, &size, 0) == NULL );
+            REQUIRE( xRingbufferGetCurFreeSize(rb) == xRingbufferGetMaxItemSize(rb) );
+
+            /* enough items to wrap around a few times */
+            for (uint32_t seq = 0; seq < 100; seq++) {
+                size_t item_size = 1 + seq % sizeof(item);
+                fill_item(item, item_size, seq);
+                REQUIRE( xRingbufferSend(rb, item, item_size, 0) == pdTRUE );
+
+                if (s_types[t] == RINGBUF_TYPE_ALLOWSPLIT) {
+                    void *head, *tail;
+                    size_t head_size, tail_size = 0;
+                    REQUIRE( xRingbufferReceiveSplit(rb, &head, &tail, &head_size, &tail_size, 0) == pdTRUE );
+                    REQUIRE( check_item((uint8_t *)head, head_size, seq) );
+                    if (tail != NULL) {
+                        REQUIRE( check_item((uint8_t *)tail, tail_size, seq, head_size) );
+                        vRingbufferReturnItem(rb, tail);
+                    }
+                    REQUIRE( head_size + tail_size == item_size );
+                    vRingbufferReturnItem(rb, head);
+                } else {
+                    size_t received = 0;
+                    while (received < item_size) {
+                        uint8_t *data = (uint8_t *)xRingbufferReceive(rb, &size, 0);
+                        REQUIRE( data != NULL );
+                        REQUIRE( check_item(data, size, seq, received) );
+                        received += size;
+                        vRingbufferReturnItem(rb, data);
+                    }
+                    REQUIRE( received == item_size );
+                }
+                REQUIRE( xRingbufferReceive(rb, &size, 0) == NULL );
+            }
+            REQUIRE( xRingbufferGetCurFreeSize(rb) > 0 );
+            vRingbufferDelete(rb);
+        }
+    }
+}
+
+TEST_CASE("ring buffer full and empty", "[ringbuf]")
+{
+    for (int spsc = 0; spsc < 2; spsc++) {
+        for (int t = 0; t < 3; t++) {
+            INFO("type " << s_type_names[t] << (spsc ? " SPSC" : ""));
+            RingbufHandle_t rb = create_ringbuf(128, s_types[t], spsc);
+            uint8_t item[8] = { 0 };
+
+            REQUIRE( xRingbufferSend(rb, item, xRingbufferGetMaxItemSize(rb) + 1, 0) == pdFALSE );
+            int sent = 0;
+            while (xRingbufferSend(rb, item, sizeof(item), 0) == pdTRUE) {
+                sent++;
+            }
+            REQUIRE( sent > 0 );
+
+            /* blocking send times out */
+            TickType_t start = xTaskGetTickCount();
+            REQUIRE( xRingbufferSend(rb, item, sizeof(item), pdMS_TO_TICKS(20)) == pdFALSE );
+            REQUIRE( xTaskGetTickCount() - start >= pdMS_TO_TICKS(20) - 1 );
+
+            size_t size;
+            void *data;
+            while ((data = xRingbufferReceive(rb, &size, 0)) != NULL) {
+                vRingbufferReturnItem(rb, data);
+            }
+            UBaseType_t waiting;
+            vRingbufferGetInfo(rb, NULL, NULL, NULL, &waiting);
+            REQUIRE( waiting == 0 );
+
+            /* blocking receive times out */
+            start = xTaskGetTickCount();
+            REQUIRE( xRingbufferReceive(rb, &size, pdMS_TO_TICKS(20)) == NULL );
+            REQUIRE( xTaskGetTickCount() - start >= pdMS_TO_TICKS(20) - 1 );
+
+            vRingbufferDelete(rb);
+        }
+    }
+}
+
+/* SPSC ring buffers keep the same items in the same places as other ring buffers. Do the same random
+   operations on both, with items returned out of order, and compare them after each one. */
+TEST_CASE("SPSC ring buffer behaves as the default one", "[ringbuf]")
+{
+    for (int t = 0; t < 3; t++) {
+        INFO("type " << s_type_names[t]);
+        RingbufHandle_t rb[2] = { create_ringbuf(300, s_types[t], false), create_ringbuf(300, s_types[t], true) };
+        std::vector<void *> outstanding[2];
+        uint8_t item[100];
+        uint32_t seq = 0;
+
+        srand(t);
+        for (int i = 0; i < 20000; i++) {
+            int op = rand() % 3;
+            if (op == 0) {
+                size_t item_size = rand() % sizeof(item);
+                size_t free_size = xRingbufferGetCurFreeSize(rb[0]);
+                if (free_size == 0 || free_size < item_size) {
+                    continue;
+                }
+                fill_item(item, item_size, seq++);
+                for (int n = 0; n < 2; n++) {
+                    REQUIRE( xRingbufferSend(rb[n], item, item_size, 0) == pdTRUE );
+                }
+            } else if (op == 1) {
+                if (s_types[t] == RINGBUF_TYPE_BYTEBUF && !outstanding[0].empty()) {
+                    continue;   /* byte buffers do not allow multiple retrievals before return */
+                }
+                void *data[2];
+                size_t size[2];
+                size_t max_size = 1 + rand() % 50;
+                for (int n = 0; n < 2; n++) {
+                    if (s_types[t] == RINGBUF_TYPE_BYTEBUF) {
+                        data[n] = xRingbufferReceiveUpTo(rb[n], &size[n], 0, max_size);
+                    } else {
+                        data[n] = xRingbufferReceive(rb[n], &size[n], 0);
+                    }
+                    if (data[n] != NULL) {
+                        outstanding[n].push_back(data[n]);
+                    }
+                }
+                REQUIRE( (data[0] == NULL) == (data[1] == NULL) );
+                if (data[0] != NULL) {
+                    REQUIRE( size[0] == size[1] );
+                    REQUIRE( memcmp(data[0], data[1], size[0]) == 0 );
+                }
+            } else if (!outstanding[0].empty()) {
+                size_t index = rand() % outstanding[0].size();
+                for (int n = 0; n < 2; n++) {
+                    vRingbufferReturnItem(rb[n], outstanding[n][index]);
+                    outstanding[n].erase(outstanding[n].begin() + index);
+                }
+            }
+
+            UBaseType_t info[2][4];
+            for (int n = 0; n < 2; n++) {
+                vRingbufferGetInfo(rb[n], &info[n][0], &info[n][1], &info[n][2], &info[n][3]);
+            }
+            REQUIRE( memcmp(info[0], info[1], sizeof(info[0])) == 0 );
+            REQUIRE( xRingbufferGetCurFreeSize(rb[0]) == xRingbufferGetCurFreeSize(rb[1]) );
+        }
+        vRingbufferDelete(rb[0]);
+        vRingbufferDelete(rb[1]);
+    }
+}
+
+typedef struct {
+    RingbufHandle_t rb;
+    ringbuf_type_t type;
+    uint32_t count;
+    bool failed;
+} spsc_test_t;
+
+static const size_t SPSC_TEST_MAX_ITEM = 60;
+
+/* Items start with their sequence number, the rest is the pattern of fill_item() */
+static void *spsc_producer(void *arg)
+{
+    spsc_test_t *test = (spsc_test_t *)arg;
+    uint8_t item[SPSC_TEST_MAX_ITEM];
+    unsigned seed = 1;
+    for (uint32_t seq = 0; seq < test->count; seq++) {
+        size_t item_size = sizeof(seq) + rand_r(&seed) % (sizeof(item) - sizeof(seq));
+        fill_item(item, item_size, seq);
+        memcpy(item, &seq, sizeof(seq));
+        if (xRingbufferSend(test->rb, item, item_size, portMAX_DELAY) != pdTRUE) {
+            test->failed = true;
+        }
+    }
+    return NULL;
+}
+
+static void *spsc_consumer(void *arg)
+{
+    spsc_test_t *test = (spsc_test_t *)arg;
+    unsigned seed = 1;
+    unsigned return_seed = 2;
+    uint8_t item[SPSC_TEST_MAX_ITEM];
+    size_t received = 0;
+    uint32_t seq = 0;
+    std::vector<void *> outstanding;
+
+    while (seq < test->count) {
+        size_t item_size = sizeof(seq) + rand_r(&seed) % (sizeof(item) - sizeof(seq));
+        /* byte buffers and split items return the data in parts, put it together */
+        while (received < item_size) {
+            void *head, *tail = NULL;
+            size_t head_size, tail_size = 0;
+            if (test->type == RINGBUF_TYPE_ALLOWSPLIT) {
+                xRingbufferReceiveSplit(test->rb, &head, &tail, &head_size, &tail_size, portMAX_DELAY);
+            } else if (test->type == RINGBUF_TYPE_BYTEBUF) {
+                head = xRingbufferReceiveUpTo(test->rb, &head_size, portMAX_DELAY, item_size - received);
+            } else {
+                head = xRingbufferReceive(test->rb, &head_size, portMAX_DELAY);
+            }
+            if (head == NULL || received + head_size + tail_size > item_size) {
+                test->failed = true;
+                return NULL;
+            }
+            memcpy(item + received, head, head_size);
+            received += head_size;
+            if (tail != NULL) {
+                memcpy(item + received, tail, tail_size);
+                received += tail_size;
+            }
+            /* receive some pairs of items of no-split ring buffers, and return them in reverse order */
+            if (test->type == RINGBUF_TYPE_NOSPLIT) {
+                outstanding.push_back(head);
+                if (outstanding.size() == 2 || rand_r(&return_seed) % 2) {
+                    while (!outstanding.empty()) {
+                        vRingbufferReturnItem(test->rb, outstanding.back());
+                        outstanding.pop_back();
+                    }
+                }
+            } else {
+                vRingbufferReturnItem(test->rb, head);
+                if (tail != NULL) {
+                    vRingbufferReturnItem(test->rb, tail);
+                }
+            }
+        }
+        uint32_t item_seq;
+        memcpy(&item_seq, item, sizeof(item_seq));
+        if (item_seq != seq || !check_item(item + sizeof(seq), item_size - sizeof(seq), seq, sizeof(seq))) {
+            test->failed = true;
+            return NULL;
+        }
+        received = 0;
+        seq++;
+    }
+    if (!outstanding.empty()) {
+        vRingbufferReturnItem(test->rb, outstanding.back());
+    }
+    return NULL;
+}
+
+TEST_CASE("ring buffer with a producer and a consumer thread", "[ringbuf]")
+{
+    for (int spsc = 0; spsc < 2; spsc++) {
+        for (int t = 0; t < 3; t++) {
+            INFO("type " << s_type_names[t] << (spsc ? " SPSC" : ""));
+            /* small enough for the producer and the consumer to block often */
+            spsc_test_t test = { create_ringbuf(256, s_types[t], spsc), s_types[t], 200000, false };
+            pthread_t producer, consumer;
+            pthread_create(&consumer, NULL, spsc_consumer, &test);
+            pthread_create(&producer, NULL, spsc_producer, &test);
+            pthread_join(producer, NULL);
+            pthread_join(consumer, NULL);
+
+            REQUIRE( !test.failed );
+            UBaseType_t waiting;
+            vRingbufferGetInfo(test.rb, NULL, NULL, NULL, &waiting);
+            REQUIRE( waiting == 0 );
+            REQUIRE( xRingbufferGetCurFreeSize(test.rb) == xRingbufferGetMaxItemSize(test.rb) );
+            vRingbufferDelete(test.rb);
+        }
+    }
+}
+
+TEST_CASE("no-split ring buffer send acquire and complete", "[ringbuf]")
+{
+    RingbufHandle_t rb = xRingbufferCreate(256, RINGBUF_TYPE_NOSPLIT);
+    REQUIRE( rb != NULL );
+
+    void *items[3];
+    size_t size;
+    REQUIRE( xRingbufferSendAcquire(rb, &items[0], 16, 0) == pdTRUE );
+    REQUIRE( xRingbufferSendAcquire(rb, &items[1], 32, 0) == pdTRUE );
+    REQUIRE( xRingbufferSendAcquire(rb, &items[2], 8, 0) == pdTRUE );
+    for (int i = 0; i < 3; i++) {
+        fill_item((uint8_t *)items[i], (i == 0) ? 16 : (i == 1) ? 32 : 8, i);
+    }
+    /* sent after the acquired items, so read after them */
+    uint8_t item[4];
+    fill_item(item, sizeof(item), 3);
+    REQUIRE( xRingbufferSend(rb, item, sizeof(item), 0) == pdTRUE );
+    REQUIRE( xRingbufferReceive(rb, &size, 0) == NULL );
+
+    /* items are read in the order they were acquired, whatever the order they are completed in */
+    REQUIRE( xRingbufferSendComplete(rb, items[2]) == pdTRUE );
+    REQUIRE( xRingbufferReceive(rb, &size, 0) == NULL );
+    REQUIRE( xRingbufferSendComplete(rb, items[0]) == pdTRUE );
+    uint8_t *data = (uint8_t *)xRingbufferReceive(rb, &size, 0);
+    REQUIRE( data == items[0] );
+    REQUIRE( size == 16 );
+    REQUIRE( check_item(data, size, 0) );
+    vRingbufferReturnItem(rb, data);
+    REQUIRE( xRingbufferReceive(rb, &size, 0) == NULL );
+
+    REQUIRE( xRingbufferSendComplete(rb, items[1]) == pdTRUE );
+    REQUIRE( xRingbufferSendComplete(rb, items[1]) == pdFALSE );
+    for (uint32_t seq = 1; seq < 4; seq++) {
+        data = (uint8_t *)xRingbufferReceive(rb, &size, 0);
+        REQUIRE( data != NULL );
+        REQUIRE( check_item(data, size, seq) );
+        vRingbufferReturnItem(rb, data);
+    }
+    REQUIRE( xRingbufferReceive(rb, &size, 0) == NULL );
+
+    void *too_large;
+    REQUIRE( xRingbufferSendAcquire(rb, &too_large, xRingbufferGetMaxItemSize(rb) + 1, 0) == pdFALSE );
+    REQUIRE( too_large == NULL );
+    REQUIRE( xRingbufferGetCurFreeSize(rb) == xRingbufferGetMaxItemSize(rb) );
+    vRingbufferDelete(rb);
+}
+
+/* Acquires, sends and receives at random, checking that the items read are the completed ones at the
+   front of the ring buffer, in the order they were acquired */
+TEST_CASE("no-split ring buffer send acquire in random order", "[ringbuf]")
+{
+    RingbufHandle_t rb = xRingbufferCreate(256, RINGBUF_TYPE_NOSPLIT);
+    REQUIRE( rb != NULL );
+
+    typedef struct {
+        uint32_t seq;
+        size_t size;
+        uint8_t *data;
+        bool completed;
+    } acquired_item_t;
+    std::vector<acquired_item_t> items;     /* sent or acquired, not yet received */
+    std::vector<void *> received;           /* not yet returned */
+    unsigned seed = 1;
+    uint32_t next_seq = 0;
+
+    for (int op = 0; op < 50000; op++) {
+        size_t item_size = rand_r(&seed) % 48;
+        switch (rand_r(&seed) % 4) {
+        case 0: {
+            void *data;
+            if (xRingbufferSendAcquire(rb, &data, item_size, 0) == pdTRUE) {
+                fill_item((uint8_t *)data, item_size, next_seq);
+                acquired_item_t acquired = { next_seq++, item_size, (uint8_t *)data, false };
+                items.push_back(acquired);
+            } else {
+                REQUIRE( data == NULL );
+            }
+            break;
+        }
+        case 1: {
+            uint8_t item[48];
+            fill_item(item, item_size, next_seq);
+            if (xRingbufferSend(rb, item, item_size, 0) == pdTRUE) {
+                acquired_item_t sent = { next_seq++, item_size, NULL, true };
+                items.push_back(sent);
+            }
+            break;
+        }
+        case 2: {
+            std::vector<acquired_item_t *> pending;
+            for (size_t i = 0; i < items.size(); i++) {
+                if (!items[i].completed) {
+                    pending.push_back(&items[i]);
+                }
+            }
+            if (!pending.empty()) {
+                acquired_item_t *complete = pending[rand_r(&seed) % pending.size()];
+                REQUIRE( xRingbufferSendComplete(rb, complete->data) == pdTRUE );
+                complete->completed = true;
+            }
+            break;
+        }
+        default: {
+            size_t size;
+            uint8_t *data = (uint8_t *)xRingbufferReceive(rb, &size, 0);
+            if (items.empty() || !items[0].completed) {
+                REQUIRE( data == NULL );
+            } else {
+                REQUIRE( data != NULL );
+                REQUIRE( size == items[0].size );
+                REQUIRE( check_item(data, size, items[0].seq) );
+                items.erase(items.begin());
+                received.push_back(data);
+            }
+            /* return the received items in a random order */
+            while (!received.empty() && rand_r(&seed) % 2) {
+                size_t i = rand_r(&seed) % received.size();
+                vRingbufferReturnItem(rb, received[i]);
+                received.erase(received.begin() + i);
+            }
+            break;
+        }
+        }
+        UBaseType_t waiting;
+        vRingbufferGetInfo(rb, NULL, NULL, NULL, &waiting);
+        size_t completed = 0;
+        for (size_t i = 0; i < items.size(); i++) {
+            completed += items[i].completed ? 1 : 0;
+        }
+        REQUIRE( waiting == completed );
+    }
+    vRingbufferDelete(rb);
+}
+
+typedef struct {
+    RingbufHandle_t rb;
+    uint32_t producer;
+    uint32_t count;
+    bool failed;
+} acquire_test_t;
+
+static const int ACQUIRE_TEST_PRODUCERS = 2;
+
+/* Items are the number of the producer and a sequence number. When there is room for two, two are acquired
+   at a time and completed in reverse order. The second one is not waited for, as the consumer cannot read
+   past the first one while it is not completed */
+static void *acquire_producer(void *arg)
+{
+    acquire_test_t *test = (acquire_test_t *)arg;
+    uint32_t seq = 0;
+    while (seq < test->count) {
+        uint32_t *items[2];
+        int acquired = 0;
+        while (acquired < 2 && seq + acquired < test->count &&
+               xRingbufferSendAcquire(test->rb, (void **)&items[acquired], 2 * sizeof(uint32_t), (acquired == 0) ? portMAX_DELAY : 0) == pdTRUE) {
+            items[acquired][0] = test->producer;
+            items[acquired][1] = seq + acquired;
+            acquired++;
+        }
+        if (acquired == 0) {
+            test->failed = true;
+            return NULL;
+        }
+        while (acquired > 0) {
+            if (xRingbufferSendComplete(test->rb, items[--acquired]) != pdTRUE) {
+                test->failed = true;
+            }
+            seq++;
+        }
+    }
+    return NULL;
+}
+
+TEST_CASE("no-split ring buffer send acquire from several threads", "[ringbuf]")
+{
+    /* small enough for the producers to block often */
+    RingbufHandle_t rb = xRingbufferCreate(128, RINGBUF_TYPE_NOSPLIT);
+    REQUIRE( rb != NULL );
+    acquire_test_t tests[ACQUIRE_TEST_PRODUCERS];
+    pthread_t producers[ACQUIRE_TEST_PRODUCERS];
+    for (int p = 0; p < ACQUIRE_TEST_PRODUCERS; p++) {
+        acquire_test_t test = { rb, (uint32_t)p, 100000, false };
+        tests[p] = test;
+        pthread_create(&producers[p], NULL, acquire_producer, &tests[p]);
+    }
+
+    /* the items of each producer are received in order */
+    uint32_t next_seq[ACQUIRE_TEST_PRODUCERS] = { 0 };
+    bool in_order = true;
+    for (uint32_t n = 0; n < ACQUIRE_TEST_PRODUCERS * tests[0].count; n++) {
+        size_t size;
+        uint32_t *item = (uint32_t *)xRingbufferReceive(rb, &size, portMAX_DELAY);
+        if (item == NULL || size != 2 * sizeof(uint32_t) || item[0] >= ACQUIRE_TEST_PRODUCERS ||
+            item[1] != next_seq[item[0]]++) {
+            in_order = false;
+            break;
+        }
+        vRingbufferReturnItem(rb, item);
+    }
+    for (int p = 0; p < ACQUIRE_TEST_PRODUCERS; p++) {
+        pthread_join(producers[p], NULL);
+        REQUIRE( !tests[p].failed );
+    }
+    REQUIRE( in_order );
+    REQUIRE( xRingbufferGetCurFreeSize(rb) == xRingbufferGetMaxItemSize(rb) );
+    vRingbufferDelete(rb);
+}
+
+TEST_CASE("no-split ring buffer receive and return several items", "[ringbuf]")
+{
+    for (int spsc = 0; spsc < 2; spsc++) {
+        INFO((spsc ? "SPSC" : "default"));
+        RingbufHandle_t rb = create_ringbuf(256, RINGBUF_TYPE_NOSPLIT, spsc);
+        REQUIRE( rb != NULL );
+
+        void *items[8];
+        size_t sizes[8];
+        REQUIRE( xRingbufferReceiveItems(rb, items, sizes, 8, 0) == 0 );
+        REQUIRE( xRingbufferReceiveItems(rb, items, sizes, 8, pdMS_TO_TICKS(20)) == 0 );
+
+        /* enough batches to wrap around a few times */
+        uint32_t sent = 0, received = 0;
+        for (int batch = 0; batch < 50; batch++) {
+            uint8_t item[24];
+            for (int i = 0; i < 6; i++) {
+                size_t item_size = sent % sizeof(item);
+                fill_item(item, item_size, sent);
+                if (xRingbufferSend(rb, item, item_size, 0) != pdTRUE) {
+                    break;
+                }
+                sent++;
+            }
+            /* at most 4 at a time, in the order they were sent */
+            UBaseType_t count;
+            while ((count = xRingbufferReceiveItems(rb, items, sizes, 4, 0)) > 0) {
+                REQUIRE( count <= 4 );
+                for (UBaseType_t i = 0; i < count; i++) {
+                    REQUIRE( sizes[i] == received % sizeof(item) );
+                    REQUIRE( check_item((uint8_t *)items[i], sizes[i], received) );
+                    received++;
+                }
+                vRingbufferReturnItems(rb, items, count);
+            }
+            REQUIRE( received == sent );
+        }
+        REQUIRE( sent > 250 );
+        REQUIRE( xRingbufferGetCurFreeSize(rb) == xRingbufferGetMaxItemSize(rb) );
+
+        /* all the available items are received at once */
+        for (uint32_t seq = 0; seq < 3; seq++) {
+            REQUIRE( xRingbufferSend(rb, &seq, sizeof(seq), 0) == pdTRUE );
+        }
+        REQUIRE( xRingbufferReceiveItems(rb, items, sizes, 8, 0) == 3 );
+        for (uint32_t seq = 0; seq < 3; seq++) {
+            REQUIRE( *(uint32_t *)items[seq] == seq );
+        }
+        vRingbufferReturnItems(rb, items, 3);
+
+        if (!spsc) {
+            /* items behind an acquired item are not received */
+            void *acquired;
+            uint32_t seq = 0;
+            REQUIRE( xRingbufferSend(rb, &seq, sizeof(seq), 0) == pdTRUE );
+            REQUIRE( xRingbufferSendAcquire(rb, &acquired, sizeof(seq), 0) == pdTRUE );
+            REQUIRE( xRingbufferSend(rb, &seq, sizeof(seq), 0) == pdTRUE );
+            REQUIRE( xRingbufferReceiveItems(rb, items, sizes, 8, 0) == 1 );
+            REQUIRE( xRingbufferSendComplete(rb, acquired) == pdTRUE );
+            REQUIRE( xRingbufferReceiveItems(rb, &items[1], &sizes[1], 8, 0) == 2 );
+            /* returned out of order */
+            std::swap(items[0], items[2]);
+            vRingbufferReturnItems(rb, items, 3);
+        }
+        REQUIRE( xRingbufferGetCurFreeSize(rb) == xRingbufferGetMaxItemSize(rb) );
+        vRingbufferDelete(rb);
+    }
+}
+
+static void *batch_consumer(void *arg)
+{
+    spsc_test_t *test = (spsc_test_t *)arg;
+    unsigned seed = 1;
+    uint32_t seq = 0;
+    while (seq < test->count) {
+        void *items[16];
+        size_t sizes[16];
+        UBaseType_t count = xRingbufferReceiveItems(test->rb, items, sizes, 16, portMAX_DELAY);
+        for (UBaseType_t i = 0; i < count; i++) {
+            size_t item_size = sizeof(seq) + rand_r(&seed) % (SPSC_TEST_MAX_ITEM - sizeof(seq));
+            uint32_t item_seq;
+            memcpy(&item_seq, items[i], sizeof(item_seq));
+            if (sizes[i] != item_size || item_seq != seq ||
+                    !check_item((uint8_t *)items[i] + sizeof(seq), item_size - sizeof(seq), seq, sizeof(seq))) {
+                test->failed = true;
+                return NULL;
+            }
+            seq++;
+        }
+        if (count == 0) {
+            test->failed = true;
+            return NULL;
+        }
+        vRingbufferReturnItems(test->rb, items, count);
+    }
+    return NULL;
+}
+
+TEST_CASE("no-split ring buffer receiving several items from a producer thread", "[ringbuf]")
+{
+    for (int spsc = 0; spsc < 2; spsc++) {
+        INFO((spsc ? "SPSC" : "default"));
+        spsc_test_t test = { create_ringbuf(256, RINGBUF_TYPE_NOSPLIT, spsc), RINGBUF_TYPE_NOSPLIT, 200000, false };
+        pthread_t producer, consumer;
+        pthread_create(&consumer, NULL, batch_consumer, &test);
+        pthread_create(&producer, NULL, spsc_producer, &test);
+        pthread_join(producer, NULL);
+        pthread_join(consumer, NULL);
+
+        REQUIRE( !test.failed );
+        REQUIRE( xRingbufferGetCurFreeSize(test.rb) == xRingbufferGetMaxItemSize(test.rb) );
+        vRingbufferDelete(test.rb);
+    }
+}
@@ -2,7 +2,7 @@
 # Component Makefile
 #
 
-COMPONENT_OBJS := heap_caps_init.o heap_caps.o multi_heap.o heap_trace.o
+COMPONENT_OBJS := heap_caps_init.o heap_caps.o heap_caps_pool.o heap_region_table.o heap_trace_index.o multi_heap.o multi_heap_segregated.o heap_trace.o
 
 ifndef CONFIG_HEAP_POISONING_DISABLED
 COMPONENT_OBJS += multi_heap_poisoning.o
@@ -12,6 +12,14 @@ COMPONENT_OBJS += heap_task_info.o
 endif
 endif
 
+ifdef CONFIG_HEAP_CACHE
+COMPONENT_OBJS += multi_heap_cache.o
+endif
+
+ifdef CONFIG_HEAP_TRACING_TOHOST
+COMPONENT_OBJS += heap_trace_tohost.o
+endif
+
 ifdef CONFIG_HEAP_TRACING
 
 WRAP_FUNCTIONS = calloc malloc free realloc heap_caps_malloc heap_caps_free heap_caps_realloc heap_caps_malloc_default heap_caps_realloc_default
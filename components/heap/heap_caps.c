@@ -60,6 +60,63 @@ bool heap_caps_match(const heap_t *heap, uint32_t caps)
     return heap->heap != NULL && ((get_all_caps(heap) & caps) == caps);
 }
 
+/*
+Allocate from a heap, through its per-core cache if it has one.
+*/
+IRAM_ATTR static inline void *heap_malloc(heap_t *heap, size_t size)
+{
+#ifdef CONFIG_HEAP_CACHE
+    if (heap->cache != NULL) {
+        return multi_heap_cache_malloc(heap->cache, size);
+    }
+#endif
+    return multi_heap_malloc(heap->heap, size);
+}
+
+IRAM_ATTR static inline void heap_free(heap_t *heap, void *ptr)
+{
+#ifdef CONFIG_HEAP_CACHE
+    if (heap->cache != NULL) {
+        multi_heap_cache_free(heap->cache, ptr);
+        return;
+    }
+#endif
+    multi_heap_free(heap->heap, ptr);
+}
+
+/*
+Get the metadata of a heap. Blocks held by its per-core cache are allocated as far as the heap is concerned,
+count them as free.
+*/
+static void heap_get_info(heap_t *heap, multi_heap_info_t *info)
+{
+    multi_heap_get_info(heap->heap, info);
+#ifdef CONFIG_HEAP_CACHE
+    if (heap->cache != NULL) {
+        size_t cached_bytes, cached_blocks;
+        multi_heap_cache_get_info(heap->cache, &cached_bytes, &cached_blocks);
+        info->total_free_bytes += cached_bytes;
+        info->total_allocated_bytes -= MIN(cached_bytes, info->total_allocated_bytes);
+        info->free_blocks += cached_blocks;
+        info->allocated_blocks -= MIN(cached_blocks, info->allocated_blocks);
+        info->total_cached_bytes = cached_bytes;
+    }
+#endif
+}
+
+static size_t heap_free_size(heap_t *heap)
+{
+    size_t ret = multi_heap_free_size(heap->heap);
+#ifdef CONFIG_HEAP_CACHE
+    if (heap->cache != NULL) {
+        size_t cached_bytes, cached_blocks;
+        multi_heap_cache_get_info(heap->cache, &cached_bytes, &cached_blocks);
+        ret += cached_bytes;
+    }
+#endif
+    return ret;
+}
+
 /*
 Routine to allocate a bit of memory with certain capabilities. caps is a bitfield of MALLOC_CAP_* bits.
 */
@@ -107,7 +164,7 @@ IRAM_ATTR void *heap_caps_malloc( size_t size, uint32_t caps )
                         }
                     } else {
                         //Just try to alloc, nothing special.
-                        ret = multi_heap_malloc(heap->heap, size);
+                        ret = heap_malloc(heap, size);
                         if (ret != NULL) {
                             return ret;
                         }
@@ -238,12 +295,9 @@ IRAM_ATTR void *heap_caps_calloc_prefer( size_t n, size_t size, size_t num, ...
 */
 IRAM_ATTR static heap_t *find_containing_heap(void *ptr )
 {
-    intptr_t p = (intptr_t)ptr;
-    heap_t *heap;
-    SLIST_FOREACH(heap, &registered_heaps, next) {
-        if (heap->heap != NULL && p >= heap->start && p < heap->end) {
-            return heap;
-        }
+    heap_t *heap = heap_region_table_find(registered_heaps_table, (intptr_t)ptr);
+    if (heap != NULL && heap->heap != NULL) {
+        return heap;
     }
     return NULL;
 }
@@ -266,7 +320,7 @@ IRAM_ATTR void heap_caps_free( void *ptr)
 
     heap_t *heap = find_containing_heap(ptr);
     assert(heap != NULL && "free() target pointer is outside heap areas");
-    multi_heap_free(heap->heap, ptr);
+    heap_free(heap, ptr);
 }
 
 IRAM_ATTR void *heap_caps_realloc( void *ptr, size_t size, int caps)
@@ -332,7 +386,7 @@ size_t heap_caps_get_free_size( uint32_t caps )
     heap_t *heap;
     SLIST_FOREACH(heap, &registered_heaps, next) {
         if (heap_caps_match(heap, caps)) {
-            ret += multi_heap_free_size(heap->heap);
+            ret += heap_free_size(heap);
         }
     }
     return ret;
@@ -365,7 +419,7 @@ void heap_caps_get_info( multi_heap_info_t *info, uint32_t caps )
     SLIST_FOREACH(heap, &registered_heaps, next) {
         if (heap_caps_match(heap, caps)) {
             multi_heap_info_t hinfo;
-            multi_heap_get_info(heap->heap, &hinfo);
+            heap_get_info(heap, &hinfo);
 
             info->total_free_bytes += hinfo.total_free_bytes;
             info->total_allocated_bytes += hinfo.total_allocated_bytes;
@@ -375,9 +429,55 @@ void heap_caps_get_info( multi_heap_info_t *info, uint32_t caps )
             info->allocated_blocks += hinfo.allocated_blocks;
             info->free_blocks += hinfo.free_blocks;
             info->total_blocks += hinfo.total_blocks;
+            info->total_cached_bytes += hinfo.total_cached_bytes;
+        }
+    }
+}
+
+void heap_caps_get_histogram( multi_heap_histogram_t *histogram, uint32_t caps )
+{
+    bzero(histogram, sizeof(multi_heap_histogram_t));
+
+    heap_t *heap;
+    SLIST_FOREACH(heap, &registered_heaps, next) {
+        if (heap_caps_match(heap, caps)) {
+            multi_heap_histogram_t hhist;
+            multi_heap_get_histogram(heap->heap, &hhist);
+
+            for (int i = 0; i < MULTI_HEAP_HISTOGRAM_CLASSES; i++) {
+                histogram->free_blocks[i] += hhist.free_blocks[i];
+                histogram->free_bytes[i] += hhist.free_bytes[i];
+                histogram->allocated_blocks[i] += hhist.allocated_blocks[i];
+                histogram->allocations[i] += hhist.allocations[i];
+            }
+        }
+    }
+}
+
+#ifdef CONFIG_HEAP_HISTOGRAM
+static void print_histogram(uint32_t caps)
+{
+    multi_heap_histogram_t histogram;
+    heap_caps_get_histogram(&histogram, caps);
+
+    printf("    %-14s %11s %11s %11s %11s\n", "block size", "free_blocks", "free", "alloc_blocks", "allocations");
+    for (int i = 0; i < MULTI_HEAP_HISTOGRAM_CLASSES; i++) {
+        if (histogram.free_blocks[i] == 0 && histogram.allocated_blocks[i] == 0 && histogram.allocations[i] == 0) {
+            continue;
+        }
+        char range[16];
+        if (i == 0) {
+            snprintf(range, sizeof(range), "< 16");
+        } else if (i == MULTI_HEAP_HISTOGRAM_CLASSES - 1) {
+            snprintf(range, sizeof(range), ">= %d", 1 << (i + 3));
+        } else {
+            snprintf(range, sizeof(range), "%d-%d", 1 << (i + 3), (1 << (i + 4)) - 1);
         }
+        printf("    %-14s %11d %11d %11d %11d\n", range, histogram.free_blocks[i], histogram.free_bytes[i],
+               histogram.allocated_blocks[i], histogram.allocations[i]);
     }
 }
+#endif
 
 void heap_caps_print_heap_info( uint32_t caps )
 {
@@ -386,7 +486,7 @@ void heap_caps_print_heap_info( uint32_t caps )
     heap_t *heap;
     SLIST_FOREACH(heap, &registered_heaps, next) {
         if (heap_caps_match(heap, caps)) {
-            multi_heap_get_info(heap->heap, &info);
+            heap_get_info(heap, &info);
 
             printf("  At 0x%08x len %d free %d allocated %d min_free %d\n",
                    heap->start, heap->end - heap->start, info.total_free_bytes, info.total_allocated_bytes, info.minimum_free_bytes);
@@ -399,6 +499,10 @@ void heap_caps_print_heap_info( uint32_t caps )
     heap_caps_get_info(&info, caps);
 
     printf("    free %d allocated %d min_free %d largest_free_block %d\n", info.total_free_bytes, info.total_allocated_bytes, info.minimum_free_bytes, info.largest_free_block);
+#ifdef CONFIG_HEAP_HISTOGRAM
+    print_histogram(caps);
+#endif
+    heap_caps_pool_print_all(caps);
 }
 
 bool heap_caps_check_integrity(uint32_t caps, bool print_errors)
@@ -29,6 +29,8 @@ static const char *TAG = "heap_init";
 /* Linked-list of registered heaps */
 struct registered_heap_ll registered_heaps;
 
+heap_region_table_t *registered_heaps_table;
+
 static void register_heap(heap_t *region)
 {
     region->heap = multi_heap_register((void *)region->start, region->end - region->start);
@@ -37,6 +39,46 @@ static void register_heap(heap_t *region)
     }
 }
 
+/* Set the lock of a registered heap, and create its cache and histogram if enabled */
+static void enable_heap(heap_t *heap)
+{
+    multi_heap_set_lock(heap->heap, &heap->heap_mux);
+#ifdef CONFIG_HEAP_HISTOGRAM
+    /* the histogram only holds words, any heap can have it */
+    multi_heap_histogram_t *histogram = multi_heap_malloc(heap->heap, sizeof(multi_heap_histogram_t));
+    if (histogram != NULL) {
+        multi_heap_set_histogram(heap->heap, histogram);
+    }
+#endif
+#ifdef CONFIG_HEAP_CACHE
+    /* the cache structure is allocated from the heap, so it has to be byte accessible */
+    heap->cache = NULL;
+    if (heap_caps_match(heap, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL)) {
+        heap->cache = multi_heap_cache_create(heap->heap);
+    }
+#endif
+}
+
+/* Build the first table of heap ranges. The heaps don't overlap, sort them by address. */
+static heap_region_table_t *build_region_table(heap_t *heaps, size_t num_heaps)
+{
+    heap_region_table_t *table = heap_caps_malloc(HEAP_REGION_TABLE_SIZE(num_heaps), MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
+    assert(table != NULL);
+    table->count = 0;
+    for (int i = 0; i < num_heaps; i++) {
+        size_t pos = table->count;
+        while (pos > 0 && table->entries[pos - 1].start > heaps[i].start) {
+            table->entries[pos] = table->entries[pos - 1];
+            pos--;
+        }
+        table->entries[pos].start = heaps[i].start;
+        table->entries[pos].end = heaps[i].end;
+        table->entries[pos].heap = &heaps[i];
+        table->count++;
+    }
+    return table;
+}
+
 void heap_caps_enable_nonos_stack_heaps()
 {
     heap_t *heap;
@@ -46,7 +88,7 @@ void heap_caps_enable_nonos_stack_heaps()
         if (heap->heap == NULL) {
             register_heap(heap);
             if (heap->heap != NULL) {
-                multi_heap_set_lock(heap->heap, &heap->heap_mux);
+                enable_heap(heap);
             }
         }
     }
@@ -106,6 +148,9 @@ void heap_caps_init()
         heap->start = region->start;
         heap->end = region->start + region->size;
         vPortCPUInitializeMutex(&heap->heap_mux);
+#ifdef CONFIG_HEAP_CACHE
+        heap->cache = NULL;
+#endif
         if (type->startup_stack) {
             /* Will be registered when OS scheduler starts */
             heap->heap = NULL;
@@ -142,7 +187,7 @@ void heap_caps_init()
     /* Iterate the heaps and set their locks, also add them to the linked list. */
     for (int i = 0; i < num_heaps; i++) {
         if (heaps_array[i].heap != NULL) {
-            multi_heap_set_lock(heaps_array[i].heap, &heaps_array[i].heap_mux);
+            enable_heap(&heaps_array[i]);
         }
         if (i == 0) {
             SLIST_INSERT_HEAD(&registered_heaps, &heaps_array[0], next);
@@ -150,6 +195,8 @@ void heap_caps_init()
             SLIST_INSERT_AFTER(&heaps_array[i-1], &heaps_array[i], next);
         }
     }
+
+    registered_heaps_table = build_region_table(heaps_array, num_heaps);
 }
 
 esp_err_t heap_caps_add_region(intptr_t start, intptr_t end)
@@ -215,20 +262,37 @@ esp_err_t heap_caps_add_region_with_caps(const uint32_t caps[], intptr_t start,
     p_new->start = start;
     p_new->end = end;
     vPortCPUInitializeMutex(&p_new->heap_mux);
+#ifdef CONFIG_HEAP_CACHE
+    p_new->cache = NULL;
+#endif
     p_new->heap = multi_heap_register((void *)start, end - start);
     SLIST_NEXT(p_new, next) = NULL;
     if (p_new->heap == NULL) {
         err = ESP_ERR_INVALID_SIZE;
         goto done;
     }
-    multi_heap_set_lock(p_new->heap, &p_new->heap_mux);
+    enable_heap(p_new);
 
     /* (This insertion is atomic to registered_heaps, so
        we don't need to worry about thread safety for readers,
        only for writers. */
     static _lock_t registered_heaps_write_lock;
     _lock_acquire(&registered_heaps_write_lock);
+
+    /* Readers search the table without a lock, so build a new one and swap the pointer. The old table isn't
+       freed as another core may still be searching it, regions are rarely added at runtime so this costs little. */
+    heap_region_table_t *old_table = registered_heaps_table;
+    heap_region_table_t *new_table = heap_caps_malloc(HEAP_REGION_TABLE_SIZE(old_table->count + 2),
+                                                      MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
+    if (new_table == NULL) {
+        _lock_release(&registered_heaps_write_lock);
+        err = ESP_ERR_NO_MEM;
+        goto done;
+    }
+    heap_region_table_insert(new_table, old_table, start, end, p_new);
+
     SLIST_INSERT_HEAD(&registered_heaps, p_new, next);
+    registered_heaps_table = new_table;
     _lock_release(&registered_heaps_write_lock);
 
     err = ESP_OK;
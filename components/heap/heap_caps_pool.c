@@ -0,0 +1,426 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/param.h>
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_heap_caps_pool.h"
+#include "rom/ets_sys.h"
+#include "heap_private.h"
+#include "multi_heap_config.h"
+
+/*
+A pool is a single block of memory from heap_caps_malloc(), holding the pool structure followed by 'count' slots of
+the same size. Free slots form a singly linked list through their first word, so that allocating and freeing an object
+only pops or pushes the head of the list.
+
+Pools are normally protected by a spinlock. Pools created with HEAP_CAPS_POOL_FLAG_SINGLE_ALLOCATOR update the list
+with compare-and-set instead: any task may push objects, but only one pops them, so the head which the allocator read
+can't be popped and pushed again by another task before its compare-and-set (the ABA problem.)
+
+With heap poisoning, each slot is [head canary][object][tail canary]. The head canary tells whether the slot is free or
+allocated, to detect double frees.
+*/
+
+#ifdef MULTI_HEAP_POISONING
+#define POOL_ALLOCATED_PATTERN 0xABBA1234
+#define POOL_FREE_PATTERN 0xF4EEB10C
+#define POOL_TAIL_PATTERN 0xBAAD5678
+#define POOL_HEAD_SIZE sizeof(uint32_t)
+#define POOL_TAIL_SIZE sizeof(uint32_t)
+#else
+#define POOL_HEAD_SIZE 0
+#define POOL_TAIL_SIZE 0
+#endif
+
+#ifdef MULTI_HEAP_POISONING_SLOW
+#define POOL_MALLOC_FILL_PATTERN 0xce
+#define POOL_FREE_FILL_PATTERN 0xfe
+#endif
+
+typedef struct pool_obj {
+    struct pool_obj *next;
+} pool_obj_t;
+
+struct heap_caps_pool {
+    pool_obj_t *free_list;
+    uint32_t free_count;
+    portMUX_TYPE mux;            ///< Protects the pool, unless lock_free is set
+    bool lock_free;              ///< Pool uses compare-and-set (HEAP_CAPS_POOL_FLAG_SINGLE_ALLOCATOR)
+    size_t object_size;          ///< Object size as requested
+    size_t area_size;            ///< Object size rounded up to whole words, at least one pointer
+    size_t slot_size;            ///< Size of a slot: head canary, object area, tail canary
+    size_t count;
+    size_t minimum_free;
+    size_t alloc_failures;
+    uint32_t heap_caps;          ///< All capabilities of the heap which holds the pool
+    uint8_t *slots;
+    SLIST_ENTRY(heap_caps_pool) next;
+};
+
+/* All pools, so that heap_caps_print_heap_info() can print them */
+static SLIST_HEAD(pool_ll, heap_caps_pool) s_pools = SLIST_HEAD_INITIALIZER(s_pools);
+static portMUX_TYPE s_pools_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static inline IRAM_ATTR void *slot_object(heap_caps_pool_handle_t pool, size_t index)
+{
+    return pool->slots + index * pool->slot_size + POOL_HEAD_SIZE;
+}
+
+/* Atomically set '*addr' to 'set' if it is 'compare', return true if it was set */
+static inline IRAM_ATTR bool compare_and_set(volatile uint32_t *addr, uint32_t compare, uint32_t set)
+{
+    uxPortCompareSet(addr, compare, &set);
+    return set == compare;
+}
+
+/* Atomically add 'delta' to the free object count, return the new count */
+static inline IRAM_ATTR uint32_t add_free_count(heap_caps_pool_handle_t pool, int32_t delta)
+{
+    uint32_t count;
+    do {
+        count = pool->free_count;
+    } while (!compare_and_set(&pool->free_count, count, count + delta));
+    return count + delta;
+}
+
+static IRAM_ATTR void pool_corrupt(const char *msg, void *obj)
+{
+    ets_printf("CORRUPT POOL: %s at %p\n", msg, obj);
+    abort();
+}
+
+#ifdef MULTI_HEAP_POISONING
+
+static inline IRAM_ATTR uint32_t *slot_head(void *obj)
+{
+    return (uint32_t *)obj - 1;
+}
+
+static inline IRAM_ATTR uint32_t *slot_tail(heap_caps_pool_handle_t pool, void *obj)
+{
+    return (uint32_t *)((uint8_t *)obj + pool->area_size);
+}
+
+/* Check the canaries of an object, before it's allocated ('expect_free') or freed */
+static IRAM_ATTR bool verify_object(heap_caps_pool_handle_t pool, void *obj, bool expect_free, bool print_errors)
+{
+    uint32_t head = *slot_head(obj);
+    if (head != POOL_FREE_PATTERN && head != POOL_ALLOCATED_PATTERN) {
+        if (print_errors) {
+            printf("CORRUPT POOL: Bad head at %p. Got 0x%08x\n", slot_head(obj), head);
+        }
+        return false;
+    }
+    if ((head == POOL_FREE_PATTERN) != expect_free) {
+        if (print_errors) {
+            printf("CORRUPT POOL: Object at %p is %s, expected it %s\n", obj,
+                   expect_free ? "allocated" : "free", expect_free ? "free" : "allocated");
+        }
+        return false;
+    }
+    uint32_t tail = *slot_tail(pool, obj);
+    if (tail != POOL_TAIL_PATTERN) {
+        if (print_errors) {
+            printf("CORRUPT POOL: Bad tail at %p. Expected 0x%08x got 0x%08x\n", slot_tail(pool, obj),
+                   POOL_TAIL_PATTERN, tail);
+        }
+        return false;
+    }
+#ifdef MULTI_HEAP_POISONING_SLOW
+    if (expect_free) {
+        /* the first word links the free list */
+        const uint8_t *data = (const uint8_t *)obj;
+        for (size_t i = sizeof(pool_obj_t); i < pool->area_size; i++) {
+            if (data[i] != POOL_FREE_FILL_PATTERN) {
+                if (print_errors) {
+                    printf("CORRUPT POOL: Freed object at %p was written to at offset %d\n", obj, i);
+                }
+                return false;
+            }
+        }
+    }
+#endif
+    return true;
+}
+
+static inline IRAM_ATTR void poison_allocated(heap_caps_pool_handle_t pool, void *obj)
+{
+    if (!verify_object(pool, obj, true, true)) {
+        pool_corrupt("free object corrupt", obj);
+    }
+    *slot_head(obj) = POOL_ALLOCATED_PATTERN;
+#ifdef MULTI_HEAP_POISONING_SLOW
+    memset(obj, POOL_MALLOC_FILL_PATTERN, pool->area_size);
+#endif
+}
+
+static inline IRAM_ATTR void poison_freed(heap_caps_pool_handle_t pool, void *obj)
+{
+    if (!verify_object(pool, obj, false, true)) {
+        pool_corrupt("object corrupt or freed twice", obj);
+    }
+    *slot_head(obj) = POOL_FREE_PATTERN;
+#ifdef MULTI_HEAP_POISONING_SLOW
+    memset(obj, POOL_FREE_FILL_PATTERN, pool->area_size);
+#endif
+}
+
+#else // MULTI_HEAP_POISONING
+
+static inline IRAM_ATTR void poison_allocated(heap_caps_pool_handle_t pool, void *obj)
+{
+}
+
+static inline IRAM_ATTR void poison_freed(heap_caps_pool_handle_t pool, void *obj)
+{
+}
+
+#endif // MULTI_HEAP_POISONING
+
+heap_caps_pool_handle_t heap_caps_pool_create(size_t object_size, size_t count, uint32_t caps)
+{
+    return heap_caps_pool_create_with_flags(object_size, count, caps, 0);
+}
+
+heap_caps_pool_handle_t heap_caps_pool_create_with_flags(size_t object_size, size_t count, uint32_t caps, uint32_t flags)
+{
+    if (object_size == 0 || count == 0) {
+        return NULL;
+    }
+
+    size_t area_size = (MAX(object_size, sizeof(pool_obj_t)) + 3) & ~3;
+    size_t slot_size = POOL_HEAD_SIZE + area_size + POOL_TAIL_SIZE;
+    size_t slots_size;
+    if (__builtin_mul_overflow(slot_size, count, &slots_size) || slots_size > SIZE_MAX - sizeof(struct heap_caps_pool)) {
+        return NULL;
+    }
+
+    heap_caps_pool_handle_t pool = heap_caps_malloc(sizeof(struct heap_caps_pool) + slots_size, caps);
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    memset(pool, 0, sizeof(struct heap_caps_pool));
+    vPortCPUInitializeMutex(&pool->mux);
+    pool->lock_free = (flags & HEAP_CAPS_POOL_FLAG_SINGLE_ALLOCATOR) && !esp_ptr_external_ram(pool);
+    pool->object_size = object_size;
+    pool->area_size = area_size;
+    pool->slot_size = slot_size;
+    pool->count = count;
+    pool->free_count = count;
+    pool->minimum_free = count;
+    pool->slots = (uint8_t *)&pool[1];
+
+    heap_t *heap;
+    SLIST_FOREACH(heap, &registered_heaps, next) {
+        if (heap->heap != NULL && (intptr_t)pool >= heap->start && (intptr_t)pool < heap->end) {
+            pool->heap_caps = get_all_caps(heap);
+            break;
+        }
+    }
+
+    /* link the slots in address order */
+    for (size_t i = count; i > 0; i--) {
+        pool_obj_t *obj = slot_object(pool, i - 1);
+#ifdef MULTI_HEAP_POISONING
+        *slot_head(obj) = POOL_FREE_PATTERN;
+        *slot_tail(pool, obj) = POOL_TAIL_PATTERN;
+#endif
+#ifdef MULTI_HEAP_POISONING_SLOW
+        memset(obj, POOL_FREE_FILL_PATTERN, area_size);
+#endif
+        obj->next = pool->free_list;
+        pool->free_list = obj;
+    }
+
+    portENTER_CRITICAL(&s_pools_mux);
+    SLIST_INSERT_HEAD(&s_pools, pool, next);
+    portEXIT_CRITICAL(&s_pools_mux);
+
+    return pool;
+}
+
+void heap_caps_pool_delete(heap_caps_pool_handle_t pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_pools_mux);
+    SLIST_REMOVE(&s_pools, pool, heap_caps_pool, next);
+    portEXIT_CRITICAL(&s_pools_mux);
+    heap_caps_free(pool);
+}
+
+IRAM_ATTR void *heap_caps_pool_alloc(heap_caps_pool_handle_t pool)
+{
+    pool_obj_t *obj;
+
+    if (pool->lock_free) {
+        do {
+            obj = pool->free_list;
+            if (obj == NULL) {
+                pool->alloc_failures++;
+                return NULL;
+            }
+        } while (!compare_and_set((volatile uint32_t *)&pool->free_list, (uint32_t)obj, (uint32_t)obj->next));
+        /* only the allocator makes the count smaller, so the count it leaves is the minimum since the last free */
+        uint32_t free_count = add_free_count(pool, -1);
+        pool->minimum_free = MIN(pool->minimum_free, free_count);
+    } else {
+        portENTER_CRITICAL(&pool->mux);
+        obj = pool->free_list;
+        if (obj == NULL) {
+            pool->alloc_failures++;
+        } else {
+            pool->free_list = obj->next;
+            pool->free_count--;
+            pool->minimum_free = MIN(pool->minimum_free, pool->free_count);
+        }
+        portEXIT_CRITICAL(&pool->mux);
+        if (obj == NULL) {
+            return NULL;
+        }
+    }
+
+    poison_allocated(pool, obj);
+    return obj;
+}
+
+IRAM_ATTR void heap_caps_pool_free(heap_caps_pool_handle_t pool, void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    intptr_t offset = (intptr_t)ptr - (intptr_t)slot_object(pool, 0);
+    if (offset < 0 || offset % pool->slot_size != 0 || offset / pool->slot_size >= pool->count) {
+        pool_corrupt("freed pointer isn't an object of the pool", ptr);
+    }
+
+    poison_freed(pool, ptr);
+
+    pool_obj_t *obj = (pool_obj_t *)ptr;
+    if (pool->lock_free) {
+        /* counted before the push, so that an allocation which pops the object first can't take the count below 0 */
+        add_free_count(pool, 1);
+        pool_obj_t *head;
+        do {
+            head = pool->free_list;
+            obj->next = head;
+        } while (!compare_and_set((volatile uint32_t *)&pool->free_list, (uint32_t)head, (uint32_t)obj));
+    } else {
+        portENTER_CRITICAL(&pool->mux);
+        obj->next = pool->free_list;
+        pool->free_list = obj;
+        pool->free_count++;
+        portEXIT_CRITICAL(&pool->mux);
+    }
+}
+
+void heap_caps_pool_get_info(heap_caps_pool_handle_t pool, heap_caps_pool_info_t *info)
+{
+    info->object_size = pool->object_size;
+    info->total_objects = pool->count;
+    info->free_objects = pool->free_count;
+    info->minimum_free_objects = pool->minimum_free;
+    info->alloc_failures = pool->alloc_failures;
+    info->total_bytes = sizeof(struct heap_caps_pool) + pool->slot_size * pool->count;
+}
+
+static void print_pool_info(heap_caps_pool_handle_t pool, const heap_caps_pool_info_t *info)
+{
+    printf("  Pool at %p object_size %d objects %d free %d min_free %d alloc_failures %d total_bytes %d\n",
+           pool, info->object_size, info->total_objects, info->free_objects, info->minimum_free_objects,
+           info->alloc_failures, info->total_bytes);
+}
+
+void heap_caps_pool_print_info(heap_caps_pool_handle_t pool)
+{
+    heap_caps_pool_info_t info;
+    heap_caps_pool_get_info(pool, &info);
+    print_pool_info(pool, &info);
+}
+
+void heap_caps_pool_print_all(uint32_t caps)
+{
+    /* a pool may be deleted while printing, so look up the n-th pool again under the lock each time */
+    for (int n = 0; ; n++) {
+        heap_caps_pool_handle_t pool;
+        heap_caps_pool_info_t info;
+        int i = 0;
+        portENTER_CRITICAL(&s_pools_mux);
+        SLIST_FOREACH(pool, &s_pools, next) {
+            if ((pool->heap_caps & caps) == caps && i++ == n) {
+                heap_caps_pool_get_info(pool, &info);
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&s_pools_mux);
+        if (pool == NULL) {
+            break;
+        }
+        print_pool_info(pool, &info);
+    }
+}
+
+bool heap_caps_pool_check(heap_caps_pool_handle_t pool, bool print_errors)
+{
+    bool valid = true;
+
+#ifdef MULTI_HEAP_POISONING
+    for (size_t i = 0; i < pool->count; i++) {
+        void *obj = slot_object(pool, i);
+        bool expect_free = (*slot_head(obj) == POOL_FREE_PATTERN);
+        if (!verify_object(pool, obj, expect_free, print_errors)) {
+            valid = false;
+        }
+    }
+#endif
+
+    if (!pool->lock_free) {
+        size_t free_count = 0;
+        size_t expected_count;
+        pool_obj_t *bad_obj = NULL;
+        portENTER_CRITICAL(&pool->mux);
+        expected_count = pool->free_count;
+        for (pool_obj_t *obj = pool->free_list; obj != NULL && free_count <= pool->count; obj = obj->next) {
+            intptr_t offset = (intptr_t)obj - (intptr_t)slot_object(pool, 0);
+            if (offset < 0 || offset % pool->slot_size != 0 || offset / pool->slot_size >= pool->count) {
+                bad_obj = obj;
+                break;
+            }
+            free_count++;
+        }
+        portEXIT_CRITICAL(&pool->mux);
+
+        if (bad_obj != NULL) {
+            if (print_errors) {
+                printf("CORRUPT POOL: Free list entry %p is outside the pool\n", bad_obj);
+            }
+            valid = false;
+        } else if (free_count != expected_count) {
+            if (print_errors) {
+                printf("CORRUPT POOL: Free list has %d objects, expected %d\n", free_count, expected_count);
+            }
+            valid = false;
+        }
+    }
+
+    return valid;
+}
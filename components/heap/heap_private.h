@@ -18,6 +18,8 @@
 #include <freertos/FreeRTOS.h>
 #include <soc/soc_memory_layout.h>
 #include "multi_heap.h"
+#include "multi_heap_cache.h"
+#include "heap_region_table.h"
 #include "rom/queue.h"
 
 #ifdef __cplusplus
@@ -35,6 +37,9 @@ typedef struct heap_t_ {
     intptr_t end;
     portMUX_TYPE heap_mux;
     multi_heap_handle_t heap;
+#ifdef CONFIG_HEAP_CACHE
+    multi_heap_cache_handle_t cache; ///< Per-core cache of small blocks, NULL if the heap has none
+#endif
     SLIST_ENTRY(heap_t_) next;
 } heap_t;
 
@@ -46,6 +51,13 @@ typedef struct heap_t_ {
 */
 extern SLIST_HEAD(registered_heap_ll, heap_t_) registered_heaps;
 
+/* Address ranges of all registered heaps, sorted by address. Entries point to heap_t.
+
+   A new table is built and published by a single pointer write when a heap is added, so that
+   readers can search it without a lock.
+*/
+extern heap_region_table_t *registered_heaps_table;
+
 bool heap_caps_match(const heap_t *heap, uint32_t caps);
 
 /* return all possible capabilities (across all priorities) for a given heap */
@@ -69,6 +81,9 @@ inline static IRAM_ATTR uint32_t get_all_caps(const heap_t *heap)
 void *heap_caps_realloc_default(void *p, size_t size);
 void *heap_caps_malloc_default(size_t size);
 
+/* Print the metadata of all pools (esp_heap_caps_pool.h) in memory with the given capabilities */
+void heap_caps_pool_print_all(uint32_t caps);
+
 
 #ifdef __cplusplus
 }
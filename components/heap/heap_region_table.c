@@ -0,0 +1,60 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "heap_region_table.h"
+
+/* Note: this source file depends on libc only, so that the host tests can use it */
+
+static void add_entry(heap_region_table_t *dst, intptr_t start, intptr_t end, void *heap)
+{
+    heap_region_entry_t *entry = &dst->entries[dst->count++];
+    entry->start = start;
+    entry->end = end;
+    entry->heap = heap;
+}
+
+void heap_region_table_insert(heap_region_table_t *dst, const heap_region_table_t *src,
+                              intptr_t start, intptr_t end, void *heap)
+{
+    bool inserted = false;
+    size_t src_count = (src != NULL) ? src->count : 0;
+
+    dst->count = 0;
+    for (size_t i = 0; i < src_count; i++) {
+        const heap_region_entry_t *entry = &src->entries[i];
+        if (!inserted && entry->start >= end) {
+            /* new range goes before this one */
+            add_entry(dst, start, end, heap);
+            inserted = true;
+        }
+        if (!inserted && start < entry->end && end > entry->start) {
+            /* new range lies inside this one, split it */
+            if (entry->start < start) {
+                add_entry(dst, entry->start, start, entry->heap);
+            }
+            add_entry(dst, start, end, heap);
+            if (end < entry->end) {
+                add_entry(dst, end, entry->end, entry->heap);
+            }
+            inserted = true;
+        } else {
+            add_entry(dst, entry->start, entry->end, entry->heap);
+        }
+    }
+    if (!inserted) {
+        add_entry(dst, start, end, heap);
+    }
+}
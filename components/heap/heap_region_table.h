@@ -0,0 +1,78 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#else
+#define IRAM_ATTR
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Table of heap address ranges, sorted by address, to find the heap which contains a pointer by binary search.
+
+   The ranges don't overlap. A heap added inside the range of another heap (see heap_caps_add_region_with_caps())
+   splits the range of that heap in two, so that the table always gives the heap added last.
+*/
+
+typedef struct {
+    intptr_t start;
+    intptr_t end;
+    void *heap;
+} heap_region_entry_t;
+
+typedef struct {
+    size_t count;
+    heap_region_entry_t entries[];
+} heap_region_table_t;
+
+/* Size in bytes of a table with room for 'count' entries */
+#define HEAP_REGION_TABLE_SIZE(count) (sizeof(heap_region_table_t) + (count) * sizeof(heap_region_entry_t))
+
+/* Find the heap whose range contains 'p', or NULL if none does */
+inline static IRAM_ATTR void *heap_region_table_find(const heap_region_table_t *table, intptr_t p)
+{
+    size_t low = 0;
+    size_t high = table->count;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        const heap_region_entry_t *entry = &table->entries[mid];
+        if (p < entry->start) {
+            high = mid;
+        } else if (p >= entry->end) {
+            low = mid + 1;
+        } else {
+            return entry->heap;
+        }
+    }
+    return NULL;
+}
+
+/* Copy table 'src' (which may be NULL for an empty table) to 'dst', adding the range of a new heap.
+
+   The new range either doesn't overlap any range of 'src', or lies inside a single one.
+   'dst' must have room for src->count + 2 entries, see HEAP_REGION_TABLE_SIZE.
+*/
+void heap_region_table_insert(heap_region_table_t *dst, const heap_region_table_t *src,
+                              intptr_t start, intptr_t end, void *heap);
+
+#ifdef __cplusplus
+}
+#endif
@@ -26,6 +26,8 @@
 #include "soc/soc_memory_layout.h"
 
 #include "heap_private.h"
+#include "heap_trace_index.h"
+#include "heap_trace_tohost.h"
 
 #define STACK_DEPTH CONFIG_HEAP_TRACING_STACK_DEPTH
 
@@ -33,16 +35,17 @@ static portMUX_TYPE trace_mux = portMUX_INITIALIZER_UNLOCKED;
 static bool tracing;
 static heap_trace_mode_t mode;
 
-/* Buffer used for records, starting at offset 0
+/* Buffer used for records, in no particular order
 */
 static heap_trace_record_t *buffer;
 static size_t total_records;
 
-/* Count of entries logged in the buffer.
+/* Index of the records in the buffer: their order, and the records of allocations not yet freed by address.
 
-   Maximum total_records
+   The number of records logged in the buffer is trace_index.count, maximum total_records.
 */
-static size_t count;
+static heap_trace_index_t trace_index;
+static void *index_memory;
 
 /* Actual number of allocations logged */
 static size_t total_allocations;
@@ -53,6 +56,9 @@ static size_t total_frees;
 /* Has the buffer overflowed and lost trace entries? */
 static bool has_overflowed = false;
 
+/* Are records sent to the host instead of the buffer? See heap_trace_tohost.c */
+static bool to_host;
+
 esp_err_t heap_trace_init_standalone(heap_trace_record_t *record_buffer, size_t num_records)
 {
 #ifndef CONFIG_HEAP_TRACING
@@ -62,9 +68,45 @@ esp_err_t heap_trace_init_standalone(heap_trace_record_t *record_buffer, size_t
     if (tracing) {
         return ESP_ERR_INVALID_STATE;
     }
+    if (num_records > HEAP_TRACE_INDEX_MAX_SLOTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    void *new_index_memory = NULL;
+    if (num_records > 0) {
+        new_index_memory = heap_caps_malloc(heap_trace_index_memory_size(num_records), MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
+        if (new_index_memory == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    heap_caps_free(index_memory);
+    index_memory = new_index_memory;
+    heap_trace_index_init(&trace_index, index_memory, num_records);
+
     buffer = record_buffer;
     total_records = num_records;
     memset(buffer, 0, num_records * sizeof(heap_trace_record_t));
+    to_host = false;
+    return ESP_OK;
+}
+
+esp_err_t heap_trace_init_tohost(void)
+{
+#ifndef CONFIG_HEAP_TRACING_TOHOST
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+
+    if (tracing) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    /* the buffer and its index are not used when records go to the host */
+    heap_caps_free(index_memory);
+    index_memory = NULL;
+    memset(&trace_index, 0, sizeof(trace_index));
+    buffer = NULL;
+    total_records = 0;
+    to_host = true;
     return ESP_OK;
 }
 
@@ -74,14 +116,22 @@ esp_err_t heap_trace_start(heap_trace_mode_t mode_param)
     return ESP_ERR_NOT_SUPPORTED;
 #endif
 
-    if (buffer == NULL || total_records == 0) {
+    if (!to_host && (buffer == NULL || total_records == 0)) {
         return ESP_ERR_INVALID_STATE;
     }
+#ifdef CONFIG_HEAP_TRACING_TOHOST
+    if (to_host) {
+        tracing = false;
+        mode = mode_param;
+        heap_trace_tohost_start(mode);
+        return heap_trace_resume();
+    }
+#endif
     portENTER_CRITICAL(&trace_mux);
 
     tracing = false;
     mode = mode_param;
-    count = 0;
+    heap_trace_index_clear(&trace_index);
     total_allocations = 0;
     total_frees = 0;
     has_overflowed = false;
@@ -105,7 +155,13 @@ static esp_err_t set_tracing(bool enable)
 
 esp_err_t heap_trace_stop(void)
 {
-    return set_tracing(false);
+    esp_err_t err = set_tracing(false);
+#ifdef CONFIG_HEAP_TRACING_TOHOST
+    if (err == ESP_OK && to_host) {
+        heap_trace_tohost_stop();
+    }
+#endif
+    return err;
 }
 
 esp_err_t heap_trace_resume(void)
@@ -115,7 +171,7 @@ esp_err_t heap_trace_resume(void)
 
 size_t heap_trace_get_count(void)
 {
-    return count;
+    return trace_index.count;
 }
 
 esp_err_t heap_trace_get(size_t index, heap_trace_record_t *record)
@@ -129,10 +185,11 @@ esp_err_t heap_trace_get(size_t index, heap_trace_record_t *record)
     esp_err_t result = ESP_OK;
 
     portENTER_CRITICAL(&trace_mux);
-    if (index >= count) {
+    size_t slot = heap_trace_index_get_slot(&trace_index, index);
+    if (slot == HEAP_TRACE_INDEX_NONE) {
         result = ESP_ERR_INVALID_ARG; /* out of range for 'count' */
     } else {
-        memcpy(record, &buffer[index], sizeof(heap_trace_record_t));
+        memcpy(record, &buffer[slot], sizeof(heap_trace_record_t));
     }
     portEXIT_CRITICAL(&trace_mux);
     return result;
@@ -144,14 +201,25 @@ void heap_trace_dump(void)
 #ifndef CONFIG_HEAP_TRACING
     printf("no data, heap tracing is disabled.\n");
     return;
+#endif
+#ifdef CONFIG_HEAP_TRACING_TOHOST
+    if (to_host) {
+        heap_trace_tohost_dump();
+        return;
+    }
 #endif
     size_t delta_size = 0;
     size_t delta_allocs = 0;
     printf("%u allocations trace (%u entry buffer)\n",
-           count, total_records);
-    size_t start_count = count;
-    for (int i = 0; i < count; i++) {
-        heap_trace_record_t *rec = &buffer[i];
+           trace_index.count, total_records);
+    size_t start_count = trace_index.count;
+    for (int i = 0; i < trace_index.count; i++) {
+        /* records are copied out under the lock, as tracing may reuse their slots meanwhile */
+        heap_trace_record_t record;
+        if (heap_trace_get(i, &record) != ESP_OK) {
+            break;
+        }
+        heap_trace_record_t *rec = &record;
 
         if (rec->address != NULL) {
             printf("%d bytes (@ %p) allocated CPU %d ccount 0x%08x caller ",
@@ -181,7 +249,7 @@ void heap_trace_dump(void)
         printf("%u bytes 'leaked' in trace (%u allocations)\n", delta_size, delta_allocs);
     }
     printf("total allocations %u total frees %u\n", total_allocations, total_frees);
-    if (start_count != count) { // only a problem if trace isn't stopped before dumping
+    if (start_count != trace_index.count) { // only a problem if trace isn't stopped before dumping
         printf("(NB: New entries were traced while dumping, so trace dump may have duplicate entries.)\n");
     }
     if (has_overflowed) {
@@ -190,33 +258,31 @@ void heap_trace_dump(void)
 }
 
 /* Add a new allocation to the heap trace records */
-static IRAM_ATTR void record_allocation(const heap_trace_record_t *record)
+static IRAM_ATTR void record_allocation(const heap_trace_record_t *record, uint32_t caps)
 {
+#ifdef CONFIG_HEAP_TRACING_TOHOST
+    if (to_host) {
+        if (tracing) {
+            heap_trace_tohost_record_alloc(record, caps);
+        }
+        return;
+    }
+#endif
     portENTER_CRITICAL(&trace_mux);
     if (tracing) {
-        if (count == total_records) {
+        /* if the buffer is full, the oldest record is dropped to make room */
+        bool evicted;
+        size_t slot = heap_trace_index_add(&trace_index, record->address, &evicted);
+        if (evicted) {
             has_overflowed = true;
-            /* Move the whole buffer back one slot.
-
-               This is a bit slow, compared to treating this buffer as a ringbuffer and rotating a head pointer.
-
-               However, ringbuffer code gets tricky when we remove elements in mid-buffer (for leak trace mode) while
-               trying to keep track of an item count that may overflow.
-            */
-            memmove(&buffer[0], &buffer[1], sizeof(heap_trace_record_t) * (total_records -1));
-            count--;
         }
         // Copy new record into place
-        memcpy(&buffer[count], record, sizeof(heap_trace_record_t));
-        count++;
+        memcpy(&buffer[slot], record, sizeof(heap_trace_record_t));
         total_allocations++;
     }
     portEXIT_CRITICAL(&trace_mux);
 }
 
-// remove a record, used when freeing
-static void remove_record(int index);
-
 /* record a free event in the heap trace log
 
    For HEAP_TRACE_ALL, this means filling in the freed_by pointer.
@@ -224,43 +290,35 @@ static void remove_record(int index);
 */
 static IRAM_ATTR void record_free(void *p, void **callers)
 {
+#ifdef CONFIG_HEAP_TRACING_TOHOST
+    if (to_host) {
+        if (tracing) {
+            heap_trace_tohost_record_free(p, callers);
+        }
+        return;
+    }
+#endif
     portENTER_CRITICAL(&trace_mux);
-    if (tracing && count > 0) {
+    if (tracing && trace_index.count > 0) {
         total_frees++;
-        /* search backwards for the allocation record matching this free */
-        int i;
-        for (i = count - 1; i >= 0; i--) {
-            if (buffer[i].address == p) {
-                break;
-            }
-        }
+        /* find the record of the allocation matching this free */
+        size_t slot = heap_trace_index_find(&trace_index, p);
 
-        if (i >= 0) {
+        if (slot != HEAP_TRACE_INDEX_NONE) {
             if (mode == HEAP_TRACE_ALL) {
-                memcpy(buffer[i].freed_by, callers, sizeof(void *) * STACK_DEPTH);
+                memcpy(buffer[slot].freed_by, callers, sizeof(void *) * STACK_DEPTH);
+                // the record stays in the log, but a later allocation at the same address gets its own record
+                heap_trace_index_unindex(&trace_index, slot);
             } else { // HEAP_TRACE_LEAKS
                 // Leak trace mode, once an allocation is freed we remove it from the list
-                remove_record(i);
+                memset(&buffer[slot], 0, sizeof(heap_trace_record_t));
+                heap_trace_index_remove(&trace_index, slot);
             }
         }
     }
     portEXIT_CRITICAL(&trace_mux);
 }
 
-/* remove the entry at 'index' from the ringbuffer of saved records */
-static IRAM_ATTR void remove_record(int index)
-{
-    if (index < count - 1) {
-        // Remove the buffer entry from the list
-        memmove(&buffer[index], &buffer[index+1],
-                sizeof(heap_trace_record_t) * (total_records - index - 1));
-    } else {
-        // For last element, just zero it out to avoid ambiguity
-        memset(&buffer[index], 0, sizeof(heap_trace_record_t));
-    }
-    count--;
-}
-
 /* Encode the CPU ID in the LSB of the ccount value */
 inline static uint32_t get_ccount(void)
 {
@@ -335,7 +393,7 @@ static IRAM_ATTR __attribute__((noinline)) void *trace_malloc(size_t size, uint3
             .size = size,
         };
         get_call_stack(rec.alloced_by);
-        record_allocation(&rec);
+        record_allocation(&rec, (mode == TRACE_MALLOC_CAPS) ? caps : MALLOC_CAP_DEFAULT);
     }
     return p;
 }
@@ -382,7 +440,7 @@ static IRAM_ATTR __attribute__((noinline)) void *trace_realloc(void *p, size_t s
             .size = size,
         };
         memcpy(rec.alloced_by, callers, sizeof(void *) * STACK_DEPTH);
-        record_allocation(&rec);
+        record_allocation(&rec, (mode == TRACE_MALLOC_CAPS) ? caps : MALLOC_CAP_DEFAULT);
     }
     return r;
 }
@@ -0,0 +1,219 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include "heap_trace_index.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#else
+#define IRAM_ATTR
+#endif
+
+/* Note: this source file depends on libc only, so that the host tests can use it */
+
+/* Number of hash buckets: a power of two, at least twice the number of slots. None for an empty index. */
+static size_t bucket_count(size_t num_slots)
+{
+    if (num_slots == 0) {
+        return 0;
+    }
+    size_t count = 2;
+    while (count < num_slots * 2) {
+        count *= 2;
+    }
+    return count;
+}
+
+static inline IRAM_ATTR size_t hash_address(const heap_trace_index_t *index, const void *address)
+{
+    /* Fibonacci hashing, the top bits of the product depend on all bits of the address */
+    return (uint32_t)((uint32_t)(uintptr_t)address * 2654435769u) >> index->hash_shift;
+}
+
+size_t heap_trace_index_memory_size(size_t num_slots)
+{
+    return num_slots * (2 * sizeof(uint16_t) + sizeof(void *)) + bucket_count(num_slots) * sizeof(uint16_t);
+}
+
+void heap_trace_index_init(heap_trace_index_t *index, void *memory, size_t num_slots)
+{
+    assert(num_slots <= HEAP_TRACE_INDEX_MAX_SLOTS);
+    /* pointers first, for alignment */
+    index->num_slots = num_slots;
+    index->addresses = (void **)memory;
+    index->next = (uint16_t *)(index->addresses + num_slots);
+    index->prev = index->next + num_slots;
+    index->buckets = index->prev + num_slots;
+    index->bucket_mask = (num_slots > 0) ? bucket_count(num_slots) - 1 : 0;
+    index->hash_shift = 32 - __builtin_popcount(index->bucket_mask);
+    heap_trace_index_clear(index);
+}
+
+void heap_trace_index_clear(heap_trace_index_t *index)
+{
+    for (size_t i = 0; i < index->num_slots; i++) {
+        index->next[i] = (i + 1 < index->num_slots) ? i + 1 : HEAP_TRACE_INDEX_NONE;
+        index->addresses[i] = NULL;
+    }
+    if (index->num_slots > 0) {
+        memset(index->buckets, 0xFF, (index->bucket_mask + 1) * sizeof(uint16_t));
+    }
+    index->free_head = (index->num_slots > 0) ? 0 : HEAP_TRACE_INDEX_NONE;
+    index->head = HEAP_TRACE_INDEX_NONE;
+    index->tail = HEAP_TRACE_INDEX_NONE;
+    index->count = 0;
+    index->cached_slot = HEAP_TRACE_INDEX_NONE;
+}
+
+/* Find the bucket which holds 'slot' */
+static IRAM_ATTR size_t find_bucket(const heap_trace_index_t *index, size_t slot)
+{
+    size_t bucket = hash_address(index, index->addresses[slot]);
+    while (index->buckets[bucket] != slot) {
+        assert(index->buckets[bucket] != HEAP_TRACE_INDEX_NONE);
+        bucket = (bucket + 1) & index->bucket_mask;
+    }
+    return bucket;
+}
+
+/* Remove a slot from the hash table. Later entries of the same probe sequence move back to fill the hole,
+   so that lookups can stop at the first empty bucket. */
+static IRAM_ATTR void remove_from_buckets(heap_trace_index_t *index, size_t slot)
+{
+    size_t hole = find_bucket(index, slot);
+    size_t bucket = hole;
+    while (true) {
+        bucket = (bucket + 1) & index->bucket_mask;
+        uint16_t entry = index->buckets[bucket];
+        if (entry == HEAP_TRACE_INDEX_NONE) {
+            break;
+        }
+        size_t home = hash_address(index, index->addresses[entry]);
+        /* the entry can move to the hole unless its home bucket is cyclically in (hole, bucket] */
+        bool stays = (hole <= bucket) ? (home > hole && home <= bucket) : (home > hole || home <= bucket);
+        if (!stays) {
+            index->buckets[hole] = entry;
+            hole = bucket;
+        }
+    }
+    index->buckets[hole] = HEAP_TRACE_INDEX_NONE;
+    index->addresses[slot] = NULL;
+}
+
+size_t IRAM_ATTR heap_trace_index_add(heap_trace_index_t *index, void *address, bool *evicted)
+{
+    size_t slot = index->free_head;
+    *evicted = false;
+    if (slot == HEAP_TRACE_INDEX_NONE) {
+        /* all slots in use, reuse the oldest */
+        slot = index->head;
+        heap_trace_index_remove(index, slot);
+        *evicted = true;
+    }
+    index->free_head = index->next[slot];
+
+    /* append to the list of slots in use */
+    index->next[slot] = HEAP_TRACE_INDEX_NONE;
+    index->prev[slot] = index->tail;
+    if (index->tail != HEAP_TRACE_INDEX_NONE) {
+        index->next[index->tail] = slot;
+    } else {
+        index->head = slot;
+    }
+    index->tail = slot;
+    index->count++;
+
+    if (address != NULL) {
+        size_t bucket = hash_address(index, address);
+        while (index->buckets[bucket] != HEAP_TRACE_INDEX_NONE) {
+            bucket = (bucket + 1) & index->bucket_mask;
+        }
+        index->buckets[bucket] = slot;
+    }
+    index->addresses[slot] = address;
+    return slot;
+}
+
+size_t IRAM_ATTR heap_trace_index_find(heap_trace_index_t *index, void *address)
+{
+    if (index->num_slots == 0) {
+        return HEAP_TRACE_INDEX_NONE;
+    }
+    size_t bucket = hash_address(index, address);
+    while (true) {
+        uint16_t slot = index->buckets[bucket];
+        if (slot == HEAP_TRACE_INDEX_NONE || index->addresses[slot] == address) {
+            return slot;
+        }
+        bucket = (bucket + 1) & index->bucket_mask;
+    }
+}
+
+void IRAM_ATTR heap_trace_index_unindex(heap_trace_index_t *index, size_t slot)
+{
+    if (index->addresses[slot] != NULL) {
+        remove_from_buckets(index, slot);
+    }
+}
+
+void IRAM_ATTR heap_trace_index_remove(heap_trace_index_t *index, size_t slot)
+{
+    heap_trace_index_unindex(index, slot);
+
+    uint16_t next = index->next[slot];
+    uint16_t prev = index->prev[slot];
+    if (prev != HEAP_TRACE_INDEX_NONE) {
+        index->next[prev] = next;
+    } else {
+        index->head = next;
+    }
+    if (next != HEAP_TRACE_INDEX_NONE) {
+        index->prev[next] = prev;
+    } else {
+        index->tail = prev;
+    }
+    index->count--;
+
+    index->next[slot] = index->free_head;
+    index->free_head = slot;
+    index->cached_slot = HEAP_TRACE_INDEX_NONE;
+}
+
+size_t heap_trace_index_get_slot(heap_trace_index_t *index, size_t position)
+{
+    if (position >= index->count) {
+        return HEAP_TRACE_INDEX_NONE;
+    }
+
+    size_t slot;
+    size_t pos;
+    if (index->cached_slot != HEAP_TRACE_INDEX_NONE && position >= index->cached_position) {
+        slot = index->cached_slot;
+        pos = index->cached_position;
+    } else {
+        slot = index->head;
+        pos = 0;
+    }
+    for (; pos < position; pos++) {
+        slot = index->next[slot];
+    }
+
+    index->cached_position = position;
+    index->cached_slot = slot;
+    return slot;
+}
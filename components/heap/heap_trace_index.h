@@ -0,0 +1,83 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Index of the heap trace record buffer (heap_trace.c).
+
+   The records of the buffer are "slots". Slots in use are kept in a list in the order they were taken, so that
+   records can be returned oldest first, and unused slots in a free list. Slots of allocations which have not been
+   freed are also in a hash table keyed by address (open addressing, linear probing), so that a free finds its record
+   without searching the buffer. Every operation takes constant time, apart from heap_trace_index_clear() and
+   heap_trace_index_get_slot() for out of order positions.
+*/
+
+/* No slot */
+#define HEAP_TRACE_INDEX_NONE 0xFFFF
+
+/* Maximum number of slots */
+#define HEAP_TRACE_INDEX_MAX_SLOTS (HEAP_TRACE_INDEX_NONE - 1)
+
+typedef struct {
+    size_t num_slots;
+    size_t count;               ///< Number of slots in use
+    uint16_t head;              ///< Oldest slot in use
+    uint16_t tail;              ///< Newest slot in use
+    uint16_t free_head;         ///< First unused slot
+    uint16_t *next;             ///< Per slot: next slot in use, or next unused slot
+    uint16_t *prev;             ///< Per slot: previous slot in use
+    void **addresses;           ///< Per slot: address of the allocation, NULL if it isn't in the hash table
+    uint16_t *buckets;          ///< Hash table of slots
+    size_t bucket_mask;
+    int hash_shift;             ///< 32 - log2(number of buckets)
+    size_t cached_position;     ///< Last position returned by heap_trace_index_get_slot()...
+    uint16_t cached_slot;       ///< ... and its slot, HEAP_TRACE_INDEX_NONE if none
+} heap_trace_index_t;
+
+/* Size of the memory to give to heap_trace_index_init() for 'num_slots' slots */
+size_t heap_trace_index_memory_size(size_t num_slots);
+
+/* Initialise an index of 'num_slots' slots (at most HEAP_TRACE_INDEX_MAX_SLOTS), all unused */
+void heap_trace_index_init(heap_trace_index_t *index, void *memory, size_t num_slots);
+
+/* Make all slots unused */
+void heap_trace_index_clear(heap_trace_index_t *index);
+
+/* Take a slot for a new allocation at 'address'. If all slots are in use, the oldest one is taken and '*evicted' is
+   set to true. Returns the slot. */
+size_t heap_trace_index_add(heap_trace_index_t *index, void *address, bool *evicted);
+
+/* Find the slot of the allocation at 'address' which hasn't been freed, or return HEAP_TRACE_INDEX_NONE */
+size_t heap_trace_index_find(heap_trace_index_t *index, void *address);
+
+/* Mark the allocation of a slot as freed: remove it from the hash table, but keep the slot in use */
+void heap_trace_index_unindex(heap_trace_index_t *index, size_t slot);
+
+/* Make a slot unused */
+void heap_trace_index_remove(heap_trace_index_t *index, size_t slot);
+
+/* Return the slot at 'position' (0 being the oldest) among the slots in use, or HEAP_TRACE_INDEX_NONE.
+   Consecutive positions take constant time. */
+size_t heap_trace_index_get_slot(heap_trace_index_t *index, size_t position);
+
+#ifdef __cplusplus
+}
+#endif
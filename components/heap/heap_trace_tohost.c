@@ -0,0 +1,195 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+#include <stdio.h>
+#include <sdkconfig.h>
+
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_app_trace.h"
+#include "freertos/FreeRTOS.h"
+
+#include "heap_trace_tohost.h"
+
+#define STACK_DEPTH CONFIG_HEAP_TRACING_STACK_DEPTH
+
+/* Time to wait for the last events to reach the host when tracing stops, in microseconds */
+#define STOP_FLUSH_TMO 1000000
+
+/* Protects the counters below, and keeps the events in order of their timestamps */
+static portMUX_TYPE tohost_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t total_allocations;
+static uint32_t total_frees;
+
+/* Events lost since the last event sent, and since tracing started */
+static uint32_t lost;
+static uint32_t total_lost;
+
+/* Time for the next INFO event */
+static int64_t next_info_time;
+
+/* Send an event. Called in a critical section of tohost_mux.
+
+   Events are never waited for: if the trace buffer is full, the event is counted as lost and a LOST event is sent
+   before the next one which fits.
+*/
+static IRAM_ATTR void send_event(heap_trace_tohost_header_t *header, heap_trace_tohost_event_type_t type, size_t length)
+{
+    header->type = type;
+    header->cpu = xPortGetCoreID();
+    header->length = length;
+    header->timestamp = (uint32_t)esp_timer_get_time();
+
+    if (lost > 0) {
+        heap_trace_tohost_lost_t lost_event = {
+            .header = *header,
+            .count = lost,
+        };
+        lost_event.header.type = HEAP_TRACE_TOHOST_EVENT_LOST;
+        lost_event.header.length = sizeof(lost_event);
+        if (esp_apptrace_write(ESP_APPTRACE_DEST_TRAX, &lost_event, sizeof(lost_event), 0) != ESP_OK) {
+            lost++;
+            total_lost++;
+            return;
+        }
+        lost = 0;
+    }
+
+    if (esp_apptrace_write(ESP_APPTRACE_DEST_TRAX, header, length, 0) != ESP_OK) {
+        lost++;
+        total_lost++;
+    }
+}
+
+static void send_info(void)
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    heap_trace_tohost_info_t event = {
+        .free_bytes = info.total_free_bytes,
+        .largest_free_block = info.largest_free_block,
+        .minimum_free_bytes = info.minimum_free_bytes,
+        .allocated_blocks = info.allocated_blocks,
+        .free_blocks = info.free_blocks,
+    };
+    portENTER_CRITICAL(&tohost_mux);
+    send_event(&event.header, HEAP_TRACE_TOHOST_EVENT_INFO, sizeof(event));
+    portEXIT_CRITICAL(&tohost_mux);
+}
+
+/* Send an INFO event if one is due.
+
+   Getting heap information walks all heap blocks, so it isn't done in interrupts.
+*/
+static IRAM_ATTR void check_info(void)
+{
+#if CONFIG_HEAP_TRACING_TOHOST_INFO_PERIOD > 0
+    if (xPortInIsrContext()) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    bool due = false;
+    portENTER_CRITICAL(&tohost_mux);
+    if (now >= next_info_time) {
+        next_info_time = now + CONFIG_HEAP_TRACING_TOHOST_INFO_PERIOD * 1000LL;
+        due = true;
+    }
+    portEXIT_CRITICAL(&tohost_mux);
+    if (due) {
+        send_info();
+    }
+#endif
+}
+
+void heap_trace_tohost_start(heap_trace_mode_t mode)
+{
+    heap_trace_tohost_start_t event = {
+        .magic = HEAP_TRACE_TOHOST_MAGIC,
+        .version = HEAP_TRACE_TOHOST_VERSION,
+        .mode = mode,
+        .stack_depth = STACK_DEPTH,
+    };
+    portENTER_CRITICAL(&tohost_mux);
+    total_allocations = 0;
+    total_frees = 0;
+    lost = 0;
+    total_lost = 0;
+    next_info_time = esp_timer_get_time() + CONFIG_HEAP_TRACING_TOHOST_INFO_PERIOD * 1000LL;
+    send_event(&event.header, HEAP_TRACE_TOHOST_EVENT_START, sizeof(event));
+    portEXIT_CRITICAL(&tohost_mux);
+    send_info();
+}
+
+void heap_trace_tohost_stop(void)
+{
+    send_info();
+    heap_trace_tohost_stop_t event;
+    portENTER_CRITICAL(&tohost_mux);
+    event.total_allocations = total_allocations;
+    event.total_frees = total_frees;
+    event.total_lost = total_lost;
+    send_event(&event.header, HEAP_TRACE_TOHOST_EVENT_STOP, sizeof(event));
+    portEXIT_CRITICAL(&tohost_mux);
+    esp_apptrace_flush(ESP_APPTRACE_DEST_TRAX, STOP_FLUSH_TMO);
+}
+
+void IRAM_ATTR heap_trace_tohost_record_alloc(const heap_trace_record_t *record, uint32_t caps)
+{
+    struct {
+        heap_trace_tohost_alloc_t alloc;
+        uint32_t callers[STACK_DEPTH];
+    } __attribute__((packed)) event = {
+        .alloc = {
+            .address = (uint32_t)record->address,
+            .size = record->size,
+            .caps = caps,
+        },
+    };
+    memcpy(event.callers, record->alloced_by, sizeof(event.callers));
+
+    portENTER_CRITICAL(&tohost_mux);
+    total_allocations++;
+    send_event(&event.alloc.header, HEAP_TRACE_TOHOST_EVENT_ALLOC, sizeof(event));
+    portEXIT_CRITICAL(&tohost_mux);
+    check_info();
+}
+
+void IRAM_ATTR heap_trace_tohost_record_free(void *p, void **callers)
+{
+    struct {
+        heap_trace_tohost_free_t free;
+        uint32_t callers[STACK_DEPTH];
+    } __attribute__((packed)) event = {
+        .free = {
+            .address = (uint32_t)p,
+        },
+    };
+    memcpy(event.callers, callers, sizeof(event.callers));
+
+    portENTER_CRITICAL(&tohost_mux);
+    total_frees++;
+    send_event(&event.free.header, HEAP_TRACE_TOHOST_EVENT_FREE, sizeof(event));
+    portEXIT_CRITICAL(&tohost_mux);
+    check_info();
+}
+
+void heap_trace_tohost_dump(void)
+{
+    printf("heap trace sent to host: total allocations %u total frees %u\n", total_allocations, total_frees);
+    if (total_lost > 0) {
+        printf("(NB: %u events were lost as the trace buffer was full, so trace data is incomplete.)\n", total_lost);
+    }
+}
@@ -0,0 +1,111 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+#include "esp_heap_trace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Heap tracing to the host (heap_trace_tohost.c), used by heap_trace.c after heap_trace_init_tohost().
+
+   Heap operations are sent as a stream of events via application level tracing. The format of the events is
+   below, all fields are little endian. tools/esp_app_trace/heaptrace_proc.py decodes it, keep them in sync.
+*/
+
+#define HEAP_TRACE_TOHOST_MAGIC 0x52544845 /* "EHTR" */
+#define HEAP_TRACE_TOHOST_VERSION 1
+
+typedef enum {
+    HEAP_TRACE_TOHOST_EVENT_START = 1,
+    HEAP_TRACE_TOHOST_EVENT_ALLOC = 2,
+    HEAP_TRACE_TOHOST_EVENT_FREE = 3,
+    HEAP_TRACE_TOHOST_EVENT_INFO = 4,
+    HEAP_TRACE_TOHOST_EVENT_LOST = 5,
+    HEAP_TRACE_TOHOST_EVENT_STOP = 6,
+} heap_trace_tohost_event_type_t;
+
+/* Start of every event */
+typedef struct {
+    uint8_t type;               ///< heap_trace_tohost_event_type_t
+    uint8_t cpu;                ///< CPU which sent the event
+    uint16_t length;            ///< Length of the whole event in bytes
+    uint32_t timestamp;         ///< esp_timer_get_time() in microseconds, wraps around every 71 minutes
+} __attribute__((packed)) heap_trace_tohost_header_t;
+
+/* Sent by heap_trace_start() */
+typedef struct {
+    heap_trace_tohost_header_t header;
+    uint32_t magic;             ///< HEAP_TRACE_TOHOST_MAGIC
+    uint8_t version;            ///< HEAP_TRACE_TOHOST_VERSION
+    uint8_t mode;               ///< heap_trace_mode_t
+    uint8_t stack_depth;        ///< Number of callers in ALLOC and FREE events
+    uint8_t reserved;
+} __attribute__((packed)) heap_trace_tohost_start_t;
+
+/* Allocation, followed by 'stack_depth' 32-bit caller addresses */
+typedef struct {
+    heap_trace_tohost_header_t header;
+    uint32_t address;
+    uint32_t size;
+    uint32_t caps;
+} __attribute__((packed)) heap_trace_tohost_alloc_t;
+
+/* Free, followed by 'stack_depth' 32-bit caller addresses */
+typedef struct {
+    heap_trace_tohost_header_t header;
+    uint32_t address;
+} __attribute__((packed)) heap_trace_tohost_free_t;
+
+/* Heap information for MALLOC_CAP_8BIT, see multi_heap_info_t. Sent periodically, see
+   CONFIG_HEAP_TRACING_TOHOST_INFO_PERIOD, and when tracing starts and stops. */
+typedef struct {
+    heap_trace_tohost_header_t header;
+    uint32_t free_bytes;
+    uint32_t largest_free_block;
+    uint32_t minimum_free_bytes;
+    uint32_t allocated_blocks;
+    uint32_t free_blocks;
+} __attribute__((packed)) heap_trace_tohost_info_t;
+
+/* Number of events lost since the previous event, because the trace buffer was full */
+typedef struct {
+    heap_trace_tohost_header_t header;
+    uint32_t count;
+} __attribute__((packed)) heap_trace_tohost_lost_t;
+
+/* Sent by heap_trace_stop() */
+typedef struct {
+    heap_trace_tohost_header_t header;
+    uint32_t total_allocations;
+    uint32_t total_frees;
+    uint32_t total_lost;
+} __attribute__((packed)) heap_trace_tohost_stop_t;
+
+void heap_trace_tohost_start(heap_trace_mode_t mode);
+
+void heap_trace_tohost_stop(void);
+
+void heap_trace_tohost_record_alloc(const heap_trace_record_t *record, uint32_t caps);
+
+void heap_trace_tohost_record_free(void *p, void **callers);
+
+/* Print the counts of events sent and lost */
+void heap_trace_tohost_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
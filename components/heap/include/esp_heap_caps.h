@@ -163,12 +163,33 @@ size_t heap_caps_get_largest_free_block( uint32_t caps );
  */
 void heap_caps_get_info( multi_heap_info_t *info, uint32_t caps );
 
+/**
+ * @brief Get histograms of the heap block sizes for all regions with the given capabilities.
+ *
+ * Calls multi_heap_get_histogram() on all heaps which share the given capabilities, and adds up the counts of each
+ * size class. This takes constant time per heap, so it can be called often to watch fragmentation. All counts are
+ * zero unless CONFIG_HEAP_HISTOGRAM is enabled.
+ *
+ * Unlike heap_caps_get_info(), blocks held by the per-core caches (CONFIG_HEAP_CACHE) are counted as allocated, and
+ * allocations served by the caches aren't counted.
+ *
+ * @param histogram   Pointer to a structure which will be filled with the
+ *                    histograms.
+ * @param caps        Bitwise OR of MALLOC_CAP_* flags indicating the type
+ *                    of memory
+ *
+ */
+void heap_caps_get_histogram( multi_heap_histogram_t *histogram, uint32_t caps );
+
 
 /**
  * @brief Print a summary of all memory with the given capabilities.
  *
  * Calls multi_heap_info on all heaps which share the given capabilities, and
- * prints a two-line summary for each, then a total summary.
+ * prints a two-line summary for each, then a total summary. If
+ * CONFIG_HEAP_HISTOGRAM is enabled, the total summary includes the histograms
+ * of heap_caps_get_histogram(). Pools created with heap_caps_pool_create() in
+ * this memory are listed after the total.
  *
  * @param caps        Bitwise OR of MALLOC_CAP_* flags indicating the type
  *                    of memory
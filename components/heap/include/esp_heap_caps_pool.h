@@ -0,0 +1,145 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_heap_caps.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Only one task allocates objects from the pool
+ *
+ * Objects can still be freed by any task. Allocating and freeing don't take a lock,
+ * they update the list of free objects with atomic compare-and-set operations instead.
+ *
+ * Pools in external memory ignore this flag, as the compare-and-set instruction
+ * doesn't work there.
+ */
+#define HEAP_CAPS_POOL_FLAG_SINGLE_ALLOCATOR (1 << 0)
+
+/**
+ * @brief Opaque handle to a pool of fixed size objects
+ */
+typedef struct heap_caps_pool *heap_caps_pool_handle_t;
+
+/**
+ * @brief Structure to access pool metadata via heap_caps_pool_get_info
+ */
+typedef struct {
+    size_t object_size;           ///< Size of each object, as passed to heap_caps_pool_create()
+    size_t total_objects;         ///< Number of objects in the pool
+    size_t free_objects;          ///< Number of objects which are currently free
+    size_t minimum_free_objects;  ///< Lifetime minimum number of free objects
+    size_t alloc_failures;        ///< Number of heap_caps_pool_alloc() calls which found no free object
+    size_t total_bytes;           ///< Heap memory taken by the pool, including its overhead
+} heap_caps_pool_info_t;
+
+/**
+ * @brief Create a pool of fixed size objects
+ *
+ * All objects are carved from a single block of memory, allocated with heap_caps_malloc().
+ * Allocating and freeing an object takes constant time, and objects have no per-object
+ * header unless heap poisoning is enabled (see below).
+ *
+ * If heap poisoning is enabled, every object gets a head and a tail canary, so that
+ * heap_caps_pool_free() detects buffer overruns and double frees. With comprehensive
+ * poisoning, free objects are also filled with a pattern which heap_caps_pool_alloc()
+ * checks, to detect writes to freed objects.
+ *
+ * @param object_size Size of each object, in bytes. Objects are 4 byte aligned.
+ * @param count Number of objects in the pool
+ * @param caps Bitwise OR of MALLOC_CAP_* flags indicating the type of memory for the pool
+ *
+ * @return Handle to the pool, or NULL if the parameters are invalid or there isn't enough memory.
+ */
+heap_caps_pool_handle_t heap_caps_pool_create(size_t object_size, size_t count, uint32_t caps);
+
+/**
+ * @brief Create a pool of fixed size objects, with additional options
+ *
+ * Same as heap_caps_pool_create(), see that function for details.
+ *
+ * @param object_size Size of each object, in bytes. Objects are 4 byte aligned.
+ * @param count Number of objects in the pool
+ * @param caps Bitwise OR of MALLOC_CAP_* flags indicating the type of memory for the pool
+ * @param flags Bitwise OR of HEAP_CAPS_POOL_FLAG_* flags
+ *
+ * @return Handle to the pool, or NULL if the parameters are invalid or there isn't enough memory.
+ */
+heap_caps_pool_handle_t heap_caps_pool_create_with_flags(size_t object_size, size_t count, uint32_t caps, uint32_t flags);
+
+/**
+ * @brief Delete a pool, freeing its memory
+ *
+ * Objects which are still allocated from the pool become invalid.
+ *
+ * @param pool Handle to the pool. Can be NULL.
+ */
+void heap_caps_pool_delete(heap_caps_pool_handle_t pool);
+
+/**
+ * @brief Allocate an object from a pool
+ *
+ * @param pool Handle to the pool
+ *
+ * @return Pointer to an object of the size the pool was created with, or NULL if all objects are in use.
+ */
+void *heap_caps_pool_alloc(heap_caps_pool_handle_t pool);
+
+/**
+ * @brief Free an object back to its pool
+ *
+ * @param pool Handle to the pool
+ * @param obj Pointer to an object previously returned by heap_caps_pool_alloc() for this pool. Can be NULL.
+ */
+void heap_caps_pool_free(heap_caps_pool_handle_t pool, void *obj);
+
+/**
+ * @brief Get metadata about a pool
+ *
+ * @param pool Handle to the pool
+ * @param info Pointer to a structure which will be filled with relevant pool metadata.
+ */
+void heap_caps_pool_get_info(heap_caps_pool_handle_t pool, heap_caps_pool_info_t *info);
+
+/**
+ * @brief Print metadata about a pool to stdout
+ *
+ * heap_caps_print_heap_info() also prints this for all pools in memory with the given capabilities.
+ *
+ * @param pool Handle to the pool
+ */
+void heap_caps_pool_print_info(heap_caps_pool_handle_t pool);
+
+/**
+ * @brief Check integrity of a pool
+ *
+ * Checks the canaries of all objects if heap poisoning is enabled, and the
+ * list of free objects unless the pool was created with HEAP_CAPS_POOL_FLAG_SINGLE_ALLOCATOR.
+ *
+ * @param pool Handle to the pool
+ * @param print_errors Print specific errors if the pool is corrupt.
+ *
+ * @return True if the pool is valid, False if it is corrupt.
+ */
+bool heap_caps_pool_check(heap_caps_pool_handle_t pool, bool print_errors);
+
+#ifdef __cplusplus
+}
+#endif
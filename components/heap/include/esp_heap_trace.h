@@ -53,20 +53,43 @@ typedef struct {
  *
  * To disable heap tracing and allow the buffer to be freed, stop tracing and then call heap_trace_init_standalone(NULL, 0);
  *
+ * An index of the records (12 to 16 bytes per record) is allocated from internal memory, so that frees find the record of
+ * their allocation quickly. It is freed by heap_trace_init_standalone(NULL, 0) too.
+ *
  * @param record_buffer Provide a buffer to use for heap trace data. Must remain valid any time heap tracing is enabled, meaning
  * it must be allocated from internal memory not in PSRAM.
- * @param num_records Size of the heap trace buffer, as number of record structures.
+ * @param num_records Size of the heap trace buffer, as number of record structures. At most 65534.
  * @return
  *  - ESP_ERR_NOT_SUPPORTED Project was compiled without heap tracing enabled in menuconfig.
  *  - ESP_ERR_INVALID_STATE Heap tracing is currently in progress.
+ *  - ESP_ERR_INVALID_ARG num_records is too large.
+ *  - ESP_ERR_NO_MEM Not enough internal memory for the index of the records.
  *  - ESP_OK Heap tracing initialised successfully.
  */
 esp_err_t heap_trace_init_standalone(heap_trace_record_t *record_buffer, size_t num_records);
 
+/**
+ * @brief Initialise heap tracing to the host.
+ *
+ * In this mode no records are kept in RAM. Every allocation and free is sent as an event to the host via application
+ * level tracing (JTAG), along with periodic heap information, so tracing can run for as long as needed. Save the
+ * trace data on the host with OpenOCD ``esp32 apptrace start file://heap.trc``, and decode it with
+ * ``tools/esp_app_trace/heaptrace_proc.py``. The application level trace must not be used for anything else meanwhile.
+ *
+ * heap_trace_get_count() and heap_trace_get() return no records in this mode, and heap_trace_dump() only prints
+ * the number of events sent. Call heap_trace_init_standalone() to go back to tracing to a buffer.
+ *
+ * @return
+ *  - ESP_ERR_NOT_SUPPORTED Project was compiled without heap tracing to host enabled in menuconfig.
+ *  - ESP_ERR_INVALID_STATE Heap tracing is currently in progress.
+ *  - ESP_OK Heap tracing initialised successfully.
+ */
+esp_err_t heap_trace_init_tohost(void);
+
 /**
  * @brief Start heap tracing. All heap allocations & frees will be traced, until heap_trace_stop() is called.
  *
- * @note heap_trace_init_standalone() must be called to provide a valid buffer, before this function is called.
+ * @note heap_trace_init_standalone() must be called to provide a valid buffer, or heap_trace_init_tohost(), before this function is called.
  *
  * @note Calling this function while heap tracing is running will reset the heap trace state and continue tracing.
  *
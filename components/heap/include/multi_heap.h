@@ -155,6 +155,7 @@ typedef struct {
     size_t allocated_blocks;      ///<  Number of (variable size) blocks allocated in the heap.
     size_t free_blocks;           ///<  Number of (variable size) free blocks in the heap.
     size_t total_blocks;          ///<  Total number of (variable size) blocks in the heap.
+    size_t total_cached_bytes;    ///<  Bytes held in per-core caches (CONFIG_HEAP_CACHE). These are counted as free by heap_caps_get_info().
 } multi_heap_info_t;
 
 /** @brief Return metadata about a given heap
@@ -166,6 +167,46 @@ typedef struct {
  */
 void multi_heap_get_info(multi_heap_handle_t heap, multi_heap_info_t *info);
 
+/** @brief Number of size classes in multi_heap_histogram_t
+ *
+ * Class 0 counts blocks of less than 16 bytes. Class N counts blocks of 2^(N+3) to 2^(N+4)-1 bytes, except the last
+ * class which counts all blocks of 2^(N+3) bytes or more.
+ */
+#define MULTI_HEAP_HISTOGRAM_CLASSES 16
+
+/** @brief Histograms of heap block sizes, see multi_heap_get_histogram */
+typedef struct {
+    size_t free_blocks[MULTI_HEAP_HISTOGRAM_CLASSES];      ///< Number of free blocks of each size class.
+    size_t free_bytes[MULTI_HEAP_HISTOGRAM_CLASSES];       ///< Total size of the free blocks of each size class.
+    size_t allocated_blocks[MULTI_HEAP_HISTOGRAM_CLASSES]; ///< Number of allocated blocks of each size class.
+    size_t allocations[MULTI_HEAP_HISTOGRAM_CLASSES];      ///< Number of allocations of each requested size class since the heap was registered.
+} multi_heap_histogram_t;
+
+/** @brief Start keeping histograms of the block sizes of a heap
+ *
+ * Counts the blocks the heap already has, then every heap operation keeps the histograms up to date. Allocations are
+ * counted from this call on. Does nothing unless CONFIG_HEAP_HISTOGRAM is enabled.
+ *
+ * When the heap is first registered, it has no histogram.
+ *
+ * @param heap Handle to a registered heap.
+ * @param histogram Structure to keep the histograms in, which must stay valid while it is set (it can be allocated
+ * from the heap itself.) NULL to stop keeping histograms.
+ */
+void multi_heap_set_histogram(multi_heap_handle_t heap, multi_heap_histogram_t *histogram);
+
+/** @brief Return histograms of the block sizes of a given heap
+ *
+ * Copies the histograms kept since multi_heap_set_histogram(), so this function takes constant time. All counts are
+ * zero if the heap has no histogram.
+ *
+ * Sizes are sizes of the block data, which include the overhead of heap poisoning if it is enabled.
+ *
+ * @param heap Handle to a registered heap.
+ * @param histogram Pointer to a structure to fill with the histograms.
+ */
+void multi_heap_get_histogram(multi_heap_handle_t heap, multi_heap_histogram_t *histogram);
+
 #ifdef __cplusplus
 }
 #endif
@@ -28,6 +28,10 @@
 /* Defines compile-time configuration macros */
 #include "multi_heap_config.h"
 
+/* Best fit implementation of the multi_heap "_impl" functions, unless the segregated fit one in
+   multi_heap_segregated.c is selected */
+#ifndef MULTI_HEAP_SEGREGATED_FIT
+
 #ifndef MULTI_HEAP_POISONING
 /* if no heap poisoning, public API aliases directly to these implementations */
 void *multi_heap_malloc(multi_heap_handle_t heap, size_t size)
@@ -57,6 +61,9 @@ size_t multi_heap_minimum_free_size(multi_heap_handle_t heap)
 void *multi_heap_get_block_address(multi_heap_block_handle_t block)
     __attribute__((alias("multi_heap_get_block_address_impl")));
 
+void multi_heap_get_histogram(multi_heap_handle_t heap, multi_heap_histogram_t *histogram)
+    __attribute__((alias("multi_heap_get_histogram_impl")));
+
 void *multi_heap_get_block_owner(multi_heap_block_handle_t block)
 {
     return NULL;
@@ -102,9 +109,36 @@ typedef struct multi_heap_info {
     size_t free_bytes;
     size_t minimum_free_bytes;
     heap_block_t *last_block;
+#ifdef MULTI_HEAP_HISTOGRAM
+    multi_heap_histogram_t *histogram; /* NULL unless set, doesn't count first_block and last_block */
+#endif
     heap_block_t first_block; /* initial 'free block', never allocated */
 } heap_t;
 
+/* Histogram updates, if multi_heap_set_histogram() was called. HISTOGRAM_FREE() counts a free block in or out with
+   its current size, allocated blocks are counted by the malloc, free and realloc functions. */
+#ifdef MULTI_HEAP_HISTOGRAM
+#define HISTOGRAM_FREE(HEAP, BLOCK, DELTA) do {                                     \
+        if ((HEAP)->histogram != NULL) {                                            \
+            multi_heap_histogram_update_free((HEAP)->histogram, block_data_size(BLOCK), (DELTA)); \
+        }                                                                           \
+    } while(0)
+#define HISTOGRAM_ALLOCATED(HEAP, SIZE, DELTA) do {                                 \
+        if ((HEAP)->histogram != NULL) {                                            \
+            multi_heap_histogram_update_allocated((HEAP)->histogram, (SIZE), (DELTA)); \
+        }                                                                           \
+    } while(0)
+#define HISTOGRAM_ALLOCATION(HEAP, SIZE) do {                                       \
+        if ((HEAP)->histogram != NULL) {                                            \
+            multi_heap_histogram_count_allocation((HEAP)->histogram, (SIZE));       \
+        }                                                                           \
+    } while(0)
+#else
+#define HISTOGRAM_FREE(HEAP, BLOCK, DELTA)
+#define HISTOGRAM_ALLOCATED(HEAP, SIZE, DELTA)
+#define HISTOGRAM_ALLOCATION(HEAP, SIZE)
+#endif
+
 /* Given a pointer to the 'data' field of a block (ie the previous malloc/realloc result), return a pointer to the
    containing block.
 */
@@ -219,11 +253,16 @@ static heap_block_t *merge_adjacent(heap_t *heap, heap_block_t *a, heap_block_t
     MULTI_HEAP_ASSERT(get_next_block(a) == b, a); // Blocks should be in order
 
     bool free = is_free(a) && is_free(b); /* merging two free blocks creates a free block */
+    if (free) {
+        HISTOGRAM_FREE(heap, a, -1);
+        HISTOGRAM_FREE(heap, b, -1);
+    }
     if (!free && (is_free(a) || is_free(b))) {
         /* only one of these blocks is free, so resulting block will be a used block.
            means we need to take the free block out of the free list
          */
         heap_block_t *free_block = is_free(a) ? a : b;
+        HISTOGRAM_FREE(heap, free_block, -1);
         heap_block_t *prev_free = get_prev_free_block(heap, free_block);
         MULTI_HEAP_ASSERT(free_block->next_free > prev_free, &free_block->next_free); // Next free block should be after prev one
         prev_free->next_free = free_block->next_free;
@@ -243,6 +282,7 @@ static heap_block_t *merge_adjacent(heap_t *heap, heap_block_t *a, heap_block_t
 
         /* b's header can be put into the pool of free bytes */
         heap->free_bytes += sizeof(a->header);
+        HISTOGRAM_FREE(heap, a, 1);
     }
 
 #ifdef MULTI_HEAP_POISONING_SLOW
@@ -278,6 +318,7 @@ static void split_if_necessary(heap_t *heap, heap_block_t *block, size_t size, h
 
     if (is_free(next_block) && !is_last_block(next_block)) {
         /* The next block is free, just extend it upwards. */
+        HISTOGRAM_FREE(heap, next_block, -1);
         new_block->header = next_block->header;
         new_block->next_free = next_block->next_free;
         if (prev_free_block == NULL) {
@@ -310,6 +351,7 @@ static void split_if_necessary(heap_t *heap, heap_block_t *block, size_t size, h
     }
     block->header = (intptr_t)new_block;
     prev_free_block->next_free = new_block;
+    HISTOGRAM_FREE(heap, new_block, 1);
 }
 
 void *multi_heap_get_block_address_impl(multi_heap_block_handle_t block)
@@ -362,6 +404,10 @@ multi_heap_handle_t multi_heap_register_impl(void *start_ptr, size_t size)
     heap->free_bytes = size - sizeof(heap_t) - sizeof(first_free_block->header) - sizeof(heap_block_t);
     heap->minimum_free_bytes = heap->free_bytes;
 
+#ifdef MULTI_HEAP_HISTOGRAM
+    heap->histogram = NULL;
+#endif
+
     return heap;
 }
 
@@ -370,6 +416,26 @@ void multi_heap_set_lock(multi_heap_handle_t heap, void *lock)
     heap->lock = lock;
 }
 
+void multi_heap_set_histogram(multi_heap_handle_t heap, multi_heap_histogram_t *histogram)
+{
+#ifdef MULTI_HEAP_HISTOGRAM
+    multi_heap_internal_lock(heap);
+    if (histogram != NULL) {
+        /* count the blocks the heap already has, allocations are only counted from now on */
+        memset(histogram, 0, sizeof(multi_heap_histogram_t));
+        for(heap_block_t *b = get_next_block(&heap->first_block); !is_last_block(b); b = get_next_block(b)) {
+            if (is_free(b)) {
+                multi_heap_histogram_update_free(histogram, block_data_size(b), 1);
+            } else {
+                multi_heap_histogram_update_allocated(histogram, block_data_size(b), 1);
+            }
+        }
+    }
+    heap->histogram = histogram;
+    multi_heap_internal_unlock(heap);
+#endif
+}
+
 void inline multi_heap_internal_lock(multi_heap_handle_t heap)
 {
     MULTI_HEAP_LOCK(heap->lock);
@@ -447,6 +513,7 @@ void *multi_heap_malloc_impl(multi_heap_handle_t heap, size_t size)
         return NULL; /* No room in heap */
     }
 
+    HISTOGRAM_FREE(heap, best_block, -1);
     prev_free->next_free = best_block->next_free;
     best_block->header &= ~BLOCK_FREE_FLAG;
 
@@ -454,6 +521,9 @@ void *multi_heap_malloc_impl(multi_heap_handle_t heap, size_t size)
 
     split_if_necessary(heap, best_block, size, prev_free);
 
+    HISTOGRAM_ALLOCATED(heap, block_data_size(best_block), 1);
+    HISTOGRAM_ALLOCATION(heap, size);
+
     if (heap->free_bytes < heap->minimum_free_bytes) {
         heap->minimum_free_bytes = heap->free_bytes;
     }
@@ -480,6 +550,8 @@ void multi_heap_free_impl(multi_heap_handle_t heap, void *p)
 
     heap_block_t *next = get_next_block(pb);
 
+    HISTOGRAM_ALLOCATED(heap, block_data_size(pb), -1);
+
     /* Update freelist pointers */
     heap_block_t *prev_free = get_prev_free_block(heap, pb);
     // freelist validity check
@@ -491,6 +563,7 @@ void multi_heap_free_impl(multi_heap_handle_t heap, void *p)
     pb->header |= BLOCK_FREE_FLAG;
 
     heap->free_bytes += block_data_size(pb);
+    HISTOGRAM_FREE(heap, pb, 1);
 
     /* Try and merge previous free block into this one */
     if (get_next_block(prev_free) == pb) {
@@ -535,6 +608,9 @@ void *multi_heap_realloc_impl(multi_heap_handle_t heap, void *p, size_t size)
 
     multi_heap_internal_lock(heap);
     result = NULL;
+#ifdef MULTI_HEAP_HISTOGRAM
+    size_t orig_block_size = block_data_size(pb);
+#endif
 
     if (size <= block_data_size(pb)) {
         // Shrinking....
@@ -578,6 +654,17 @@ void *multi_heap_realloc_impl(multi_heap_handle_t heap, void *p, size_t size)
         }
     }
 
+#ifdef MULTI_HEAP_HISTOGRAM
+    // pb may have been resized, even if it is moved below
+    if (block_data_size(pb) != orig_block_size) {
+        HISTOGRAM_ALLOCATED(heap, orig_block_size, -1);
+        HISTOGRAM_ALLOCATED(heap, block_data_size(pb), 1);
+    }
+    if (result != NULL) {
+        HISTOGRAM_ALLOCATION(heap, size);
+    }
+#endif
+
     if (result == NULL) {
         // Need to allocate elsewhere and copy data over
         //
@@ -746,3 +833,22 @@ void multi_heap_get_info_impl(multi_heap_handle_t heap, multi_heap_info_t *info)
     multi_heap_internal_unlock(heap);
 
 }
+
+void multi_heap_get_histogram_impl(multi_heap_handle_t heap, multi_heap_histogram_t *histogram)
+{
+    memset(histogram, 0, sizeof(multi_heap_histogram_t));
+
+#ifdef MULTI_HEAP_HISTOGRAM
+    if (heap == NULL) {
+        return;
+    }
+
+    multi_heap_internal_lock(heap);
+    if (heap->histogram != NULL) {
+        memcpy(histogram, heap->histogram, sizeof(multi_heap_histogram_t));
+    }
+    multi_heap_internal_unlock(heap);
+#endif
+}
+
+#endif // MULTI_HEAP_SEGREGATED_FIT
@@ -0,0 +1,299 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+#include <assert.h>
+#include <multi_heap.h>
+#include "multi_heap_internal.h"
+#include "multi_heap_cache.h"
+
+/* Note: Keep platform-specific parts in this header, this source
+   file should depend on libc only */
+#include "multi_heap_platform.h"
+
+/* Defines compile-time configuration macros */
+#include "multi_heap_config.h"
+
+#define CACHE_CLASS_COUNT 5
+#define CACHE_MIN_SIZE_LOG2 4
+#define CACHE_MIN_SIZE (1 << CACHE_MIN_SIZE_LOG2)
+#define CACHE_MAX_SIZE (CACHE_MIN_SIZE << (CACHE_CLASS_COUNT - 1))
+
+/* Number of blocks taken from or given back to the heap at once */
+#define CACHE_BATCH_SIZE ((MULTI_HEAP_CACHE_MAX_BLOCKS + 1) / 2)
+
+/* A cached block, the first words of its data link it into the cache of its size class */
+typedef struct cached_block {
+    struct cached_block *next;
+    size_t size;                /* allocated size of the block, at least the size of its class */
+} cached_block_t;
+
+/* Cache of one core */
+typedef struct {
+    cached_block_t *blocks[CACHE_CLASS_COUNT];
+    uint8_t count[CACHE_CLASS_COUNT];
+    size_t bytes;
+    MULTI_HEAP_CACHE_LOCK_T lock;   /* taken by the core itself, or by another one flushing all caches */
+} cache_slot_t;
+
+struct multi_heap_cache {
+    multi_heap_handle_t heap;
+    cache_slot_t slots[MULTI_HEAP_CACHE_CORES];
+};
+
+/* Mask interrupts and lock the current core's cache */
+static inline cache_slot_t *lock_slot(multi_heap_cache_handle_t cache, unsigned *state)
+{
+    *state = MULTI_HEAP_CACHE_ENTER();
+    cache_slot_t *slot = &cache->slots[MULTI_HEAP_CACHE_CORE_ID()];
+    MULTI_HEAP_CACHE_LOCK(&slot->lock);
+    return slot;
+}
+
+static inline void unlock_slot(cache_slot_t *slot, unsigned state)
+{
+    MULTI_HEAP_CACHE_UNLOCK(&slot->lock);
+    MULTI_HEAP_CACHE_EXIT(state);
+}
+
+/* Smallest size class which holds 'size' bytes, size must be between 1 and CACHE_MAX_SIZE */
+static inline size_t alloc_class(size_t size)
+{
+    if (size <= CACHE_MIN_SIZE) {
+        return 0;
+    }
+    return sizeof(unsigned) * 8 - __builtin_clz((unsigned)size - 1) - CACHE_MIN_SIZE_LOG2;
+}
+
+/* Largest size class a block of 'size' bytes can serve, size must be between CACHE_MIN_SIZE and 2 * CACHE_MAX_SIZE - 1 */
+static inline size_t free_class(size_t size)
+{
+    return sizeof(unsigned) * 8 - 1 - __builtin_clz((unsigned)size) - CACHE_MIN_SIZE_LOG2;
+}
+
+/* Give a list of blocks back to the heap, under a single heap lock */
+static void release_blocks(multi_heap_cache_handle_t cache, cached_block_t *list)
+{
+    multi_heap_internal_lock(cache->heap);
+    while (list != NULL) {
+        cached_block_t *next = list->next;
+        multi_heap_free(cache->heap, list);
+        list = next;
+    }
+    multi_heap_internal_unlock(cache->heap);
+}
+
+/* Take a block of size class 'cls' from the heap, along with a batch of blocks for the cache */
+static void *refill(multi_heap_cache_handle_t cache, size_t cls)
+{
+    const size_t size = CACHE_MIN_SIZE << cls;
+    cached_block_t *list = NULL;
+    cached_block_t *last = NULL;
+    size_t count = 0;
+    size_t bytes = 0;
+
+    multi_heap_internal_lock(cache->heap);
+    void *result = multi_heap_malloc(cache->heap, size);
+    while (result != NULL && count < CACHE_BATCH_SIZE - 1) {
+        cached_block_t *block = multi_heap_malloc(cache->heap, size);
+        if (block == NULL) {
+            break;
+        }
+        block->size = multi_heap_get_allocated_size(cache->heap, block);
+        block->next = list;
+        list = block;
+        if (last == NULL) {
+            last = block;
+        }
+        count++;
+        bytes += block->size;
+    }
+    multi_heap_internal_unlock(cache->heap);
+
+    if (result == NULL) {
+        /* the heap may still fit it once the caches of all cores are given back */
+        multi_heap_cache_flush(cache);
+        return multi_heap_malloc(cache->heap, size);
+    }
+
+    if (list != NULL) {
+        unsigned state;
+        cache_slot_t *slot = lock_slot(cache, &state);
+        last->next = slot->blocks[cls];
+        slot->blocks[cls] = list;
+        slot->count[cls] += count;
+        slot->bytes += bytes;
+        unlock_slot(slot, state);
+    }
+    return result;
+}
+
+multi_heap_cache_handle_t multi_heap_cache_create(multi_heap_handle_t heap)
+{
+    multi_heap_cache_handle_t cache = multi_heap_malloc(heap, sizeof(struct multi_heap_cache));
+    if (cache != NULL) {
+        memset(cache, 0, sizeof(struct multi_heap_cache));
+        cache->heap = heap;
+        for (int i = 0; i < MULTI_HEAP_CACHE_CORES; i++) {
+            MULTI_HEAP_CACHE_LOCK_INIT(&cache->slots[i].lock);
+        }
+    }
+    return cache;
+}
+
+void *multi_heap_cache_malloc(multi_heap_cache_handle_t cache, size_t size)
+{
+    if (size == 0 || size > CACHE_MAX_SIZE) {
+        void *result = multi_heap_malloc(cache->heap, size);
+        if (result == NULL && size > 0) {
+            multi_heap_cache_flush(cache);
+            result = multi_heap_malloc(cache->heap, size);
+        }
+        return result;
+    }
+
+    const size_t cls = alloc_class(size);
+    unsigned state;
+    cache_slot_t *slot = lock_slot(cache, &state);
+    cached_block_t *block = slot->blocks[cls];
+    if (block != NULL) {
+        slot->blocks[cls] = block->next;
+        slot->count[cls]--;
+        slot->bytes -= block->size;
+    }
+    unlock_slot(slot, state);
+
+    if (block != NULL) {
+        return block;
+    }
+    return refill(cache, cls);
+}
+
+void multi_heap_cache_free(multi_heap_cache_handle_t cache, void *p)
+{
+    if (p == NULL) {
+        return;
+    }
+
+    size_t size = multi_heap_get_allocated_size(cache->heap, p);
+    if (size < CACHE_MIN_SIZE || size >= 2 * CACHE_MAX_SIZE) {
+        multi_heap_free(cache->heap, p);
+        return;
+    }
+
+    const size_t cls = free_class(size);
+    cached_block_t *block = (cached_block_t *)p;
+    cached_block_t *spill = NULL;
+    block->size = size;
+
+    unsigned state;
+    cache_slot_t *slot = lock_slot(cache, &state);
+    block->next = slot->blocks[cls];
+    slot->blocks[cls] = block;
+    slot->count[cls]++;
+    slot->bytes += size;
+    if (slot->count[cls] > MULTI_HEAP_CACHE_MAX_BLOCKS) {
+        /* cache is full, give a batch back to the heap */
+        spill = slot->blocks[cls];
+        cached_block_t *last = spill;
+        for (int i = 0; i < CACHE_BATCH_SIZE; i++) {
+            last = slot->blocks[cls];
+            slot->bytes -= last->size;
+            slot->blocks[cls] = last->next;
+        }
+        last->next = NULL;
+        slot->count[cls] -= CACHE_BATCH_SIZE;
+    }
+    unlock_slot(slot, state);
+
+    if (spill != NULL) {
+        release_blocks(cache, spill);
+    }
+}
+
+void multi_heap_cache_flush(multi_heap_cache_handle_t cache)
+{
+    cached_block_t *list = NULL;
+
+    for (int i = 0; i < MULTI_HEAP_CACHE_CORES; i++) {
+        unsigned state = MULTI_HEAP_CACHE_ENTER();
+        cache_slot_t *slot = &cache->slots[i];
+        MULTI_HEAP_CACHE_LOCK(&slot->lock);
+        for (int cls = 0; cls < CACHE_CLASS_COUNT; cls++) {
+            cached_block_t *block = slot->blocks[cls];
+            while (block != NULL) {
+                cached_block_t *next = block->next;
+                block->next = list;
+                list = block;
+                block = next;
+            }
+            slot->blocks[cls] = NULL;
+            slot->count[cls] = 0;
+        }
+        slot->bytes = 0;
+        unlock_slot(slot, state);
+    }
+
+    release_blocks(cache, list);
+}
+
+void multi_heap_cache_get_info(multi_heap_cache_handle_t cache, size_t *cached_bytes, size_t *cached_blocks)
+{
+    *cached_bytes = 0;
+    *cached_blocks = 0;
+    for (int i = 0; i < MULTI_HEAP_CACHE_CORES; i++) {
+        const cache_slot_t *slot = &cache->slots[i];
+        *cached_bytes += slot->bytes;
+        for (int cls = 0; cls < CACHE_CLASS_COUNT; cls++) {
+            *cached_blocks += slot->count[cls];
+        }
+    }
+}
+
+#ifndef ESP_PLATFORM
+/* Slots in use by running threads, a thread gives its slot back when it exits */
+static unsigned s_used_slots;
+static pthread_key_t s_slot_key;
+static pthread_once_t s_slot_key_once = PTHREAD_ONCE_INIT;
+static __thread int s_slot = -1;
+
+static void release_slot(void *arg)
+{
+    int slot = (int)(intptr_t)arg - 1;
+    __atomic_fetch_and(&s_used_slots, ~(1u << slot), __ATOMIC_RELEASE);
+}
+
+static void create_slot_key(void)
+{
+    pthread_key_create(&s_slot_key, release_slot);
+}
+
+int multi_heap_cache_host_thread_id(void)
+{
+    if (s_slot < 0) {
+        pthread_once(&s_slot_key_once, create_slot_key);
+        unsigned used = __atomic_load_n(&s_used_slots, __ATOMIC_ACQUIRE);
+        do {
+            assert(used != (1u << MULTI_HEAP_CACHE_CORES) - 1 && "too many threads use heap caches");
+            s_slot = __builtin_ctz(~used);
+        } while (!__atomic_compare_exchange_n(&s_used_slots, &used, used | (1u << s_slot), false,
+                                              __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+        pthread_setspecific(s_slot_key, (void *)(intptr_t)(s_slot + 1));
+    }
+    return s_slot;
+}
+#endif
@@ -0,0 +1,63 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "multi_heap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Per-core cache of small blocks in front of a multi_heap (CONFIG_HEAP_CACHE).
+
+   Each core keeps a few free blocks of each size class (16, 32, 64, 128 and 256 bytes.) Allocations and frees which
+   the current core's cache can serve don't take the heap lock, only mask interrupts on the current core and take the
+   cache's own lock, which no other core holds unless an allocation has failed. The cache takes blocks from the heap
+   and gives them back in batches, under a single heap lock. When an allocation fails, the caches of all cores are
+   given back to the heap before trying again.
+
+   Cached blocks are allocated blocks as far as the heap itself is concerned. multi_heap_cache_get_info() tells how
+   many bytes the caches hold, so that callers can count them as free.
+
+   On the host, every thread is a "core". Up to MULTI_HEAP_CACHE_CORES threads can use the caches at the same time,
+   a thread which exits leaves its cached blocks to the next thread.
+*/
+
+/* Opaque handle to a heap cache */
+typedef struct multi_heap_cache *multi_heap_cache_handle_t;
+
+/* Create a cache for a heap. The cache structure is allocated from the heap itself.
+
+   Returns NULL if the heap has no room for it.
+*/
+multi_heap_cache_handle_t multi_heap_cache_create(multi_heap_handle_t heap);
+
+/* malloc() from the heap, through the current core's cache if 'size' fits a size class */
+void *multi_heap_cache_malloc(multi_heap_cache_handle_t cache, size_t size);
+
+/* free() a block of the heap, keeping it in the current core's cache if its size fits a size class */
+void multi_heap_cache_free(multi_heap_cache_handle_t cache, void *p);
+
+/* Return all blocks of the caches of all cores to the heap. Done when an allocation fails, before trying again. */
+void multi_heap_cache_flush(multi_heap_cache_handle_t cache);
+
+/* Get the number of bytes and blocks held by the caches of all cores */
+void multi_heap_cache_get_info(multi_heap_cache_handle_t cache, size_t *cached_bytes, size_t *cached_blocks);
+
+#ifdef __cplusplus
+}
+#endif
@@ -27,3 +27,17 @@
 #define MULTI_HEAP_POISONING
 #define MULTI_HEAP_POISONING_SLOW
 #endif
+
+#ifdef CONFIG_HEAP_ALLOCATOR_SEGREGATED_FIT
+#define MULTI_HEAP_SEGREGATED_FIT
+#endif
+
+#ifdef CONFIG_HEAP_HISTOGRAM
+#define MULTI_HEAP_HISTOGRAM
+#endif
+
+#ifdef CONFIG_HEAP_CACHE_MAX_BLOCKS
+#define MULTI_HEAP_CACHE_MAX_BLOCKS CONFIG_HEAP_CACHE_MAX_BLOCKS
+#else
+#define MULTI_HEAP_CACHE_MAX_BLOCKS 8
+#endif
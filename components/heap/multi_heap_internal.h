@@ -32,6 +32,7 @@ size_t multi_heap_free_size_impl(multi_heap_handle_t heap);
 size_t multi_heap_minimum_free_size_impl(multi_heap_handle_t heap);
 size_t multi_heap_get_allocated_size_impl(multi_heap_handle_t heap, void *p);
 void *multi_heap_get_block_address_impl(multi_heap_block_handle_t block);
+void multi_heap_get_histogram_impl(multi_heap_handle_t heap, multi_heap_histogram_t *histogram);
 
 /* Some internal functions for heap poisoning use */
 
@@ -66,3 +67,35 @@ void *multi_heap_get_block_address(multi_heap_block_handle_t block);
 
 /* Get the owner identification for a heap block */
 void *multi_heap_get_block_owner(multi_heap_block_handle_t block);
+
+/* Histogram helpers, used by the multi_heap implementations if MULTI_HEAP_HISTOGRAM is defined */
+
+/* Size class of a block in multi_heap_histogram_t */
+static inline size_t multi_heap_histogram_class(size_t size)
+{
+    if (size < 16) {
+        return 0;
+    }
+    size_t cls = (sizeof(unsigned long) * 8 - 1) - __builtin_clzl((unsigned long)size) - 3;
+    return (cls < MULTI_HEAP_HISTOGRAM_CLASSES) ? cls : MULTI_HEAP_HISTOGRAM_CLASSES - 1;
+}
+
+/* Count a free block of 'size' bytes in (delta 1) or out (delta -1) */
+static inline void multi_heap_histogram_update_free(multi_heap_histogram_t *histogram, size_t size, int delta)
+{
+    size_t cls = multi_heap_histogram_class(size);
+    histogram->free_blocks[cls] += delta;
+    histogram->free_bytes[cls] += delta * (intptr_t)size;
+}
+
+/* Count an allocated block of 'size' bytes in (delta 1) or out (delta -1) */
+static inline void multi_heap_histogram_update_allocated(multi_heap_histogram_t *histogram, size_t size, int delta)
+{
+    histogram->allocated_blocks[multi_heap_histogram_class(size)] += delta;
+}
+
+/* Count an allocation request of 'size' bytes */
+static inline void multi_heap_histogram_count_allocation(multi_heap_histogram_t *histogram, size_t size)
+{
+    histogram->allocations[multi_heap_histogram_class(size)]++;
+}
@@ -62,6 +62,23 @@ inline static void multi_heap_assert(bool condition, const char *format, int lin
     multi_heap_assert((CONDITION), "CORRUPT HEAP: multi_heap.c:%d detected at 0x%08x\n", \
                       __LINE__, (intptr_t)(ADDRESS))
 
+/* The per-core heap caches (multi_heap_cache.c) mask interrupts on the current core, so that neither another task
+   nor an ISR can use the same core's cache meanwhile. Each cache also has a spinlock, which only the other core
+   contends for when it gives all cached blocks back to the heap. */
+#define MULTI_HEAP_CACHE_CORES portNUM_PROCESSORS
+#define MULTI_HEAP_CACHE_CORE_ID() xPortGetCoreID()
+#define MULTI_HEAP_CACHE_ENTER() portENTER_CRITICAL_NESTED()
+#define MULTI_HEAP_CACHE_EXIT(STATE) portEXIT_CRITICAL_NESTED(STATE)
+#define MULTI_HEAP_CACHE_LOCK_T portMUX_TYPE
+#define MULTI_HEAP_CACHE_LOCK_INIT(PLOCK) vPortCPUInitializeMutex(PLOCK)
+#ifdef CONFIG_FREERTOS_PORTMUX_DEBUG
+#define MULTI_HEAP_CACHE_LOCK(PLOCK) vPortCPUAcquireMutex((PLOCK), __FUNCTION__, __LINE__)
+#define MULTI_HEAP_CACHE_UNLOCK(PLOCK) vPortCPUReleaseMutex((PLOCK), __FUNCTION__, __LINE__)
+#else
+#define MULTI_HEAP_CACHE_LOCK(PLOCK) vPortCPUAcquireMutex(PLOCK)
+#define MULTI_HEAP_CACHE_UNLOCK(PLOCK) vPortCPUReleaseMutex(PLOCK)
+#endif
+
 #ifdef CONFIG_HEAP_TASK_TRACKING
 #include <freertos/task.h>
 #define MULTI_HEAP_BLOCK_OWNER TaskHandle_t task;
@@ -76,11 +93,34 @@ inline static void multi_heap_assert(bool condition, const char *format, int lin
 #else // ESP_PLATFORM
 
 #include <assert.h>
+#include <pthread.h>
 
 #define MULTI_HEAP_PRINTF printf
 #define MULTI_HEAP_STDERR_PRINTF(MSG, ...) fprintf(stderr, MSG, __VA_ARGS__)
-#define MULTI_HEAP_LOCK(PLOCK)
-#define MULTI_HEAP_UNLOCK(PLOCK)
+
+/* Heaps have no lock unless a test shares one between threads, then the lock is a recursive pthread mutex */
+#define MULTI_HEAP_LOCK(PLOCK) do {                                 \
+        if ((PLOCK) != NULL) {                                      \
+            pthread_mutex_lock((pthread_mutex_t *)(PLOCK));         \
+        }                                                           \
+    } while(0)
+
+#define MULTI_HEAP_UNLOCK(PLOCK) do {                               \
+        if ((PLOCK) != NULL) {                                      \
+            pthread_mutex_unlock((pthread_mutex_t *)(PLOCK));       \
+        }                                                           \
+    } while(0)
+
+/* Each running thread uses its own heap cache slot, see multi_heap_cache.h */
+int multi_heap_cache_host_thread_id(void);
+#define MULTI_HEAP_CACHE_CORES 8
+#define MULTI_HEAP_CACHE_CORE_ID() multi_heap_cache_host_thread_id()
+#define MULTI_HEAP_CACHE_ENTER() 0
+#define MULTI_HEAP_CACHE_EXIT(STATE) (void)(STATE)
+#define MULTI_HEAP_CACHE_LOCK_T int
+#define MULTI_HEAP_CACHE_LOCK_INIT(PLOCK) __atomic_store_n((PLOCK), 0, __ATOMIC_RELAXED)
+#define MULTI_HEAP_CACHE_LOCK(PLOCK) while (__atomic_exchange_n((PLOCK), 1, __ATOMIC_ACQUIRE)) { }
+#define MULTI_HEAP_CACHE_UNLOCK(PLOCK) __atomic_store_n((PLOCK), 0, __ATOMIC_RELEASE)
 
 #define MULTI_HEAP_ASSERT(CONDITION, ADDRESS) assert((CONDITION) && "Heap corrupt")
 
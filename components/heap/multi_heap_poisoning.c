@@ -329,6 +329,12 @@ void multi_heap_get_info(multi_heap_handle_t heap, multi_heap_info_t *info)
     subtract_poison_overhead(&info->minimum_free_bytes);
 }
 
+void multi_heap_get_histogram(multi_heap_handle_t heap, multi_heap_histogram_t *histogram)
+{
+    /* block sizes include the poison head & tail, as they are what the heap has to find room for */
+    multi_heap_get_histogram_impl(heap, histogram);
+}
+
 size_t multi_heap_free_size(multi_heap_handle_t heap)
 {
     size_t r = multi_heap_free_size_impl(heap);
@@ -0,0 +1,872 @@
+// Copyright 2015-2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <multi_heap.h>
+#include "multi_heap_internal.h"
+
+/* Note: Keep platform-specific parts in this header, this source
+   file should depend on libc only */
+#include "multi_heap_platform.h"
+
+/* Defines compile-time configuration macros */
+#include "multi_heap_config.h"
+
+/* Segregated fit implementation of the multi_heap "_impl" functions.
+
+   Used instead of the best fit implementation in multi_heap.c if MULTI_HEAP_SEGREGATED_FIT is defined
+   (CONFIG_HEAP_ALLOCATOR_SEGREGATED_FIT.)
+
+   Free blocks are kept in doubly linked lists, one for each power of two size class, and a bitmap records which
+   lists are not empty. malloc() looks at a few blocks of the list of the requested size's class, then takes the
+   first block of the next non-empty larger class, which always fits. free() finds the adjacent blocks from the block
+   headers and merges with them without searching any list. All operations take constant time, regardless of the
+   number of blocks in the heap.
+*/
+#ifdef MULTI_HEAP_SEGREGATED_FIT
+
+#ifndef MULTI_HEAP_POISONING
+/* if no heap poisoning, public API aliases directly to these implementations */
+void *multi_heap_malloc(multi_heap_handle_t heap, size_t size)
+    __attribute__((alias("multi_heap_malloc_impl")));
+
+void multi_heap_free(multi_heap_handle_t heap, void *p)
+    __attribute__((alias("multi_heap_free_impl")));
+
+void *multi_heap_realloc(multi_heap_handle_t heap, void *p, size_t size)
+    __attribute__((alias("multi_heap_realloc_impl")));
+
+size_t multi_heap_get_allocated_size(multi_heap_handle_t heap, void *p)
+    __attribute__((alias("multi_heap_get_allocated_size_impl")));
+
+multi_heap_handle_t multi_heap_register(void *start, size_t size)
+    __attribute__((alias("multi_heap_register_impl")));
+
+void multi_heap_get_info(multi_heap_handle_t heap, multi_heap_info_t *info)
+    __attribute__((alias("multi_heap_get_info_impl")));
+
+size_t multi_heap_free_size(multi_heap_handle_t heap)
+    __attribute__((alias("multi_heap_free_size_impl")));
+
+size_t multi_heap_minimum_free_size(multi_heap_handle_t heap)
+    __attribute__((alias("multi_heap_minimum_free_size_impl")));
+
+void *multi_heap_get_block_address(multi_heap_block_handle_t block)
+    __attribute__((alias("multi_heap_get_block_address_impl")));
+
+void multi_heap_get_histogram(multi_heap_handle_t heap, multi_heap_histogram_t *histogram)
+    __attribute__((alias("multi_heap_get_histogram_impl")));
+
+void *multi_heap_get_block_owner(multi_heap_block_handle_t block)
+{
+    return NULL;
+}
+
+#endif
+
+#define ALIGN(X) ((X) & ~(sizeof(void *)-1))
+#define ALIGN_UP(X) ALIGN((X)+sizeof(void *)-1)
+
+/* Number of blocks of the requested size's class which malloc looks at, before it takes a block of a larger class */
+#define CLASS_SEARCH_LIMIT 4
+
+struct heap_block;
+
+/* Block in the heap
+
+   'header' holds a pointer to the next block (used or free) ORed with a free flag and a flag which tells if the
+   previous block is free.
+
+   'next_free' and 'prev_free' are valid if the block is free, they link the block into the free list of its size
+   class. The last word of a free block's data points back to the block (see get_footer()), so that free() can find
+   the start of a free block in front of the freed one.
+*/
+typedef struct heap_block {
+    intptr_t header;                  /* Encodes next block in heap (used or unused), free and previous free flags */
+    union {
+        uint8_t data[1];              /* First byte of data, valid if block is used. Actual size of data is 'block_data_size(block)' */
+        struct {
+            struct heap_block *next_free; /* Next free block in the same size class, valid if block is free */
+            struct heap_block *prev_free; /* Previous free block in the same size class, valid if block is free */
+        };
+    };
+} heap_block_t;
+
+/* These masks apply to the 'header' field of heap_block_t */
+#define BLOCK_FREE_FLAG 0x1      /* If set, this block is free & in a free list */
+#define PREV_FREE_FLAG 0x2       /* If set, the previous block in the heap is free and its footer is valid */
+#define NEXT_BLOCK_MASK (~3)     /* AND header with this mask to get pointer to next block (free or used) */
+
+/* Smallest data size of a block, it must hold the free list links and the footer once the block is freed */
+#define MIN_BLOCK_DATA_SIZE (3 * sizeof(void *))
+
+/* Size class of the smallest blocks, log2 of MIN_BLOCK_DATA_SIZE rounded down. See size_class() */
+#define MIN_CLASS_LOG2 (sizeof(void *) == 4 ? 3 : 4)
+
+/* Metadata header for the heap, stored at the beginning of heap space.
+
+   'free_lists' holds one list per size class, as many as it takes for the largest block this heap can have (see
+   get_free_list_count()). The first block of the heap follows the list heads.
+
+   'last_block' is a pointer to a final header at the end of the heap, which has no data and is never free.
+ */
+typedef struct multi_heap_info {
+    void *lock;
+    size_t free_bytes;
+    size_t minimum_free_bytes;
+    heap_block_t *last_block;
+    uint32_t free_list_bitmap;  /* bit N is set if free_lists[N] isn't empty */
+#ifdef MULTI_HEAP_HISTOGRAM
+    multi_heap_histogram_t *histogram; /* NULL unless set */
+#endif
+    heap_block_t *free_lists[];
+} heap_t;
+
+/* Histogram updates, if multi_heap_set_histogram() was called. Free blocks are counted as they go in and out of the
+   free lists, allocated blocks are counted by the malloc, free and realloc functions. */
+#ifdef MULTI_HEAP_HISTOGRAM
+#define HISTOGRAM_FREE(HEAP, BLOCK, DELTA) do {                                     \
+        if ((HEAP)->histogram != NULL) {                                            \
+            multi_heap_histogram_update_free((HEAP)->histogram, block_data_size(BLOCK), (DELTA)); \
+        }                                                                           \
+    } while(0)
+#define HISTOGRAM_ALLOCATED(HEAP, SIZE, DELTA) do {                                 \
+        if ((HEAP)->histogram != NULL) {                                            \
+            multi_heap_histogram_update_allocated((HEAP)->histogram, (SIZE), (DELTA)); \
+        }                                                                           \
+    } while(0)
+#define HISTOGRAM_ALLOCATION(HEAP, SIZE) do {                                       \
+        if ((HEAP)->histogram != NULL) {                                            \
+            multi_heap_histogram_count_allocation((HEAP)->histogram, (SIZE));       \
+        }                                                                           \
+    } while(0)
+#else
+#define HISTOGRAM_FREE(HEAP, BLOCK, DELTA)
+#define HISTOGRAM_ALLOCATED(HEAP, SIZE, DELTA)
+#define HISTOGRAM_ALLOCATION(HEAP, SIZE)
+#endif
+
+/* Given a pointer to the 'data' field of a block (ie the previous malloc/realloc result), return a pointer to the
+   containing block.
+*/
+static inline heap_block_t *get_block(const void *data_ptr)
+{
+    return (heap_block_t *)((char *)data_ptr - offsetof(heap_block_t, data));
+}
+
+
+/* Return the next sequential block in the heap.
+ */
+static inline heap_block_t *get_next_block(const heap_block_t *block)
+{
+    intptr_t next = block->header & NEXT_BLOCK_MASK;
+    if (next == 0) {
+        return NULL; /* last_block */
+    }
+    assert(next > (intptr_t)block);
+    return (heap_block_t *)next;
+}
+
+/* Return true if this block is free. */
+static inline bool is_free(const heap_block_t *block)
+{
+    return block->header & BLOCK_FREE_FLAG;
+}
+
+/* Return true if the block before this one is free. */
+static inline bool is_prev_free(const heap_block_t *block)
+{
+    return block->header & PREV_FREE_FLAG;
+}
+
+/* Return true if this block is the last_block in the heap
+   (the only block with no next pointer) */
+static inline bool is_last_block(const heap_block_t *block)
+{
+    return (block->header & NEXT_BLOCK_MASK) == 0;
+}
+
+/* Data size of the block (excludes this block's header) */
+static inline size_t block_data_size(const heap_block_t *block)
+{
+    intptr_t next = (intptr_t)block->header & NEXT_BLOCK_MASK;
+    intptr_t this = (intptr_t)block;
+    if (next == 0) {
+        return 0; /* this is the last block in the heap */
+    }
+    return next - this - sizeof(block->header);
+}
+
+/* Return the location of the footer of a free block, the last word of its data */
+static inline heap_block_t **get_footer(const heap_block_t *block)
+{
+    return (heap_block_t **)(block->header & NEXT_BLOCK_MASK) - 1;
+}
+
+/* Return the free block before 'block', read from its footer. Only valid if is_prev_free(block). */
+static inline heap_block_t *get_prev_block(const heap_block_t *block)
+{
+    return ((heap_block_t **)block)[-1];
+}
+
+/* Size class of a block data size: blocks of class N hold between 2^(N + MIN_CLASS_LOG2) and
+   2^(N + MIN_CLASS_LOG2 + 1) - 1 bytes. */
+static inline size_t size_class(size_t size)
+{
+    return (sizeof(unsigned long) * 8 - 1) - __builtin_clzl((unsigned long)size) - MIN_CLASS_LOG2;
+}
+
+/* Number of free lists of the heap. No block can be as big as the space after the heap_t header, so the size class
+   of that space covers all of them. */
+static inline size_t get_free_list_count(const heap_t *heap)
+{
+    return size_class((intptr_t)heap->last_block - (intptr_t)heap->free_lists) + 1;
+}
+
+/* Return the first block of the heap, which follows the free list heads */
+static inline heap_block_t *get_first_block(const heap_t *heap)
+{
+    return (heap_block_t *)&heap->free_lists[get_free_list_count(heap)];
+}
+
+/* Check a block is valid for this heap. Used to verify parameters. */
+static void assert_valid_block(const heap_t *heap, const heap_block_t *block)
+{
+    MULTI_HEAP_ASSERT(block >= get_first_block(heap) && block <= heap->last_block,
+                      block); // block not in heap
+    if (heap < (const heap_t *)heap->last_block) {
+        const heap_block_t *next = get_next_block(block);
+        MULTI_HEAP_ASSERT(next >= get_first_block(heap) && next <= heap->last_block, block); // Next block not in heap
+    }
+}
+
+/* Add a free block to the head of the free list of its size class, and write its footer. */
+static void insert_free_block(heap_t *heap, heap_block_t *block)
+{
+    size_t cls = size_class(block_data_size(block));
+    MULTI_HEAP_ASSERT(cls < get_free_list_count(heap), block); // block is too big for this heap
+    heap_block_t *head = heap->free_lists[cls];
+
+    block->header |= BLOCK_FREE_FLAG;
+    block->next_free = head;
+    block->prev_free = NULL;
+    if (head != NULL) {
+        head->prev_free = block;
+    }
+    heap->free_lists[cls] = block;
+    heap->free_list_bitmap |= 1u << cls;
+    HISTOGRAM_FREE(heap, block, 1);
+
+    *get_footer(block) = block;
+    get_next_block(block)->header |= PREV_FREE_FLAG;
+}
+
+/* Take a free block out of the free list of its size class, it is marked as used. */
+static void remove_free_block(heap_t *heap, heap_block_t *block)
+{
+    MULTI_HEAP_ASSERT(is_free(block), block); // block should be free
+    size_t cls = size_class(block_data_size(block));
+    HISTOGRAM_FREE(heap, block, -1);
+
+    if (block->prev_free != NULL) {
+        MULTI_HEAP_ASSERT(block->prev_free->next_free == block, &block->prev_free); // free list links should match
+        block->prev_free->next_free = block->next_free;
+    } else {
+        MULTI_HEAP_ASSERT(heap->free_lists[cls] == block, block); // block should head its free list
+        heap->free_lists[cls] = block->next_free;
+        if (block->next_free == NULL) {
+            heap->free_list_bitmap &= ~(1u << cls);
+        }
+    }
+    if (block->next_free != NULL) {
+        MULTI_HEAP_ASSERT(block->next_free->prev_free == block, &block->next_free); // free list links should match
+        block->next_free->prev_free = block->prev_free;
+    }
+
+    block->header &= ~BLOCK_FREE_FLAG;
+    get_next_block(block)->header &= ~PREV_FREE_FLAG;
+}
+
+/* Merge block 'b' into the block 'a' before it. Neither block may be in a free list, the result
+   is marked as used.
+
+   The caller is responsible for the free_bytes count.
+*/
+static heap_block_t *merge_adjacent(heap_block_t *a, heap_block_t *b)
+{
+    MULTI_HEAP_ASSERT(get_next_block(a) == b, a); // Blocks should be in order
+    assert(!is_free(a) && !is_free(b));
+    assert(!is_last_block(b));
+
+    a->header = (b->header & NEXT_BLOCK_MASK) | (a->header & PREV_FREE_FLAG);
+
+#ifdef MULTI_HEAP_POISONING_SLOW
+    /* a's footer and b's former block header and links need to be replaced with a fill pattern. This is only done
+       for free blocks, when slow poisoning is enabled realloc never resizes in place. */
+    multi_heap_internal_poison_fill_region((char *)b - sizeof(heap_block_t *), sizeof(heap_block_t *) + sizeof(heap_block_t), true);
+#endif
+
+    return a;
+}
+
+/* Free a block which isn't in a free list yet, merging it with free blocks before and after it. */
+static void add_free_block(heap_t *heap, heap_block_t *block)
+{
+    heap_block_t *next = get_next_block(block);
+
+    heap->free_bytes += block_data_size(block);
+
+    if (is_prev_free(block)) {
+        heap_block_t *prev = get_prev_block(block);
+        MULTI_HEAP_ASSERT(prev >= get_first_block(heap) && prev < block && get_next_block(prev) == block,
+                          (heap_block_t **)block - 1); // footer of the previous block should point to it
+        remove_free_block(heap, prev);
+        block = merge_adjacent(prev, block);
+        heap->free_bytes += sizeof(block->header);
+    }
+
+    if (is_free(next)) {
+        remove_free_block(heap, next);
+        block = merge_adjacent(block, next);
+        heap->free_bytes += sizeof(block->header);
+    }
+
+    insert_free_block(heap, block);
+}
+
+/* Split a used block so it holds at least 'size' bytes of data, making any spare space into a new free block
+   (merged with the next block, if that one is free.)
+*/
+static void split_if_necessary(heap_t *heap, heap_block_t *block, size_t size)
+{
+    const size_t block_size = block_data_size(block);
+    MULTI_HEAP_ASSERT(!is_free(block), block); // split block shouldn't be free
+    MULTI_HEAP_ASSERT(size <= block_size, block); // size should be valid
+
+    if (block_size < size + sizeof(block->header) + MIN_BLOCK_DATA_SIZE) {
+        /* Can't split 'block' if we're not going to get a usable free block afterwards */
+        return;
+    }
+
+    heap_block_t *new_block = (heap_block_t *)(block->data + size);
+    new_block->header = block->header & NEXT_BLOCK_MASK;
+    block->header = (intptr_t)new_block | (block->header & PREV_FREE_FLAG);
+    add_free_block(heap, new_block);
+}
+
+/* Find a free block with at least 'size' bytes of data, or NULL if the heap has none */
+static heap_block_t *find_free_block(heap_t *heap, size_t size)
+{
+    size_t cls = size_class(size);
+    if (cls >= get_free_list_count(heap)) {
+        return NULL;
+    }
+
+    /* The requested size's class may have blocks which are too small, look at the best of the first few of them */
+    heap_block_t *best_block = NULL;
+    size_t best_size = SIZE_MAX;
+    heap_block_t *b = heap->free_lists[cls];
+    for (int i = 0; b != NULL && i < CLASS_SEARCH_LIMIT; b = b->next_free, i++) {
+        size_t bs = block_data_size(b);
+        if (bs >= size && bs < best_size) {
+            best_block = b;
+            best_size = bs;
+            if (bs == size) {
+                break; /* we've found a perfect sized block */
+            }
+        }
+    }
+    if (best_block != NULL) {
+        return best_block;
+    }
+
+    /* Any block of a larger class fits, take the first one of the smallest such class */
+    uint32_t larger = heap->free_list_bitmap & ~((2u << cls) - 1);
+    if (larger == 0) {
+        return NULL;
+    }
+    return heap->free_lists[__builtin_ctz(larger)];
+}
+
+void *multi_heap_get_block_address_impl(multi_heap_block_handle_t block)
+{
+    return ((char *)block + offsetof(heap_block_t, data));
+}
+
+size_t multi_heap_get_allocated_size_impl(multi_heap_handle_t heap, void *p)
+{
+    heap_block_t *pb = get_block(p);
+
+    assert_valid_block(heap, pb);
+    MULTI_HEAP_ASSERT(!is_free(pb), pb); // block shouldn't be free
+    return block_data_size(pb);
+}
+
+multi_heap_handle_t multi_heap_register_impl(void *start_ptr, size_t size)
+{
+    uintptr_t start = ALIGN_UP((uintptr_t)start_ptr);
+    uintptr_t end = ALIGN((uintptr_t)start_ptr + size);
+    heap_t *heap = (heap_t *)start;
+    size = end - start;
+
+    if (end < start || size < sizeof(heap_t) + 2 * sizeof(heap_block_t)) {
+        return NULL; /* 'size' is too small to fit a heap here */
+    }
+
+
+    /* last block is 'used' and has a NULL next pointer, it only consists of the header */
+    heap->last_block = (heap_block_t *)(end - sizeof(intptr_t));
+
+    size_t free_list_count = get_free_list_count(heap);
+    size_t header_size = sizeof(heap_t) + free_list_count * sizeof(heap_block_t *);
+    if (free_list_count > 32 || size < header_size + sizeof(intptr_t) * 2 + MIN_BLOCK_DATA_SIZE) {
+        return NULL; /* no room for the free list heads and a block, or too many lists for the bitmap */
+    }
+
+    heap->lock = NULL;
+    heap->free_list_bitmap = 0;
+    memset(heap->free_lists, 0, free_list_count * sizeof(heap_block_t *));
+#ifdef MULTI_HEAP_HISTOGRAM
+    heap->histogram = NULL;
+#endif
+    heap->last_block->header = 0;
+
+    /* first (allocatable) free block goes after the free list heads */
+    heap_block_t *first_free_block = get_first_block(heap);
+    first_free_block->header = (intptr_t)heap->last_block;
+    heap->free_bytes = 0;
+    add_free_block(heap, first_free_block);
+    heap->minimum_free_bytes = heap->free_bytes;
+
+    return heap;
+}
+
+void multi_heap_set_lock(multi_heap_handle_t heap, void *lock)
+{
+    heap->lock = lock;
+}
+
+void multi_heap_set_histogram(multi_heap_handle_t heap, multi_heap_histogram_t *histogram)
+{
+#ifdef MULTI_HEAP_HISTOGRAM
+    multi_heap_internal_lock(heap);
+    if (histogram != NULL) {
+        /* count the blocks the heap already has, allocations are only counted from now on */
+        memset(histogram, 0, sizeof(multi_heap_histogram_t));
+        for(heap_block_t *b = get_first_block(heap); !is_last_block(b); b = get_next_block(b)) {
+            if (is_free(b)) {
+                multi_heap_histogram_update_free(histogram, block_data_size(b), 1);
+            } else {
+                multi_heap_histogram_update_allocated(histogram, block_data_size(b), 1);
+            }
+        }
+    }
+    heap->histogram = histogram;
+    multi_heap_internal_unlock(heap);
+#endif
+}
+
+void inline multi_heap_internal_lock(multi_heap_handle_t heap)
+{
+    MULTI_HEAP_LOCK(heap->lock);
+}
+
+void inline multi_heap_internal_unlock(multi_heap_handle_t heap)
+{
+    MULTI_HEAP_UNLOCK(heap->lock);
+}
+
+multi_heap_block_handle_t multi_heap_get_first_block(multi_heap_handle_t heap)
+{
+    return get_first_block(heap);
+}
+
+multi_heap_block_handle_t multi_heap_get_next_block(multi_heap_handle_t heap, multi_heap_block_handle_t block)
+{
+    heap_block_t *next = get_next_block(block);
+    if (next == heap->last_block && is_last_block(next)) {
+        return NULL;
+    }
+    assert_valid_block(heap, next);
+    return next;
+}
+
+bool multi_heap_is_free(multi_heap_block_handle_t block)
+{
+    return is_free(block);
+}
+
+void *multi_heap_malloc_impl(multi_heap_handle_t heap, size_t size)
+{
+    size = ALIGN_UP(size);
+
+    if (size == 0 || heap == NULL) {
+        return NULL;
+    }
+    if (size < MIN_BLOCK_DATA_SIZE) {
+        size = MIN_BLOCK_DATA_SIZE;
+    }
+
+    multi_heap_internal_lock(heap);
+
+    if (heap->free_bytes < size) {
+        multi_heap_internal_unlock(heap);
+        return NULL;
+    }
+
+    heap_block_t *block = find_free_block(heap, size);
+    if (block == NULL) {
+        multi_heap_internal_unlock(heap);
+        return NULL; /* No room in heap */
+    }
+
+    remove_free_block(heap, block);
+    heap->free_bytes -= block_data_size(block);
+
+#ifdef MULTI_HEAP_POISONING_SLOW
+    /* free list links and footer are handed out as data, replace them with the free fill pattern */
+    multi_heap_internal_poison_fill_region(block->data, 2 * sizeof(heap_block_t *), true);
+    multi_heap_internal_poison_fill_region(get_footer(block), sizeof(heap_block_t *), true);
+#endif
+
+    split_if_necessary(heap, block, size);
+
+    HISTOGRAM_ALLOCATED(heap, block_data_size(block), 1);
+    HISTOGRAM_ALLOCATION(heap, size);
+
+    if (heap->free_bytes < heap->minimum_free_bytes) {
+        heap->minimum_free_bytes = heap->free_bytes;
+    }
+
+    multi_heap_internal_unlock(heap);
+
+    return block->data;
+}
+
+void multi_heap_free_impl(multi_heap_handle_t heap, void *p)
+{
+    heap_block_t *pb = get_block(p);
+
+    if (heap == NULL || p == NULL) {
+        return;
+    }
+
+    multi_heap_internal_lock(heap);
+
+    assert_valid_block(heap, pb);
+    MULTI_HEAP_ASSERT(!is_free(pb), pb); // block should not be free
+    MULTI_HEAP_ASSERT(!is_last_block(pb), pb); // block should not be last block
+
+    HISTOGRAM_ALLOCATED(heap, block_data_size(pb), -1);
+    add_free_block(heap, pb);
+
+    multi_heap_internal_unlock(heap);
+}
+
+void *multi_heap_realloc_impl(multi_heap_handle_t heap, void *p, size_t size)
+{
+    heap_block_t *pb = get_block(p);
+    void *result;
+    size = ALIGN_UP(size);
+
+    assert(heap != NULL);
+
+    if (p == NULL) {
+        return multi_heap_malloc_impl(heap, size);
+    }
+
+    assert_valid_block(heap, pb);
+    // non-null realloc arg should be allocated
+    MULTI_HEAP_ASSERT(!is_free(pb), pb);
+
+    if (size == 0) {
+        /* note: calling multi_free_impl() here as we've already been
+           through any poison-unwrapping */
+        multi_heap_free_impl(heap, p);
+        return NULL;
+    }
+
+    if (heap == NULL) {
+        return NULL;
+    }
+    if (size < MIN_BLOCK_DATA_SIZE) {
+        size = MIN_BLOCK_DATA_SIZE;
+    }
+
+    multi_heap_internal_lock(heap);
+    result = NULL;
+#ifdef MULTI_HEAP_HISTOGRAM
+    size_t orig_block_size = block_data_size(pb);
+#endif
+
+    if (size <= block_data_size(pb)) {
+        // Shrinking....
+        split_if_necessary(heap, pb, size);
+        result = pb->data;
+    }
+    else if (heap->free_bytes < size - block_data_size(pb)) {
+        // Growing, but there's not enough total free space in the heap
+        multi_heap_internal_unlock(heap);
+        return NULL;
+    }
+
+    // New size is larger than existing block, see if we can grow into the next block
+    if (result == NULL) {
+        heap_block_t *next = get_next_block(pb);
+        if (is_free(next) && block_data_size(pb) + sizeof(next->header) + block_data_size(next) >= size) {
+            remove_free_block(heap, next);
+            heap->free_bytes -= block_data_size(next);
+            pb = merge_adjacent(pb, next);
+            split_if_necessary(heap, pb, size);
+            result = pb->data;
+        }
+    }
+
+    if (result != NULL) {
+        // Resized in place
+        HISTOGRAM_ALLOCATED(heap, orig_block_size, -1);
+        HISTOGRAM_ALLOCATED(heap, block_data_size(pb), 1);
+        HISTOGRAM_ALLOCATION(heap, size);
+    } else {
+        // Need to allocate elsewhere and copy data over
+        //
+        // (Calling _impl versions here as we've already been through any
+        // unwrapping for heap poisoning features.)
+        result = multi_heap_malloc_impl(heap, size);
+        if (result != NULL) {
+            memcpy(result, pb->data, block_data_size(pb));
+            multi_heap_free_impl(heap, pb->data);
+        }
+    }
+
+    if (heap->free_bytes < heap->minimum_free_bytes) {
+        heap->minimum_free_bytes = heap->free_bytes;
+    }
+
+    multi_heap_internal_unlock(heap);
+    return result;
+}
+
+#define FAIL_PRINT(MSG, ...) do {                                       \
+        if (print_errors) {                                             \
+            MULTI_HEAP_STDERR_PRINTF(MSG, __VA_ARGS__);                 \
+        }                                                               \
+        valid = false;                                                  \
+    }                                                                   \
+    while(0)
+
+bool multi_heap_check(multi_heap_handle_t heap, bool print_errors)
+{
+    bool valid = true;
+    size_t total_free_bytes = 0;
+    size_t free_blocks = 0;
+    assert(heap != NULL);
+    const size_t free_list_count = get_free_list_count(heap);
+
+    multi_heap_internal_lock(heap);
+
+    heap_block_t *prev = NULL;
+
+    /* note: not using get_next_block() in loop, so that assertions aren't checked here */
+    for(heap_block_t *b = get_first_block(heap); b != NULL; b = (heap_block_t *)(b->header & NEXT_BLOCK_MASK)) {
+        if (b == prev) {
+            FAIL_PRINT("CORRUPT HEAP: Block %p points to itself\n", b);
+            goto done;
+        }
+        if (b < prev) {
+            FAIL_PRINT("CORRUPT HEAP: Block %p is before prev block %p\n", b, prev);
+            goto done;
+        }
+        if (b > heap->last_block || b < get_first_block(heap)) {
+            FAIL_PRINT("CORRUPT HEAP: Block %p is outside heap (last valid block %p)\n", b, prev);
+            goto done;
+        }
+        bool prev_free = (prev != NULL && is_free(prev));
+        if (is_prev_free(b) != prev_free) {
+            FAIL_PRINT("CORRUPT HEAP: Block %p previous free flag doesn't match block %p\n", b, prev);
+        }
+        if (is_free(b)) {
+            if (prev_free) {
+                FAIL_PRINT("CORRUPT HEAP: Two adjacent free blocks found, %p and %p\n", prev, b);
+            }
+            if (is_last_block(b)) {
+                FAIL_PRINT("CORRUPT HEAP: Last block %p is free\n", b);
+                goto done;
+            }
+            if (block_data_size(b) < MIN_BLOCK_DATA_SIZE) {
+                FAIL_PRINT("CORRUPT HEAP: Free block %p is too small\n", b);
+                goto done;
+            }
+            if (*get_footer(b) != b) {
+                FAIL_PRINT("CORRUPT HEAP: Free block %p footer %p points to %p\n", b, get_footer(b), *get_footer(b));
+            }
+            if (size_class(block_data_size(b)) >= free_list_count) {
+                FAIL_PRINT("CORRUPT HEAP: Free block %p is too big\n", b);
+                goto done;
+            }
+            total_free_bytes += block_data_size(b);
+            free_blocks++;
+        }
+        prev = b;
+
+#ifdef MULTI_HEAP_POISONING
+        if (!is_last_block(b)) {
+            /* For slow heap poisoning, any block should contain correct poisoning patterns and/or fills */
+            bool poison_ok;
+            if (is_free(b)) {
+                /* skip the free list links and the footer */
+                uint32_t block_len = block_data_size(b) - MIN_BLOCK_DATA_SIZE;
+                poison_ok = multi_heap_internal_check_block_poisoning(&b->data[2 * sizeof(heap_block_t *)], block_len, true, print_errors);
+            }
+            else {
+                poison_ok = multi_heap_internal_check_block_poisoning(b->data, block_data_size(b), false, print_errors);
+            }
+            valid = poison_ok && valid;
+        }
+#endif
+
+    } /* for(heap_block_t b = ... */
+
+    if (prev != heap->last_block) {
+        FAIL_PRINT("CORRUPT HEAP: Last block %p not %p\n", prev, heap->last_block);
+    }
+
+    if (heap->free_bytes != total_free_bytes) {
+        FAIL_PRINT("CORRUPT HEAP: Expected %u free bytes counted %u\n", (unsigned)heap->free_bytes, (unsigned)total_free_bytes);
+    }
+
+    /* every free block should be in the list of its class, once */
+    size_t listed_blocks = 0;
+    for (size_t cls = 0; cls < free_list_count; cls++) {
+        bool bit = heap->free_list_bitmap & (1u << cls);
+        if (bit != (heap->free_lists[cls] != NULL)) {
+            FAIL_PRINT("CORRUPT HEAP: Free list %u bitmap bit doesn't match head %p\n", (unsigned)cls, heap->free_lists[cls]);
+        }
+        heap_block_t *prev_free = NULL;
+        for (heap_block_t *b = heap->free_lists[cls]; b != NULL; b = b->next_free) {
+            if (b < get_first_block(heap) || b >= heap->last_block) {
+                FAIL_PRINT("CORRUPT HEAP: Free list %u block %p is outside heap\n", (unsigned)cls, b);
+                goto done;
+            }
+            if (!is_free(b) || size_class(block_data_size(b)) != cls) {
+                FAIL_PRINT("CORRUPT HEAP: Free list %u has block %p which isn't free or has another size\n", (unsigned)cls, b);
+                goto done;
+            }
+            if (b->prev_free != prev_free) {
+                FAIL_PRINT("CORRUPT HEAP: Free block %p prev free %p expected %p\n", b, b->prev_free, prev_free);
+            }
+            if (++listed_blocks > free_blocks) {
+                FAIL_PRINT("CORRUPT HEAP: Free lists have more than %u blocks\n", (unsigned)free_blocks);
+                goto done;
+            }
+            prev_free = b;
+        }
+    }
+    if (listed_blocks != free_blocks) {
+        FAIL_PRINT("CORRUPT HEAP: Free lists have %u of %u free blocks\n", (unsigned)listed_blocks, (unsigned)free_blocks);
+    }
+
+ done:
+    multi_heap_internal_unlock(heap);
+
+    return valid;
+}
+
+void multi_heap_dump(multi_heap_handle_t heap)
+{
+    assert(heap != NULL);
+
+    multi_heap_internal_lock(heap);
+    MULTI_HEAP_STDERR_PRINTF("Heap start %p end %p\nFree list bitmap 0x%08x\n", get_first_block(heap), heap->last_block, heap->free_list_bitmap);
+    for(heap_block_t *b = get_first_block(heap); b != NULL; b = get_next_block(b)) {
+        MULTI_HEAP_STDERR_PRINTF("Block %p data size 0x%08x bytes next block %p", b, block_data_size(b), get_next_block(b));
+        if (is_free(b)) {
+            MULTI_HEAP_STDERR_PRINTF(" FREE. Next free %p prev free %p\n", b->next_free, b->prev_free);
+        } else {
+            MULTI_HEAP_STDERR_PRINTF("%s", "\n"); /* C macros & optional __VA_ARGS__ */
+        }
+    }
+    multi_heap_internal_unlock(heap);
+}
+
+size_t multi_heap_free_size_impl(multi_heap_handle_t heap)
+{
+    if (heap == NULL) {
+        return 0;
+    }
+    return heap->free_bytes;
+}
+
+size_t multi_heap_minimum_free_size_impl(multi_heap_handle_t heap)
+{
+    if (heap == NULL) {
+        return 0;
+    }
+    return heap->minimum_free_bytes;
+}
+
+void multi_heap_get_info_impl(multi_heap_handle_t heap, multi_heap_info_t *info)
+{
+    memset(info, 0, sizeof(multi_heap_info_t));
+
+    if (heap == NULL) {
+        return;
+    }
+
+    multi_heap_internal_lock(heap);
+    for(heap_block_t *b = get_first_block(heap); !is_last_block(b); b = get_next_block(b)) {
+        info->total_blocks++;
+        if (is_free(b)) {
+            size_t s = block_data_size(b);
+            info->total_free_bytes += s;
+            if (s > info->largest_free_block) {
+                info->largest_free_block = s;
+            }
+            info->free_blocks++;
+        } else {
+            info->total_allocated_bytes += block_data_size(b);
+            info->allocated_blocks++;
+        }
+    }
+
+    info->minimum_free_bytes = heap->minimum_free_bytes;
+    // heap has wrong total size (address printed here is not indicative of the real error)
+    MULTI_HEAP_ASSERT(info->total_free_bytes == heap->free_bytes, heap);
+
+    multi_heap_internal_unlock(heap);
+}
+
+void multi_heap_get_histogram_impl(multi_heap_handle_t heap, multi_heap_histogram_t *histogram)
+{
+    memset(histogram, 0, sizeof(multi_heap_histogram_t));
+
+#ifdef MULTI_HEAP_HISTOGRAM
+    if (heap == NULL) {
+        return;
+    }
+
+    multi_heap_internal_lock(heap);
+    if (heap->histogram != NULL) {
+        memcpy(histogram, heap->histogram, sizeof(multi_heap_histogram_t));
+    }
+    multi_heap_internal_unlock(heap);
+#endif
+}
+
+#endif // MULTI_HEAP_SEGREGATED_FIT
@@ -161,4 +161,26 @@ TEST_CASE("can trace allocations made by newlib", "[heap]")
 }
 
 
+#ifdef CONFIG_HEAP_TRACING_TOHOST
+TEST_CASE("heap trace can switch between standalone and to host", "[heap]")
+{
+    heap_trace_record_t recs[8];
+    TEST_ESP_OK(heap_trace_init_standalone(recs, 8));
+    TEST_ESP_OK(heap_trace_init_tohost());
+    TEST_ASSERT_EQUAL(0, heap_trace_get_count());
+    TEST_ESP_OK(heap_trace_init_standalone(recs, 8));
+
+    TEST_ESP_OK(heap_trace_start(HEAP_TRACE_LEAKS));
+    void *p = malloc(32);
+    TEST_ESP_OK(heap_trace_stop());
+    TEST_ASSERT_EQUAL(1, heap_trace_get_count());
+    TEST_ASSERT_EQUAL_PTR(p, recs[0].address);
+    free(p);
+
+    /* releases the index of the standalone buffer */
+    TEST_ESP_OK(heap_trace_init_standalone(NULL, 0));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, heap_trace_start(HEAP_TRACE_LEAKS));
+}
+#endif
+
 #endif
@@ -0,0 +1,123 @@
+/*
+ Tests for the fixed size object pools
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "sdkconfig.h"
+#include "esp_heap_caps.h"
+#include "esp_heap_caps_pool.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+TEST_CASE("pool allocates all its objects", "[heap]")
+{
+    const size_t count = 16;
+    void *objs[count];
+    heap_caps_pool_info_t info;
+
+    size_t free_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    heap_caps_pool_handle_t pool = heap_caps_pool_create(22, count, MALLOC_CAP_8BIT);
+    TEST_ASSERT_NOT_NULL(pool);
+    TEST_ASSERT(heap_caps_get_free_size(MALLOC_CAP_8BIT) < free_before);
+
+    for (int i = 0; i < count; i++) {
+        objs[i] = heap_caps_pool_alloc(pool);
+        TEST_ASSERT_NOT_NULL(objs[i]);
+        TEST_ASSERT_EQUAL(0, (intptr_t)objs[i] % 4);
+        memset(objs[i], i, 22);
+    }
+    TEST_ASSERT_NULL(heap_caps_pool_alloc(pool));
+
+    heap_caps_pool_get_info(pool, &info);
+    TEST_ASSERT_EQUAL(22, info.object_size);
+    TEST_ASSERT_EQUAL(count, info.total_objects);
+    TEST_ASSERT_EQUAL(0, info.free_objects);
+    TEST_ASSERT_EQUAL(0, info.minimum_free_objects);
+    TEST_ASSERT_EQUAL(1, info.alloc_failures);
+    TEST_ASSERT(heap_caps_pool_check(pool, true));
+
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < 22; j++) {
+            TEST_ASSERT_EQUAL_HEX8(i, ((uint8_t *)objs[i])[j]);
+        }
+        heap_caps_pool_free(pool, objs[i]);
+    }
+    heap_caps_pool_get_info(pool, &info);
+    TEST_ASSERT_EQUAL(count, info.free_objects);
+    TEST_ASSERT(heap_caps_pool_check(pool, true));
+
+    /* the last freed object is allocated first */
+    TEST_ASSERT_EQUAL_PTR(objs[count - 1], heap_caps_pool_alloc(pool));
+
+    heap_caps_print_heap_info(MALLOC_CAP_8BIT);
+    heap_caps_pool_delete(pool);
+    TEST_ASSERT_EQUAL(free_before, heap_caps_get_free_size(MALLOC_CAP_8BIT));
+}
+
+TEST_CASE("pool with invalid parameters fails", "[heap]")
+{
+    TEST_ASSERT_NULL(heap_caps_pool_create(0, 10, MALLOC_CAP_8BIT));
+    TEST_ASSERT_NULL(heap_caps_pool_create(16, 0, MALLOC_CAP_8BIT));
+    TEST_ASSERT_NULL(heap_caps_pool_create(SIZE_MAX / 2, 4, MALLOC_CAP_8BIT));
+    TEST_ASSERT_NULL(heap_caps_pool_create(16, 4, MALLOC_CAP_EXEC | MALLOC_CAP_8BIT));
+}
+
+static const int SINGLE_ALLOCATOR_OBJECTS = 1000;
+
+typedef struct {
+    heap_caps_pool_handle_t pool;
+    QueueHandle_t queue;
+    SemaphoreHandle_t done;
+} pool_free_args_t;
+
+static void pool_free_task(void *arg)
+{
+    pool_free_args_t *args = (pool_free_args_t *)arg;
+    for (int i = 0; i < SINGLE_ALLOCATOR_OBJECTS; i++) {
+        void *obj;
+        xQueueReceive(args->queue, &obj, portMAX_DELAY);
+        heap_caps_pool_free(args->pool, obj);
+    }
+    xSemaphoreGive(args->done);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("pool in single allocator mode frees objects from another core", "[heap]")
+{
+    const size_t count = 8;
+    pool_free_args_t args;
+    heap_caps_pool_info_t info;
+
+    heap_caps_pool_handle_t pool = heap_caps_pool_create_with_flags(32, count, MALLOC_CAP_8BIT,
+                                                                    HEAP_CAPS_POOL_FLAG_SINGLE_ALLOCATOR);
+    TEST_ASSERT_NOT_NULL(pool);
+    args.pool = pool;
+    args.queue = xQueueCreate(count, sizeof(void *));
+    args.done = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(args.queue);
+    TEST_ASSERT_NOT_NULL(args.done);
+    xTaskCreatePinnedToCore(pool_free_task, "pool_free", 2048, &args, uxTaskPriorityGet(NULL), NULL,
+                            portNUM_PROCESSORS - 1);
+
+    for (int i = 0; i < SINGLE_ALLOCATOR_OBJECTS; i++) {
+        void *obj;
+        while ((obj = heap_caps_pool_alloc(pool)) == NULL) {
+            vTaskDelay(1);
+        }
+        memset(obj, 0xAA, 32);
+        xQueueSend(args.queue, &obj, portMAX_DELAY);
+    }
+    /* the free count goes up before the object is pushed, wait for the last free to complete */
+    TEST_ASSERT(xSemaphoreTake(args.done, pdMS_TO_TICKS(5000)));
+
+    heap_caps_pool_get_info(pool, &info);
+    TEST_ASSERT_EQUAL(count, info.free_objects);
+    TEST_ASSERT(heap_caps_pool_check(pool, true));
+    vSemaphoreDelete(args.done);
+    vQueueDelete(args.queue);
+    heap_caps_pool_delete(pool);
+}
@@ -0,0 +1,20 @@
+#!/bin/bash
+#
+# Run the heap benchmark with each allocator, to compare them
+#
+
+FAIL=0
+
+for ALLOCATOR in "CONFIG_HEAP_ALLOCATOR_BEST_FIT" "CONFIG_HEAP_ALLOCATOR_SEGREGATED_FIT"; do
+    echo "==== Benchmark with config: ${ALLOCATOR} ===="
+    CPPFLAGS="-D${ALLOCATOR}" make clean bench || FAIL=1
+done
+
+make clean
+
+if [ $FAIL == 0 ]; then
+    echo "All configurations passed"
+else
+    echo "Some configurations failed, see log."
+    exit 1
+fi
@@ -0,0 +1,135 @@
+#include "catch.hpp"
+#include "multi_heap.h"
+
+#include "../multi_heap_config.h"
+#include "../multi_heap_cache.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+/* Contention benchmark of the per-core heap caches: threads allocate and free small blocks of a shared heap,
+   either straight from the heap (which takes its lock every time) or through the cache.
+   The test is hidden, run it with "make bench" or "./test_multi_heap [bench]".
+*/
+
+static const size_t CACHE_BENCH_HEAP_SIZE = 512 * 1024;
+static const int CACHE_BENCH_ITERATIONS = 200000;
+static const size_t CACHE_BENCH_LIVE_BLOCKS = 64;
+static const int s_thread_counts[] = { 1, 2, 4 };
+
+typedef struct {
+    multi_heap_handle_t heap;
+    multi_heap_cache_handle_t cache; /* NULL to use the heap directly */
+    uint32_t seed;
+    size_t failures;
+} cache_bench_thread_t;
+
+static uint32_t cache_bench_rand(uint32_t *state)
+{
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *cache_bench_thread(void *arg)
+{
+    cache_bench_thread_t *t = (cache_bench_thread_t *)arg;
+    void *blocks[CACHE_BENCH_LIVE_BLOCKS] = { 0 };
+
+    for (int i = 0; i < CACHE_BENCH_ITERATIONS; i++) {
+        size_t n = cache_bench_rand(&t->seed) % CACHE_BENCH_LIVE_BLOCKS;
+        size_t size = 16 + cache_bench_rand(&t->seed) % (256 - 16 + 1);
+        if (t->cache != NULL) {
+            multi_heap_cache_free(t->cache, blocks[n]);
+            blocks[n] = multi_heap_cache_malloc(t->cache, size);
+        } else {
+            multi_heap_free(t->heap, blocks[n]);
+            blocks[n] = multi_heap_malloc(t->heap, size);
+        }
+        if (blocks[n] == NULL) {
+            t->failures++;
+        } else {
+            memset(blocks[n], 0xA5, 8);
+        }
+    }
+
+    for (size_t n = 0; n < CACHE_BENCH_LIVE_BLOCKS; n++) {
+        if (t->cache != NULL) {
+            multi_heap_cache_free(t->cache, blocks[n]);
+        } else {
+            multi_heap_free(t->heap, blocks[n]);
+        }
+    }
+    if (t->cache != NULL) {
+        multi_heap_cache_flush(t->cache);
+    }
+    return NULL;
+}
+
+static double run_cache_benchmark(multi_heap_handle_t heap, multi_heap_cache_handle_t cache, int thread_count)
+{
+    std::vector<pthread_t> threads(thread_count);
+    std::vector<cache_bench_thread_t> args(thread_count);
+    size_t free_before = multi_heap_free_size(heap);
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < thread_count; i++) {
+        args[i].heap = heap;
+        args[i].cache = cache;
+        args[i].seed = i + 1;
+        args[i].failures = 0;
+        REQUIRE( pthread_create(&threads[i], NULL, cache_bench_thread, &args[i]) == 0 );
+    }
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    for (int i = 0; i < thread_count; i++) {
+        REQUIRE( args[i].failures == 0 );
+    }
+    REQUIRE( multi_heap_check(heap, true) );
+    REQUIRE( multi_heap_free_size(heap) == free_before );
+
+    /* every iteration is one malloc and (apart from the first ones) one free */
+    return 2.0 * CACHE_BENCH_ITERATIONS * thread_count / (elapsed / 1e9);
+}
+
+TEST_CASE("multi_heap cache benchmark", "[multi_heap][bench][.]")
+{
+    std::vector<uint8_t> heap_mem(CACHE_BENCH_HEAP_SIZE);
+    multi_heap_handle_t heap = multi_heap_register(heap_mem.data(), heap_mem.size());
+    REQUIRE( heap != NULL );
+
+    pthread_mutex_t lock;
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    multi_heap_set_lock(heap, &lock);
+
+    multi_heap_cache_handle_t cache = multi_heap_cache_create(heap);
+    REQUIRE( cache != NULL );
+
+    printf("heap cache, %d blocks per size class: malloc+free of 16-256 byte blocks, Mops/s\n", MULTI_HEAP_CACHE_MAX_BLOCKS);
+    printf("%8s %10s %10s\n", "threads", "heap", "cache");
+    for (size_t t = 0; t < sizeof(s_thread_counts) / sizeof(s_thread_counts[0]); t++) {
+        double heap_ops = run_cache_benchmark(heap, NULL, s_thread_counts[t]);
+        double cache_ops = run_cache_benchmark(heap, cache, s_thread_counts[t]);
+        printf("%8d %10.2f %10.2f\n", s_thread_counts[t], heap_ops / 1e6, cache_ops / 1e6);
+    }
+
+    multi_heap_free(heap, cache);
+    multi_heap_set_lock(heap, NULL);
+    pthread_mutex_destroy(&lock);
+}
@@ -0,0 +1,108 @@
+#include "catch.hpp"
+
+#include "../heap_region_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+/* Benchmark of finding the heap which contains a pointer, as heap_caps_free() and heap_caps_realloc() do:
+   walking a linked list of heaps, as heap_caps.c did before, against a binary search of heap_region_table_t.
+   The test is hidden, run it with "make bench" or "./test_multi_heap [bench]".
+*/
+
+typedef struct bench_heap {
+    intptr_t start;
+    intptr_t end;
+    struct bench_heap *next;
+} bench_heap_t;
+
+static const int s_region_counts[] = { 4, 12, 32, 128 };
+static const int REGION_BENCH_LOOKUPS = 2000000;
+static const intptr_t REGION_BENCH_REGION_SIZE = 0x10000;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bench_heap_t *find_in_list(bench_heap_t *list, intptr_t p)
+{
+    for (bench_heap_t *heap = list; heap != NULL; heap = heap->next) {
+        if (p >= heap->start && p < heap->end) {
+            return heap;
+        }
+    }
+    return NULL;
+}
+
+static void run_region_benchmark(int region_count)
+{
+    std::vector<bench_heap_t> heaps(region_count);
+    std::vector<uint8_t> table_buf[2];
+    heap_region_table_t *table = NULL;
+    bench_heap_t *list = NULL;
+
+    /* regions with gaps between them, added in a shuffled order as with heap_caps_add_region() */
+    std::vector<int> order(region_count);
+    for (int i = 0; i < region_count; i++) {
+        order[i] = i;
+    }
+    srand(1);
+    for (int i = region_count - 1; i > 0; i--) {
+        std::swap(order[i], order[rand() % (i + 1)]);
+    }
+    for (int i = 0; i < region_count; i++) {
+        bench_heap_t *heap = &heaps[order[i]];
+        heap->start = 0x3f800000 + order[i] * 2 * REGION_BENCH_REGION_SIZE;
+        heap->end = heap->start + REGION_BENCH_REGION_SIZE;
+        heap->next = list;
+        list = heap;
+
+        std::vector<uint8_t> &buf = table_buf[i % 2];
+        buf.resize(HEAP_REGION_TABLE_SIZE(i + 2));
+        heap_region_table_t *new_table = (heap_region_table_t *)buf.data();
+        heap_region_table_insert(new_table, table, heap->start, heap->end, heap);
+        table = new_table;
+    }
+
+    /* pointers to free, spread evenly over the heaps */
+    std::vector<intptr_t> pointers(4096);
+    for (size_t i = 0; i < pointers.size(); i++) {
+        const bench_heap_t *heap = &heaps[rand() % region_count];
+        pointers[i] = heap->start + rand() % REGION_BENCH_REGION_SIZE;
+    }
+
+    for (size_t i = 0; i < pointers.size(); i++) {
+        REQUIRE( heap_region_table_find(table, pointers[i]) == find_in_list(list, pointers[i]) );
+    }
+
+    uintptr_t check = 0;
+    uint64_t start = now_ns();
+    for (int i = 0; i < REGION_BENCH_LOOKUPS; i++) {
+        check += (uintptr_t)find_in_list(list, pointers[i % pointers.size()]);
+    }
+    uint64_t list_ns = now_ns() - start;
+
+    start = now_ns();
+    for (int i = 0; i < REGION_BENCH_LOOKUPS; i++) {
+        check -= (uintptr_t)heap_region_table_find(table, pointers[i % pointers.size()]);
+    }
+    uint64_t table_ns = now_ns() - start;
+    REQUIRE( check == 0 );
+
+    printf("%8d %12.1f %12.1f\n", region_count,
+           (double)list_ns / REGION_BENCH_LOOKUPS, (double)table_ns / REGION_BENCH_LOOKUPS);
+}
+
+TEST_CASE("heap region lookup benchmark", "[multi_heap][bench][.]")
+{
+    printf("pointer to heap lookup, ns per lookup\n");
+    printf("%8s %12s %12s\n", "regions", "list", "table");
+    for (size_t i = 0; i < sizeof(s_region_counts) / sizeof(s_region_counts[0]); i++) {
+        run_region_benchmark(s_region_counts[i]);
+    }
+}
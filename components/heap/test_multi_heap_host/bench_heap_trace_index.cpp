@@ -0,0 +1,170 @@
+#include "catch.hpp"
+
+#include "../heap_trace_index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+/* Benchmark of recording traced allocations and frees, as heap_trace.c does: the record buffer kept in order and
+   searched backwards on free, as heap_trace.c did before, against the buffer indexed by heap_trace_index_t.
+   The test is hidden, run it with "make bench" or "./test_multi_heap [bench]".
+*/
+
+typedef struct {
+    void *address;
+    size_t size;
+    void *alloced_by[2];
+    void *freed_by[2];
+} bench_record_t;
+
+static const size_t s_record_counts[] = { 1000, 10000 };
+static const int TRACE_BENCH_OPERATIONS = 200000;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* the previous heap_trace.c algorithm */
+class linear_trace {
+public:
+    linear_trace(size_t total_records) : buffer(total_records), count(0) { }
+
+    void record_allocation(void *address, size_t size)
+    {
+        if (count == buffer.size()) {
+            memmove(&buffer[0], &buffer[1], sizeof(bench_record_t) * (buffer.size() - 1));
+            count--;
+        }
+        bench_record_t *rec = &buffer[count++];
+        memset(rec, 0, sizeof(bench_record_t));
+        rec->address = address;
+        rec->size = size;
+    }
+
+    void record_free(void *address, bool leaks)
+    {
+        int i;
+        for (i = count - 1; i >= 0; i--) {
+            if (buffer[i].address == address) {
+                break;
+            }
+        }
+        if (i >= 0) {
+            if (!leaks) {
+                buffer[i].freed_by[0] = address;
+            } else {
+                if (i < (int)count - 1) {
+                    memmove(&buffer[i], &buffer[i + 1], sizeof(bench_record_t) * (buffer.size() - i - 1));
+                } else {
+                    memset(&buffer[i], 0, sizeof(bench_record_t));
+                }
+                count--;
+            }
+        }
+    }
+
+    std::vector<bench_record_t> buffer;
+    size_t count;
+};
+
+/* the heap_trace.c algorithm with heap_trace_index_t */
+class indexed_trace {
+public:
+    indexed_trace(size_t total_records) : buffer(total_records),
+        memory(heap_trace_index_memory_size(total_records) / sizeof(intptr_t) + 1)
+    {
+        heap_trace_index_init(&index, memory.data(), total_records);
+    }
+
+    void record_allocation(void *address, size_t size)
+    {
+        bool evicted;
+        bench_record_t *rec = &buffer[heap_trace_index_add(&index, address, &evicted)];
+        memset(rec, 0, sizeof(bench_record_t));
+        rec->address = address;
+        rec->size = size;
+    }
+
+    void record_free(void *address, bool leaks)
+    {
+        size_t slot = heap_trace_index_find(&index, address);
+        if (slot != HEAP_TRACE_INDEX_NONE) {
+            if (!leaks) {
+                buffer[slot].freed_by[0] = address;
+                heap_trace_index_unindex(&index, slot);
+            } else {
+                memset(&buffer[slot], 0, sizeof(bench_record_t));
+                heap_trace_index_remove(&index, slot);
+            }
+        }
+    }
+
+    std::vector<bench_record_t> buffer;
+    std::vector<intptr_t> memory;
+    heap_trace_index_t index;
+};
+
+/* Keeps about 'live' allocations alive, freeing a random one of them after each new allocation, so that the
+   buffer fills with records of live allocations (LEAKS mode) or of live and freed ones (ALL mode). */
+template<typename trace_t>
+static uint64_t run_trace(trace_t &trace, size_t live, bool leaks)
+{
+    std::vector<void *> alive(live);
+    uintptr_t next_address = 0x3f800000;
+    for (size_t i = 0; i < live; i++) {
+        alive[i] = (void *)next_address;
+        next_address += 16;
+        trace.record_allocation(alive[i], 16);
+    }
+
+    srand(1);
+    uint64_t start = now_ns();
+    for (int i = 0; i < TRACE_BENCH_OPERATIONS; i++) {
+        size_t n = rand() % live;
+        trace.record_free(alive[n], leaks);
+        /* heaps reuse freed addresses, so do the same half the time */
+        if (rand() % 2) {
+            alive[n] = (void *)next_address;
+            next_address += 16;
+        }
+        trace.record_allocation(alive[n], 16);
+    }
+    return now_ns() - start;
+}
+
+static void run_trace_benchmark(size_t total_records, bool leaks)
+{
+    /* LEAKS mode: the buffer is mostly full of live allocations. ALL mode: live allocations are a third of it. */
+    size_t live = leaks ? total_records * 9 / 10 : total_records / 3;
+
+    linear_trace linear(total_records);
+    uint64_t linear_ns = run_trace(linear, live, leaks);
+    indexed_trace indexed(total_records);
+    uint64_t indexed_ns = run_trace(indexed, live, leaks);
+
+    /* both keep the same records in the same order */
+    REQUIRE( indexed.index.count == linear.count );
+    for (size_t i = 0; i < linear.count; i++) {
+        size_t slot = heap_trace_index_get_slot(&indexed.index, i);
+        REQUIRE( memcmp(&indexed.buffer[slot], &linear.buffer[i], sizeof(bench_record_t)) == 0 );
+    }
+
+    printf("%8zu %8s %12.1f %12.1f\n", total_records, leaks ? "leaks" : "all",
+           (double)linear_ns / TRACE_BENCH_OPERATIONS, (double)indexed_ns / TRACE_BENCH_OPERATIONS);
+}
+
+TEST_CASE("heap trace benchmark", "[multi_heap][bench][.]")
+{
+    printf("traced free + malloc, ns per pair\n");
+    printf("%8s %8s %12s %12s\n", "records", "mode", "linear", "indexed");
+    for (size_t i = 0; i < sizeof(s_record_counts) / sizeof(s_record_counts[0]); i++) {
+        run_trace_benchmark(s_record_counts[i], true);
+        run_trace_benchmark(s_record_counts[i], false);
+    }
+}
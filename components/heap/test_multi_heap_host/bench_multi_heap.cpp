@@ -0,0 +1,150 @@
+#include "catch.hpp"
+#include "multi_heap.h"
+
+#include "../multi_heap_config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+/* Latency and fragmentation benchmark of the heap allocator selected at build time.
+   The test is hidden, run it with "make bench" or "./test_multi_heap [bench]".
+   bench_all_configs.sh runs it for each allocator, so the results can be compared.
+*/
+
+#ifdef MULTI_HEAP_SEGREGATED_FIT
+#define ALLOCATOR_NAME "segregated fit"
+#else
+#define ALLOCATOR_NAME "best fit"
+#endif
+
+typedef struct {
+    const char *name;
+    size_t min_size;
+    size_t max_size;
+    size_t large_size;      /* size of the occasional large allocation, 0 for none */
+    unsigned large_percent; /* percentage of allocations which are large */
+    size_t live_blocks;     /* number of blocks allocated at the same time */
+} bench_workload_t;
+
+static const bench_workload_t s_workloads[] = {
+    { "small objects",  8,   128,  0,     0, 2000 },
+    { "mixed sizes",    16,  1024, 4096,  2, 500 },
+    { "tls buffers",    16,  256,  16384, 1, 1000 },
+};
+
+static const size_t BENCH_HEAP_SIZE = 256 * 1024;
+static const int BENCH_ITERATIONS = 200000;
+
+static uint32_t s_rand_state;
+
+static uint32_t bench_rand()
+{
+    // fixed sequence, so that both allocators get the same workload
+    s_rand_state = s_rand_state * 1103515245 + 12345;
+    return s_rand_state >> 8;
+}
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static size_t random_size(const bench_workload_t *workload)
+{
+    if (workload->large_size > 0 && bench_rand() % 100 < workload->large_percent) {
+        return workload->large_size;
+    }
+    return workload->min_size + bench_rand() % (workload->max_size - workload->min_size + 1);
+}
+
+static void print_latency(const char *op, std::vector<uint32_t> &samples)
+{
+    if (samples.empty()) {
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    uint64_t sum = 0;
+    for (uint32_t s : samples) {
+        sum += s;
+    }
+    printf("  %-8s mean %6.1f ns  p99 %6u ns  p99.9 %6u ns  max %7u ns\n", op,
+           (double)sum / samples.size(),
+           samples[samples.size() * 99 / 100],
+           samples[samples.size() * 999 / 1000],
+           samples.back());
+}
+
+static void run_benchmark(uint8_t *heap_mem, const bench_workload_t *workload)
+{
+    multi_heap_handle_t heap = multi_heap_register(heap_mem, BENCH_HEAP_SIZE);
+    REQUIRE( heap != NULL );
+
+    std::vector<void *> blocks(workload->live_blocks, (void *)NULL);
+    std::vector<uint32_t> malloc_ns, free_ns;
+    malloc_ns.reserve(BENCH_ITERATIONS);
+    free_ns.reserve(BENCH_ITERATIONS);
+    size_t failures = 0;
+    double fragmentation_sum = 0;
+    size_t fragmentation_samples = 0;
+    s_rand_state = 1;
+
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        size_t n = bench_rand() % blocks.size();
+        if (blocks[n] != NULL) {
+            uint64_t start = now_ns();
+            multi_heap_free(heap, blocks[n]);
+            free_ns.push_back(now_ns() - start);
+            blocks[n] = NULL;
+        }
+
+        size_t size = random_size(workload);
+        uint64_t start = now_ns();
+        blocks[n] = multi_heap_malloc(heap, size);
+        uint32_t elapsed = now_ns() - start;
+        if (blocks[n] != NULL) {
+            malloc_ns.push_back(elapsed);
+        } else {
+            failures++;
+        }
+
+        if (i % 1000 == 999) {
+            multi_heap_info_t info;
+            multi_heap_get_info(heap, &info);
+            if (info.total_free_bytes > 0) {
+                fragmentation_sum += 1.0 - (double)info.largest_free_block / info.total_free_bytes;
+                fragmentation_samples++;
+            }
+        }
+    }
+
+    multi_heap_info_t info;
+    multi_heap_get_info(heap, &info);
+    REQUIRE( multi_heap_check(heap, true) );
+
+    printf("%s, %s: %zu live blocks, %zu free blocks, %zu of %d allocations failed\n",
+           ALLOCATOR_NAME, workload->name, info.allocated_blocks, info.free_blocks, failures, BENCH_ITERATIONS);
+    printf("  fragmentation (1 - largest free block / free bytes): mean %.3f, at end %.3f, minimum free %zu bytes\n",
+           fragmentation_samples ? fragmentation_sum / fragmentation_samples : 0.0,
+           info.total_free_bytes ? 1.0 - (double)info.largest_free_block / info.total_free_bytes : 0.0,
+           info.minimum_free_bytes);
+    print_latency("malloc", malloc_ns);
+    print_latency("free", free_ns);
+
+    for (size_t n = 0; n < blocks.size(); n++) {
+        multi_heap_free(heap, blocks[n]);
+    }
+}
+
+TEST_CASE("multi_heap benchmark", "[multi_heap][bench][.]")
+{
+    std::vector<uint8_t> heap_mem(BENCH_HEAP_SIZE);
+    for (size_t w = 0; w < sizeof(s_workloads) / sizeof(s_workloads[0]); w++) {
+        run_benchmark(heap_mem.data(), &s_workloads[w]);
+    }
+}
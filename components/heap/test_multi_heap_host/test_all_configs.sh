@@ -5,9 +5,13 @@
 
 FAIL=0
 
-for FLAGS in "CONFIG_HEAP_POISONING_NONE" "CONFIG_HEAP_POISONING_LIGHT" "CONFIG_HEAP_POISONING_COMPREHENSIVE"; do
-    echo "==== Testing with config: ${FLAGS} ===="
-    CPPFLAGS="-D${FLAGS}" make clean test || FAIL=1
+for ALLOCATOR in "CONFIG_HEAP_ALLOCATOR_BEST_FIT" "CONFIG_HEAP_ALLOCATOR_SEGREGATED_FIT"; do
+    for FLAGS in "CONFIG_HEAP_POISONING_NONE" "CONFIG_HEAP_POISONING_LIGHT" "CONFIG_HEAP_POISONING_COMPREHENSIVE"; do
+        for HISTOGRAM in "CONFIG_HEAP_HISTOGRAM_DISABLED" "CONFIG_HEAP_HISTOGRAM"; do
+            echo "==== Testing with config: ${ALLOCATOR} ${FLAGS} ${HISTOGRAM} ===="
+            CPPFLAGS="-D${ALLOCATOR} -D${FLAGS} -D${HISTOGRAM}" make clean test || FAIL=1
+        done
+    done
 done
 
 make clean
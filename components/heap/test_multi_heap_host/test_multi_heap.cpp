@@ -2,9 +2,13 @@
 #include "multi_heap.h"
 
 #include "../multi_heap_config.h"
+#include "../multi_heap_cache.h"
+#include "../heap_region_table.h"
+#include "../heap_trace_index.h"
 
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 
 /* Insurance against accidentally using libc heap functions in tests */
 #undef free
@@ -494,3 +498,363 @@ TEST_CASE("unaligned heaps", "[multi_heap]")
         }
     }
 }
+
+TEST_CASE("multi_heap cache", "[multi_heap]")
+{
+    uint8_t heapdata[4096];
+    multi_heap_handle_t heap = multi_heap_register(heapdata, sizeof(heapdata));
+    size_t initial_free = multi_heap_free_size(heap);
+
+    multi_heap_cache_handle_t cache = multi_heap_cache_create(heap);
+    REQUIRE( cache != NULL );
+    size_t cache_free = multi_heap_free_size(heap);
+    size_t cached_bytes, cached_blocks;
+
+    /* the first allocation takes a batch of blocks from the heap */
+    void *a = multi_heap_cache_malloc(cache, 30);
+    REQUIRE( a != NULL );
+    REQUIRE( multi_heap_get_allocated_size(heap, a) >= 32 );
+    multi_heap_cache_get_info(cache, &cached_bytes, &cached_blocks);
+    REQUIRE( cached_blocks == (MULTI_HEAP_CACHE_MAX_BLOCKS + 1) / 2 - 1 );
+    REQUIRE( cached_bytes >= cached_blocks * 32 );
+    REQUIRE( multi_heap_check(heap, true) );
+
+    /* a freed block is kept in the cache and used again */
+    memset(a, 0xEE, 30);
+    multi_heap_cache_free(cache, a);
+    multi_heap_cache_get_info(cache, &cached_bytes, &cached_blocks);
+    REQUIRE( cached_blocks == (MULTI_HEAP_CACHE_MAX_BLOCKS + 1) / 2 );
+    void *b = multi_heap_cache_malloc(cache, 20);
+    REQUIRE( b == a );
+
+    /* sizes outside the size classes go straight to the heap */
+    void *large = multi_heap_cache_malloc(cache, 600);
+    REQUIRE( large != NULL );
+    multi_heap_cache_free(cache, large);
+    multi_heap_cache_get_info(cache, &cached_bytes, &cached_blocks);
+    REQUIRE( cached_blocks == (MULTI_HEAP_CACHE_MAX_BLOCKS + 1) / 2 - 1 );
+
+    /* the cache holds no more than MULTI_HEAP_CACHE_MAX_BLOCKS blocks of a size class */
+    void *blocks[MULTI_HEAP_CACHE_MAX_BLOCKS * 2];
+    for (int i = 0; i < MULTI_HEAP_CACHE_MAX_BLOCKS * 2; i++) {
+        blocks[i] = multi_heap_cache_malloc(cache, 100);
+        REQUIRE( blocks[i] != NULL );
+    }
+    for (int i = 0; i < MULTI_HEAP_CACHE_MAX_BLOCKS * 2; i++) {
+        multi_heap_cache_free(cache, blocks[i]);
+    }
+    multi_heap_cache_get_info(cache, &cached_bytes, &cached_blocks);
+    REQUIRE( cached_blocks <= MULTI_HEAP_CACHE_MAX_BLOCKS * 2 );
+    REQUIRE( multi_heap_check(heap, true) );
+
+    /* every cached block goes back to the heap on flush */
+    multi_heap_cache_free(cache, b);
+    multi_heap_cache_flush(cache);
+    multi_heap_cache_get_info(cache, &cached_bytes, &cached_blocks);
+    REQUIRE( cached_bytes == 0 );
+    REQUIRE( cached_blocks == 0 );
+    REQUIRE( multi_heap_free_size(heap) == cache_free );
+    REQUIRE( multi_heap_check(heap, true) );
+
+    /* blocks are given back to the heap when it runs out of memory */
+    a = multi_heap_cache_malloc(cache, 16);
+    REQUIRE( a != NULL );
+    multi_heap_cache_free(cache, a);
+    void *all = multi_heap_cache_malloc(cache, cache_free - 64);
+    REQUIRE( all != NULL );
+    multi_heap_cache_free(cache, all);
+
+    multi_heap_free(heap, cache);
+    REQUIRE( multi_heap_free_size(heap) == initial_free );
+}
+
+static void *cache_blocks_in_thread(void *arg)
+{
+    multi_heap_cache_handle_t cache = (multi_heap_cache_handle_t)arg;
+    void *blocks[MULTI_HEAP_CACHE_MAX_BLOCKS];
+    for (int i = 0; i < MULTI_HEAP_CACHE_MAX_BLOCKS; i++) {
+        blocks[i] = multi_heap_cache_malloc(cache, 200);
+    }
+    for (int i = 0; i < MULTI_HEAP_CACHE_MAX_BLOCKS; i++) {
+        multi_heap_cache_free(cache, blocks[i]);
+    }
+    return NULL;
+}
+
+TEST_CASE("multi_heap cache gives back the blocks of other cores when out of memory", "[multi_heap]")
+{
+    uint8_t heapdata[4096];
+    multi_heap_handle_t heap = multi_heap_register(heapdata, sizeof(heapdata));
+    multi_heap_cache_handle_t cache = multi_heap_cache_create(heap);
+    REQUIRE( cache != NULL );
+    size_t cache_free = multi_heap_free_size(heap);
+
+    /* this thread takes a cache slot, another thread ("core") leaves blocks in its own slot */
+    void *a = multi_heap_cache_malloc(cache, 16);
+    REQUIRE( a != NULL );
+    multi_heap_cache_free(cache, a);
+    pthread_t thread;
+    REQUIRE( pthread_create(&thread, NULL, cache_blocks_in_thread, cache) == 0 );
+    pthread_join(thread, NULL);
+    size_t cached_bytes, cached_blocks;
+    multi_heap_cache_get_info(cache, &cached_bytes, &cached_blocks);
+    REQUIRE( cached_bytes >= 4 * 200 );
+
+    /* only fits once the blocks cached by the other thread are given back */
+    void *all = multi_heap_cache_malloc(cache, cache_free - 64);
+    REQUIRE( all != NULL );
+    multi_heap_cache_get_info(cache, &cached_bytes, &cached_blocks);
+    REQUIRE( cached_blocks == 0 );
+    multi_heap_cache_free(cache, all);
+    REQUIRE( multi_heap_check(heap, true) );
+    multi_heap_free(heap, cache);
+}
+
+TEST_CASE("heap region table", "[multi_heap]")
+{
+    intptr_t table_buf[2][HEAP_REGION_TABLE_SIZE(8) / sizeof(intptr_t)];
+    heap_region_table_t *a = (heap_region_table_t *)table_buf[0];
+    heap_region_table_t *b = (heap_region_table_t *)table_buf[1];
+    int heaps[4];
+
+    /* regions added out of order end up sorted */
+    heap_region_table_insert(a, NULL, 0x2000, 0x3000, &heaps[0]);
+    heap_region_table_insert(b, a, 0x1000, 0x1800, &heaps[1]);
+    heap_region_table_insert(a, b, 0x4000, 0x5000, &heaps[2]);
+    REQUIRE( a->count == 3 );
+    REQUIRE( a->entries[0].start == 0x1000 );
+    REQUIRE( a->entries[1].start == 0x2000 );
+    REQUIRE( a->entries[2].start == 0x4000 );
+
+    REQUIRE( heap_region_table_find(a, 0x0fff) == NULL );
+    REQUIRE( heap_region_table_find(a, 0x1000) == &heaps[1] );
+    REQUIRE( heap_region_table_find(a, 0x17ff) == &heaps[1] );
+    REQUIRE( heap_region_table_find(a, 0x1800) == NULL );
+    REQUIRE( heap_region_table_find(a, 0x2abc) == &heaps[0] );
+    REQUIRE( heap_region_table_find(a, 0x3000) == NULL );
+    REQUIRE( heap_region_table_find(a, 0x4fff) == &heaps[2] );
+    REQUIRE( heap_region_table_find(a, 0x5000) == NULL );
+
+    /* a region added inside another one splits it */
+    heap_region_table_insert(b, a, 0x2400, 0x2800, &heaps[3]);
+    REQUIRE( b->count == 5 );
+    REQUIRE( heap_region_table_find(b, 0x23ff) == &heaps[0] );
+    REQUIRE( heap_region_table_find(b, 0x2400) == &heaps[3] );
+    REQUIRE( heap_region_table_find(b, 0x27ff) == &heaps[3] );
+    REQUIRE( heap_region_table_find(b, 0x2800) == &heaps[0] );
+    REQUIRE( heap_region_table_find(b, 0x4000) == &heaps[2] );
+
+    /* ... unless it starts or ends with it */
+    heap_region_table_insert(a, b, 0x4000, 0x4100, &heaps[1]);
+    REQUIRE( a->count == 6 );
+    REQUIRE( heap_region_table_find(a, 0x4000) == &heaps[1] );
+    REQUIRE( heap_region_table_find(a, 0x4100) == &heaps[2] );
+    for (size_t i = 1; i < a->count; i++) {
+        REQUIRE( a->entries[i - 1].end <= a->entries[i].start );
+    }
+}
+
+TEST_CASE("heap trace index", "[multi_heap]")
+{
+    const size_t SLOTS = 8;
+    intptr_t memory[64];
+    REQUIRE( heap_trace_index_memory_size(SLOTS) <= sizeof(memory) );
+    heap_trace_index_t index;
+    heap_trace_index_init(&index, memory, SLOTS);
+    bool evicted;
+
+    REQUIRE( heap_trace_index_find(&index, (void *)0x1000) == HEAP_TRACE_INDEX_NONE );
+    REQUIRE( heap_trace_index_get_slot(&index, 0) == HEAP_TRACE_INDEX_NONE );
+
+    /* addresses 0x10000 apart, all with the same low bits, to make the hash collide */
+    size_t slots[SLOTS];
+    for (size_t i = 0; i < SLOTS; i++) {
+        slots[i] = heap_trace_index_add(&index, (void *)(0x10000 * (i + 1)), &evicted);
+        REQUIRE( !evicted );
+        REQUIRE( slots[i] < SLOTS );
+    }
+    REQUIRE( index.count == SLOTS );
+    for (size_t i = 0; i < SLOTS; i++) {
+        REQUIRE( heap_trace_index_find(&index, (void *)(0x10000 * (i + 1))) == slots[i] );
+        REQUIRE( heap_trace_index_get_slot(&index, i) == slots[i] );
+    }
+    REQUIRE( heap_trace_index_get_slot(&index, SLOTS) == HEAP_TRACE_INDEX_NONE );
+
+    /* freed in ALL mode: no longer found, but still in order */
+    heap_trace_index_unindex(&index, slots[2]);
+    REQUIRE( heap_trace_index_find(&index, (void *)0x30000) == HEAP_TRACE_INDEX_NONE );
+    REQUIRE( index.count == SLOTS );
+    REQUIRE( heap_trace_index_get_slot(&index, 2) == slots[2] );
+
+    /* freed in LEAKS mode: the slot is gone, and every other allocation still found */
+    heap_trace_index_remove(&index, slots[4]);
+    REQUIRE( index.count == SLOTS - 1 );
+    for (size_t i = 0; i < SLOTS; i++) {
+        size_t expected = (i == 2 || i == 4) ? HEAP_TRACE_INDEX_NONE : slots[i];
+        REQUIRE( heap_trace_index_find(&index, (void *)(0x10000 * (i + 1))) == expected );
+    }
+    REQUIRE( heap_trace_index_get_slot(&index, 3) == slots[3] );
+    REQUIRE( heap_trace_index_get_slot(&index, 4) == slots[5] );
+
+    /* the removed slot is reused, and the new record is the newest */
+    size_t slot = heap_trace_index_add(&index, (void *)0x50000, &evicted);
+    REQUIRE( !evicted );
+    REQUIRE( slot == slots[4] );
+    REQUIRE( heap_trace_index_get_slot(&index, SLOTS - 1) == slot );
+    REQUIRE( heap_trace_index_find(&index, (void *)0x50000) == slot );
+
+    /* when all slots are in use, the oldest is evicted */
+    slot = heap_trace_index_add(&index, (void *)0x90000, &evicted);
+    REQUIRE( evicted );
+    REQUIRE( slot == slots[0] );
+    REQUIRE( heap_trace_index_find(&index, (void *)0x10000) == HEAP_TRACE_INDEX_NONE );
+    REQUIRE( heap_trace_index_find(&index, (void *)0x90000) == slot );
+    REQUIRE( heap_trace_index_get_slot(&index, 0) == slots[1] );
+    REQUIRE( index.count == SLOTS );
+
+    heap_trace_index_clear(&index);
+    REQUIRE( index.count == 0 );
+    REQUIRE( heap_trace_index_find(&index, (void *)0x90000) == HEAP_TRACE_INDEX_NONE );
+}
+
+TEST_CASE("heap trace index without slots", "[multi_heap]")
+{
+    /* heap_trace_init_standalone(NULL, 0) releases the index this way */
+    REQUIRE( heap_trace_index_memory_size(0) == 0 );
+    heap_trace_index_t index;
+    heap_trace_index_init(&index, NULL, 0);
+    REQUIRE( index.count == 0 );
+    REQUIRE( heap_trace_index_find(&index, (void *)0x1000) == HEAP_TRACE_INDEX_NONE );
+    REQUIRE( heap_trace_index_get_slot(&index, 0) == HEAP_TRACE_INDEX_NONE );
+    heap_trace_index_clear(&index);
+    REQUIRE( index.count == 0 );
+}
+
+TEST_CASE("heap trace index random add and remove", "[multi_heap]")
+{
+    const size_t SLOTS = 100;
+    intptr_t memory[1024];
+    REQUIRE( heap_trace_index_memory_size(SLOTS) <= sizeof(memory) );
+    heap_trace_index_t index;
+    heap_trace_index_init(&index, memory, SLOTS);
+
+    /* check the index against a plain list of the addresses in use, oldest first */
+    void *addresses[SLOTS];
+    size_t count = 0;
+    srand(3);
+    for (int i = 0; i < 20000; i++) {
+        bool evicted;
+        if (count == 0 || rand() % 2) {
+            void *address = (void *)(intptr_t)(0x3ffb0000 + (i * 8));
+            heap_trace_index_add(&index, address, &evicted);
+            REQUIRE( evicted == (count == SLOTS) );
+            if (evicted) {
+                memmove(&addresses[0], &addresses[1], sizeof(void *) * (SLOTS - 1));
+                count--;
+            }
+            addresses[count++] = address;
+        } else {
+            size_t n = rand() % count;
+            size_t slot = heap_trace_index_find(&index, addresses[n]);
+            REQUIRE( slot != HEAP_TRACE_INDEX_NONE );
+            heap_trace_index_remove(&index, slot);
+            memmove(&addresses[n], &addresses[n + 1], sizeof(void *) * (count - n - 1));
+            count--;
+        }
+
+        REQUIRE( index.count == count );
+        for (size_t n = 0; n < count; n++) {
+            size_t slot = heap_trace_index_get_slot(&index, n);
+            REQUIRE( slot == heap_trace_index_find(&index, addresses[n]) );
+        }
+    }
+}
+
+static size_t sum_histogram_class(const size_t *counts)
+{
+    size_t sum = 0;
+    for (int i = 0; i < MULTI_HEAP_HISTOGRAM_CLASSES; i++) {
+        sum += counts[i];
+    }
+    return sum;
+}
+
+TEST_CASE("multi_heap histogram", "[multi_heap]")
+{
+    const size_t NUM_ALLOCS = 64;
+    uint8_t heapdata[16384];
+    void *allocs[NUM_ALLOCS] = { 0 };
+    size_t num_allocations = 0;
+    multi_heap_handle_t heap = multi_heap_register(heapdata, sizeof(heapdata));
+    multi_heap_histogram_t histogram;
+    multi_heap_info_t info;
+
+    /* the histogram starts after some allocations are made */
+    multi_heap_histogram_t heap_histogram;
+    bool histogram_set = false;
+
+    srand(4);
+    for (int i = 0; i < 5000; i++) {
+        if (i == 1000) {
+            multi_heap_set_histogram(heap, &heap_histogram);
+            histogram_set = true;
+            num_allocations = 0;
+        }
+
+        size_t n = rand() % NUM_ALLOCS;
+        size_t size = (rand() % 2) ? rand() % 64 + 1 : rand() % 1024 + 1;
+        void *p;
+        switch (rand() % 3) {
+        case 0:
+            multi_heap_free(heap, allocs[n]);
+            allocs[n] = NULL;
+            break;
+        case 1:
+            p = multi_heap_realloc(heap, allocs[n], size);
+            if (p != NULL) {
+                allocs[n] = p;
+                num_allocations++;
+            }
+            break;
+        default:
+            if (allocs[n] == NULL) {
+                allocs[n] = multi_heap_malloc(heap, size);
+                num_allocations += (allocs[n] != NULL);
+            }
+            break;
+        }
+
+        multi_heap_get_histogram(heap, &histogram);
+#ifdef MULTI_HEAP_HISTOGRAM
+        if (histogram_set) {
+            multi_heap_get_info(heap, &info);
+            REQUIRE( sum_histogram_class(histogram.free_blocks) == info.free_blocks );
+            REQUIRE( sum_histogram_class(histogram.allocated_blocks) == info.allocated_blocks );
+            REQUIRE( sum_histogram_class(histogram.allocations) == num_allocations );
+#ifndef MULTI_HEAP_POISONING
+            REQUIRE( sum_histogram_class(histogram.free_bytes) == info.total_free_bytes );
+            REQUIRE( histogram.free_blocks[MULTI_HEAP_HISTOGRAM_CLASSES - 1] == 0 ); /* no block of 256KB here */
+#endif
+            continue;
+        }
+#endif
+        REQUIRE( sum_histogram_class(histogram.free_blocks) == 0 );
+        REQUIRE( sum_histogram_class(histogram.allocations) == 0 );
+        (void)info;
+        (void)histogram_set;
+    }
+
+    for (size_t n = 0; n < NUM_ALLOCS; n++) {
+        multi_heap_free(heap, allocs[n]);
+    }
+    REQUIRE( multi_heap_check(heap, true) );
+    multi_heap_get_histogram(heap, &histogram);
+    REQUIRE( sum_histogram_class(histogram.allocated_blocks) == 0 );
+#ifdef MULTI_HEAP_HISTOGRAM
+    REQUIRE( sum_histogram_class(histogram.free_blocks) == 1 );
+#endif
+
+    multi_heap_set_histogram(heap, NULL);
+    multi_heap_get_histogram(heap, &histogram);
+    REQUIRE( sum_histogram_class(histogram.free_blocks) == 0 );
+}
@@ -3,3 +3,7 @@
 #
 # (Uses default behaviour of compiling all source files in directory, adding 'include' to include path.)
 
+ifdef IS_BOOTLOADER_BUILD
+# Asynchronous log output needs FreeRTOS
+COMPONENT_OBJS := log.o
+endif
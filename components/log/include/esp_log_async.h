@@ -0,0 +1,139 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __ESP_LOG_ASYNC_H__
+#define __ESP_LOG_ASYNC_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Configuration of the asynchronous log output
+ */
+typedef struct {
+    size_t buffer_size;         /*!< Size of the ring buffer holding log records, in bytes */
+    UBaseType_t task_priority;  /*!< Priority of the task which formats and outputs log records */
+    uint32_t task_stack_size;   /*!< Stack size of the log task, in bytes */
+    BaseType_t task_core_id;    /*!< Core the log task is pinned to, or tskNO_AFFINITY */
+    bool binary;                /*!< Output records in the binary log format instead of text, see esp_log_async_init() */
+} esp_log_async_config_t;
+
+/**
+ * @brief Default configuration of the asynchronous log output
+ */
+#define ESP_LOG_ASYNC_CONFIG_DEFAULT() { \
+    .buffer_size = 4096, \
+    .task_priority = 1, \
+    .task_stack_size = 3072, \
+    .task_core_id = tskNO_AFFINITY, \
+    .binary = false, \
+}
+
+/**
+ * @brief Statistics of the asynchronous log output
+ */
+typedef struct {
+    uint32_t dropped[ESP_LOG_VERBOSE + 1];  /*!< Records dropped because the ring buffer was full, indexed by esp_log_level_t */
+    uint32_t preformatted;                  /*!< Records formatted by the caller, see esp_log_async_init() */
+    uint32_t truncated;                     /*!< Preformatted records cut to the largest item the ring buffer can hold */
+} esp_log_async_stats_t;
+
+/**
+ * @brief Output log records from a low priority task
+ *
+ * Installs a function with esp_log_set_vprintf() which stores the format string and the arguments of
+ * each log record in a ring buffer, without formatting them. A task with the configured priority
+ * formats the records and passes them to the function which was set with esp_log_set_vprintf()
+ * before this call, so the task calling ESP_LOGx does not wait for the output.
+ *
+ * String arguments are copied into the record, up to their precision, unless they are in flash, so
+ * they may change after ESP_LOGx returns. Records with a format string outside flash, with
+ * conversions other than those of integers, pointers, strings and doubles (such as %n or %Lf), or
+ * too large for the ring buffer, are formatted by the caller instead.
+ *
+ * Records are never waited for. When the ring buffer fills up, records below Warning level are
+ * dropped once less than a quarter of the buffer is free and warnings once less than an eighth is
+ * free, so the remaining space is kept for errors. The number of dropped records is counted per
+ * level and reported by the log task.
+ *
+ * If config->binary is set, the log task does not format the records. It outputs lines which start
+ * with the byte 0x1E and hold base64 encoded records: the offset of the format string in flash,
+ * followed by the arguments, with integers as variable length numbers. idf_monitor decodes these
+ * lines using the ELF file of the application.
+ *
+ * @param config Configuration, initialize with ESP_LOG_ASYNC_CONFIG_DEFAULT()
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the asynchronous log output is already in use
+ *      - ESP_ERR_NO_MEM if the ring buffer or the task could not be created
+ */
+esp_err_t esp_log_async_init(const esp_log_async_config_t *config);
+
+/**
+ * @brief Stop the asynchronous log output
+ *
+ * Outputs all buffered records, deletes the log task and the ring buffer, and restores the
+ * function which was used for output before esp_log_async_init().
+ *
+ * @note No other task may be logging while this function runs.
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the asynchronous log output is not in use, or when called from the log task
+ */
+esp_err_t esp_log_async_deinit(void);
+
+/**
+ * @brief Wait until all records logged before this call have been output
+ *
+ * @param ticks_to_wait Ticks to wait for space in the ring buffer and for the output
+ *
+ * @return
+ *      - ESP_OK if the records have been output
+ *      - ESP_ERR_TIMEOUT if they have not been output in time
+ *      - ESP_ERR_INVALID_STATE if the asynchronous log output is not in use, or when called from the log task
+ */
+esp_err_t esp_log_async_flush(TickType_t ticks_to_wait);
+
+/**
+ * @brief Output buffered records from the panic handler
+ *
+ * Formats the records which the log task has not taken yet and writes them with ets_printf(),
+ * without blocking or using the output function. Called by the panic handler if
+ * CONFIG_LOG_ASYNC_PANIC_FLUSH is enabled. Does nothing if the asynchronous log output is not in use.
+ */
+void esp_log_async_panic_flush(void);
+
+/**
+ * @brief Get statistics of the asynchronous log output
+ *
+ * @param[out] stats Counters since esp_log_async_init()
+ */
+void esp_log_async_get_stats(esp_log_async_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ESP_LOG_ASYNC_H__ */
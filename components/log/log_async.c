@@ -0,0 +1,940 @@
+// Copyright 2019 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Asynchronous log output implementation notes.
+ *
+ * esp_log_async_init() installs log_async_vprintf() with esp_log_set_vprintf().
+ * Each log record becomes one item of a no-split ring buffer: a log_record_t
+ * header with the format string pointer, followed by the arguments as they
+ * were passed (ints, longs, doubles, pointers) and copies of the strings
+ * which are not in flash. The format string is not parsed by the caller
+ * beyond finding the type of each argument, so logging costs about as much
+ * as copying the arguments. The item is reserved with xRingbufferSendAcquire()
+ * and written in place, records from several tasks keep the order in which
+ * they were reserved.
+ *
+ * The log task takes records with xRingbufferReceiveItems() and formats them
+ * one conversion at a time with snprintf() into a line buffer, which is
+ * passed to the previous output function. A va_list can not be rebuilt from
+ * the stored arguments, so each conversion specification is formatted on its
+ * own, with '*' widths and precisions replaced by their values.
+ *
+ * esp_log_async_flush() sends a flush record with a sequence number and waits
+ * until the log task has reached it, so it waits only for the records which
+ * were logged before it.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
+#include "soc/soc.h"
+#include "soc/soc_memory_layout.h"
+#include "rom/ets_sys.h"
+
+#include "esp_log.h"
+#include "esp_log_async.h"
+
+// Maximum number of records the log task takes from the ring buffer at once
+#define RECORDS_PER_BATCH 8
+
+// Size of the buffer a line is formatted into before it is passed to the output function
+#define LINE_SIZE 128
+
+// Binary log lines start with this, followed by base64 encoded records
+#define BINARY_LINE_START "\x1e"
+
+// Length after which a binary log line is ended
+#define BINARY_LINE_LEN 256
+
+// Maximum length of a conversion specification, records with longer ones are formatted by the caller
+#define MAX_SPEC_LEN 16
+
+// Size of a conversion specification with the values of two '*' filled in
+#define MAX_SPEC_SIZE (MAX_SPEC_LEN + 2 * 11 + 1)
+
+static const char *TAG = "log_async";
+
+typedef enum {
+    RECORD_FORMAT,  // format string and arguments
+    RECORD_TEXT,    // text formatted by the caller
+    RECORD_FLUSH,   // sequence number of a flush
+    RECORD_STOP,    // sequence number of a flush, the log task exits after it
+} record_kind_t;
+
+typedef struct {
+    const char *format;
+    uint8_t kind;       // record_kind_t as uint8_t
+    uint8_t level;      // esp_log_level_t as uint8_t
+} log_record_t;
+
+typedef enum {
+    ARG_NONE,           // "%%"
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_PTR,
+    ARG_DOUBLE,
+    ARG_STR,
+    ARG_UNSUPPORTED,
+} arg_type_t;
+
+// Strings are stored as one of these, followed by the string or by the pointer
+typedef enum {
+    STR_INLINE,
+    STR_FLASH,
+    STR_NULL,
+} str_kind_t;
+
+typedef struct {
+    arg_type_t type;
+    bool width_arg;     // width is '*'
+    bool precision_arg; // precision is '*'
+    int precision;      // precision given in the format, -1 if none
+} conversion_t;
+
+typedef struct {
+    char buf[LINE_SIZE];
+    size_t len;
+    vprintf_like_t out;
+    bool binary;            // a binary log line has been started
+    size_t binary_len;      // characters of the binary log line
+    uint8_t raw[3];         // bytes waiting to be encoded
+    uint8_t raw_len;
+} line_t;
+
+static RingbufHandle_t s_ringbuf;
+static size_t s_buffer_size;
+static TaskHandle_t s_task;
+static vprintf_like_t s_output_func;
+static bool s_binary;
+static SemaphoreHandle_t s_flush_mutex;     // one flush at a time
+static SemaphoreHandle_t s_flush_sem;       // given by the log task after each flush record
+static uint32_t s_flush_seq;                // protected by s_flush_mutex
+static volatile uint32_t s_flushed_seq;     // written by the log task
+static line_t s_line;                       // used by the log task only
+static esp_log_async_stats_t s_stats;
+static uint32_t s_reported_drops;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int call_vprintf(vprintf_like_t func, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int ret = (*func)(format, args);
+    va_end(args);
+    return ret;
+}
+
+static esp_log_level_t level_from_format(const char *format)
+{
+    // ESP_LOGx formats start with the level letter, after the color code if LOG_COLORS is enabled
+    if (format[0] == '\033') {
+        format = strchr(format, 'm');
+        if (format == NULL) {
+            return ESP_LOG_INFO;
+        }
+        format++;
+    }
+    if (format[0] == '\0' || format[1] != ' ') {
+        return ESP_LOG_INFO;
+    }
+    switch (format[0]) {
+    case 'E':
+        return ESP_LOG_ERROR;
+    case 'W':
+        return ESP_LOG_WARN;
+    case 'D':
+        return ESP_LOG_DEBUG;
+    case 'V':
+        return ESP_LOG_VERBOSE;
+    default:
+        return ESP_LOG_INFO;
+    }
+}
+
+// Space which has to stay free after storing a record of the given level
+static size_t reserved_space(esp_log_level_t level)
+{
+    if (level == ESP_LOG_ERROR) {
+        return 0;
+    }
+    if (level == ESP_LOG_WARN) {
+        return s_buffer_size / 8;
+    }
+    return s_buffer_size / 4;
+}
+
+// Parse the conversion specification after a '%', return a pointer past it
+static const char *parse_conversion(const char *p, conversion_t *conv)
+{
+    conv->type = ARG_UNSUPPORTED;
+    conv->width_arg = false;
+    conv->precision_arg = false;
+    conv->precision = -1;
+    while (*p != '\0' && strchr("-+ #0", *p) != NULL) {
+        p++;
+    }
+    if (*p == '*') {
+        conv->width_arg = true;
+        p++;
+    }
+    while (*p >= '0' && *p <= '9') {
+        p++;
+    }
+    if (*p == '.') {
+        p++;
+        conv->precision = 0;
+        if (*p == '*') {
+            conv->precision_arg = true;
+            p++;
+        }
+        while (*p >= '0' && *p <= '9') {
+            if (conv->precision < 100000000) {
+                conv->precision = conv->precision * 10 + (*p - '0');
+            }
+            p++;
+        }
+    }
+    int longs = 0;
+    bool size = false;
+    bool other_length = false;
+    for (; *p != '\0' && strchr("hlqzjtL", *p) != NULL; p++) {
+        if (*p == 'l') {
+            longs++;
+        } else if (*p == 'q') {
+            longs = 2;
+        } else if (*p == 'z') {
+            size = true;
+        } else if (*p != 'h') {
+            other_length = true;
+        }
+    }
+    if (*p == '\0') {
+        return p;
+    }
+    char c = *p++;
+    if (other_length || longs > 2) {
+        return p;
+    }
+    if (strchr("diouxXc", c) != NULL) {
+        if (c == 'c' && (longs > 0 || size)) {
+            return p;
+        }
+        conv->type = size ? ARG_SIZE : (longs == 2) ? ARG_LLONG : (longs == 1) ? ARG_LONG : ARG_INT;
+    } else if (longs > 0 || size) {
+        // wide characters and strings, and %lf which is rare enough to be formatted by the caller
+    } else if (c == 's') {
+        conv->type = ARG_STR;
+    } else if (c == 'p') {
+        conv->type = ARG_PTR;
+    } else if (strchr("fFeEgGaA", c) != NULL) {
+        conv->type = ARG_DOUBLE;
+    } else if (c == '%') {
+        conv->type = ARG_NONE;
+    }
+    return p;
+}
+
+static inline size_t store(uint8_t *out, size_t capacity, size_t pos, const void *value, size_t size)
+{
+    if (out != NULL && pos + size <= capacity) {
+        memcpy(out + pos, value, size);
+    }
+    return pos + size;
+}
+
+/* Store the arguments of a record in 'out', or only add up their size if 'out' is NULL.
+   Returns the size, or -1 if the format has a conversion which is not supported. Nothing is
+   written past 'capacity', a string which has grown since its size was taken makes the size
+   exceed it. */
+static int capture_args(const char *format, va_list args, uint8_t *out, size_t capacity)
+{
+    size_t pos = 0;
+    const char *p = format;
+    const char *percent;
+    while ((percent = strchr(p, '%')) != NULL) {
+        conversion_t conv;
+        p = parse_conversion(percent + 1, &conv);
+        if (conv.type == ARG_UNSUPPORTED || p - percent > MAX_SPEC_LEN) {
+            return -1;
+        }
+        if (conv.width_arg) {
+            int width = va_arg(args, int);
+            pos = store(out, capacity, pos, &width, sizeof(width));
+        }
+        int precision = conv.precision;
+        if (conv.precision_arg) {
+            precision = va_arg(args, int);
+            pos = store(out, capacity, pos, &precision, sizeof(precision));
+        }
+        switch (conv.type) {
+        case ARG_INT: {
+            int value = va_arg(args, int);
+            pos = store(out, capacity, pos, &value, sizeof(value));
+            break;
+        }
+        case ARG_LONG: {
+            long value = va_arg(args, long);
+            pos = store(out, capacity, pos, &value, sizeof(value));
+            break;
+        }
+        case ARG_LLONG: {
+            long long value = va_arg(args, long long);
+            pos = store(out, capacity, pos, &value, sizeof(value));
+            break;
+        }
+        case ARG_SIZE: {
+            size_t value = va_arg(args, size_t);
+            pos = store(out, capacity, pos, &value, sizeof(value));
+            break;
+        }
+        case ARG_PTR: {
+            void *value = va_arg(args, void *);
+            pos = store(out, capacity, pos, &value, sizeof(value));
+            break;
+        }
+        case ARG_DOUBLE: {
+            double value = va_arg(args, double);
+            pos = store(out, capacity, pos, &value, sizeof(value));
+            break;
+        }
+        case ARG_STR: {
+            const char *value = va_arg(args, const char *);
+            uint8_t kind = (value == NULL) ? STR_NULL : esp_ptr_in_drom(value) ? STR_FLASH : STR_INLINE;
+            pos = store(out, capacity, pos, &kind, sizeof(kind));
+            if (kind == STR_FLASH) {
+                pos = store(out, capacity, pos, &value, sizeof(value));
+            } else if (kind == STR_INLINE) {
+                // with a precision, the string need not be terminated
+                size_t len = (precision >= 0) ? strnlen(value, precision) : strlen(value);
+                pos = store(out, capacity, pos, value, len);
+                pos = store(out, capacity, pos, "", 1);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    if (out != NULL && pos > capacity) {
+        return -1;
+    }
+    return pos;
+}
+
+static void count_stat(uint32_t *counter)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    (*counter)++;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+static int log_async_vprintf(const char *format, va_list args)
+{
+    esp_log_level_t level = level_from_format(format);
+    int args_size = -1;
+    va_list copy;
+    // A format string in RAM may be gone by the time the log task gets to it
+    if (esp_ptr_in_drom(format)) {
+        va_copy(copy, args);
+        args_size = capture_args(format, copy, NULL, 0);
+        va_end(copy);
+    }
+    size_t max_size = xRingbufferGetMaxItemSize(s_ringbuf);
+    if (args_size >= 0 && sizeof(log_record_t) + args_size > max_size) {
+        // Too large for the ring buffer with long strings, formatted and truncated by the caller
+        args_size = -1;
+    }
+    size_t size;
+    bool truncated = false;
+    if (args_size >= 0) {
+        size = sizeof(log_record_t) + args_size;
+    } else {
+        va_copy(copy, args);
+        int len = vsnprintf(NULL, 0, format, copy);
+        va_end(copy);
+        if (len < 0) {
+            return len;
+        }
+        size = sizeof(log_record_t) + len + 1;
+        if (size > max_size) {
+            size = max_size;
+            truncated = true;
+        }
+    }
+
+    void *item;
+    if (xRingbufferGetCurFreeSize(s_ringbuf) < size + reserved_space(level) ||
+            xRingbufferSendAcquire(s_ringbuf, &item, size, 0) != pdTRUE) {
+        count_stat(&s_stats.dropped[level]);
+        return 0;
+    }
+    log_record_t *record = (log_record_t *) item;
+    uint8_t *data = (uint8_t *) (record + 1);
+    record->level = level;
+    record->format = format;
+    record->kind = RECORD_FORMAT;
+    if (args_size >= 0) {
+        va_copy(copy, args);
+        if (capture_args(format, copy, data, size - sizeof(log_record_t)) < 0) {
+            // A string argument has grown, output what fits
+            record->kind = RECORD_TEXT;
+            truncated = true;
+        }
+        va_end(copy);
+    } else {
+        record->kind = RECORD_TEXT;
+    }
+    if (record->kind == RECORD_TEXT) {
+        vsnprintf((char *) data, size - sizeof(log_record_t), format, args);
+    }
+    xRingbufferSendComplete(s_ringbuf, item);
+
+    if (args_size < 0) {
+        count_stat(&s_stats.preformatted);
+    }
+    if (truncated) {
+        count_stat(&s_stats.truncated);
+    }
+    return 0;
+}
+
+static void line_flush(line_t *line)
+{
+    if (line->len > 0) {
+        call_vprintf(line->out, "%s", line->buf);
+        line->len = 0;
+    }
+}
+
+static void line_append(line_t *line, const char *text, size_t len)
+{
+    while (len > 0) {
+        size_t n = LINE_SIZE - 1 - line->len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(line->buf + line->len, text, n);
+        line->len += n;
+        line->buf[line->len] = '\0';
+        text += n;
+        len -= n;
+        if (line->len == LINE_SIZE - 1) {
+            line_flush(line);
+        }
+    }
+}
+
+#define FORMAT_VALUE(type) do { \
+        type v; \
+        memcpy(&v, value, sizeof(v)); \
+        return direct ? call_vprintf(line->out, spec, v) : snprintf(buf, size, spec, v); \
+    } while (0)
+
+/* Format one conversion into the rest of the line buffer, or pass it to the output function
+   if 'direct' is set. Returns the length of the output, like snprintf. */
+static int format_value(line_t *line, const char *spec, arg_type_t type, const void *value, bool direct)
+{
+    char *buf = line->buf + line->len;
+    size_t size = LINE_SIZE - line->len;
+    switch (type) {
+    case ARG_INT:
+        FORMAT_VALUE(int);
+    case ARG_LONG:
+        FORMAT_VALUE(long);
+    case ARG_LLONG:
+        FORMAT_VALUE(long long);
+    case ARG_SIZE:
+        FORMAT_VALUE(size_t);
+    case ARG_PTR:
+        FORMAT_VALUE(void *);
+    case ARG_DOUBLE:
+        FORMAT_VALUE(double);
+    case ARG_STR:
+        // 'value' is the string itself
+        return direct ? call_vprintf(line->out, spec, value) : snprintf(buf, size, spec, (const char *) value);
+    default:
+        return 0;
+    }
+}
+
+static void line_append_value(line_t *line, const char *spec, arg_type_t type, const void *value)
+{
+    int len = format_value(line, spec, type, value, false);
+    if (len >= 0 && (size_t) len < LINE_SIZE - line->len) {
+        line->len += len;
+        return;
+    }
+    line->buf[line->len] = '\0';
+    line_flush(line);
+    if (len >= 0 && len < LINE_SIZE) {
+        line->len = format_value(line, spec, type, value, false);
+    } else {
+        format_value(line, spec, type, value, true);
+    }
+}
+
+typedef struct {
+    conversion_t conv;
+    int width;              // value of a '*' width
+    int precision;          // value of a '*' precision
+    uint8_t str_kind;       // str_kind_t of a string
+    const void *value;      // the stored value, or the string itself
+} stored_arg_t;
+
+static inline const uint8_t *load_int(const uint8_t *data, int *value)
+{
+    memcpy(value, data, sizeof(*value));
+    return data + sizeof(*value);
+}
+
+// Load the arguments of the conversion starting at 'percent' from the data of a record
+static const char *load_arg(const char *percent, const uint8_t **data, stored_arg_t *arg)
+{
+    const char *p = parse_conversion(percent + 1, &arg->conv);
+    const uint8_t *d = *data;
+    if (arg->conv.width_arg) {
+        d = load_int(d, &arg->width);
+    }
+    if (arg->conv.precision_arg) {
+        d = load_int(d, &arg->precision);
+    }
+    arg->value = d;
+    switch (arg->conv.type) {
+    case ARG_INT:
+        d += sizeof(int);
+        break;
+    case ARG_LONG:
+        d += sizeof(long);
+        break;
+    case ARG_LLONG:
+        d += sizeof(long long);
+        break;
+    case ARG_SIZE:
+        d += sizeof(size_t);
+        break;
+    case ARG_PTR:
+        d += sizeof(void *);
+        break;
+    case ARG_DOUBLE:
+        d += sizeof(double);
+        break;
+    case ARG_STR:
+        arg->str_kind = *d++;
+        if (arg->str_kind == STR_INLINE) {
+            arg->value = d;
+            d += strlen((const char *) d) + 1;
+        } else if (arg->str_kind == STR_FLASH) {
+            memcpy(&arg->value, d, sizeof(arg->value));
+            d += sizeof(arg->value);
+        } else {
+            arg->value = NULL;
+        }
+        break;
+    default:
+        break;
+    }
+    *data = d;
+    return p;
+}
+
+// Format a record stored by log_async_vprintf() and pass it to the output function of 'line'
+static void output_record(line_t *line, const log_record_t *record, size_t size)
+{
+    const uint8_t *data = (const uint8_t *) (record + 1);
+    if (record->kind == RECORD_TEXT) {
+        line_append(line, (const char *) data, strnlen((const char *) data, size - sizeof(log_record_t)));
+        line_flush(line);
+        return;
+    }
+    if (record->kind != RECORD_FORMAT) {
+        return;
+    }
+    const char *p = record->format;
+    const char *percent;
+    while ((percent = strchr(p, '%')) != NULL) {
+        line_append(line, p, percent - p);
+        stored_arg_t arg;
+        p = load_arg(percent, &data, &arg);
+        if (arg.conv.type == ARG_NONE) {
+            line_append(line, "%", 1);
+            continue;
+        }
+
+        // Copy the specification, with the values of '*' width and precision
+        char spec[MAX_SPEC_SIZE];
+        size_t len = 0;
+        bool precision = false;
+        for (const char *s = percent; s < p; s++) {
+            if (*s == '.') {
+                precision = true;
+            }
+            if (*s != '*') {
+                spec[len++] = *s;
+            } else if (!precision) {
+                len += sprintf(spec + len, "%d", arg.width);
+            } else if (arg.precision >= 0) {
+                len += sprintf(spec + len, "%d", arg.precision);
+            } else {
+                len--;      // a negative precision is taken as if it was omitted
+            }
+        }
+        spec[len] = '\0';
+        line_append_value(line, spec, arg.conv.type, arg.value);
+    }
+    line_append(line, p, strlen(p));
+    line_flush(line);
+}
+
+static const char s_base64_digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void binary_put(line_t *line, const void *data, size_t len)
+{
+    const char *digits = s_base64_digits;
+    const uint8_t *bytes = (const uint8_t *) data;
+    for (size_t i = 0; i < len; i++) {
+        line->raw[line->raw_len++] = bytes[i];
+        if (line->raw_len == 3) {
+            uint32_t n = (line->raw[0] << 16) | (line->raw[1] << 8) | line->raw[2];
+            char text[4] = { digits[n >> 18], digits[(n >> 12) & 0x3f], digits[(n >> 6) & 0x3f], digits[n & 0x3f] };
+            line_append(line, text, sizeof(text));
+            line->raw_len = 0;
+            line->binary_len += sizeof(text);
+        }
+    }
+}
+
+static void binary_put_varint(line_t *line, uint64_t value)
+{
+    uint8_t bytes[10];
+    size_t len = 0;
+    do {
+        bytes[len] = value & 0x7f;
+        value >>= 7;
+        if (value != 0) {
+            bytes[len] |= 0x80;
+        }
+        len++;
+    } while (value != 0);
+    binary_put(line, bytes, len);
+}
+
+static void binary_put_signed(line_t *line, int64_t value)
+{
+    // zigzag encoding, small negative numbers take as few bytes as small positive ones
+    binary_put_varint(line, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+}
+
+static void binary_end_line(line_t *line)
+{
+    if (!line->binary) {
+        return;
+    }
+    if (line->raw_len > 0) {
+        const char *digits = s_base64_digits;
+        uint32_t n = (line->raw[0] << 16) | ((line->raw_len > 1) ? (line->raw[1] << 8) : 0);
+        char text[4] = { digits[n >> 18], digits[(n >> 12) & 0x3f],
+                         (line->raw_len > 1) ? digits[(n >> 6) & 0x3f] : '=', '=' };
+        line_append(line, text, sizeof(text));
+        line->raw_len = 0;
+    }
+    line_append(line, "\n", 1);
+    line_flush(line);
+    line->binary = false;
+}
+
+/* Encode a record stored by log_async_vprintf() into a binary log line, see esp_log_async_init().
+   The line is ended at the end of a batch of records, or when it gets long. */
+static void encode_record(line_t *line, const log_record_t *record, size_t size)
+{
+    const uint8_t *data = (const uint8_t *) (record + 1);
+    if (record->kind != RECORD_FORMAT && record->kind != RECORD_TEXT) {
+        return;
+    }
+    if (!line->binary) {
+        line_append(line, BINARY_LINE_START, strlen(BINARY_LINE_START));
+        line->binary = true;
+        line->binary_len = 0;
+    }
+    if (record->kind == RECORD_TEXT) {
+        size_t len = strnlen((const char *) data, size - sizeof(log_record_t));
+        binary_put_varint(line, 0);
+        binary_put_varint(line, len);
+        binary_put(line, data, len);
+    } else {
+        // format strings are identified by their offset in flash, 0 is for text
+        binary_put_varint(line, (uintptr_t) record->format - SOC_DROM_LOW + 1);
+        const char *p = record->format;
+        const char *percent;
+        while ((percent = strchr(p, '%')) != NULL) {
+            stored_arg_t arg;
+            p = load_arg(percent, &data, &arg);
+            if (arg.conv.width_arg) {
+                binary_put_signed(line, arg.width);
+            }
+            if (arg.conv.precision_arg) {
+                binary_put_signed(line, arg.precision);
+            }
+            switch (arg.conv.type) {
+            case ARG_INT: {
+                int v;
+                memcpy(&v, arg.value, sizeof(v));
+                binary_put_signed(line, v);
+                break;
+            }
+            case ARG_LONG: {
+                long v;
+                memcpy(&v, arg.value, sizeof(v));
+                binary_put_signed(line, v);
+                break;
+            }
+            case ARG_LLONG: {
+                long long v;
+                memcpy(&v, arg.value, sizeof(v));
+                binary_put_signed(line, v);
+                break;
+            }
+            case ARG_SIZE: {
+                size_t v;
+                memcpy(&v, arg.value, sizeof(v));
+                binary_put_varint(line, v);
+                break;
+            }
+            case ARG_PTR: {
+                uintptr_t v;
+                memcpy(&v, arg.value, sizeof(v));
+                binary_put_varint(line, v);
+                break;
+            }
+            case ARG_DOUBLE:
+                binary_put(line, arg.value, sizeof(double));
+                break;
+            case ARG_STR:
+                binary_put(line, &arg.str_kind, sizeof(arg.str_kind));
+                if (arg.str_kind == STR_INLINE) {
+                    size_t len = strlen((const char *) arg.value);
+                    binary_put_varint(line, len);
+                    binary_put(line, arg.value, len);
+                } else if (arg.str_kind == STR_FLASH) {
+                    binary_put_varint(line, (uintptr_t) arg.value - SOC_DROM_LOW);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    if (line->binary_len >= BINARY_LINE_LEN) {
+        binary_end_line(line);
+    }
+}
+
+static void report_drops(line_t *line)
+{
+    uint32_t dropped = 0;
+    portENTER_CRITICAL(&s_stats_lock);
+    for (int level = 0; level <= ESP_LOG_VERBOSE; level++) {
+        dropped += s_stats.dropped[level];
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+    if (dropped != s_reported_drops) {
+        call_vprintf(line->out, LOG_FORMAT(W, "%u log records dropped"),
+                     esp_log_timestamp(), TAG, dropped - s_reported_drops);
+        s_reported_drops = dropped;
+    }
+}
+
+static void log_async_task(void *arg)
+{
+    void *records[RECORDS_PER_BATCH];
+    size_t sizes[RECORDS_PER_BATCH];
+    s_line.out = s_output_func;
+    while (true) {
+        UBaseType_t count = xRingbufferReceiveItems(s_ringbuf, records, sizes, RECORDS_PER_BATCH, portMAX_DELAY);
+        report_drops(&s_line);
+        bool stop = false;
+        uint32_t seq = 0;
+        for (UBaseType_t i = 0; i < count; i++) {
+            const log_record_t *record = (const log_record_t *) records[i];
+            if (record->kind == RECORD_FLUSH) {
+                binary_end_line(&s_line);
+                memcpy(&seq, record + 1, sizeof(seq));
+                s_flushed_seq = seq;
+                xSemaphoreGive(s_flush_sem);
+            } else if (record->kind == RECORD_STOP) {
+                memcpy(&seq, record + 1, sizeof(seq));
+                stop = true;
+            } else if (s_binary) {
+                encode_record(&s_line, record, sizes[i]);
+            } else {
+                output_record(&s_line, record, sizes[i]);
+            }
+        }
+        binary_end_line(&s_line);
+        vRingbufferReturnItems(s_ringbuf, records, count);
+        if (stop) {
+            // Nothing is logged after the stop record, esp_log_async_deinit() deletes the ring buffer
+            s_flushed_seq = seq;
+            xSemaphoreGive(s_flush_sem);
+            vTaskDelete(NULL);
+        }
+    }
+}
+
+static TickType_t ticks_left(TickType_t start, TickType_t ticks_to_wait)
+{
+    if (ticks_to_wait == portMAX_DELAY) {
+        return portMAX_DELAY;
+    }
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    return (elapsed < ticks_to_wait) ? ticks_to_wait - elapsed : 0;
+}
+
+// Send a flush or stop record and wait until the log task has reached it
+static esp_err_t send_flush_record(record_kind_t kind, TickType_t ticks_to_wait)
+{
+    TickType_t start = xTaskGetTickCount();
+    if (xSemaphoreTake(s_flush_mutex, ticks_to_wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    struct {
+        log_record_t header;
+        uint32_t seq;
+    } record = {
+        .header = { .format = NULL, .kind = kind, .level = ESP_LOG_NONE },
+        .seq = ++s_flush_seq,
+    };
+    esp_err_t err = ESP_OK;
+    if (xRingbufferSend(s_ringbuf, &record, sizeof(record), ticks_left(start, ticks_to_wait)) != pdTRUE) {
+        err = ESP_ERR_TIMEOUT;
+    }
+    // Gives of flushes which have timed out may be left over, wait for this one
+    while (err == ESP_OK && (int32_t) (s_flushed_seq - record.seq) < 0) {
+        if (xSemaphoreTake(s_flush_sem, ticks_left(start, ticks_to_wait)) != pdTRUE) {
+            err = ESP_ERR_TIMEOUT;
+        }
+    }
+    xSemaphoreGive(s_flush_mutex);
+    return err;
+}
+
+static void free_resources(void)
+{
+    if (s_ringbuf != NULL) {
+        vRingbufferDelete(s_ringbuf);
+        s_ringbuf = NULL;
+    }
+    if (s_flush_mutex != NULL) {
+        vSemaphoreDelete(s_flush_mutex);
+        s_flush_mutex = NULL;
+    }
+    if (s_flush_sem != NULL) {
+        vSemaphoreDelete(s_flush_sem);
+        s_flush_sem = NULL;
+    }
+    s_task = NULL;
+}
+
+esp_err_t esp_log_async_init(const esp_log_async_config_t *config)
+{
+    if (s_ringbuf != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_ringbuf = xRingbufferCreate(config->buffer_size, RINGBUF_TYPE_NOSPLIT);
+    s_flush_mutex = xSemaphoreCreateMutex();
+    s_flush_sem = xSemaphoreCreateBinary();
+    if (s_ringbuf == NULL || s_flush_mutex == NULL || s_flush_sem == NULL) {
+        free_resources();
+        return ESP_ERR_NO_MEM;
+    }
+    s_buffer_size = config->buffer_size;
+    s_binary = config->binary;
+    s_flush_seq = 0;
+    s_flushed_seq = 0;
+    s_reported_drops = 0;
+    memset(&s_stats, 0, sizeof(s_stats));
+
+    // Records are buffered until the task starts, it outputs them with the previous function
+    s_output_func = esp_log_set_vprintf(&log_async_vprintf);
+    if (xTaskCreatePinnedToCore(&log_async_task, "log_async", config->task_stack_size, NULL,
+                                config->task_priority, &s_task, config->task_core_id) != pdPASS) {
+        esp_log_set_vprintf(s_output_func);
+        free_resources();
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_log_async_deinit(void)
+{
+    if (s_ringbuf == NULL || xTaskGetCurrentTaskHandle() == s_task) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_log_set_vprintf(s_output_func);
+    esp_err_t err = send_flush_record(RECORD_STOP, portMAX_DELAY);
+    if (err != ESP_OK) {
+        return err;
+    }
+    free_resources();
+    return ESP_OK;
+}
+
+esp_err_t esp_log_async_flush(TickType_t ticks_to_wait)
+{
+    if (s_ringbuf == NULL || xTaskGetCurrentTaskHandle() == s_task) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return send_flush_record(RECORD_FLUSH, ticks_to_wait);
+}
+
+static int panic_vprintf(const char *format, va_list args)
+{
+    static char buf[LINE_SIZE];
+    int ret = vsnprintf(buf, sizeof(buf), format, args);
+    ets_printf("%s", buf);
+    return ret;
+}
+
+void esp_log_async_panic_flush(void)
+{
+    if (s_ringbuf == NULL) {
+        return;
+    }
+    ets_printf("Buffered log records:\n");
+    static line_t line;
+    line.len = 0;
+    line.binary = false;
+    line.out = &panic_vprintf;
+    void *record;
+    size_t size;
+    while ((record = xRingbufferReceiveFromISR(s_ringbuf, &size)) != NULL) {
+        output_record(&line, (const log_record_t *) record, size);
+        vRingbufferReturnItemFromISR(s_ringbuf, record, NULL);
+    }
+}
+
+void esp_log_async_get_stats(esp_log_async_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_log_async.h"
+#include "unity.h"
+
+static const char *TAG = "test_log_async";
+
+static char s_output[2048];
+static size_t s_output_len;
+static SemaphoreHandle_t s_output_gate;    // taken by the test to block the output
+
+static int capture_vprintf(const char *format, va_list args)
+{
+    if (s_output_gate != NULL) {
+        xSemaphoreTake(s_output_gate, portMAX_DELAY);
+        xSemaphoreGive(s_output_gate);
+    }
+    int len = vsnprintf(s_output + s_output_len, sizeof(s_output) - s_output_len, format, args);
+    if (len > 0) {
+        s_output_len += len;
+        if (s_output_len >= sizeof(s_output)) {
+            s_output_len = sizeof(s_output) - 1;
+        }
+    }
+    return len;
+}
+
+static vprintf_like_t start_capture(bool binary)
+{
+    s_output_len = 0;
+    s_output[0] = '\0';
+    vprintf_like_t orig_func = esp_log_set_vprintf(&capture_vprintf);
+    esp_log_async_config_t config = ESP_LOG_ASYNC_CONFIG_DEFAULT();
+    config.binary = binary;
+    TEST_ESP_OK(esp_log_async_init(&config));
+    return orig_func;
+}
+
+static void stop_capture(vprintf_like_t orig_func)
+{
+    TEST_ESP_OK(esp_log_async_deinit());
+    esp_log_set_vprintf(orig_func);
+}
+
+TEST_CASE("async log output is the same as synchronous output", "[log]")
+{
+    char buf[16];
+    strcpy(buf, "in RAM");
+
+    vprintf_like_t orig_func = start_capture(false);
+    ESP_LOGI(TAG, "%d %5u %-4x| %08lx %lld %c %%", -5, 17u, 0xab, 0x1234L, -1234567890123LL, 'Z');
+    ESP_LOGW(TAG, "[%10s] [%-8.3s] [%*d] [%.*s] %.3f", buf, buf, 6, 42, 2, "abc", 3.14159);
+    // the string was copied when it was logged
+    strcpy(buf, "changed");
+    TEST_ESP_OK(esp_log_async_flush(portMAX_DELAY));
+    stop_capture(orig_func);
+
+    TEST_ASSERT_NOT_NULL(strstr(s_output, "-5    17 ab  | 00001234 -1234567890123 Z %"));
+    TEST_ASSERT_NOT_NULL(strstr(s_output, "[    in RAM] [in      ] [    42] [ab] 3.142"));
+}
+
+TEST_CASE("async log output drops lower levels first when full", "[log]")
+{
+    s_output_gate = xSemaphoreCreateMutex();
+    TEST_ASSERT_NOT_NULL(s_output_gate);
+    xSemaphoreTake(s_output_gate, portMAX_DELAY);
+    vprintf_like_t orig_func = start_capture(false);
+
+    // the log task blocks on the first record, the others stay in the ring buffer
+    for (int i = 0; i < 200; i++) {
+        ESP_LOGI(TAG, "filling the buffer %d", i);
+    }
+    ESP_LOGW(TAG, "warning");
+    ESP_LOGE(TAG, "error");
+    esp_log_async_stats_t stats;
+    esp_log_async_get_stats(&stats);
+    TEST_ASSERT_NOT_EQUAL(0, stats.dropped[ESP_LOG_INFO]);
+    TEST_ASSERT_EQUAL(0, stats.dropped[ESP_LOG_WARN]);
+    TEST_ASSERT_EQUAL(0, stats.dropped[ESP_LOG_ERROR]);
+    TEST_ASSERT_EQUAL(ESP_ERR_TIMEOUT, esp_log_async_flush(10 / portTICK_PERIOD_MS));
+
+    xSemaphoreGive(s_output_gate);
+    TEST_ESP_OK(esp_log_async_flush(portMAX_DELAY));
+    stop_capture(orig_func);
+    vSemaphoreDelete(s_output_gate);
+    s_output_gate = NULL;
+}
+
+TEST_CASE("async log output formats records from RAM in the caller", "[log]")
+{
+    char format[] = LOG_FORMAT(I, "format in RAM %d");
+    vprintf_like_t orig_func = start_capture(false);
+    esp_log_write(ESP_LOG_INFO, TAG, format, esp_log_timestamp(), TAG, 7);
+    format[0] = 'X';
+    TEST_ESP_OK(esp_log_async_flush(portMAX_DELAY));
+    esp_log_async_stats_t stats;
+    esp_log_async_get_stats(&stats);
+    stop_capture(orig_func);
+
+    TEST_ASSERT_EQUAL(1, stats.preformatted);
+    TEST_ASSERT_NOT_NULL(strstr(s_output, "format in RAM 7"));
+}
+
+TEST_CASE("async log output copies strings up to their precision", "[log]")
+{
+    // not terminated, only the part given by the precision may be read
+    char *buf = malloc(8);
+    TEST_ASSERT_NOT_NULL(buf);
+    memcpy(buf, "abcdefgh", 8);
+    const size_t long_len = 3000;
+    char *long_str = malloc(long_len + 1);
+    TEST_ASSERT_NOT_NULL(long_str);
+    memset(long_str, 'x', long_len);
+    long_str[long_len] = '\0';
+
+    vprintf_like_t orig_func = start_capture(false);
+    ESP_LOGI(TAG, "[%.*s] [%.3s]", 5, buf, buf);
+    // larger than the largest record the ring buffer can hold
+    ESP_LOGE(TAG, "long %s", long_str);
+    TEST_ESP_OK(esp_log_async_flush(portMAX_DELAY));
+    esp_log_async_stats_t stats;
+    esp_log_async_get_stats(&stats);
+    stop_capture(orig_func);
+    free(buf);
+    free(long_str);
+
+    TEST_ASSERT_NOT_NULL(strstr(s_output, "[abcde] [abc]"));
+    TEST_ASSERT_NOT_NULL(strstr(s_output, "long xxxxxxxx"));
+    TEST_ASSERT_EQUAL(0, stats.dropped[ESP_LOG_ERROR]);
+    TEST_ASSERT_EQUAL(1, stats.truncated);
+}
+
+TEST_CASE("async log output in binary format is shorter than text", "[log]")
+{
+    vprintf_like_t orig_func = start_capture(false);
+    for (int i = 0; i < 10; i++) {
+        ESP_LOGI(TAG, "record %d of %s", i, "the binary log test");
+    }
+    TEST_ESP_OK(esp_log_async_flush(portMAX_DELAY));
+    stop_capture(orig_func);
+    size_t text_len = s_output_len;
+
+    orig_func = start_capture(true);
+    for (int i = 0; i < 10; i++) {
+        ESP_LOGI(TAG, "record %d of %s", i, "the binary log test");
+    }
+    TEST_ESP_OK(esp_log_async_flush(portMAX_DELAY));
+    stop_capture(orig_func);
+
+    // binary log lines start with 0x1E and only hold base64 characters, batches of records may take several lines
+    TEST_ASSERT_EQUAL('\x1e', s_output[0]);
+    TEST_ASSERT_EQUAL(s_output_len, strspn(s_output, "\x1e\nABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/="));
+    TEST_ASSERT_EQUAL('\n', s_output[s_output_len - 1]);
+    TEST_ASSERT_LESS_THAN(text_len / 2, s_output_len);
+}
+
+static const int CONTENTION_RECORDS = 40;
+
+static void log_error_task(void *arg)
+{
+    SemaphoreHandle_t done = (SemaphoreHandle_t) arg;
+    for (int i = 0; i < CONTENTION_RECORDS; i++) {
+        ESP_LOGE(TAG, "error %d from core %d", i, xPortGetCoreID());
+    }
+    xSemaphoreGive(done);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("async log output doesn't drop records of tasks logging at the same time", "[log]")
+{
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(2, 0);
+    TEST_ASSERT_NOT_NULL(done);
+    vprintf_like_t orig_func = start_capture(false);
+
+    // all the records fit in the ring buffer, none may be dropped while the other task is sending
+    for (int i = 0; i < 2; i++) {
+        xTaskCreatePinnedToCore(log_error_task, "log_error", 2048, done, uxTaskPriorityGet(NULL) + 1, NULL,
+                                i % portNUM_PROCESSORS);
+    }
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT(xSemaphoreTake(done, pdMS_TO_TICKS(5000)));
+    }
+    TEST_ESP_OK(esp_log_async_flush(portMAX_DELAY));
+    esp_log_async_stats_t stats;
+    esp_log_async_get_stats(&stats);
+    stop_capture(orig_func);
+    vSemaphoreDelete(done);
+
+    TEST_ASSERT_EQUAL(0, stats.dropped[ESP_LOG_ERROR]);
+}
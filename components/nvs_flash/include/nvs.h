@@ -351,6 +351,41 @@ esp_err_t nvs_erase_key(nvs_handle handle, const char* key);
  */
 esp_err_t nvs_erase_all(nvs_handle handle);
 
+/**
+ * @brief      Start a transaction on the handle
+ *
+ * Until nvs_commit() or nvs_transaction_abort() is called, the nvs_set_* functions
+ * only stage the new values in RAM. nvs_commit() then writes all of them, so that
+ * after a power loss either all or none of the staged values are in storage.
+ * Staged values which are equal to the stored ones are not written again.
+ *
+ * Staged values are not returned by the nvs_get_* functions before they are
+ * committed. nvs_erase_key() and nvs_erase_all() are not part of the transaction
+ * and take effect immediately.
+ *
+ * @param[in]  handle  Storage handle obtained with nvs_open.
+ *                     Handles that were opened read only cannot be used.
+ *
+ * @return
+ *             - ESP_OK if the transaction has been started
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_READ_ONLY if handle was opened as read only
+ *             - ESP_ERR_NVS_INVALID_STATE if a transaction is already open on this handle
+ */
+esp_err_t nvs_transaction_begin(nvs_handle handle);
+
+/**
+ * @brief      Discard the values staged since nvs_transaction_begin
+ *
+ * @param[in]  handle  Storage handle obtained with nvs_open.
+ *
+ * @return
+ *             - ESP_OK if the transaction has been discarded
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_INVALID_STATE if no transaction is open on this handle
+ */
+esp_err_t nvs_transaction_abort(nvs_handle handle);
+
 /**
  * @brief      Write any pending changes to non-volatile storage
  *
@@ -358,12 +393,20 @@ esp_err_t nvs_erase_all(nvs_handle handle);
  * to non-volatile storage. Individual implementations may write to storage at other times,
  * but this is not guaranteed.
  *
+ * If a transaction was started with nvs_transaction_begin(), the staged values are
+ * written all together and the transaction is closed, whether it succeeds or not.
+ *
  * @param[in]  handle  Storage handle obtained with nvs_open.
  *                     Handles that were opened read only cannot be used.
  *
  * @return
  *             - ESP_OK if the changes have been written successfully
  *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_NOT_ENOUGH_SPACE if there is not enough space for the
+ *               whole transaction; none of its values have been written
+ *             - ESP_ERR_NVS_REMOVE_FAILED if the transaction has been written, but
+ *               the old values couldn't be erased. This will be finished after
+ *               re-initialization of nvs, provided that flash operation doesn't fail again.
  *             - other error codes from the underlying storage driver
  */
 esp_err_t nvs_commit(nvs_handle handle);
@@ -464,6 +507,320 @@ esp_err_t nvs_get_stats(const char* part_name, nvs_stats_t* nvs_stats);
  */
 esp_err_t nvs_get_used_entry_count(nvs_handle handle, size_t* used_entries);
 
+/**
+ * @brief      Reclaim part of a page, so that writes don't have to
+ *
+ * Does nothing unless CONFIG_NVS_GC_FREE_PAGE_RESERVE is non-zero. When fewer free pages
+ * than that are left, each call copies up to max_entries entries from the page with the
+ * most erased entries onto the active page, or erases the page once it has been emptied.
+ * The sector erase is done in a call of its own, unless the last free page had to be used
+ * for copying the items.
+ *
+ * \code{c}
+ * // Example of a low priority task which keeps free pages available:
+ * void nvs_gc_task(void* arg)
+ * {
+ *     while (true) {
+ *         bool done = false;
+ *         while (!done && nvs_gc_step(NULL, 16, &done) == ESP_OK) {
+ *             taskYIELD();
+ *         }
+ *         vTaskDelay(100 / portTICK_PERIOD_MS);
+ *     }
+ * }
+ * \endcode
+ *
+ * @param[in]   part_name    Partition name NVS in the partition table.
+ *                           If pass a NULL than will use NVS_DEFAULT_PART_NAME ("nvs").
+ * @param[in]   max_entries  Maximum number of entries to copy in this step.
+ * @param[out]  done         If not NULL, set to true if enough free pages are available,
+ *                           or no page can be reclaimed.
+ *
+ * @return
+ *             - ESP_OK if the step has been done successfully.
+ *             - ESP_ERR_NVS_NOT_INITIALIZED if the storage driver is not initialized.
+ *             - Other error codes from the underlying storage driver.
+ */
+esp_err_t nvs_gc_step(const char* part_name, size_t max_entries, bool* done);
+
+/**
+ * @note Counters of the entry cache.
+ */
+typedef struct {
+    size_t hits;        /**< Number of entry reads served from RAM */
+    size_t misses;      /**< Number of entry reads which went to flash */
+} nvs_cache_stats_t;
+
+/**
+ * @brief      Get hit and miss counters of the entry cache
+ *
+ * The cache keeps recently read item entries of all partitions in RAM. Its size is
+ * set by CONFIG_NVS_ENTRY_CACHE_SIZE. When the cache is disabled, both counters are 0.
+ *
+ * @param[out]  cache_stats  Returns the counters.
+ *
+ * @return
+ *             - ESP_OK if cache_stats has been filled.
+ *             - ESP_ERR_INVALID_ARG if cache_stats is equal to NULL.
+ */
+esp_err_t nvs_get_cache_stats(nvs_cache_stats_t* cache_stats);
+
+/**
+ * @note Info about an entry returned by the iterator.
+ */
+typedef struct {
+    char namespace_name[16];    /**< Namespace to which the entry belongs */
+    char key[16];               /**< Key of the entry */
+    nvs_type_t type;            /**< Type of the entry */
+} nvs_entry_info_t;
+
+/**
+ * Opaque pointer type representing an iterator over NVS entries
+ */
+typedef struct nvs_opaque_iterator_t *nvs_iterator_t;
+
+/**
+ * @brief      Create an iterator over the entries of a partition
+ *
+ * Entries are returned in the order they are stored in flash, so listing all
+ * of them takes a single pass over the partition. Each blob is returned once,
+ * with type NVS_TYPE_BLOB.
+ *
+ * \code{c}
+ * // Example of listing all the key-value pairs of a namespace:
+ * nvs_iterator_t it = nvs_entry_find("nvs", "namespace1", NVS_TYPE_ANY);
+ * while (it != NULL) {
+ *     nvs_entry_info_t info;
+ *     nvs_entry_info(it, &info);
+ *     it = nvs_entry_next(it);
+ *     printf("key '%s', type '%d' \n", info.key, info.type);
+ * };
+ * // Note: no need to release the iterator obtained from nvs_entry_find,
+ * // as nvs_entry_next releases it once there are no more entries.
+ * \endcode
+ *
+ * Writes made while iterating may or may not be visible to the iterator.
+ *
+ * @param[in]   part_name       Partition name
+ * @param[in]   namespace_name  Set this value if looking for entries with
+ *                              a specific namespace. Pass NULL otherwise.
+ * @param[in]   type            One of nvs_type_t values.
+ *
+ * @return
+ *          Iterator used to enumerate all the entries found,
+ *          or NULL if no entry satisfying the criteria was found.
+ *          Iterator obtained through this function has to be released
+ *          using nvs_release_iterator when not used any more.
+ */
+nvs_iterator_t nvs_entry_find(const char *part_name, const char *namespace_name, nvs_type_t type);
+
+/**
+ * @brief      Advance the iterator to the next entry matching the criteria
+ *
+ * @param[in]   iterator  Iterator obtained from nvs_entry_find function.
+ *
+ * @return
+ *          NULL if no further entry matching the criteria was found, in which
+ *          case the iterator is released. Otherwise the same iterator.
+ */
+nvs_iterator_t nvs_entry_next(nvs_iterator_t iterator);
+
+/**
+ * @brief      Fill nvs_entry_info_t structure with information about the entry
+ *             the iterator points to
+ *
+ * @param[in]   iterator     Iterator obtained from nvs_entry_find or nvs_entry_next function.
+ *                           Must be non-NULL.
+ *
+ * @param[out]  out_info     Structure to which entry information is copied.
+ */
+void nvs_entry_info(nvs_iterator_t iterator, nvs_entry_info_t *out_info);
+
+/**
+ * @brief      Release the iterator
+ *
+ * @param[in]   iterator    Iterator obtained from nvs_entry_find or nvs_entry_next function.
+ *                          NULL is allowed.
+ */
+void nvs_release_iterator(nvs_iterator_t iterator);
+
+/**
+ * Opaque pointer type representing a blob opened for reading
+ */
+typedef struct nvs_opaque_blob_reader_t *nvs_blob_reader_t;
+
+/**
+ * @brief      Open a blob for reading it in parts
+ *
+ * Unlike nvs_get_blob, which needs a buffer for the whole value, a blob reader
+ * reads any range of the blob straight from flash into a buffer of the caller.
+ * Opening the blob locates each of its chunks once. The data is not checked
+ * against the CRC of the chunks, as it is by nvs_get_blob.
+ *
+ * \code{c}
+ * // Example of computing a digest over a large blob using a small buffer:
+ * nvs_blob_reader_t reader;
+ * size_t length;
+ * nvs_blob_open(my_handle, "cert_bundle", &reader, &length);
+ * uint8_t buf[256];
+ * for (size_t offset = 0; offset < length; offset += sizeof(buf)) {
+ *     size_t n = (length - offset < sizeof(buf)) ? length - offset : sizeof(buf);
+ *     nvs_blob_read(reader, offset, buf, n);
+ *     mbedtls_sha256_update(&ctx, buf, n);
+ * }
+ * nvs_blob_close(reader);
+ * \endcode
+ *
+ * @param[in]   handle      Handle obtained from nvs_open function.
+ * @param[in]   key         Key name. Maximal length is 15 characters. Shouldn't be empty.
+ * @param[out]  out_reader  Reader for the blob, to be closed using nvs_blob_close.
+ * @param[out]  out_length  If not NULL, set to the length of the blob in bytes.
+ *
+ * @return
+ *             - ESP_OK if the blob has been opened
+ *             - ESP_ERR_NVS_NOT_FOUND if the requested key doesn't exist
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_blob_open(nvs_handle handle, const char* key, nvs_blob_reader_t* out_reader, size_t* out_length);
+
+/**
+ * @brief      Read part of a blob
+ *
+ * If the blob has been written again or erased since it was opened,
+ * ESP_ERR_NVS_NOT_FOUND is returned.
+ *
+ * @param[in]   reader      Reader obtained from nvs_blob_open.
+ * @param[in]   offset      Offset within the blob of the first byte to read.
+ * @param[out]  out_value   Buffer of at least length bytes.
+ * @param[in]   length      Number of bytes to read.
+ *
+ * @return
+ *             - ESP_OK if the data has been read
+ *             - ESP_ERR_NVS_NOT_FOUND if the blob has been modified since it was opened
+ *             - ESP_ERR_NVS_INVALID_LENGTH if the range extends past the end of the blob
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_blob_read(nvs_blob_reader_t reader, size_t offset, void* out_value, size_t length);
+
+/**
+ * @brief      Get a pointer to the blob data in memory mapped flash
+ *
+ * Blobs are stored in chunks, one per page, so the data is contiguous only up
+ * to the end of the chunk holding the offset. Blobs which fit into a page are
+ * stored in a single chunk. The pointer stays valid until the next call of
+ * nvs_blob_mmap or nvs_blob_close for this reader, as long as nothing is written
+ * to the partition.
+ *
+ * @param[in]   reader      Reader obtained from nvs_blob_open.
+ * @param[in]   offset      Offset within the blob.
+ * @param[out]  out_ptr     Pointer to the byte at the given offset.
+ * @param[out]  out_length  Number of bytes which can be read from out_ptr.
+ *
+ * @return
+ *             - ESP_OK if the data has been mapped
+ *             - ESP_ERR_NOT_SUPPORTED if the partition is encrypted
+ *             - ESP_ERR_NVS_NOT_FOUND if the blob has been modified since it was opened
+ *             - ESP_ERR_NVS_INVALID_LENGTH if offset is not within the blob
+ *             - other error codes from spi_flash_mmap
+ */
+esp_err_t nvs_blob_mmap(nvs_blob_reader_t reader, size_t offset, const void** out_ptr, size_t* out_length);
+
+/**
+ * @brief      Close a blob reader
+ *
+ * Memory mapped by nvs_blob_mmap is unmapped.
+ *
+ * @param[in]   reader      Reader obtained from nvs_blob_open. NULL is allowed.
+ */
+void nvs_blob_close(nvs_blob_reader_t reader);
+
+/**
+ * Opaque pointer type representing a blob being written in parts
+ */
+typedef struct nvs_opaque_blob_writer_t *nvs_blob_writer_t;
+
+/**
+ * @brief      Start writing a blob in parts
+ *
+ * Unlike nvs_set_blob, the value doesn't need to be in a single buffer. Data
+ * passed to nvs_blob_append is written to flash as soon as it fills the rest of
+ * a page, so the writer only needs a buffer of one page worth of data. The new
+ * value replaces the previous one when nvs_blob_writer_commit is called; until
+ * then, and if power is lost before that, the previous value stays readable.
+ *
+ * \code{c}
+ * // Example of storing a table which is computed row by row:
+ * nvs_blob_writer_t writer;
+ * nvs_blob_writer_open(my_handle, "cal_table", &writer);
+ * for (int i = 0; i < ROW_COUNT; ++i) {
+ *     calc_row(i, &row);
+ *     nvs_blob_append(writer, &row, sizeof(row));
+ * }
+ * nvs_blob_writer_commit(writer);
+ * \endcode
+ *
+ * The key must not be written by other means, nor by another writer, until the
+ * writer is committed or aborted. The writer is not part of a transaction
+ * started with nvs_transaction_begin.
+ *
+ * @param[in]   handle      Handle obtained from nvs_open function.
+ *                          Handles that were opened read only cannot be used.
+ * @param[in]   key         Key name. Maximal length is 15 characters. Shouldn't be empty.
+ * @param[out]  out_writer  Writer for the blob, to be released using
+ *                          nvs_blob_writer_commit or nvs_blob_writer_abort.
+ *
+ * @return
+ *             - ESP_OK if the writer has been created
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_READ_ONLY if storage handle was opened as read only
+ *             - ESP_ERR_NVS_KEY_TOO_LONG if the key name is too long
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_blob_writer_open(nvs_handle handle, const char* key, nvs_blob_writer_t* out_writer);
+
+/**
+ * @brief      Append data to a blob being written
+ *
+ * @param[in]   writer      Writer obtained from nvs_blob_writer_open.
+ * @param[in]   value       The data to append.
+ * @param[in]   length      Length of the data, in bytes.
+ *
+ * @return
+ *             - ESP_OK if the data has been appended
+ *             - ESP_ERR_NVS_VALUE_TOO_LONG if the blob would be longer than supported
+ *             - ESP_ERR_NVS_NOT_ENOUGH_SPACE if there is not enough space to save the data
+ *             - other error codes from the underlying storage driver
+ *             On error, the writer has to be released using nvs_blob_writer_abort.
+ */
+esp_err_t nvs_blob_append(nvs_blob_writer_t writer, const void* value, size_t length);
+
+/**
+ * @brief      Write the rest of the blob and make it replace the previous value
+ *
+ * The writer is released, whether the blob has been written or not. If it hasn't,
+ * the previous value is kept.
+ *
+ * @param[in]   writer      Writer obtained from nvs_blob_writer_open.
+ *
+ * @return
+ *             - ESP_OK if the blob has been written
+ *             - ESP_ERR_NVS_NOT_ENOUGH_SPACE if there is not enough space to save the blob
+ *             - ESP_ERR_NVS_REMOVE_FAILED if the blob has been written, but the previous
+ *               value couldn't be erased (see nvs_set_blob)
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_blob_writer_commit(nvs_blob_writer_t writer);
+
+/**
+ * @brief      Discard a blob being written
+ *
+ * The data written so far is erased and the previous value is kept.
+ *
+ * @param[in]   writer      Writer obtained from nvs_blob_writer_open. NULL is allowed.
+ */
+void nvs_blob_writer_abort(nvs_blob_writer_t writer);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -59,6 +59,7 @@ public:
     uint8_t mReadOnly;
     uint8_t mNsIndex;
     nvs::Storage* mStoragePtr;
+    nvs::Storage::TTransactionItemList* mTransaction = nullptr; // values staged by nvs_set_* until nvs_commit
 };
 
 #ifdef ESP_PLATFORM
@@ -72,6 +73,15 @@ static intrusive_list<HandleEntry> s_nvs_handles;
 uint32_t HandleEntry::s_nvs_next_handle;
 static intrusive_list<nvs::Storage> s_nvs_storage_list;
 
+static void nvs_discard_transaction(HandleEntry* entry)
+{
+    if (entry->mTransaction) {
+        entry->mTransaction->clearAndFreeNodes();
+        delete entry->mTransaction;
+        entry->mTransaction = nullptr;
+    }
+}
+
 static nvs::Storage* lookup_storage_from_name(const char *name)
 {
     auto it = find_if(begin(s_nvs_storage_list), end(s_nvs_storage_list), [=](Storage& e) -> bool {
@@ -235,6 +245,7 @@ extern "C" esp_err_t nvs_flash_deinit_partition(const char* partition_name)
         if (it->mStoragePtr == storage) {
             ESP_LOGD(TAG, "Deleting handle %d (ns=%d) related to partition \"%s\" (missing call to nvs_close?)",
                      it->mHandle, it->mNsIndex, partition_name);
+            nvs_discard_transaction(it);
             s_nvs_handles.erase(it);
             delete static_cast<HandleEntry*>(it);
         }
@@ -253,18 +264,47 @@ extern "C" esp_err_t nvs_flash_deinit(void)
     return nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME);
 }
 
-static esp_err_t nvs_find_ns_handle(nvs_handle handle, HandleEntry& entry)
+static HandleEntry* nvs_find_handle_entry(nvs_handle handle)
 {
     auto it = find_if(begin(s_nvs_handles), end(s_nvs_handles), [=](HandleEntry& e) -> bool {
         return e.mHandle == handle;
     });
     if (it == end(s_nvs_handles)) {
+        return NULL;
+    }
+    return it;
+}
+
+static esp_err_t nvs_find_ns_handle(nvs_handle handle, HandleEntry& entry)
+{
+    HandleEntry* it = nvs_find_handle_entry(handle);
+    if (it == NULL) {
         return ESP_ERR_NVS_INVALID_HANDLE;
     }
     entry = *it;
     return ESP_OK;
 }
 
+static esp_err_t nvs_stage_item(HandleEntry& entry, nvs::ItemType datatype, const char* key, const void* data, size_t dataSize)
+{
+    if (strlen(key) > Item::MAX_KEY_LENGTH) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+    if (datatype == nvs::ItemType::SZ && dataSize > Page::CHUNK_MAX_SIZE) {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+    auto list = entry.mTransaction;
+    auto it = find_if(list->begin(), list->end(), [=](Storage::TransactionItem& e) -> bool {
+        return e.datatype == datatype && strcmp(e.key, key) == 0;
+    });
+    if (it != list->end()) {
+        list->erase(it);
+        delete static_cast<Storage::TransactionItem*>(it);
+    }
+    list->push_back(new Storage::TransactionItem(datatype, key, data, dataSize));
+    return ESP_OK;
+}
+
 extern "C" esp_err_t nvs_open_from_partition(const char *part_name, const char* name, nvs_open_mode open_mode, nvs_handle *out_handle)
 {
     Lock lock;
@@ -309,6 +349,7 @@ extern "C" void nvs_close(nvs_handle handle)
     if (it == end(s_nvs_handles)) {
         return;
     }
+    nvs_discard_transaction(it);
     s_nvs_handles.erase(it);
     delete static_cast<HandleEntry*>(it);
 }
@@ -356,6 +397,9 @@ static esp_err_t nvs_set(nvs_handle handle, const char* key, T value)
     if (entry.mReadOnly) {
         return ESP_ERR_NVS_READ_ONLY;
     }
+    if (entry.mTransaction) {
+        return nvs_stage_item(entry, itemTypeOf(value), key, &value, sizeof(value));
+    }
     return entry.mStoragePtr->writeItem(entry.mNsIndex, key, value);
 }
 
@@ -399,12 +443,53 @@ extern "C" esp_err_t nvs_set_u64 (nvs_handle handle, const char* key, uint64_t v
     return nvs_set(handle, key, value);
 }
 
+extern "C" esp_err_t nvs_transaction_begin(nvs_handle handle)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %d", __func__, handle);
+    HandleEntry* entry = nvs_find_handle_entry(handle);
+    if (entry == NULL) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (entry->mReadOnly) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    if (entry->mTransaction) {
+        return ESP_ERR_NVS_INVALID_STATE;
+    }
+    entry->mTransaction = new nvs::Storage::TTransactionItemList;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_transaction_abort(nvs_handle handle)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %d", __func__, handle);
+    HandleEntry* entry = nvs_find_handle_entry(handle);
+    if (entry == NULL) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (entry->mTransaction == nullptr) {
+        return ESP_ERR_NVS_INVALID_STATE;
+    }
+    nvs_discard_transaction(entry);
+    return ESP_OK;
+}
+
 extern "C" esp_err_t nvs_commit(nvs_handle handle)
 {
     Lock lock;
-    // no-op for now, to be used when intermediate cache is added
-    HandleEntry entry;
-    return nvs_find_ns_handle(handle, entry);
+    HandleEntry* entry = nvs_find_handle_entry(handle);
+    if (entry == NULL) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (entry->mTransaction == nullptr) {
+        // values set outside of a transaction have been written already
+        return ESP_OK;
+    }
+    auto err = entry->mStoragePtr->commitTransaction(entry->mNsIndex, *entry->mTransaction);
+    nvs_discard_transaction(entry);
+    return err;
 }
 
 extern "C" esp_err_t nvs_set_str(nvs_handle handle, const char* key, const char* value)
@@ -416,6 +501,9 @@ extern "C" esp_err_t nvs_set_str(nvs_handle handle, const char* key, const char*
     if (err != ESP_OK) {
         return err;
     }
+    if (entry.mTransaction) {
+        return nvs_stage_item(entry, nvs::ItemType::SZ, key, value, strlen(value) + 1);
+    }
     return entry.mStoragePtr->writeItem(entry.mNsIndex, nvs::ItemType::SZ, key, value, strlen(value) + 1);
 }
 
@@ -428,6 +516,9 @@ extern "C" esp_err_t nvs_set_blob(nvs_handle handle, const char* key, const void
     if (err != ESP_OK) {
         return err;
     }
+    if (entry.mTransaction) {
+        return nvs_stage_item(entry, nvs::ItemType::BLOB, key, value, length);
+    }
     return entry.mStoragePtr->writeItem(entry.mNsIndex, nvs::ItemType::BLOB, key, value, length);
 }
 
@@ -550,6 +641,33 @@ extern "C" esp_err_t nvs_get_stats(const char* part_name, nvs_stats_t* nvs_stats
     return pStorage->fillStats(*nvs_stats);
 }
 
+extern "C" esp_err_t nvs_gc_step(const char* part_name, size_t max_entries, bool* done)
+{
+    Lock lock;
+    nvs::Storage* pStorage = lookup_storage_from_name((part_name == NULL) ? NVS_DEFAULT_PART_NAME : part_name);
+    if (pStorage == NULL) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    bool finished;
+    auto err = pStorage->collectGarbage(max_entries, finished);
+    if (done) {
+        *done = finished;
+    }
+    return err;
+}
+
+extern "C" esp_err_t nvs_get_cache_stats(nvs_cache_stats_t* cache_stats)
+{
+    Lock lock;
+    if (cache_stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    auto& cache = nvs::Page::getEntryCache();
+    cache_stats->hits = cache.getHits();
+    cache_stats->misses = cache.getMisses();
+    return ESP_OK;
+}
+
 extern "C" esp_err_t nvs_get_used_entry_count(nvs_handle handle, size_t* used_entries)
 {
     Lock lock;
@@ -572,6 +690,178 @@ extern "C" esp_err_t nvs_get_used_entry_count(nvs_handle handle, size_t* used_en
     return err;
 }
 
+extern "C" nvs_iterator_t nvs_entry_find(const char *part_name, const char *namespace_name, nvs_type_t type)
+{
+    Lock lock;
+    nvs::Storage* pStorage = lookup_storage_from_name(part_name);
+    if (pStorage == NULL) {
+        return NULL;
+    }
+
+    nvs_iterator_t it = new nvs_opaque_iterator_t;
+    it->storage = pStorage;
+    it->type = type;
+    if (!pStorage->findEntry(it, namespace_name)) {
+        delete it;
+        return NULL;
+    }
+    return it;
+}
+
+extern "C" nvs_iterator_t nvs_entry_next(nvs_iterator_t it)
+{
+    Lock lock;
+    assert(it);
+    if (!it->storage->nextEntry(it)) {
+        delete it;
+        return NULL;
+    }
+    return it;
+}
+
+extern "C" void nvs_entry_info(nvs_iterator_t it, nvs_entry_info_t *out_info)
+{
+    *out_info = it->entry_info;
+}
+
+extern "C" void nvs_release_iterator(nvs_iterator_t it)
+{
+    delete it;
+}
+
+extern "C" esp_err_t nvs_blob_open(nvs_handle handle, const char* key, nvs_blob_reader_t* out_reader, size_t* out_length)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %s", __func__, key);
+    HandleEntry entry;
+    auto err = nvs_find_ns_handle(handle, entry);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    nvs_blob_reader_t reader = new nvs_opaque_blob_reader_t;
+    err = entry.mStoragePtr->openBlob(reader, entry.mNsIndex, key);
+    if (err != ESP_OK) {
+        delete reader;
+        return err;
+    }
+    if (out_length) {
+        *out_length = reader->dataSize;
+    }
+    *out_reader = reader;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_blob_read(nvs_blob_reader_t reader, size_t offset, void* out_value, size_t length)
+{
+    Lock lock;
+    assert(reader);
+    return reader->storage->readBlob(reader, offset, out_value, length);
+}
+
+static void nvs_blob_unmap(nvs_blob_reader_t reader)
+{
+    if (reader->mapped) {
+        spi_flash_munmap(reader->mapHandle);
+        reader->mapped = false;
+    }
+}
+
+extern "C" esp_err_t nvs_blob_mmap(nvs_blob_reader_t reader, size_t offset, const void** out_ptr, size_t* out_length)
+{
+    Lock lock;
+    assert(reader);
+#ifdef CONFIG_NVS_ENCRYPTION
+    // mapped flash would hold encrypted entries
+    if (EncrMgr::isEncrActive() &&
+            EncrMgr::getInstance()->findXtsCtxtFromAddr(reader->storage->getBaseSector() * SPI_FLASH_SEC_SIZE)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+#endif
+
+    uint32_t address;
+    size_t length;
+    auto err = reader->storage->findBlobData(reader, offset, address, length);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // a chunk never crosses its page, so mapping the MMU page holding the start of it is enough
+    uint32_t mapAddress = address & ~(SPI_FLASH_MMU_PAGE_SIZE - 1);
+    if (!reader->mapped || reader->mapAddress != mapAddress) {
+        nvs_blob_unmap(reader);
+        size_t mapSize = (address / SPI_FLASH_SEC_SIZE + 1) * SPI_FLASH_SEC_SIZE - mapAddress;
+        err = spi_flash_mmap(mapAddress, mapSize, SPI_FLASH_MMAP_DATA, &reader->mapPtr, &reader->mapHandle);
+        if (err != ESP_OK) {
+            return err;
+        }
+        reader->mapped = true;
+        reader->mapAddress = mapAddress;
+    }
+    *out_ptr = static_cast<const uint8_t*>(reader->mapPtr) + (address - mapAddress);
+    *out_length = length;
+    return ESP_OK;
+}
+
+extern "C" void nvs_blob_close(nvs_blob_reader_t reader)
+{
+    if (reader == NULL) {
+        return;
+    }
+    Lock lock;
+    nvs_blob_unmap(reader);
+    delete reader;
+}
+
+extern "C" esp_err_t nvs_blob_writer_open(nvs_handle handle, const char* key, nvs_blob_writer_t* out_writer)
+{
+    Lock lock;
+    ESP_LOGD(TAG, "%s %s", __func__, key);
+    HandleEntry entry;
+    auto err = nvs_find_ns_handle(handle, entry);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (entry.mReadOnly) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+
+    nvs_blob_writer_t writer = new nvs_opaque_blob_writer_t;
+    err = entry.mStoragePtr->openBlobWriter(writer, entry.mNsIndex, key);
+    if (err != ESP_OK) {
+        delete writer;
+        return err;
+    }
+    *out_writer = writer;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_blob_append(nvs_blob_writer_t writer, const void* value, size_t length)
+{
+    Lock lock;
+    assert(writer);
+    return writer->storage->appendBlob(writer, value, length);
+}
+
+extern "C" esp_err_t nvs_blob_writer_commit(nvs_blob_writer_t writer)
+{
+    Lock lock;
+    assert(writer);
+    auto err = writer->storage->commitBlob(writer);
+    delete writer;
+    return err;
+}
+
+extern "C" void nvs_blob_writer_abort(nvs_blob_writer_t writer)
+{
+    if (writer == NULL) {
+        return;
+    }
+    Lock lock;
+    writer->storage->abortBlob(writer);
+    delete writer;
+}
+
 #if (defined CONFIG_NVS_ENCRYPTION) && (defined ESP_PLATFORM)
 
 extern "C" esp_err_t nvs_flash_generate_keys(const esp_partition_t* partition, nvs_sec_cfg_t* cfg)
@@ -128,22 +128,26 @@ namespace nvs
 
     esp_err_t EncrMgr::decryptNvsData(uint8_t* ctxt, uint32_t addr, uint32_t ctxtLen, XtsCtxt* xtsCtxt) {
 
+        uint8_t entrySize = sizeof(Item);
+
         //sector num required as an arr by mbedtls. Should have been just uint64/32.
         uint8_t data_unit[16];
 
-
-        /** Currently upper layer of NVS reads entries one by one even for variable size
-        * multi-entry data types. So length should always be equal to size of an entry.*/
-        assert(ctxtLen == sizeof(Item));
+        /** Data of variable size multi-entry data types is read in one go, so decrypt
+        * entry by entry, the same way as it was encrypted.*/
+        assert(ctxtLen % entrySize == 0);
 
         uint32_t relAddr = addr - (xtsCtxt->baseSector * SPI_FLASH_SEC_SIZE);
 
         memset(data_unit, 0, sizeof(data_unit));
 
-        memcpy(data_unit, &relAddr, sizeof(relAddr));
-
-        if(mbedtls_aes_crypt_xts(xtsCtxt->dctxt, MBEDTLS_AES_DECRYPT, ctxtLen, data_unit, ctxt, ctxt))  {
-            return ESP_ERR_NVS_XTS_DECR_FAILED;
+        for(uint32_t offset = 0; offset < ctxtLen; offset += entrySize)
+        {
+            uint32_t entryAddr = relAddr + offset;
+            memcpy(data_unit, &entryAddr, sizeof(entryAddr));
+            if(mbedtls_aes_crypt_xts(xtsCtxt->dctxt, MBEDTLS_AES_DECRYPT, entrySize, data_unit, ctxt + offset, ctxt + offset))  {
+                return ESP_ERR_NVS_XTS_DECR_FAILED;
+            }
         }
         return ESP_OK;
     }
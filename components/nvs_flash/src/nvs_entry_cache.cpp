@@ -0,0 +1,118 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nvs_entry_cache.hpp"
+#include <new>
+#include <utility>
+
+namespace nvs
+{
+
+void EntryCache::resize(size_t budget)
+{
+    mLines.reset();
+    mSetCount = 0;
+    mAllocated = false;
+    mBudget = budget;
+    resetStats();
+}
+
+bool EntryCache::allocate()
+{
+    if (mAllocated) {
+        return mSetCount != 0;
+    }
+    mAllocated = true;
+
+    size_t setCount = 1;
+    while (setCount * 2 * WAY_COUNT * sizeof(Line) <= mBudget) {
+        setCount *= 2;
+    }
+    if (setCount * WAY_COUNT * sizeof(Line) > mBudget) {
+        return false;
+    }
+    mLines.reset(new (std::nothrow) Line[setCount * WAY_COUNT]);
+    if (!mLines) {
+        return false;
+    }
+    mSetCount = setCount;
+    return true;
+}
+
+bool EntryCache::read(uint32_t address, Item& dst)
+{
+    if (!allocate()) {
+        return false;
+    }
+    Line* lines = set(address);
+    for (size_t way = 0; way < WAY_COUNT; ++way) {
+        if (lines[way].mAddress == address) {
+            // keep the most recently used line in way 0
+            if (way != 0) {
+                std::swap(lines[0], lines[way]);
+            }
+            dst = lines[0].mItem;
+            ++mHits;
+            return true;
+        }
+    }
+    ++mMisses;
+    return false;
+}
+
+void EntryCache::insert(uint32_t address, const Item& item)
+{
+    if (!allocate()) {
+        return;
+    }
+    Line* lines = set(address);
+    for (size_t way = WAY_COUNT - 1; way > 0; --way) {
+        lines[way] = lines[way - 1];
+    }
+    lines[0].mAddress = address;
+    lines[0].mItem = item;
+}
+
+void EntryCache::invalidate(uint32_t address)
+{
+    if (!mSetCount) {
+        return;
+    }
+    Line* lines = set(address);
+    for (size_t way = 0; way < WAY_COUNT; ++way) {
+        if (lines[way].mAddress == address) {
+            lines[way].mAddress = EMPTY_ADDRESS;
+        }
+    }
+}
+
+void EntryCache::invalidateRange(uint32_t address, size_t size)
+{
+    if (!mSetCount) {
+        return;
+    }
+    if (size / sizeof(Item) >= mSetCount) {
+        for (size_t i = 0; i < mSetCount * WAY_COUNT; ++i) {
+            if (mLines[i].mAddress >= address && mLines[i].mAddress - address < size) {
+                mLines[i].mAddress = EMPTY_ADDRESS;
+            }
+        }
+        return;
+    }
+    for (size_t offset = 0; offset < size; offset += sizeof(Item)) {
+        invalidate(address + offset);
+    }
+}
+
+} // namespace nvs
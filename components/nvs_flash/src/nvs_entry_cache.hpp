@@ -0,0 +1,103 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef nvs_entry_cache_h
+#define nvs_entry_cache_h
+
+#include <memory>
+#include "nvs_types.hpp"
+
+namespace nvs
+{
+
+/**
+ * Two-way set associative cache of item entries, keyed by flash address.
+ *
+ * Entries are stored as they are returned by nvs_flash_read, i.e. decrypted.
+ * Pages invalidate the entries they write, erase or mark as erased, and the
+ * whole page range when the page is loaded or erased, so a cached entry always
+ * matches the contents of flash.
+ *
+ * The table is allocated on first use. If the allocation fails, or the budget is
+ * too small for a single set, the cache stays disabled and every lookup misses
+ * without being counted.
+ */
+class EntryCache
+{
+public:
+    EntryCache(size_t budget) : mBudget(budget) { }
+
+    void resize(size_t budget);
+
+    bool read(uint32_t address, Item& dst);
+
+    void insert(uint32_t address, const Item& item);
+
+    void invalidate(uint32_t address);
+
+    void invalidateRange(uint32_t address, size_t size);
+
+    bool isActive()
+    {
+        return allocate();
+    }
+
+    size_t getHits() const
+    {
+        return mHits;
+    }
+
+    size_t getMisses() const
+    {
+        return mMisses;
+    }
+
+    void resetStats()
+    {
+        mHits = 0;
+        mMisses = 0;
+    }
+
+private:
+    EntryCache(const EntryCache& other);
+    const EntryCache& operator= (const EntryCache& rhs);
+
+protected:
+
+    static const size_t WAY_COUNT = 2;
+    static const uint32_t EMPTY_ADDRESS = UINT32_MAX;
+
+    struct Line {
+        uint32_t mAddress = EMPTY_ADDRESS;
+        Item mItem;
+    };
+
+    bool allocate();
+
+    Line* set(uint32_t address)
+    {
+        return &mLines[((address / sizeof(Item)) & (mSetCount - 1)) * WAY_COUNT];
+    }
+
+    size_t mBudget;
+    size_t mSetCount = 0;
+    bool mAllocated = false;
+    size_t mHits = 0;
+    size_t mMisses = 0;
+    std::unique_ptr<Line[]> mLines;
+}; // class EntryCache
+
+} // namespace nvs
+
+#endif /* nvs_entry_cache_h */
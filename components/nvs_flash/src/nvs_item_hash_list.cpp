@@ -44,7 +44,12 @@ HashList::HashListBlock::HashListBlock()
 
 void HashList::insert(const Item& item, size_t index)
 {
-    const uint32_t hash_24 = item.calculateCrc32WithoutValue() & 0xffffff;
+    insert(item.calculateCrc32WithoutValue(), index);
+}
+
+void HashList::insert(uint32_t hash, size_t index)
+{
+    const uint32_t hash_24 = hash & 0xffffff;
     // add entry to the end of last block if possible
     if (mBlockList.size()) {
         auto& block = mBlockList.back();
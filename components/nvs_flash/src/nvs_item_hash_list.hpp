@@ -29,6 +29,7 @@ public:
     ~HashList();
     
     void insert(const Item& item, size_t index);
+    void insert(uint32_t hash, size_t index);
     void erase(const size_t index, bool itemShouldExist=true);
     size_t find(size_t start, const Item& item);
     void clear();
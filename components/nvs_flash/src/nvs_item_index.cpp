@@ -0,0 +1,158 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nvs_item_index.hpp"
+#include <new>
+
+namespace nvs
+{
+
+void ItemIndex::build()
+{
+    clear();
+
+    size_t capacity = 1;
+    while (capacity * 2 * sizeof(Node) <= mBudget) {
+        capacity *= 2;
+    }
+    if (capacity * sizeof(Node) > mBudget || capacity < MIN_CAPACITY) {
+        return;
+    }
+
+    mNodes.reset(new (std::nothrow) Node[capacity]);
+    if (!mNodes) {
+        return;
+    }
+    mCapacity = capacity;
+    mActive = true;
+}
+
+void ItemIndex::clear()
+{
+    mNodes.reset();
+    mCapacity = 0;
+    mSize = 0;
+    mActive = false;
+}
+
+size_t ItemIndex::lookup(uint32_t hash, Page* page) const
+{
+    for (size_t i = home(hash); mNodes[i].mCount != 0; i = (i + 1) & (mCapacity - 1)) {
+        if (mNodes[i].mHash == hash && mNodes[i].mPage == page) {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+void ItemIndex::insert(uint32_t hash, Page* page)
+{
+    if (!mActive) {
+        return;
+    }
+    size_t slot = lookup(hash, page);
+    if (slot != SIZE_MAX) {
+        ++mNodes[slot].mCount;
+        return;
+    }
+
+    // keep the load factor at or below 3/4, otherwise give up and let
+    // Storage fall back to searching every page
+    if ((mSize + 1) * 4 > mCapacity * 3) {
+        clear();
+        return;
+    }
+
+    for (slot = home(hash); mNodes[slot].mCount != 0; slot = (slot + 1) & (mCapacity - 1)) {
+    }
+    mNodes[slot].mPage = page;
+    mNodes[slot].mHash = hash;
+    mNodes[slot].mCount = 1;
+    ++mSize;
+}
+
+void ItemIndex::erase(const Item& item, Page* page)
+{
+    if (!mActive) {
+        return;
+    }
+    size_t slot = lookup(hashOf(item), page);
+    if (slot == SIZE_MAX) {
+        return;
+    }
+    if (--mNodes[slot].mCount == 0) {
+        eraseSlot(slot);
+    }
+}
+
+void ItemIndex::eraseSlot(size_t slot)
+{
+    // backward shift deletion: move the following nodes of the probe sequence
+    // into the hole unless that would place them before their home slot
+    const size_t mask = mCapacity - 1;
+    size_t hole = slot;
+    for (size_t i = (slot + 1) & mask; mNodes[i].mCount != 0; i = (i + 1) & mask) {
+        size_t h = home(mNodes[i].mHash);
+        bool between = (hole <= i) ? (hole < h && h <= i) : (hole < h || h <= i);
+        if (between) {
+            continue;
+        }
+        mNodes[hole] = mNodes[i];
+        hole = i;
+    }
+    mNodes[hole] = Node();
+    --mSize;
+}
+
+void ItemIndex::movePage(Page* from, Page* to)
+{
+    if (!mActive) {
+        return;
+    }
+    for (size_t i = 0; i < mCapacity;) {
+        Node& node = mNodes[i];
+        if (node.mCount == 0 || node.mPage != from) {
+            ++i;
+            continue;
+        }
+        size_t existing = lookup(node.mHash, to);
+        if (existing == SIZE_MAX) {
+            node.mPage = to;
+            ++i;
+            continue;
+        }
+        // both pages had items with this hash; merge the counts and
+        // look at slot i again, as the deletion may have moved a node into it
+        mNodes[existing].mCount += node.mCount;
+        eraseSlot(i);
+    }
+}
+
+size_t ItemIndex::findPages(const Item& item, Page** pages, size_t maxCount) const
+{
+    assert(mActive);
+    const uint32_t hash = hashOf(item);
+    size_t count = 0;
+    for (size_t i = home(hash); mNodes[i].mCount != 0; i = (i + 1) & (mCapacity - 1)) {
+        if (mNodes[i].mHash == hash) {
+            if (count < maxCount) {
+                pages[count] = mNodes[i].mPage;
+            }
+            ++count;
+        }
+    }
+    return count;
+}
+
+} // namespace nvs
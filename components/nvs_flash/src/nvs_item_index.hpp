@@ -0,0 +1,118 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef nvs_item_index_h
+#define nvs_item_index_h
+
+#include <memory>
+#include "nvs.h"
+#include "nvs_types.hpp"
+
+namespace nvs
+{
+
+class Page;
+
+/**
+ * Partition-wide map from item hash (namespace, key and chunk index) to the pages
+ * which hold items with that hash.
+ *
+ * The index may report pages which no longer hold the item (e.g. after an entry
+ * was erased because of a CRC error), so callers have to confirm every candidate
+ * with Page::findItem. It never misses a page which does hold the item, which
+ * makes "not in the index" a definitive answer.
+ *
+ * Once the number of distinct (hash, page) pairs would exceed the memory budget,
+ * the index drops its table and stays inactive until the next build().
+ */
+class ItemIndex
+{
+public:
+    ItemIndex(size_t budget) : mBudget(budget) { }
+
+    void build();
+
+    void clear();
+
+    bool isActive() const
+    {
+        return mActive;
+    }
+
+    void insert(const Item& item, Page* page)
+    {
+        insert(hashOf(item), page);
+    }
+
+    void insert(uint32_t hash, Page* page);
+
+    void erase(const Item& item, Page* page);
+
+    void movePage(Page* from, Page* to);
+
+    size_t findPages(const Item& item, Page** pages, size_t maxCount) const;
+
+    bool contains(const Item& item, Page* page) const
+    {
+        return mActive && lookup(hashOf(item), page) != SIZE_MAX;
+    }
+
+    size_t size() const
+    {
+        return mSize;
+    }
+
+    size_t capacity() const
+    {
+        return mCapacity;
+    }
+
+private:
+    ItemIndex(const ItemIndex& other);
+    const ItemIndex& operator= (const ItemIndex& rhs);
+
+protected:
+
+    static const size_t MIN_CAPACITY = 16;
+
+    struct Node {
+        Page* mPage = nullptr;
+        uint32_t mHash = 0;
+        uint32_t mCount = 0;
+    };
+
+    static uint32_t hashOf(const Item& item)
+    {
+        return item.calculateCrc32WithoutValue();
+    }
+
+    size_t home(uint32_t hash) const
+    {
+        return hash & (mCapacity - 1);
+    }
+
+    size_t lookup(uint32_t hash, Page* page) const;
+
+    void eraseSlot(size_t slot);
+
+    size_t mBudget;
+    size_t mCapacity = 0;
+    size_t mSize = 0;
+    bool mActive = false;
+    std::unique_ptr<Node[]> mNodes;
+}; // class ItemIndex
+
+} // namespace nvs
+
+#endif /* nvs_item_index_h */
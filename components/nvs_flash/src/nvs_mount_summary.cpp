@@ -0,0 +1,226 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nvs_mount_summary.hpp"
+#include "nvs_page.hpp"
+#include "esp_crc.h"
+#include <algorithm>
+#include <new>
+
+namespace nvs
+{
+
+uint32_t MountSummary::Header::calculateCrc32(const PageRecord* pages, const Record* records) const
+{
+    uint32_t result = esp_crc32_le(0xffffffff, reinterpret_cast<const uint8_t*>(this), offsetof(Header, mCrc32));
+    result = esp_crc32_le(result, reinterpret_cast<const uint8_t*>(pages), mPageCount * sizeof(PageRecord));
+    return esp_crc32_le(result, reinterpret_cast<const uint8_t*>(records), mRecordCount * sizeof(Record));
+}
+
+esp_err_t MountSummary::isReserved(uint32_t baseSector, uint32_t sectorCount, bool& reserved)
+{
+    // The last sector is taken for the summary if it already holds one, or if it is
+    // free and another free page remains. Existing partitions which use the last
+    // sector, or whose only free page it is, keep working without a summary.
+    const uint32_t uninitialized = static_cast<uint32_t>(Page::PageState::UNINITIALIZED);
+    const uint32_t lastSector = baseSector + sectorCount - 1;
+    uint32_t magic;
+    auto rc = spi_flash_read(lastSector * SPI_FLASH_SEC_SIZE, &magic, sizeof(magic));
+    if (rc != ESP_OK) {
+        return rc;
+    }
+    reserved = (magic == MAGIC);
+    if (magic != uninitialized) {
+        return ESP_OK;
+    }
+    for (uint32_t sector = baseSector; sector < lastSector; ++sector) {
+        uint32_t state;
+        rc = spi_flash_read(sector * SPI_FLASH_SEC_SIZE, &state, sizeof(state));
+        if (rc != ESP_OK) {
+            return rc;
+        }
+        if (state == uninitialized) {
+            reserved = true;
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+size_t MountSummary::recordCapacity(size_t pageCount) const
+{
+    return (SPI_FLASH_SEC_SIZE - sizeof(Header) - pageCount * sizeof(PageRecord)) / sizeof(Record);
+}
+
+esp_err_t MountSummary::load(uint32_t sectorNumber)
+{
+    clear();
+
+    const uint32_t address = sectorNumber * SPI_FLASH_SEC_SIZE;
+    Header header;
+    auto rc = spi_flash_read(address, &header, sizeof(header));
+    if (rc != ESP_OK) {
+        return rc;
+    }
+    if (header.mMagic != MAGIC || header.mVersion != VERSION ||
+            header.mPageCount * sizeof(PageRecord) > SPI_FLASH_SEC_SIZE - sizeof(Header) ||
+            header.mRecordCount > recordCapacity(header.mPageCount)) {
+        return ESP_OK;
+    }
+
+    mPages.reset(new (std::nothrow) PageRecord[header.mPageCount]);
+    mRecords.reset(new (std::nothrow) Record[header.mRecordCount]);
+    if (!mPages || !mRecords) {
+        clear();
+        return ESP_OK;
+    }
+    const uint32_t pagesAddress = address + sizeof(Header);
+    const uint32_t recordsAddress = pagesAddress + header.mPageCount * sizeof(PageRecord);
+    rc = spi_flash_read(pagesAddress, mPages.get(), header.mPageCount * sizeof(PageRecord));
+    if (rc == ESP_OK) {
+        rc = spi_flash_read(recordsAddress, mRecords.get(), header.mRecordCount * sizeof(Record));
+    }
+    if (rc != ESP_OK) {
+        clear();
+        return rc;
+    }
+    if (header.mCrc32 != header.calculateCrc32(mPages.get(), mRecords.get())) {
+        clear();
+        return ESP_OK;
+    }
+    for (size_t i = 0; i < header.mPageCount; ++i) {
+        if (mPages[i].firstRecord + mPages[i].recordCount > header.mRecordCount) {
+            clear();
+            return ESP_OK;
+        }
+    }
+
+    mPageCount = header.mPageCount;
+    mRecordCount = header.mRecordCount;
+    mOmittedPageCount = header.mOmittedPageCount;
+    mValid = true;
+    return ESP_OK;
+}
+
+void MountSummary::clear()
+{
+    mValid = false;
+    mPages.reset();
+    mPageCount = 0;
+    mPageCapacity = 0;
+    mRecords.reset();
+    mRecordCount = 0;
+    mOmittedPageCount = 0;
+}
+
+const MountSummary::PageRecord* MountSummary::find(uint32_t seqNumber) const
+{
+    if (!mValid) {
+        return nullptr;
+    }
+    auto end = mPages.get() + mPageCount;
+    auto it = std::lower_bound(mPages.get(), end, seqNumber, [](const PageRecord& page, uint32_t seqNumber) -> bool {
+        return page.seqNumber < seqNumber;
+    });
+    if (it == end || it->seqNumber != seqNumber) {
+        return nullptr;
+    }
+    return it;
+}
+
+esp_err_t MountSummary::build(size_t pageCount)
+{
+    clear();
+    pageCount = std::min(pageCount, (SPI_FLASH_SEC_SIZE - sizeof(Header)) / sizeof(PageRecord));
+    mPages.reset(new (std::nothrow) PageRecord[pageCount]);
+    mRecords.reset(new (std::nothrow) Record[recordCapacity(pageCount ? 1 : 0)]);
+    if (!mPages || !mRecords) {
+        clear();
+        return ESP_ERR_NO_MEM;
+    }
+    mPageCapacity = pageCount;
+    return ESP_OK;
+}
+
+esp_err_t MountSummary::addPage(Page& page)
+{
+    assert(page.state() == Page::PageState::FULL);
+    uint32_t seqNumber;
+    ESP_ERROR_CHECK(page.getSeqNumber(seqNumber));
+    assert(mPageCount == 0 || mPages[mPageCount - 1].seqNumber < seqNumber);
+
+    const size_t firstRecord = mRecordCount;
+    bool fits = mPageCount < mPageCapacity && mRecordCount <= recordCapacity(mPageCount + 1);
+    size_t itemIndex = 0;
+    Item item;
+    while (fits && page.findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) == ESP_OK) {
+        if (mRecordCount >= recordCapacity(mPageCount + 1)) {
+            fits = false;
+            break;
+        }
+        Record& record = mRecords[mRecordCount++];
+        record.hash = item.calculateCrc32WithoutValue();
+        record.index = static_cast<uint8_t>(itemIndex);
+        record.span = item.span;
+        record.nsIndex = item.nsIndex;
+        record.datatype = item.datatype;
+        itemIndex += item.span;
+    }
+    if (!fits) {
+        mRecordCount = firstRecord;
+        ++mOmittedPageCount;
+        return ESP_OK;
+    }
+
+    PageRecord& pageRecord = mPages[mPageCount++];
+    pageRecord.seqNumber = seqNumber;
+    pageRecord.entryTableCrc32 = page.getEntryTableCrc32();
+    pageRecord.firstRecord = static_cast<uint16_t>(firstRecord);
+    pageRecord.recordCount = static_cast<uint16_t>(mRecordCount - firstRecord);
+    return ESP_OK;
+}
+
+esp_err_t MountSummary::write(uint32_t sectorNumber)
+{
+    Header header;
+    std::fill_n(reinterpret_cast<uint8_t*>(&header), sizeof(header), 0xff);
+    header.mMagic = MAGIC;
+    header.mVersion = VERSION;
+    header.mPageCount = static_cast<uint16_t>(mPageCount);
+    header.mRecordCount = static_cast<uint16_t>(mRecordCount);
+    header.mOmittedPageCount = static_cast<uint16_t>(mOmittedPageCount);
+    header.mCrc32 = header.calculateCrc32(mPages.get(), mRecords.get());
+
+    const uint32_t address = sectorNumber * SPI_FLASH_SEC_SIZE;
+    const uint32_t pagesAddress = address + sizeof(Header);
+    const uint32_t recordsAddress = pagesAddress + mPageCount * sizeof(PageRecord);
+    auto rc = spi_flash_erase_sector(sectorNumber);
+    if (rc == ESP_OK && mPageCount) {
+        rc = spi_flash_write(pagesAddress, mPages.get(), mPageCount * sizeof(PageRecord));
+    }
+    if (rc == ESP_OK && mRecordCount) {
+        rc = spi_flash_write(recordsAddress, mRecords.get(), mRecordCount * sizeof(Record));
+    }
+    // the header goes last, so that an interrupted write leaves no summary rather than a partial one
+    if (rc == ESP_OK) {
+        rc = spi_flash_write(address, &header, sizeof(header));
+    }
+    if (rc != ESP_OK) {
+        return rc;
+    }
+    mValid = true;
+    return ESP_OK;
+}
+
+} // namespace nvs
@@ -0,0 +1,129 @@
+// Copyright 2015-2018 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef nvs_mount_summary_h
+#define nvs_mount_summary_h
+
+#include <memory>
+#include "nvs.h"
+#include "nvs_types.hpp"
+
+namespace nvs
+{
+
+class Page;
+
+/**
+ * Items of the full pages of a partition, as found by an earlier initialization,
+ * kept in a sector reserved at the end of the partition.
+ *
+ * Loading a page reads every written entry to build its hash list, and
+ * Storage::init reads them again to find namespaces and blob indices. A full page
+ * whose sequence number and entry state table still match the summary is loaded
+ * from its header and entry state table instead, and only the items whose
+ * contents are needed are read. Pages which don't match, because entries were
+ * written or erased since or the sector was reused, are scanned as before, so a
+ * stale summary is never wrong, only less useful.
+ *
+ * The summary is only kept in RAM while the partition is being initialized.
+ */
+class MountSummary
+{
+public:
+    struct Record {
+        uint32_t hash;      // Item::calculateCrc32WithoutValue
+        uint8_t index;      // index of the item header on the page
+        uint8_t span;
+        uint8_t nsIndex;
+        ItemType datatype;
+    };
+
+    struct PageRecord {
+        uint32_t seqNumber;
+        uint32_t entryTableCrc32;
+        uint16_t firstRecord;
+        uint16_t recordCount;
+    };
+
+    MountSummary() { }
+
+    static esp_err_t isReserved(uint32_t baseSector, uint32_t sectorCount, bool& reserved);
+
+    esp_err_t load(uint32_t sectorNumber);
+
+    void clear();
+
+    bool isValid() const
+    {
+        return mValid;
+    }
+
+    size_t getOmittedPageCount() const
+    {
+        return mOmittedPageCount;
+    }
+
+    const PageRecord* find(uint32_t seqNumber) const;
+
+    const Record* getRecords(const PageRecord& page) const
+    {
+        return mRecords.get() + page.firstRecord;
+    }
+
+    esp_err_t build(size_t pageCount);
+
+    esp_err_t addPage(Page& page);
+
+    esp_err_t write(uint32_t sectorNumber);
+
+private:
+    MountSummary(const MountSummary& other);
+    const MountSummary& operator= (const MountSummary& rhs);
+
+protected:
+
+    static const uint32_t MAGIC = 0x53564e53; // "SNVS", never a valid page state
+    static const uint8_t VERSION = 1;
+
+    struct Header {
+        uint32_t mMagic;
+        uint8_t mVersion;
+        uint8_t mReserved[3];
+        uint16_t mPageCount;
+        uint16_t mRecordCount;
+        uint16_t mOmittedPageCount; // full pages which didn't fit
+        uint8_t mReserved2[14];
+        uint32_t mCrc32;            // crc of the header fields before it, page and item records
+
+        uint32_t calculateCrc32(const PageRecord* pages, const Record* records) const;
+    };
+
+    static_assert(sizeof(Header) == 32, "header size must be 32 bytes");
+    static_assert(sizeof(PageRecord) == 12, "page record size must be 12 bytes");
+    static_assert(sizeof(Record) == 8, "item record size must be 8 bytes");
+
+    size_t recordCapacity(size_t pageCount) const;
+
+    bool mValid = false;
+    std::unique_ptr<PageRecord[]> mPages; // sorted by sequence number
+    size_t mPageCount = 0;
+    size_t mPageCapacity = 0;
+    std::unique_ptr<Record[]> mRecords;
+    size_t mRecordCount = 0;
+    size_t mOmittedPageCount = 0;
+}; // class MountSummary
+
+} // namespace nvs
+
+#endif /* nvs_mount_summary_h */
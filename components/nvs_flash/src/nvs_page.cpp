@@ -12,31 +12,35 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include "nvs_page.hpp"
-#if defined(ESP_PLATFORM)
-#include <rom/crc.h>
-#else
-#include "crc.h"
-#endif
+#include "esp_crc.h"
 #include <cstdio>
 #include <cstring>
 
 #include "nvs_ops.hpp"
+#include "sdkconfig.h"
 
 namespace nvs
 {
 
 uint32_t Page::Header::calculateCrc32()
 {
-    return crc32_le(0xffffffff,
-                    reinterpret_cast<uint8_t*>(this) + offsetof(Header, mSeqNumber),
-                    offsetof(Header, mCrc32) - offsetof(Header, mSeqNumber));
+    return esp_crc32_le(0xffffffff,
+                        reinterpret_cast<uint8_t*>(this) + offsetof(Header, mSeqNumber),
+                        offsetof(Header, mCrc32) - offsetof(Header, mSeqNumber));
 }
 
-esp_err_t Page::load(uint32_t sectorNumber)
+EntryCache& Page::getEntryCache()
+{
+    static EntryCache cache(CONFIG_NVS_ENTRY_CACHE_SIZE);
+    return cache;
+}
+
+esp_err_t Page::load(uint32_t sectorNumber, const MountSummary* summary)
 {
     mBaseAddress = sectorNumber * SEC_SIZE;
     mUsedEntryCount = 0;
     mErasedEntryCount = 0;
+    getEntryCache().invalidateRange(mBaseAddress, SEC_SIZE);
 
     Header header;
     auto rc = spi_flash_read(mBaseAddress, &header, sizeof(header));
@@ -81,6 +85,19 @@ esp_err_t Page::load(uint32_t sectorNumber)
         break;
 
     case PageState::FULL:
+        if (summary) {
+            bool loaded;
+            rc = loadFromSummary(*summary, loaded);
+            if (rc != ESP_OK) {
+                return rc;
+            }
+            if (loaded) {
+                break;
+            }
+        }
+        mLoadEntryTable();
+        break;
+
     case PageState::ACTIVE:
     case PageState::FREEING:
         mLoadEntryTable();
@@ -98,6 +115,7 @@ esp_err_t Page::writeEntry(const Item& item)
 {
     esp_err_t err;
 
+    getEntryCache().invalidate(getEntryAddress(mNextFreeEntry));
     err = nvs_flash_write(getEntryAddress(mNextFreeEntry), &item, sizeof(item));
 
     if (err != ESP_OK) {
@@ -146,6 +164,7 @@ esp_err_t Page::writeEntryData(const uint8_t* data, size_t size)
     }
 #endif //ESP_PLATFORM
 
+    getEntryCache().invalidateRange(getEntryAddress(mNextFreeEntry), size);
     auto rc = nvs_flash_write(getEntryAddress(mNextFreeEntry), buf, size);
 
 #ifdef ESP_PLATFORM
@@ -284,19 +303,23 @@ esp_err_t Page::readItem(uint8_t nsIndex, ItemType datatype, const char* key, vo
         return ESP_ERR_NVS_INVALID_LENGTH;
     }
 
+    // read whole data entries straight into the output buffer, only the last one is partial
     uint8_t* dst = reinterpret_cast<uint8_t*>(data);
-    size_t left = item.varLength.dataSize;
-    for (size_t i = index + 1; i < index + item.span; ++i) {
+    size_t fullEntries = item.varLength.dataSize / ENTRY_SIZE;
+    size_t left = item.varLength.dataSize % ENTRY_SIZE;
+    if (fullEntries > 0) {
+        rc = readEntryData(index + 1, dst, fullEntries);
+        if (rc != ESP_OK) {
+            return rc;
+        }
+    }
+    if (left > 0) {
         Item ditem;
-        rc = readEntry(i, ditem);
+        rc = readEntryData(index + 1 + fullEntries, &ditem, 1);
         if (rc != ESP_OK) {
             return rc;
         }
-        size_t willCopy = ENTRY_SIZE;
-        willCopy = (left < willCopy)?left:willCopy;
-        memcpy(dst, ditem.rawData, willCopy);
-        left -= willCopy;
-        dst += willCopy;
+        memcpy(dst + fullEntries * ENTRY_SIZE, ditem.rawData, left);
     }
     if (Item::calculateCrc32(reinterpret_cast<uint8_t*>(data), item.varLength.dataSize) != item.varLength.dataCrc32) {
         rc = eraseEntryAndSpan(index);
@@ -308,6 +331,45 @@ esp_err_t Page::readItem(uint8_t nsIndex, ItemType datatype, const char* key, vo
     return ESP_OK;
 }
 
+esp_err_t Page::readItemData(size_t index, size_t offset, void* data, size_t size)
+{
+    if (mState == PageState::INVALID) {
+        return ESP_ERR_NVS_INVALID_STATE;
+    }
+
+    // data of variable length items starts at the entry after the item header,
+    // entries within the range are read straight into the output buffer
+    uint8_t* dst = static_cast<uint8_t*>(data);
+    size_t entry = index + 1 + offset / ENTRY_SIZE;
+    size_t skip = offset % ENTRY_SIZE;
+    while (size > 0) {
+        esp_err_t rc;
+        if (skip == 0 && size >= ENTRY_SIZE) {
+            size_t count = size / ENTRY_SIZE;
+            rc = readEntryData(entry, dst, count);
+            if (rc != ESP_OK) {
+                return rc;
+            }
+            entry += count;
+            dst += count * ENTRY_SIZE;
+            size -= count * ENTRY_SIZE;
+            continue;
+        }
+        Item ditem;
+        rc = readEntryData(entry, &ditem, 1);
+        if (rc != ESP_OK) {
+            return rc;
+        }
+        size_t len = std::min(size, ENTRY_SIZE - skip);
+        memcpy(dst, ditem.rawData + skip, len);
+        ++entry;
+        skip = 0;
+        dst += len;
+        size -= len;
+    }
+    return ESP_OK;
+}
+
 esp_err_t Page::eraseItem(uint8_t nsIndex, ItemType datatype, const char* key, uint8_t chunkIdx, VerOffset chunkStart)
 {
     size_t index = 0;
@@ -404,14 +466,6 @@ esp_err_t Page::copyItems(Page& other)
         return ESP_ERR_NVS_NOT_FOUND;
     }
 
-    if (other.mState == PageState::UNINITIALIZED) {
-        auto err = other.initialize();
-        if (err != ESP_OK) {
-            return err;
-        }
-    }
-
-    Item entry;
     size_t readEntryIndex = mFirstUsedEntry;
 
     while (readEntryIndex < ENTRY_COUNT) {
@@ -421,31 +475,102 @@ esp_err_t Page::copyItems(Page& other)
             readEntryIndex++;
             continue;
         }
-        auto err = readEntry(readEntryIndex, entry);
+        size_t span;
+        auto err = copyItem(readEntryIndex, other, span);
         if (err != ESP_OK) {
             return err;
         }
+        readEntryIndex += span;
 
-        other.mHashList.insert(entry, other.mNextFreeEntry);
-        err = other.writeEntry(entry);
+    }
+    return ESP_OK;
+}
+
+esp_err_t Page::copyItem(size_t index, Page& other, size_t& span)
+{
+    if (other.mState == PageState::UNINITIALIZED) {
+        auto err = other.initialize();
         if (err != ESP_OK) {
             return err;
         }
-        size_t span = entry.span;
-        size_t end = readEntryIndex + span;
+    }
 
-        assert(end <= ENTRY_COUNT);
+    Item entry;
+    auto err = readEntry(index, entry);
+    if (err != ESP_OK) {
+        return err;
+    }
 
-        for (size_t i = readEntryIndex + 1; i < end; ++i) {
-            readEntry(i, entry);
-            err = other.writeEntry(entry);
-            if (err != ESP_OK) {
-                return err;
+    span = entry.span;
+    size_t end = index + span;
+
+    assert(end <= ENTRY_COUNT);
+
+    if (other.getFreeEntryCount() < span) {
+        return ESP_ERR_NVS_PAGE_FULL;
+    }
+
+    other.mHashList.insert(entry, other.mNextFreeEntry);
+    err = other.writeEntry(entry);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    for (size_t i = index + 1; i < end; ++i) {
+        readEntryData(i, &entry, 1);
+        err = other.writeEntry(entry);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+void Page::countEntries()
+{
+    mErasedEntryCount = 0;
+    mUsedEntryCount = 0;
+    for (size_t i = 0; i < ENTRY_COUNT; ++i) {
+        auto s = mEntryTable.get(i);
+        if (s == EntryState::WRITTEN) {
+            if (mFirstUsedEntry == INVALID_ENTRY) {
+                mFirstUsedEntry = i;
             }
+            ++mUsedEntryCount;
+        } else if (s == EntryState::ERASED) {
+            ++mErasedEntryCount;
         }
-        readEntryIndex = end;
+    }
+}
+
+uint32_t Page::getEntryTableCrc32() const
+{
+    return esp_crc32_le(0xffffffff, reinterpret_cast<const uint8_t*>(mEntryTable.data()), mEntryTable.byteSize());
+}
 
+esp_err_t Page::loadFromSummary(const MountSummary& summary, bool& loaded)
+{
+    loaded = false;
+    auto pageRecord = summary.find(mSeqNumber);
+    if (pageRecord == nullptr) {
+        return ESP_OK;
+    }
+    auto rc = spi_flash_read(mBaseAddress + ENTRY_TABLE_OFFSET, mEntryTable.data(), mEntryTable.byteSize());
+    if (rc != ESP_OK) {
+        mState = PageState::INVALID;
+        return rc;
     }
+    // any entry written or erased since the summary was made changes the table
+    if (getEntryTableCrc32() != pageRecord->entryTableCrc32) {
+        return ESP_OK;
+    }
+
+    countEntries();
+    auto records = summary.getRecords(*pageRecord);
+    for (size_t i = 0; i < pageRecord->recordCount; ++i) {
+        mHashList.insert(records[i].hash, records[i].index);
+    }
+    loaded = true;
     return ESP_OK;
 }
 
@@ -463,19 +588,7 @@ esp_err_t Page::mLoadEntryTable()
         }
     }
 
-    mErasedEntryCount = 0;
-    mUsedEntryCount = 0;
-    for (size_t i = 0; i < ENTRY_COUNT; ++i) {
-        auto s = mEntryTable.get(i);
-        if (s == EntryState::WRITTEN) {
-            if (mFirstUsedEntry == INVALID_ENTRY) {
-                mFirstUsedEntry = i;
-            }
-            ++mUsedEntryCount;
-        } else if (s == EntryState::ERASED) {
-            ++mErasedEntryCount;
-        }
-    }
+    countEntries();
 
     // for PageState::ACTIVE, we may have more data written to this page
     // as such, we need to figure out where the first unused entry is
@@ -520,6 +633,7 @@ esp_err_t Page::mLoadEntryTable()
         // check that all variable-length items are written or erased fully
         Item item;
         size_t lastItemIndex = INVALID_ENTRY;
+        bool transactionMarkFound = false;
         size_t end = mNextFreeEntry;
         if (end > ENTRY_COUNT) {
             end = ENTRY_COUNT;
@@ -551,6 +665,12 @@ esp_err_t Page::mLoadEntryTable()
 
             mHashList.insert(item, i);
 
+            // items written after a transaction mark may have to be rolled back,
+            // so the older copies they duplicate are left to PageManager
+            if (item.nsIndex == NS_INDEX && item.datatype == ItemType::TXN_MARK) {
+                transactionMarkFound = true;
+            }
+
             // search for potential duplicate item
             size_t duplicateIndex = mHashList.find(0, item);
 
@@ -574,13 +694,13 @@ esp_err_t Page::mLoadEntryTable()
              * when old-format blob is present along with new-format blob-index 
              * for same key on active page. Since datatype is not used in hash calculation, 
              * old-format blob will be removed.*/
-            if (duplicateIndex < i) {
+            if (duplicateIndex < i && !transactionMarkFound) {
                 eraseEntryAndSpan(duplicateIndex);
             }
         }
 
         // check that last item is not duplicate
-        if (lastItemIndex != INVALID_ENTRY) {
+        if (lastItemIndex != INVALID_ENTRY && !transactionMarkFound) {
             size_t findItemIndex = 0;
             Item dupItem;
             if (findItem(item.nsIndex, item.datatype, item.key, findItemIndex, dupItem) == ESP_OK) {
@@ -665,6 +785,9 @@ esp_err_t Page::initialize()
 esp_err_t Page::alterEntryState(size_t index, EntryState state)
 {
     assert(index < ENTRY_COUNT);
+    if (state == EntryState::ERASED) {
+        getEntryCache().invalidate(getEntryAddress(index));
+    }
     mEntryTable.set(index, state);
     size_t wordToWrite = mEntryTable.getWordIndex(index);
     uint32_t word = mEntryTable.data()[wordToWrite];
@@ -681,6 +804,9 @@ esp_err_t Page::alterEntryRangeState(size_t begin, size_t end, EntryState state)
 {
     assert(end <= ENTRY_COUNT);
     assert(end > begin);
+    if (state == EntryState::ERASED) {
+        getEntryCache().invalidateRange(getEntryAddress(begin), (end - begin) * ENTRY_SIZE);
+    }
     size_t wordIndex = mEntryTable.getWordIndex(end - 1);
     for (ptrdiff_t i = end - 1; i >= static_cast<ptrdiff_t>(begin); --i) {
         mEntryTable.set(i, state);
@@ -717,13 +843,24 @@ esp_err_t Page::alterPageState(PageState state)
 
 esp_err_t Page::readEntry(size_t index, Item& dst) const
 {
+    if (getEntryCache().read(getEntryAddress(index), dst)) {
+        return ESP_OK;
+    }
     auto rc = nvs_flash_read(getEntryAddress(index), &dst, sizeof(dst));
     if (rc != ESP_OK) {
         return rc;
     }
+    getEntryCache().insert(getEntryAddress(index), dst);
     return ESP_OK;
 }
 
+esp_err_t Page::readEntryData(size_t index, void* dst, size_t count) const
+{
+    // data entries bypass the entry cache, so that blob chunks don't evict item headers
+    assert(index + count <= ENTRY_COUNT);
+    return nvs_flash_read(getEntryAddress(index), dst, count * ENTRY_SIZE);
+}
+
 esp_err_t Page::findItem(uint8_t nsIndex, ItemType datatype, const char* key, size_t &itemIndex, Item& item, uint8_t chunkIdx, VerOffset chunkStart)
 {
     if (mState == PageState::CORRUPT || mState == PageState::INVALID || mState == PageState::UNINITIALIZED) {
@@ -854,6 +991,7 @@ esp_err_t Page::setVersion(uint8_t ver)
 esp_err_t Page::erase()
 {
     auto sector = mBaseAddress / SPI_FLASH_SEC_SIZE;
+    getEntryCache().invalidateRange(mBaseAddress, SEC_SIZE);
     auto rc = spi_flash_erase_sector(sector);
     if (rc != ESP_OK) {
         mState = PageState::INVALID;
@@ -895,6 +1033,16 @@ size_t Page::getVarDataTailroom() const
     return ((mNextFreeEntry < (ENTRY_COUNT-1)) ? ((ENTRY_COUNT - mNextFreeEntry - 1) * ENTRY_SIZE): 0);
 }
 
+size_t Page::getFreeEntryCount() const
+{
+    if (mState == PageState::UNINITIALIZED) {
+        return ENTRY_COUNT;
+    } else if (mState != PageState::ACTIVE || mNextFreeEntry >= ENTRY_COUNT) {
+        return 0;
+    }
+    return ENTRY_COUNT - mNextFreeEntry;
+}
+
 const char* Page::pageStateToName(PageState ps)
 {
     switch (ps) {
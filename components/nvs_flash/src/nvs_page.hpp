@@ -24,6 +24,8 @@
 #include "compressed_enum_table.hpp"
 #include "intrusive_list.h"
 #include "nvs_item_hash_list.hpp"
+#include "nvs_entry_cache.hpp"
+#include "nvs_mount_summary.hpp"
 
 namespace nvs
 {
@@ -82,7 +84,7 @@ public:
         return mState;
     }
 
-    esp_err_t load(uint32_t sectorNumber);
+    esp_err_t load(uint32_t sectorNumber, const MountSummary* summary = nullptr);
 
     esp_err_t getSeqNumber(uint32_t& seqNumber) const;
 
@@ -94,6 +96,8 @@ public:
 
     esp_err_t readItem(uint8_t nsIndex, ItemType datatype, const char* key, void* data, size_t dataSize, uint8_t chunkIdx = CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
 
+    esp_err_t readItemData(size_t index, size_t offset, void* data, size_t size);
+
     esp_err_t eraseItem(uint8_t nsIndex, ItemType datatype, const char* key, uint8_t chunkIdx = CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
 
     esp_err_t findItem(uint8_t nsIndex, ItemType datatype, const char* key, uint8_t chunkIdx = CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
@@ -129,18 +133,33 @@ public:
     }
     size_t getVarDataTailroom() const ;
 
+    size_t getFreeEntryCount() const;
+
     esp_err_t markFull();
 
     esp_err_t markFreeing();
 
     esp_err_t copyItems(Page& other);
 
+    esp_err_t copyItem(size_t index, Page& other, size_t& span);
+
     esp_err_t erase();
 
+    esp_err_t eraseEntryAndSpan(size_t index);
+
     void debugDump() const;
 
     esp_err_t calcEntries(nvs_stats_t &nvsStats);
 
+    uint32_t getEntryTableCrc32() const;
+
+    uint32_t getItemDataAddress(size_t index) const
+    {
+        return getEntryAddress(index + 1);
+    }
+
+    static EntryCache& getEntryCache();
+
 protected:
 
     class Header
@@ -169,6 +188,10 @@ protected:
 
     esp_err_t mLoadEntryTable();
 
+    esp_err_t loadFromSummary(const MountSummary& summary, bool& loaded);
+
+    void countEntries();
+
     esp_err_t initialize();
 
     esp_err_t alterEntryState(size_t index, EntryState state);
@@ -179,12 +202,12 @@ protected:
 
     esp_err_t readEntry(size_t index, Item& dst) const;
 
+    esp_err_t readEntryData(size_t index, void* dst, size_t count) const;
+
     esp_err_t writeEntry(const Item& item);
     
     esp_err_t writeEntryData(const uint8_t* data, size_t size);
 
-    esp_err_t eraseEntryAndSpan(size_t index);
-
     void updateFirstUsedEntry(size_t index, size_t span);
 
     static constexpr size_t getAlignmentForType(ItemType type)
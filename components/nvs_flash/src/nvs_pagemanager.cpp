@@ -15,16 +15,20 @@
 
 namespace nvs
 {
-esp_err_t PageManager::load(uint32_t baseSector, uint32_t sectorCount)
+const char* const PageManager::TXN_BEGIN_KEY = "txn_begin";
+const char* const PageManager::TXN_COMMIT_KEY = "txn_commit";
+
+esp_err_t PageManager::load(uint32_t baseSector, uint32_t sectorCount, const MountSummary* summary)
 {
     mBaseSector = baseSector;
     mPageCount = sectorCount;
     mPageList.clear();
     mFreePageList.clear();
+    mFreeingPage = nullptr;
     mPages.reset(new Page[sectorCount]);
 
     for (uint32_t i = 0; i < sectorCount; ++i) {
-        auto err = mPages[i].load(baseSector + i);
+        auto err = mPages[i].load(baseSector + i, summary);
         if (err != ESP_OK) {
             return err;
         }
@@ -53,6 +57,12 @@ esp_err_t PageManager::load(uint32_t baseSector, uint32_t sectorCount)
         mSeqNumber = lastSeqNo + 1;
     }
 
+    // if power went out during a transaction, either roll it back or finish it
+    auto err = recoverTransactions();
+    if (err != ESP_OK) {
+        return err;
+    }
+
     // if power went out after a new item for the given key was written,
     // but before the old one was erased, we end up with a duplicate item
     Page& lastPage = back();
@@ -91,6 +101,15 @@ esp_err_t PageManager::load(uint32_t baseSector, uint32_t sectorCount)
     // check if power went out while page was being freed
     for (auto it = begin(); it!= end(); ++it) {
         if (it->state() == Page::PageState::FREEING) {
+            if (!mFreePageList.empty()) {
+                auto err = resumeReclaim(it);
+                if (err != ESP_OK) {
+                    return err;
+                }
+                break;
+            }
+
+            // the last free page was taken to copy all the items at once
             Page* newPage = &mPageList.back();
             if (newPage->state() == Page::PageState::ACTIVE) {
                 auto err = newPage->erase();
@@ -131,7 +150,7 @@ esp_err_t PageManager::load(uint32_t baseSector, uint32_t sectorCount)
     return ESP_OK;
 }
 
-esp_err_t PageManager::requestNewPage()
+esp_err_t PageManager::requestNewPage(Page** reclaimedPage)
 {
     if (mFreePageList.empty()) {
         return ESP_ERR_NVS_INVALID_STATE;
@@ -166,6 +185,10 @@ esp_err_t PageManager::requestNewPage()
     Page* newPage = &mPageList.back();
 
     Page* erasedPage = maxUnusedItemsPageIt;
+    if (reclaimedPage) {
+        // items of erasedPage are about to be copied to newPage
+        *reclaimedPage = erasedPage;
+    }
 
 #ifndef NDEBUG
     size_t usedEntries = erasedPage->getUsedEntryCount();
@@ -194,6 +217,108 @@ esp_err_t PageManager::requestNewPage()
     return ESP_OK;
 }
 
+esp_err_t PageManager::startReclaim()
+{
+    assert(mFreeingPage == nullptr);
+
+    // same choice as requestNewPage, but the active page is left alone,
+    // as the items are copied onto it
+    TPageListIterator maxUnusedItemsPageIt;
+    size_t maxUnusedItems = 0;
+    for (auto it = begin(); it != end(); ++it) {
+        if (it->state() != Page::PageState::FULL) {
+            continue;
+        }
+        auto unused = Page::ENTRY_COUNT - it->getUsedEntryCount();
+        if (unused > maxUnusedItems) {
+            maxUnusedItemsPageIt = it;
+            maxUnusedItems = unused;
+        }
+    }
+
+    if (maxUnusedItems == 0) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    auto err = maxUnusedItemsPageIt->markFreeing();
+    if (err != ESP_OK) {
+        return err;
+    }
+    mFreeingPage = maxUnusedItemsPageIt;
+    return ESP_OK;
+}
+
+esp_err_t PageManager::finishReclaim()
+{
+    assert(mFreeingPage != nullptr);
+
+    auto err = mFreeingPage->erase();
+    if (err != ESP_OK) {
+        return err;
+    }
+    mPageList.erase(mFreeingPage);
+    mFreePageList.push_back(mFreeingPage);
+    mFreeingPage = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t PageManager::resumeReclaim(TPageListIterator freeingPage)
+{
+    // Unless the last free page was taken, items are moved one by one onto the active page,
+    // and each of them is erased on the freeing page once it has been copied. Items which are
+    // also present on one of the following pages have been copied (or written again with
+    // a new value) before power went out, so only the remaining items are copied.
+    Item item;
+    size_t itemIndex = 0;
+    while (freeingPage->findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) == ESP_OK) {
+        bool copied = false;
+        for (auto it = freeingPage; ++it != end();) {
+            Item copy;
+            size_t copyIndex = 0;
+            VerOffset chunkStart = (item.datatype == ItemType::BLOB_IDX) ? item.blobIndex.chunkStart : VerOffset::VER_ANY;
+            if (it->findItem(item.nsIndex, item.datatype, item.key, copyIndex, copy, item.chunkIndex, chunkStart) == ESP_OK) {
+                copied = true;
+                break;
+            }
+        }
+
+        esp_err_t err;
+        if (!copied) {
+            size_t span;
+            Page* newPage = &mPageList.back();
+            err = ESP_ERR_NVS_PAGE_FULL;
+            if (newPage->state() == Page::PageState::ACTIVE) {
+                err = freeingPage->copyItem(itemIndex, *newPage, span);
+            }
+            if (err == ESP_ERR_NVS_PAGE_FULL) {
+                if (newPage->state() == Page::PageState::ACTIVE) {
+                    err = newPage->markFull();
+                    if (err != ESP_OK) {
+                        return err;
+                    }
+                }
+                err = activatePage();
+                if (err != ESP_OK) {
+                    return err;
+                }
+                err = freeingPage->copyItem(itemIndex, mPageList.back(), span);
+            }
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+
+        err = freeingPage->eraseEntryAndSpan(itemIndex);
+        if (err != ESP_OK) {
+            return err;
+        }
+        itemIndex += item.span;
+    }
+
+    mFreeingPage = freeingPage;
+    return finishReclaim();
+}
+
 esp_err_t PageManager::activatePage()
 {
     if (mFreePageList.empty()) {
@@ -213,6 +338,136 @@ esp_err_t PageManager::activatePage()
     return ESP_OK;
 }
 
+esp_err_t PageManager::findTransactionMark(const char* key, TPageListIterator& page, size_t& itemIndex)
+{
+    Item item;
+    for (; page != end(); ++page, itemIndex = 0) {
+        if (page->findItem(Page::NS_INDEX, ItemType::TXN_MARK, key, itemIndex, item, TXN_MARK_CHUNK) == ESP_OK) {
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t PageManager::recoverTransactions()
+{
+    // Storage writes a begin mark, the items of the transaction, then a commit mark.
+    // Pages are never reclaimed in between, so every item after the begin mark
+    // belongs to the transaction.
+    while (true) {
+        TPageListIterator beginPage = begin();
+        size_t beginIndex = 0;
+        if (findTransactionMark(TXN_BEGIN_KEY, beginPage, beginIndex) != ESP_OK) {
+            break;
+        }
+        TPageListIterator commitPage = beginPage;
+        size_t commitIndex = beginIndex + 1;
+        esp_err_t err;
+        if (findTransactionMark(TXN_COMMIT_KEY, commitPage, commitIndex) == ESP_OK) {
+            err = finishTransaction(beginPage, beginIndex);
+        } else {
+            err = rollbackTransaction(beginPage, beginIndex);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    // the begin mark is erased first, so a commit mark may be left on its own
+    TPageListIterator page = begin();
+    size_t itemIndex = 0;
+    while (findTransactionMark(TXN_COMMIT_KEY, page, itemIndex) == ESP_OK) {
+        auto err = page->eraseEntryAndSpan(itemIndex);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t PageManager::rollbackTransaction()
+{
+    TPageListIterator beginPage = begin();
+    size_t beginIndex = 0;
+    if (findTransactionMark(TXN_BEGIN_KEY, beginPage, beginIndex) != ESP_OK) {
+        return ESP_OK;
+    }
+    return rollbackTransaction(beginPage, beginIndex);
+}
+
+esp_err_t PageManager::rollbackTransaction(TPageListIterator beginPage, size_t beginIndex)
+{
+    // the items which the transaction was going to replace are still in place,
+    // so dropping everything written after the begin mark restores them
+    size_t itemIndex = beginIndex + 1;
+    Item item;
+    for (auto it = beginPage; it != end(); ++it, itemIndex = 0) {
+        while (it->findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) == ESP_OK) {
+            auto err = it->eraseEntryAndSpan(itemIndex);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return beginPage->eraseEntryAndSpan(beginIndex);
+}
+
+esp_err_t PageManager::finishTransaction(TPageListIterator beginPage, size_t beginIndex)
+{
+    // the transaction was committed, erase what it replaced
+    size_t itemIndex = beginIndex + 1;
+    Item item;
+    for (auto it = beginPage; it != end(); ++it, itemIndex = 0) {
+        while (it->findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) == ESP_OK) {
+            itemIndex += item.span;
+            /* Data chunks of a replaced blob become orphans once its index is erased,
+             * Storage cleans them up during init */
+            if (item.datatype == ItemType::BLOB_DATA || item.datatype == ItemType::TXN_MARK) {
+                continue;
+            }
+            auto err = erasePreviousItems(item, beginPage, beginIndex);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return beginPage->eraseEntryAndSpan(beginIndex);
+}
+
+esp_err_t PageManager::erasePreviousItems(const Item& item, TPageListIterator beginPage, size_t beginIndex)
+{
+    for (auto it = begin(); it != end(); ++it) {
+        size_t itemIndex = 0;
+        Item previous;
+        while (it->findItem(item.nsIndex, item.datatype, item.key, itemIndex, previous) == ESP_OK) {
+            if (it == beginPage && itemIndex > beginIndex) {
+                break;
+            }
+            auto err = it->eraseEntryAndSpan(itemIndex);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        if (item.datatype == ItemType::BLOB_IDX) {
+            /* The blob may have been stored in the old format before */
+            itemIndex = 0;
+            while (it->findItem(item.nsIndex, ItemType::BLOB, item.key, itemIndex, previous) == ESP_OK) {
+                if (it == beginPage && itemIndex > beginIndex) {
+                    break;
+                }
+                auto err = it->eraseEntryAndSpan(itemIndex);
+                if (err != ESP_OK) {
+                    return err;
+                }
+            }
+        }
+        if (it == beginPage) {
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
 esp_err_t PageManager::fillStats(nvs_stats_t& nvsStats)
 {
     nvsStats.used_entries      = 0;
@@ -29,9 +29,15 @@ class PageManager
     using TPageListIterator = TPageList::iterator;
 public:
 
+    static const char* const TXN_BEGIN_KEY;
+    static const char* const TXN_COMMIT_KEY;
+    // marks use a chunk index which namespace entries never have, so that their
+    // hash doesn't collide with a namespace of the same name
+    static const uint8_t TXN_MARK_CHUNK = 0;
+
     PageManager() {}
 
-    esp_err_t load(uint32_t baseSector, uint32_t sectorCount);
+    esp_err_t load(uint32_t baseSector, uint32_t sectorCount, const MountSummary* summary = nullptr);
 
     TPageListIterator begin()
     {
@@ -52,7 +58,25 @@ public:
         return mPageCount;
     }
 
-    esp_err_t requestNewPage();
+    size_t getFreePageCount() const
+    {
+        return mFreePageList.size();
+    }
+
+    esp_err_t requestNewPage(Page** reclaimedPage = nullptr);
+
+    esp_err_t activatePage();
+
+    Page* getFreeingPage() const
+    {
+        return mFreeingPage;
+    }
+
+    esp_err_t startReclaim();
+
+    esp_err_t finishReclaim();
+
+    esp_err_t rollbackTransaction();
 
     esp_err_t fillStats(nvs_stats_t& nvsStats);
 
@@ -64,7 +88,17 @@ public:
 protected:
     friend class Iterator;
 
-    esp_err_t activatePage();
+    esp_err_t resumeReclaim(TPageListIterator freeingPage);
+
+    esp_err_t findTransactionMark(const char* key, TPageListIterator& page, size_t& itemIndex);
+
+    esp_err_t recoverTransactions();
+
+    esp_err_t rollbackTransaction(TPageListIterator beginPage, size_t beginIndex);
+
+    esp_err_t finishTransaction(TPageListIterator beginPage, size_t beginIndex);
+
+    esp_err_t erasePreviousItems(const Item& item, TPageListIterator beginPage, size_t beginIndex);
 
     TPageList mPageList;
     TPageList mFreePageList;
@@ -72,6 +106,7 @@ protected:
     uint32_t mBaseSector;
     uint32_t mPageCount;
     uint32_t mSeqNumber;
+    Page* mFreeingPage = nullptr;
 }; // class PageManager
 
 
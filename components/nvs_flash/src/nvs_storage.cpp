@@ -12,6 +12,11 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include "nvs_storage.hpp"
+#ifdef CONFIG_NVS_ENCRYPTION
+#include "nvs_encr.hpp"
+#endif
+
+#include <algorithm>
 
 #ifndef ESP_PLATFORM
 #include <map>
@@ -21,6 +26,31 @@
 namespace nvs
 {
 
+Storage::TransactionItem::TransactionItem(ItemType datatype, const char* key, const void* data, size_t dataSize)
+    : datatype(datatype), data(new uint8_t[dataSize]), dataSize(dataSize),
+      unchanged(false), written(false), hasPrevious(false),
+      prevStart(VerOffset::VER_ANY), nextStart(VerOffset::VER_0_OFFSET)
+{
+    strncpy(this->key, key, sizeof(this->key) - 1);
+    this->key[sizeof(this->key) - 1] = 0;
+    memcpy(this->data.get(), data, dataSize);
+}
+
+size_t Storage::TransactionItem::entryCount() const
+{
+    const size_t dataEntries = (dataSize + Page::ENTRY_SIZE - 1) / Page::ENTRY_SIZE;
+    if (datatype == ItemType::BLOB) {
+        /* Upper bound: a header per chunk, the index, and the tail of a page which
+         * is skipped when it is too small for the first chunk */
+        return dataEntries + (dataSize / Page::CHUNK_MAX_SIZE + 2) + 1
+               + Page::CHUNK_MAX_SIZE / 10 / Page::ENTRY_SIZE + 1;
+    }
+    if (isVariableLengthType(datatype)) {
+        return 1 + dataEntries;
+    }
+    return 1;
+}
+
 Storage::~Storage()
 {
     clearNamespaces();
@@ -42,7 +72,10 @@ void Storage::populateBlobIndices(TBlobIndexList& blobIdxList)
          * logic in pagemanager will remove the earlier index. So we should never find a
          * duplicate index at this point */
 
-        while (p.findItem(Page::NS_ANY, ItemType::BLOB_IDX, nullptr, itemIndex, item) == ESP_OK) {
+        size_t recordCount = 0;
+        auto records = findSummaryRecords(p, recordCount);
+
+        while (findItemOfType(p, records, recordCount, ItemType::BLOB_IDX, itemIndex, item) == ESP_OK) {
             BlobIndexNode* entry = new BlobIndexNode;
 
             item.getKey(entry->key, sizeof(entry->key) - 1);
@@ -67,7 +100,9 @@ void Storage::eraseOrphanDataBlobs(TBlobIndexList& blobIdxList)
          * 1) VER_0_OFFSET <= chunkIndex < VER_1_OFFSET-1 => Version0 chunks
          * 2) VER_1_OFFSET <= chunkIndex < VER_ANY => Version1 chunks
          */
-        while (p.findItem(Page::NS_ANY, ItemType::BLOB_DATA, nullptr, itemIndex, item) == ESP_OK) {
+        size_t recordCount = 0;
+        auto records = findSummaryRecords(p, recordCount);
+        while (findItemOfType(p, records, recordCount, ItemType::BLOB_DATA, itemIndex, item) == ESP_OK) {
 
             auto iter = std::find_if(blobIdxList.begin(),
                     blobIdxList.end(),
@@ -77,34 +112,159 @@ void Storage::eraseOrphanDataBlobs(TBlobIndexList& blobIdxList)
                             && (item.chunkIndex >=  static_cast<uint8_t> (e.chunkStart))
                             && (item.chunkIndex < static_cast<uint8_t> (e.chunkStart) + e.chunkCount);});
             if (iter == std::end(blobIdxList)) {
-                p.eraseItem(item.nsIndex, item.datatype, item.key, item.chunkIndex);
+                if (p.eraseItem(item.nsIndex, item.datatype, item.key, item.chunkIndex) == ESP_OK) {
+                    mItemIndex.erase(item, &p);
+                }
             }
             itemIndex += item.span;
         }
     }
 }
 
+const MountSummary::Record* Storage::findSummaryRecords(Page& page, size_t& recordCount)
+{
+    uint32_t seqNumber;
+    if (!mMountSummary.isValid() || page.state() != Page::PageState::FULL || page.getSeqNumber(seqNumber) != ESP_OK) {
+        return nullptr;
+    }
+    auto pageRecord = mMountSummary.find(seqNumber);
+    if (pageRecord == nullptr || pageRecord->entryTableCrc32 != page.getEntryTableCrc32()) {
+        return nullptr;
+    }
+    recordCount = pageRecord->recordCount;
+    return mMountSummary.getRecords(*pageRecord);
+}
+
+esp_err_t Storage::findItemOfType(Page& page, const MountSummary::Record* records, size_t recordCount, ItemType datatype, size_t& itemIndex, Item& item)
+{
+    if (records == nullptr) {
+        return page.findItem(Page::NS_ANY, datatype, nullptr, itemIndex, item);
+    }
+    // the summary tells where the items of the type are, so only those entries are read
+    for (size_t i = 0; i < recordCount; ++i) {
+        if (records[i].index >= itemIndex && records[i].datatype == datatype) {
+            itemIndex = records[i].index;
+            return page.findItem(Page::NS_ANY, datatype, nullptr, itemIndex, item);
+        }
+    }
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+bool Storage::reserveMountSummarySector(uint32_t baseSector, uint32_t sectorCount)
+{
+    if (!mUseMountSummary || sectorCount < MIN_SECTORS_FOR_MOUNT_SUMMARY) {
+        return false;
+    }
+#ifdef CONFIG_NVS_ENCRYPTION
+    // the summary holds item hashes and types in plain text
+    if (EncrMgr::isEncrActive() && EncrMgr::getInstance()->findXtsCtxtFromAddr(baseSector * SPI_FLASH_SEC_SIZE)) {
+        return false;
+    }
+#endif
+    bool reserved;
+    if (MountSummary::isReserved(baseSector, sectorCount, reserved) != ESP_OK) {
+        return false;
+    }
+    return reserved;
+}
+
+esp_err_t Storage::updateMountSummary(size_t fullPageCount, size_t scannedPageCount)
+{
+    // Rewriting the summary erases its sector, so it is only rewritten when a
+    // good part of the full pages had to be scanned. Pages which didn't fit into
+    // the summary last time are expected to be scanned.
+    if (!scannedPageCount) {
+        return ESP_OK;
+    }
+    if (mMountSummary.isValid() &&
+            (scannedPageCount - std::min(scannedPageCount, mMountSummary.getOmittedPageCount())) * 4 <= fullPageCount) {
+        return ESP_OK;
+    }
+
+    auto err = mMountSummary.build(fullPageCount);
+    if (err != ESP_OK) {
+        return err;
+    }
+    for (auto it = mPageManager.begin(); it != mPageManager.end(); ++it) {
+        if (it->state() == Page::PageState::FULL) {
+            err = mMountSummary.addPage(*it);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return mMountSummary.write(mMountSummarySector);
+}
+
 esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount)
 {
-    auto err = mPageManager.load(baseSector, sectorCount);
+    // with the mount summary, the last sector of the partition holds it instead of a page
+    mMountSummary.clear();
+    mHasMountSummarySector = reserveMountSummarySector(baseSector, sectorCount);
+    if (mHasMountSummarySector) {
+        --sectorCount;
+        mMountSummarySector = baseSector + sectorCount;
+        auto err = mMountSummary.load(mMountSummarySector);
+        if (err != ESP_OK) {
+            mState = StorageState::INVALID;
+            return err;
+        }
+    }
+
+    auto err = mPageManager.load(baseSector, sectorCount, &mMountSummary);
     if (err != ESP_OK) {
+        mMountSummary.clear();
         mState = StorageState::INVALID;
         return err;
     }
 
-    // load namespaces list
+    // load namespaces list and build the item index in the same pass
     clearNamespaces();
     std::fill_n(mNamespaceUsage.data(), mNamespaceUsage.byteSize() / 4, 0);
+    mItemIndex.build();
+    size_t fullPageCount = 0;
+    size_t scannedPageCount = 0;
     for (auto it = mPageManager.begin(); it != mPageManager.end(); ++it) {
         Page& p = *it;
         size_t itemIndex = 0;
         Item item;
-        while (p.findItem(Page::NS_INDEX, ItemType::U8, nullptr, itemIndex, item) == ESP_OK) {
-            NamespaceEntry* entry = new NamespaceEntry;
-            item.getKey(entry->mName, sizeof(entry->mName) - 1);
-            item.getValue(entry->mIndex);
-            mNamespaces.push_back(entry);
-            mNamespaceUsage.set(entry->mIndex, true);
+        size_t recordCount = 0;
+        auto records = findSummaryRecords(p, recordCount);
+        if (p.state() == Page::PageState::FULL) {
+            ++fullPageCount;
+            if (records == nullptr) {
+                ++scannedPageCount;
+            }
+        }
+        if (records) {
+            for (size_t i = 0; i < recordCount; ++i) {
+                if (records[i].nsIndex == Page::NS_INDEX && records[i].datatype == ItemType::U8) {
+                    itemIndex = records[i].index;
+                    err = p.findItem(Page::NS_INDEX, ItemType::U8, nullptr, itemIndex, item);
+                    if (err != ESP_OK) {
+                        mMountSummary.clear();
+                        mState = StorageState::INVALID;
+                        return err;
+                    }
+                    NamespaceEntry* entry = new NamespaceEntry;
+                    item.getKey(entry->mName, sizeof(entry->mName) - 1);
+                    item.getValue(entry->mIndex);
+                    mNamespaces.push_back(entry);
+                    mNamespaceUsage.set(entry->mIndex, true);
+                }
+                mItemIndex.insert(records[i].hash, &p);
+            }
+            continue;
+        }
+        while (p.findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) == ESP_OK) {
+            if (item.nsIndex == Page::NS_INDEX && item.datatype == ItemType::U8) {
+                NamespaceEntry* entry = new NamespaceEntry;
+                item.getKey(entry->mName, sizeof(entry->mName) - 1);
+                item.getValue(entry->mIndex);
+                mNamespaces.push_back(entry);
+                mNamespaceUsage.set(entry->mIndex, true);
+            }
+            mItemIndex.insert(item, &p);
             itemIndex += item.span;
         }
     }
@@ -122,6 +282,12 @@ esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount)
     // Purge the blob index list
     blobIdxList.clearAndFreeNodes();
 
+    if (mHasMountSummarySector) {
+        // the summary is only an optimization, the next init scans the pages if it couldn't be written
+        updateMountSummary(fullPageCount, scannedPageCount);
+        mMountSummary.clear();
+    }
+
 #ifndef ESP_PLATFORM
     debugCheck();
 #endif
@@ -133,10 +299,44 @@ bool Storage::isValid() const
     return mState == StorageState::ACTIVE;
 }
 
-esp_err_t Storage::findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx, VerOffset chunkStart)
+esp_err_t Storage::findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, size_t& itemIndex, Item& item, uint8_t chunkIdx, VerOffset chunkStart)
 {
+    /* The index is keyed by <ns,key,chunkIndex>, so it can't answer wildcard
+     * searches: any datatype, or any chunk of a blob data item. */
+    if (mItemIndex.isActive() && datatype != ItemType::ANY
+            && !(datatype == ItemType::BLOB_DATA && chunkIdx == Page::CHUNK_ANY)) {
+        const size_t MAX_CANDIDATES = 4;
+        Page* candidates[MAX_CANDIDATES];
+        size_t count = mItemIndex.findPages(Item(nsIndex, datatype, 0, key, chunkIdx), candidates, MAX_CANDIDATES);
+        if (count <= MAX_CANDIDATES) {
+            Page* found = nullptr;
+            uint32_t foundSeqNumber = UINT32_MAX;
+            for (size_t i = 0; i < count; ++i) {
+                size_t candidateIndex = 0;
+                Item candidateItem;
+                if (candidates[i]->findItem(nsIndex, datatype, key, candidateIndex, candidateItem, chunkIdx, chunkStart) != ESP_OK) {
+                    continue;
+                }
+                // same as the full scan below, prefer the oldest page if the item is found on several
+                uint32_t seqNumber;
+                candidates[i]->getSeqNumber(seqNumber);
+                if (found == nullptr || seqNumber < foundSeqNumber) {
+                    found = candidates[i];
+                    foundSeqNumber = seqNumber;
+                    itemIndex = candidateIndex;
+                    item = candidateItem;
+                }
+            }
+            if (found == nullptr) {
+                return ESP_ERR_NVS_NOT_FOUND;
+            }
+            page = found;
+            return ESP_OK;
+        }
+    }
+
     for (auto it = std::begin(mPageManager); it != std::end(mPageManager); ++it) {
-        size_t itemIndex = 0;
+        itemIndex = 0;
         auto err = it->findItem(nsIndex, datatype, key, itemIndex, item, chunkIdx, chunkStart);
         if (err == ESP_OK) {
             page = it;
@@ -146,22 +346,200 @@ esp_err_t Storage::findItem(uint8_t nsIndex, ItemType datatype, const char* key,
     return ESP_ERR_NVS_NOT_FOUND;
 }
 
-esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const void* data, size_t dataSize, VerOffset chunkStart)
+esp_err_t Storage::requestNewPage()
 {
-    uint8_t chunkCount = 0;
-    TUsedPageList usedPages;
-    size_t remainingSize = dataSize;
-    size_t offset=0;
-    esp_err_t err = ESP_OK;
+    if (mInTransaction && mPageManager.getFreePageCount() < 2) {
+        // reclaiming would copy older items after the begin mark of the transaction
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+
+    if (mPageManager.getFreeingPage() != nullptr && mPageManager.getFreePageCount() < 2) {
+        // pages weren't reclaimed incrementally in time, finish the page which is being freed
+        auto err = finishFreeingPage();
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (getCurrentPage().state() != Page::PageState::FULL) {
+            // remaining items were moved onto a new page
+            return ESP_OK;
+        }
+    }
+
+    Page* reclaimedPage = nullptr;
+    auto err = mPageManager.requestNewPage(&reclaimedPage);
+    if (reclaimedPage) {
+        if (err == ESP_OK) {
+            mItemIndex.movePage(reclaimedPage, &getCurrentPage());
+        } else {
+            // items may be left on either page, rebuild on next init
+            mItemIndex.clear();
+        }
+    }
+    return err;
+}
+
+esp_err_t Storage::moveFreeingPageItems(size_t maxEntries, size_t& movedEntries, bool& empty)
+{
+    Page* freeingPage = mPageManager.getFreeingPage();
+    assert(freeingPage != nullptr);
+
+    movedEntries = 0;
+    empty = false;
+    bool eraseCopies = true;
+    Item item;
+    size_t itemIndex = 0;
+    while (movedEntries < maxEntries) {
+        if (freeingPage->findItem(Page::NS_ANY, ItemType::ANY, nullptr, itemIndex, item) != ESP_OK) {
+            empty = true;
+            break;
+        }
+        size_t span;
+        auto err = freeingPage->copyItem(itemIndex, getCurrentPage(), span);
+        if (err == ESP_ERR_NVS_PAGE_FULL) {
+            if (getCurrentPage().state() != Page::PageState::FULL) {
+                err = getCurrentPage().markFull();
+                if (err != ESP_OK) {
+                    return err;
+                }
+            }
+            if (mPageManager.getFreePageCount() < 2) {
+                // The last free page is only used to copy all remaining items at once, like
+                // requestNewPage does, and the freeing page is erased right after. The items
+                // always fit, as the freeing page had unused entries. Items are not erased
+                // on the freeing page, so that PageManager::load can copy them again.
+                maxEntries = SIZE_MAX;
+                eraseCopies = false;
+            }
+            err = mPageManager.activatePage();
+            if (err != ESP_OK) {
+                return err;
+            }
+            err = freeingPage->copyItem(itemIndex, getCurrentPage(), span);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+        mItemIndex.insert(item, &getCurrentPage());
+
+        // each item is erased right after it has been copied, so that writes and erases
+        // of the key always find the only copy of it
+        if (eraseCopies) {
+            err = freeingPage->eraseEntryAndSpan(itemIndex);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        mItemIndex.erase(item, freeingPage);
+        itemIndex += span;
+        movedEntries += span;
+    }
+    return ESP_OK;
+}
+
+esp_err_t Storage::finishFreeingPage()
+{
+    size_t movedEntries;
+    bool empty;
+    auto err = moveFreeingPageItems(SIZE_MAX, movedEntries, empty);
+    if (err != ESP_OK) {
+        return err;
+    }
+    assert(empty);
+    return mPageManager.finishReclaim();
+}
+
+esp_err_t Storage::collectGarbage(size_t maxEntries, bool& done)
+{
+    done = false;
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    if (mPageManager.getFreeingPage() == nullptr) {
+        if (mPageManager.getFreePageCount() >= mGcReserve) {
+            done = true;
+            return ESP_OK;
+        }
+        auto err = mPageManager.startReclaim();
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            // no page has erased entries
+            done = true;
+            return ESP_OK;
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    size_t movedEntries;
+    bool empty;
+    auto err = moveFreeingPageItems(maxEntries, movedEntries, empty);
+    if (err != ESP_OK) {
+        return err;
+    }
+    // erasing the sector takes longer than moving a few items, so it gets a step of its own,
+    // unless the last free page was used to move the items
+    if (!empty || (movedEntries > 0 && mPageManager.getFreePageCount() > 0)) {
+        return ESP_OK;
+    }
+    err = mPageManager.finishReclaim();
+    if (err != ESP_OK) {
+        return err;
+    }
+    done = mPageManager.getFreePageCount() >= mGcReserve;
+    return ESP_OK;
+}
+
+esp_err_t Storage::writeSingleItem(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize, uint8_t chunkIdx)
+{
+    Page& page = getCurrentPage();
+    auto err = page.writeItem(nsIndex, datatype, key, data, dataSize, chunkIdx);
+    if (err == ESP_ERR_NVS_PAGE_FULL) {
+        if (page.state() != Page::PageState::FULL) {
+            err = page.markFull();
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        err = requestNewPage();
+        if (err != ESP_OK) {
+            return err;
+        }
+
+        err = getCurrentPage().writeItem(nsIndex, datatype, key, data, dataSize, chunkIdx);
+        if (err == ESP_ERR_NVS_PAGE_FULL) {
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+    } else if (err != ESP_OK) {
+        return err;
+    }
+    mItemIndex.insert(Item(nsIndex, datatype, 0, key, chunkIdx), &getCurrentPage());
+    return ESP_OK;
+}
 
+size_t Storage::getMaxBlobSize()
+{
     /* Check how much maximum data can be accommodated**/
     uint32_t max_pages = mPageManager.getPageCount() - 1;
 
     if(max_pages > (Page::CHUNK_ANY-1)/2) {
        max_pages = (Page::CHUNK_ANY-1)/2;
     }
+    return max_pages * Page::CHUNK_MAX_SIZE;
+}
+
+esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const void* data, size_t dataSize, VerOffset chunkStart)
+{
+    uint8_t chunkCount = 0;
+    TUsedPageList usedPages;
+    size_t remainingSize = dataSize;
+    size_t offset=0;
+    esp_err_t err = ESP_OK;
 
-    if (dataSize > max_pages * Page::CHUNK_MAX_SIZE) {
+    if (dataSize > getMaxBlobSize()) {
         return ESP_ERR_NVS_VALUE_TOO_LONG;
     }
 
@@ -177,7 +555,7 @@ esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const vo
                     return err;
                 }
             }
-            err = mPageManager.requestNewPage();
+            err = requestNewPage();
             if (err != ESP_OK) {
                 return err;
             } else if(getCurrentPage().getVarDataTailroom() == tailroom) {
@@ -196,13 +574,15 @@ esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const vo
         chunkSize = (remainingSize > tailroom)? tailroom : remainingSize;
         remainingSize -= chunkSize;
 
+        const uint8_t chunkIdx = static_cast<uint8_t> (chunkStart) + chunkCount;
         err = page.writeItem(nsIndex, ItemType::BLOB_DATA, key,
-                static_cast<const uint8_t*> (data) + offset, chunkSize, static_cast<uint8_t> (chunkStart) + chunkCount);
+                static_cast<const uint8_t*> (data) + offset, chunkSize, chunkIdx);
         chunkCount++;
         assert(err != ESP_ERR_NVS_PAGE_FULL);
         if (err != ESP_OK) {
             break;
         } else {
+            mItemIndex.insert(Item(nsIndex, ItemType::BLOB_DATA, 0, key, chunkIdx), &page);
             UsedPageNode* node = new UsedPageNode();
             node->mPage = &page;
             usedPages.push_back(node);
@@ -213,7 +593,7 @@ esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const vo
                         break;
                     }
                 }
-                err = mPageManager.requestNewPage();
+                err = requestNewPage();
                 if (err != ESP_OK) {
                     break;
                 }
@@ -230,6 +610,9 @@ esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const vo
 
             err = getCurrentPage().writeItem(nsIndex, ItemType::BLOB_IDX, key, item.data, sizeof(item.data));
             assert(err != ESP_ERR_NVS_PAGE_FULL);
+            if (err == ESP_OK) {
+                mItemIndex.insert(Item(nsIndex, ItemType::BLOB_IDX, 0, key), &getCurrentPage());
+            }
             break;
         }
     } while (1);
@@ -311,29 +694,8 @@ esp_err_t Storage::writeItem(uint8_t nsIndex, ItemType datatype, const char* key
             }
         }
     } else {
-
-        Page& page = getCurrentPage();
-        err = page.writeItem(nsIndex, datatype, key, data, dataSize);
-        if (err == ESP_ERR_NVS_PAGE_FULL) {
-            if (page.state() != Page::PageState::FULL) {
-                err = page.markFull();
-                if (err != ESP_OK) {
-                    return err;
-                }
-            }
-            err = mPageManager.requestNewPage();
-            if (err != ESP_OK) {
-                return err;
-            }
-
-            err = getCurrentPage().writeItem(nsIndex, datatype, key, data, dataSize);
-            if (err == ESP_ERR_NVS_PAGE_FULL) {
-                return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
-            }
-            if (err != ESP_OK) {
-                return err;
-            }
-        } else if (err != ESP_OK) {
+        err = writeSingleItem(nsIndex, datatype, key, data, dataSize);
+        if (err != ESP_OK) {
             return err;
         }
     }
@@ -350,6 +712,7 @@ esp_err_t Storage::writeItem(uint8_t nsIndex, ItemType datatype, const char* key
         if (err != ESP_OK) {
             return err;
         }
+        mItemIndex.erase(item, findPage);
     }
 #ifndef ESP_PLATFORM
     debugCheck();
@@ -483,6 +846,7 @@ esp_err_t Storage::eraseMultiPageBlob(uint8_t nsIndex, const char* key, VerOffse
     if (err != ESP_OK) {
         return err;
     }
+    mItemIndex.erase(item, findPage);
 
     uint8_t chunkCount = item.blobIndex.chunkCount;
 
@@ -493,8 +857,15 @@ esp_err_t Storage::eraseMultiPageBlob(uint8_t nsIndex, const char* key, VerOffse
     }
 
     /* Now erase corresponding chunks*/
+    return eraseBlobChunks(nsIndex, key, chunkStart, chunkCount);
+}
+
+esp_err_t Storage::eraseBlobChunks(uint8_t nsIndex, const char* key, VerOffset chunkStart, uint8_t chunkCount)
+{
+    Item item;
+    Page* findPage = nullptr;
     for (uint8_t chunkNum = 0; chunkNum < chunkCount; chunkNum++) {
-        err = findItem(nsIndex, ItemType::BLOB_DATA, key, findPage, item, static_cast<uint8_t> (chunkStart) + chunkNum);
+        auto err = findItem(nsIndex, ItemType::BLOB_DATA, key, findPage, item, static_cast<uint8_t> (chunkStart) + chunkNum);
 
         if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
             return err;
@@ -505,6 +876,7 @@ esp_err_t Storage::eraseMultiPageBlob(uint8_t nsIndex, const char* key, VerOffse
         if (err != ESP_OK) {
             return err;
         }
+        mItemIndex.erase(item, findPage);
 
     }
 
@@ -528,7 +900,11 @@ esp_err_t Storage::eraseItem(uint8_t nsIndex, ItemType datatype, const char* key
         return err;
     }
 
-    return findPage->eraseItem(nsIndex, datatype, key);
+    err = findPage->eraseItem(nsIndex, datatype, key);
+    if (err == ESP_OK) {
+        mItemIndex.erase(item, findPage);
+    }
+    return err;
 }
 
 esp_err_t Storage::eraseNamespace(uint8_t nsIndex)
@@ -538,43 +914,749 @@ esp_err_t Storage::eraseNamespace(uint8_t nsIndex)
     }
 
     for (auto it = std::begin(mPageManager); it != std::end(mPageManager); ++it) {
+        size_t itemIndex = 0;
+        Item item;
         while (true) {
-            auto err = it->eraseItem(nsIndex, ItemType::ANY, nullptr);
+            auto err = it->findItem(nsIndex, ItemType::ANY, nullptr, itemIndex, item);
             if (err == ESP_ERR_NVS_NOT_FOUND) {
                 break;
             }
             else if (err != ESP_OK) {
                 return err;
             }
+            err = it->eraseItem(nsIndex, item.datatype, item.key, item.chunkIndex);
+            if (err != ESP_OK) {
+                return err;
+            }
+            mItemIndex.erase(item, it);
         }
     }
     return ESP_OK;
 
 }
 
-esp_err_t Storage::getItemDataSize(uint8_t nsIndex, ItemType datatype, const char* key, size_t& dataSize)
+esp_err_t Storage::commitTransaction(uint8_t nsIndex, TTransactionItemList& items)
 {
     if (mState != StorageState::ACTIVE) {
         return ESP_ERR_NVS_NOT_INITIALIZED;
     }
 
-    Item item;
-    Page* findPage = nullptr;
-    auto err = findItem(nsIndex, datatype, key, findPage, item);
-    if (err != ESP_OK) {
-        if (datatype != ItemType::BLOB) {
-            return err;
-        }
-        err = findItem(nsIndex, ItemType::BLOB_IDX, key, findPage, item);
+    // values which are already stored don't need to be written again
+    uint32_t writeCount = 0;
+    size_t entryCount = 2; // begin and commit marks
+    size_t maxSpan = 1;
+    for (auto it = items.begin(); it != items.end(); ++it) {
+        auto err = findPreviousItem(nsIndex, *it);
         if (err != ESP_OK) {
             return err;
         }
-        dataSize = item.blobIndex.dataSize;
+        if (it->unchanged) {
+            continue;
+        }
+        ++writeCount;
+        entryCount += it->entryCount();
+        if (it->datatype != ItemType::BLOB) {
+            maxSpan = std::max(maxSpan, it->entryCount());
+        }
+    }
+    if (writeCount == 0) {
         return ESP_OK;
     }
 
-    dataSize = item.varLength.dataSize;
-    return ESP_OK;
+    /* Reclaiming a page while the transaction is being written would copy older
+     * items after its begin mark, so make room for all of it up front. Each page
+     * boundary may leave up to maxSpan - 1 entries unused. */
+    entryCount += (entryCount / Page::ENTRY_COUNT + 1) * (maxSpan - 1);
+    auto err = reserveEntries(entryCount);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    mInTransaction = true;
+    err = writeSingleItem(Page::NS_INDEX, ItemType::TXN_MARK, PageManager::TXN_BEGIN_KEY,
+            &writeCount, sizeof(writeCount), PageManager::TXN_MARK_CHUNK);
+    if (err == ESP_OK) {
+        err = writeTransactionItems(nsIndex, items);
+    }
+    if (err == ESP_OK) {
+        err = writeSingleItem(Page::NS_INDEX, ItemType::TXN_MARK, PageManager::TXN_COMMIT_KEY,
+                &writeCount, sizeof(writeCount), PageManager::TXN_MARK_CHUNK);
+    }
+    mInTransaction = false;
+
+    if (err != ESP_OK) {
+        if (mPageManager.rollbackTransaction() != ESP_OK) {
+            /* Items left after the begin mark would be rolled back on the next init
+             * together with anything written later, so refuse further writes */
+            mState = StorageState::INVALID;
+        }
+        return err;
+    }
+
+    // the transaction is committed, erase the items it replaced
+    for (auto it = items.begin(); it != items.end() && err == ESP_OK; ++it) {
+        if (!it->unchanged && it->hasPrevious) {
+            err = erasePreviousItem(nsIndex, *it);
+        }
+    }
+    if (err == ESP_OK) {
+        err = eraseTransactionMark(PageManager::TXN_BEGIN_KEY);
+    }
+    if (err == ESP_OK) {
+        err = eraseTransactionMark(PageManager::TXN_COMMIT_KEY);
+    }
+    if (err == ESP_ERR_FLASH_OP_FAIL) {
+        return ESP_ERR_NVS_REMOVE_FAILED;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+#ifndef ESP_PLATFORM
+    debugCheck();
+#endif
+    return ESP_OK;
+}
+
+esp_err_t Storage::reserveEntries(size_t count)
+{
+    bool reclaimed = false;
+    size_t reclaimedAvailable = 0;
+    while (true) {
+        const size_t freePages = mPageManager.getFreePageCount();
+        if (freePages == 0) {
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+        // the last free page is kept for reclaiming
+        Page& page = getCurrentPage();
+        const size_t available = page.getFreeEntryCount() + (freePages - 1) * Page::ENTRY_COUNT;
+        if (available >= count) {
+            return ESP_OK;
+        }
+        if (page.state() == Page::PageState::UNINITIALIZED) {
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+        if (freePages == 1) {
+            if (reclaimed && available <= reclaimedAvailable) {
+                /* Reclaiming doesn't free up any more entries */
+                return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+            }
+            reclaimed = true;
+            reclaimedAvailable = available;
+        }
+        if (page.state() != Page::PageState::FULL) {
+            auto err = page.markFull();
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        auto err = requestNewPage();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+}
+
+esp_err_t Storage::findPreviousItem(uint8_t nsIndex, TransactionItem& txnItem)
+{
+    Page* findPage = nullptr;
+    Item item;
+
+    txnItem.unchanged = false;
+    txnItem.written = false;
+    txnItem.hasPrevious = false;
+    txnItem.prevStart = VerOffset::VER_ANY;
+    txnItem.nextStart = VerOffset::VER_0_OFFSET;
+
+    if (txnItem.datatype == ItemType::BLOB) {
+        auto err = findItem(nsIndex, ItemType::BLOB_IDX, txnItem.key, findPage, item);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            /* Support for earlier versions where BLOBS were stored without index */
+            err = findItem(nsIndex, ItemType::BLOB, txnItem.key, findPage, item);
+            txnItem.hasPrevious = (err == ESP_OK);
+            return (err == ESP_ERR_NVS_NOT_FOUND) ? ESP_OK : err;
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+        txnItem.hasPrevious = true;
+        txnItem.prevStart = item.blobIndex.chunkStart;
+        txnItem.nextStart = (txnItem.prevStart == VerOffset::VER_1_OFFSET) ? VerOffset::VER_0_OFFSET : VerOffset::VER_1_OFFSET;
+        if (item.blobIndex.dataSize != txnItem.dataSize) {
+            return ESP_OK;
+        }
+        std::unique_ptr<uint8_t[]> stored(new uint8_t[txnItem.dataSize]);
+        err = readMultiPageBlob(nsIndex, txnItem.key, stored.get(), txnItem.dataSize);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            // a chunk was missing and the blob has been erased
+            txnItem.hasPrevious = false;
+            txnItem.nextStart = VerOffset::VER_0_OFFSET;
+            return ESP_OK;
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+        txnItem.unchanged = memcmp(stored.get(), txnItem.data.get(), txnItem.dataSize) == 0;
+        return ESP_OK;
+    }
+
+    auto err = findItem(nsIndex, txnItem.datatype, txnItem.key, findPage, item);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_OK;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    txnItem.hasPrevious = true;
+    if (!isVariableLengthType(txnItem.datatype)) {
+        txnItem.unchanged = memcmp(item.data, txnItem.data.get(), txnItem.dataSize) == 0;
+    } else if (item.varLength.dataSize == txnItem.dataSize &&
+            item.varLength.dataCrc32 == Item::calculateCrc32(txnItem.data.get(), txnItem.dataSize)) {
+        // matching CRC doesn't prove that the data is the same
+        std::unique_ptr<uint8_t[]> stored(new uint8_t[txnItem.dataSize]);
+        err = findPage->readItem(nsIndex, txnItem.datatype, txnItem.key, stored.get(), txnItem.dataSize);
+        if (err != ESP_OK) {
+            return err;
+        }
+        txnItem.unchanged = memcmp(stored.get(), txnItem.data.get(), txnItem.dataSize) == 0;
+    }
+    return ESP_OK;
+}
+
+esp_err_t Storage::writeTransactionItems(uint8_t nsIndex, TTransactionItemList& items)
+{
+    while (true) {
+        /* Write the largest item which still fits into the current page, so that
+         * pages get filled up before the next one is started. Blobs are split
+         * to fill the page anyway, they go in when nothing else fits. */
+        const size_t freeEntries = getCurrentPage().getFreeEntryCount();
+        TransactionItem* next = nullptr;
+        TransactionItem* largest = nullptr;
+        TransactionItem* blob = nullptr;
+        for (auto it = items.begin(); it != items.end(); ++it) {
+            if (it->unchanged || it->written) {
+                continue;
+            }
+            if (it->datatype == ItemType::BLOB) {
+                if (blob == nullptr) {
+                    blob = it;
+                }
+                continue;
+            }
+            const size_t span = it->entryCount();
+            if (span <= freeEntries && (next == nullptr || span > next->entryCount())) {
+                next = it;
+            }
+            if (largest == nullptr || span > largest->entryCount()) {
+                largest = it;
+            }
+        }
+        if (next == nullptr) {
+            next = (blob != nullptr) ? blob : largest;
+        }
+        if (next == nullptr) {
+            return ESP_OK;
+        }
+
+        esp_err_t err;
+        if (next->datatype == ItemType::BLOB) {
+            err = writeMultiPageBlob(nsIndex, next->key, next->data.get(), next->dataSize, next->nextStart);
+            if (err == ESP_ERR_NVS_PAGE_FULL) {
+                err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+            }
+        } else {
+            err = writeSingleItem(nsIndex, next->datatype, next->key, next->data.get(), next->dataSize);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+        next->written = true;
+    }
+}
+
+esp_err_t Storage::erasePreviousItem(uint8_t nsIndex, const TransactionItem& txnItem)
+{
+    if (txnItem.datatype == ItemType::BLOB && txnItem.prevStart != VerOffset::VER_ANY) {
+        return eraseMultiPageBlob(nsIndex, txnItem.key, txnItem.prevStart);
+    }
+
+    // the previous item was written first, so it is the one found
+    Page* findPage = nullptr;
+    Item item;
+    auto err = findItem(nsIndex, txnItem.datatype, txnItem.key, findPage, item);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = findPage->eraseItem(nsIndex, txnItem.datatype, txnItem.key);
+    if (err == ESP_OK) {
+        mItemIndex.erase(item, findPage);
+    }
+    return err;
+}
+
+esp_err_t Storage::eraseTransactionMark(const char* key)
+{
+    Page* findPage = nullptr;
+    Item item;
+    auto err = findItem(Page::NS_INDEX, ItemType::TXN_MARK, key, findPage, item, PageManager::TXN_MARK_CHUNK);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = findPage->eraseItem(Page::NS_INDEX, ItemType::TXN_MARK, key, PageManager::TXN_MARK_CHUNK);
+    if (err == ESP_OK) {
+        mItemIndex.erase(item, findPage);
+    }
+    return err;
+}
+
+esp_err_t Storage::getItemDataSize(uint8_t nsIndex, ItemType datatype, const char* key, size_t& dataSize)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    Item item;
+    Page* findPage = nullptr;
+    auto err = findItem(nsIndex, datatype, key, findPage, item);
+    if (err != ESP_OK) {
+        if (datatype != ItemType::BLOB) {
+            return err;
+        }
+        err = findItem(nsIndex, ItemType::BLOB_IDX, key, findPage, item);
+        if (err != ESP_OK) {
+            return err;
+        }
+        dataSize = item.blobIndex.dataSize;
+        return ESP_OK;
+    }
+
+    dataSize = item.varLength.dataSize;
+    return ESP_OK;
+}
+
+bool Storage::findEntry(nvs_opaque_iterator_t* it, const char* nsName)
+{
+    if (mState != StorageState::ACTIVE) {
+        return false;
+    }
+
+    // resolve namespace names once, items only carry the index
+    it->nsIndex = Page::NS_ANY;
+    if (nsName != nullptr) {
+        if (createOrOpenNamespace(nsName, false, it->nsIndex) != ESP_OK) {
+            return false;
+        }
+        it->nameCount = 1;
+        it->names.reset(new nvs_opaque_iterator_t::NamespaceName[1]);
+        it->names[0].index = it->nsIndex;
+        strncpy(it->names[0].name, nsName, sizeof(it->names[0].name) - 1);
+        it->names[0].name[sizeof(it->names[0].name) - 1] = 0;
+    } else {
+        it->nameCount = 0;
+        it->names.reset(new nvs_opaque_iterator_t::NamespaceName[mNamespaces.size()]);
+        for (auto ns = mNamespaces.begin(); ns != mNamespaces.end(); ++ns) {
+            it->names[it->nameCount].index = ns->mIndex;
+            strcpy(it->names[it->nameCount].name, ns->mName);
+            ++it->nameCount;
+        }
+        std::sort(&it->names[0], &it->names[it->nameCount],
+                [](const nvs_opaque_iterator_t::NamespaceName& a, const nvs_opaque_iterator_t::NamespaceName& b) -> bool {
+                    return a.index < b.index;
+                });
+    }
+
+    it->page = mPageManager.begin();
+    it->entryIndex = 0;
+    return findNextEntry(it);
+}
+
+static bool isIterableItem(const Item& item, nvs_type_t type)
+{
+    /* Skip namespace entries and transaction marks. Blobs are returned once,
+     * for their index (or for the whole blob if stored in the old format) */
+    if (item.nsIndex == Page::NS_INDEX || item.datatype == ItemType::BLOB_DATA) {
+        return false;
+    }
+    if (type == NVS_TYPE_ANY) {
+        return true;
+    }
+    if (type == NVS_TYPE_BLOB) {
+        return item.datatype == ItemType::BLOB_IDX || item.datatype == ItemType::BLOB;
+    }
+    return item.datatype == static_cast<ItemType>(type);
+}
+
+bool Storage::nextEntry(nvs_opaque_iterator_t* it)
+{
+    if (mState != StorageState::ACTIVE) {
+        return false;
+    }
+
+    // if the page has been reclaimed since, carry on with the pages written after it
+    uint32_t seqNumber;
+    if (it->page != mPageManager.end() &&
+            (it->page->getSeqNumber(seqNumber) != ESP_OK || seqNumber != it->pageSeqNumber)) {
+        it->page = std::find_if(mPageManager.begin(), mPageManager.end(), [=](const Page& page) -> bool {
+            uint32_t otherSeqNumber;
+            return page.getSeqNumber(otherSeqNumber) == ESP_OK && otherSeqNumber > it->pageSeqNumber;
+        });
+        it->entryIndex = 0;
+    }
+
+    return findNextEntry(it);
+}
+
+bool Storage::findNextEntry(nvs_opaque_iterator_t* it)
+{
+    Item item;
+    for (; it->page != mPageManager.end(); ++it->page, it->entryIndex = 0) {
+        if (it->page->getSeqNumber(it->pageSeqNumber) != ESP_OK) {
+            continue;
+        }
+        // type is checked here rather than by findItem, which stops at the first mismatch
+        while (it->page->findItem(it->nsIndex, ItemType::ANY, nullptr, it->entryIndex, item) == ESP_OK) {
+            it->entryIndex += item.span;
+            if (!isIterableItem(item, it->type)) {
+                continue;
+            }
+
+            nvs_entry_info_t& info = it->entry_info;
+            item.getKey(info.key, sizeof(info.key) - 1);
+            info.key[sizeof(info.key) - 1] = 0;
+            info.type = (item.datatype == ItemType::BLOB_IDX || item.datatype == ItemType::BLOB)
+                        ? NVS_TYPE_BLOB : static_cast<nvs_type_t>(item.datatype);
+            auto name = std::lower_bound(&it->names[0], &it->names[it->nameCount], item.nsIndex,
+                    [](const nvs_opaque_iterator_t::NamespaceName& e, uint8_t index) -> bool {
+                        return e.index < index;
+                    });
+            if (name != &it->names[it->nameCount] && name->index == item.nsIndex) {
+                strcpy(info.namespace_name, name->name);
+            } else {
+                info.namespace_name[0] = 0;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint8_t blobChunkIndex(const nvs_opaque_blob_reader_t* reader, size_t chunkNum)
+{
+    if (reader->chunkType == ItemType::BLOB) {
+        return Page::CHUNK_ANY;
+    }
+    return static_cast<uint8_t>(reader->chunkStart + chunkNum);
+}
+
+esp_err_t Storage::openBlob(nvs_opaque_blob_reader_t* reader, uint8_t nsIndex, const char* key)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    Item item;
+    Page* findPage = nullptr;
+    auto err = findItem(nsIndex, ItemType::BLOB_IDX, key, findPage, item);
+    if (err == ESP_OK) {
+        reader->chunkType = ItemType::BLOB_DATA;
+        reader->chunkStart = static_cast<uint8_t>(item.blobIndex.chunkStart);
+        reader->chunkCount = item.blobIndex.chunkCount;
+        reader->dataSize = item.blobIndex.dataSize;
+    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+        // blob stored with earlier version format without index, a single chunk
+        err = findItem(nsIndex, ItemType::BLOB, key, findPage, item);
+        if (err != ESP_OK) {
+            return err;
+        }
+        reader->chunkType = ItemType::BLOB;
+        reader->chunkStart = Page::CHUNK_ANY;
+        reader->chunkCount = 1;
+        reader->dataSize = item.varLength.dataSize;
+    } else {
+        return err;
+    }
+
+    reader->storage = this;
+    reader->nsIndex = nsIndex;
+    strncpy(reader->key, key, sizeof(reader->key) - 1);
+    reader->key[sizeof(reader->key) - 1] = 0;
+
+    /* Chunk sizes depend on the space which was left on each page, so they are
+     * collected once to find the chunk holding a given offset. The CRC of each
+     * chunk tells later reads whether the blob has been written again. */
+    reader->chunks.reset(new nvs_opaque_blob_reader_t::Chunk[reader->chunkCount]);
+    uint32_t end = 0;
+    for (size_t chunkNum = 0; chunkNum < reader->chunkCount; ++chunkNum) {
+        err = findItem(nsIndex, reader->chunkType, key, findPage, item, blobChunkIndex(reader, chunkNum));
+        if (err != ESP_OK) {
+            return err;
+        }
+        end += item.varLength.dataSize;
+        reader->chunks[chunkNum].end = end;
+        reader->chunks[chunkNum].dataCrc32 = item.varLength.dataCrc32;
+    }
+    if (end != reader->dataSize) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t Storage::findBlobChunk(nvs_opaque_blob_reader_t* reader, size_t offset, Page* &page, size_t& itemIndex, size_t& chunkOffset, size_t& chunkSize)
+{
+    assert(offset < reader->dataSize);
+    auto chunk = std::upper_bound(&reader->chunks[0], &reader->chunks[reader->chunkCount], offset,
+            [](size_t offset, const nvs_opaque_blob_reader_t::Chunk& chunk) -> bool {
+                return offset < chunk.end;
+            });
+    size_t chunkNum = chunk - &reader->chunks[0];
+    size_t chunkBegin = (chunkNum == 0) ? 0 : reader->chunks[chunkNum - 1].end;
+
+    // the chunk may have been moved to another page since it was last read
+    Item item;
+    auto err = findItem(reader->nsIndex, reader->chunkType, reader->key, page, itemIndex, item, blobChunkIndex(reader, chunkNum));
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (item.varLength.dataSize != chunk->end - chunkBegin || item.varLength.dataCrc32 != chunk->dataCrc32) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    chunkOffset = offset - chunkBegin;
+    chunkSize = item.varLength.dataSize;
+    return ESP_OK;
+}
+
+esp_err_t Storage::readBlob(nvs_opaque_blob_reader_t* reader, size_t offset, void* data, size_t size)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (offset > reader->dataSize || size > reader->dataSize - offset) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    uint8_t* dst = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        Page* page;
+        size_t itemIndex;
+        size_t chunkOffset;
+        size_t chunkSize;
+        auto err = findBlobChunk(reader, offset, page, itemIndex, chunkOffset, chunkSize);
+        if (err != ESP_OK) {
+            return err;
+        }
+        size_t len = std::min(size, chunkSize - chunkOffset);
+        err = page->readItemData(itemIndex, chunkOffset, dst, len);
+        if (err != ESP_OK) {
+            return err;
+        }
+        dst += len;
+        offset += len;
+        size -= len;
+    }
+    return ESP_OK;
+}
+
+esp_err_t Storage::findBlobData(nvs_opaque_blob_reader_t* reader, size_t offset, uint32_t& address, size_t& size)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (offset >= reader->dataSize) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    Page* page;
+    size_t itemIndex;
+    size_t chunkOffset;
+    size_t chunkSize;
+    auto err = findBlobChunk(reader, offset, page, itemIndex, chunkOffset, chunkSize);
+    if (err != ESP_OK) {
+        return err;
+    }
+    address = page->getItemDataAddress(itemIndex) + static_cast<uint32_t>(chunkOffset);
+    size = chunkSize - chunkOffset;
+    return ESP_OK;
+}
+
+esp_err_t Storage::openBlobWriter(nvs_opaque_blob_writer_t* writer, uint8_t nsIndex, const char* key)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (strlen(key) > Item::MAX_KEY_LENGTH) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    Item item;
+    Page* findPage = nullptr;
+    auto err = findItem(nsIndex, ItemType::BLOB_IDX, key, findPage, item);
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+        return err;
+    }
+    writer->hasPrevious = (err == ESP_OK);
+    if (writer->hasPrevious) {
+        /* Chunks are written with the other version, so the previous blob stays intact until commit */
+        writer->prevStart = item.blobIndex.chunkStart;
+        writer->nextStart = (writer->prevStart == VerOffset::VER_1_OFFSET) ? VerOffset::VER_0_OFFSET : VerOffset::VER_1_OFFSET;
+    } else {
+        writer->prevStart = VerOffset::VER_ANY;
+        writer->nextStart = VerOffset::VER_0_OFFSET;
+    }
+
+    writer->storage = this;
+    writer->nsIndex = nsIndex;
+    strncpy(writer->key, key, sizeof(writer->key) - 1);
+    writer->key[sizeof(writer->key) - 1] = 0;
+    writer->chunkCount = 0;
+    writer->dataSize = 0;
+    writer->buffer.reset(new uint8_t[Page::CHUNK_MAX_SIZE]);
+    writer->bufferSize = 0;
+    return ESP_OK;
+}
+
+esp_err_t Storage::writeBlobChunk(nvs_opaque_blob_writer_t* writer)
+{
+    Page& page = getCurrentPage();
+    size_t tailroom = page.getVarDataTailroom();
+    if (!tailroom || (tailroom < writer->bufferSize && tailroom < Page::CHUNK_MAX_SIZE / 10)) {
+        /* Tailroom is too small for a chunk, continue on a new page */
+        if (page.state() != Page::PageState::FULL) {
+            auto err = page.markFull();
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        auto err = requestNewPage();
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (getCurrentPage().getVarDataTailroom() == tailroom) {
+            return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+        return ESP_OK;
+    }
+    if (writer->chunkCount == (Page::CHUNK_ANY - 1) / 2) {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+
+    size_t chunkSize = std::min(writer->bufferSize, tailroom);
+    const uint8_t chunkIdx = static_cast<uint8_t>(writer->nextStart) + writer->chunkCount;
+    auto err = page.writeItem(writer->nsIndex, ItemType::BLOB_DATA, writer->key, writer->buffer.get(), chunkSize, chunkIdx);
+    assert(err != ESP_ERR_NVS_PAGE_FULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+    mItemIndex.insert(Item(writer->nsIndex, ItemType::BLOB_DATA, 0, writer->key, chunkIdx), &page);
+    writer->chunkCount++;
+    writer->bufferSize -= chunkSize;
+    memmove(writer->buffer.get(), writer->buffer.get() + chunkSize, writer->bufferSize);
+
+    if (writer->bufferSize || (tailroom - chunkSize) < Page::ENTRY_SIZE) {
+        if (page.state() != Page::PageState::FULL) {
+            err = page.markFull();
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        err = requestNewPage();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t Storage::appendBlob(nvs_opaque_blob_writer_t* writer, const void* data, size_t size)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (size > getMaxBlobSize() - writer->dataSize) {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        size_t len = std::min(size, Page::CHUNK_MAX_SIZE - writer->bufferSize);
+        memcpy(writer->buffer.get() + writer->bufferSize, src, len);
+        writer->bufferSize += len;
+        writer->dataSize += len;
+        src += len;
+        size -= len;
+
+        /* A chunk is written as soon as it fills the rest of the current page */
+        while (writer->bufferSize && writer->bufferSize >= getCurrentPage().getVarDataTailroom()) {
+            auto err = writeBlobChunk(writer);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t Storage::commitBlob(nvs_opaque_blob_writer_t* writer)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    esp_err_t err = ESP_OK;
+    /* Even an empty blob has one chunk, as written by writeMultiPageBlob */
+    while (err == ESP_OK && (writer->bufferSize || !writer->chunkCount)) {
+        err = writeBlobChunk(writer);
+    }
+    if (err == ESP_OK) {
+        /* All chunks are stored. Now store the index, which makes the new version visible.*/
+        Item item;
+        std::fill_n(item.data, sizeof(item.data), 0xff);
+        item.blobIndex.dataSize = writer->dataSize;
+        item.blobIndex.chunkCount = writer->chunkCount;
+        item.blobIndex.chunkStart = writer->nextStart;
+        err = writeSingleItem(writer->nsIndex, ItemType::BLOB_IDX, writer->key, item.data, sizeof(item.data));
+    }
+    if (err != ESP_OK) {
+        abortBlob(writer);
+        return (err == ESP_ERR_NVS_PAGE_FULL) ? ESP_ERR_NVS_NOT_ENOUGH_SPACE : err;
+    }
+
+    if (writer->hasPrevious) {
+        /* Erase the blob with earlier version*/
+        err = eraseMultiPageBlob(writer->nsIndex, writer->key, writer->prevStart);
+    } else {
+        /* Support for earlier versions where BLOBS were stored without index */
+        Item item;
+        Page* findPage = nullptr;
+        err = findItem(writer->nsIndex, ItemType::BLOB, writer->key, findPage, item);
+        if (err == ESP_OK) {
+            err = findPage->eraseItem(writer->nsIndex, ItemType::BLOB, writer->key);
+            if (err == ESP_OK) {
+                mItemIndex.erase(item, findPage);
+            }
+        } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    }
+    if (err == ESP_ERR_FLASH_OP_FAIL) {
+        return ESP_ERR_NVS_REMOVE_FAILED;
+    }
+#ifndef ESP_PLATFORM
+    if (err == ESP_OK) {
+        debugCheck();
+    }
+#endif
+    return err;
+}
+
+esp_err_t Storage::abortBlob(nvs_opaque_blob_writer_t* writer)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    /* Without the index the chunks are orphans, which would also be erased by the next init */
+    auto err = eraseBlobChunks(writer->nsIndex, writer->key, writer->nextStart, writer->chunkCount);
+    writer->chunkCount = 0;
+    writer->bufferSize = 0;
+    return err;
 }
 
 void Storage::debugDump()
@@ -603,6 +1685,7 @@ void Storage::debugCheck()
                 assert(0);
             }
             keys.insert(std::make_pair(keystr, static_cast<Page*>(p)));
+            assert(!mItemIndex.isActive() || mItemIndex.contains(item, p));
             itemIndex += item.span;
             usedCount += item.span;
         }
@@ -21,12 +21,26 @@
 #include "nvs_types.hpp"
 #include "nvs_page.hpp"
 #include "nvs_pagemanager.hpp"
+#include "nvs_item_index.hpp"
+#include "nvs_mount_summary.hpp"
+#include "esp_spi_flash.h"
+#include "sdkconfig.h"
 
 //extern void dumpBytes(const uint8_t* data, size_t count);
 
+struct nvs_opaque_iterator_t;
+struct nvs_opaque_blob_reader_t;
+struct nvs_opaque_blob_writer_t;
+
 namespace nvs
 {
 
+#ifdef CONFIG_NVS_MOUNT_SUMMARY
+static const bool MOUNT_SUMMARY_DEFAULT = true;
+#else
+static const bool MOUNT_SUMMARY_DEFAULT = false;
+#endif
+
 class Storage : public intrusive_list_node<Storage>
 {
     enum class StorageState : uint32_t {
@@ -59,9 +73,32 @@ class Storage : public intrusive_list_node<Storage>
     typedef intrusive_list<BlobIndexNode> TBlobIndexList;
 
 public:
+    struct TransactionItem : public intrusive_list_node<TransactionItem> {
+        public:
+            TransactionItem(ItemType datatype, const char* key, const void* data, size_t dataSize);
+
+            size_t entryCount() const;
+
+            ItemType datatype;
+            char key[Item::MAX_KEY_LENGTH + 1];
+            std::unique_ptr<uint8_t[]> data;
+            size_t dataSize;
+
+            // filled in by commitTransaction
+            bool unchanged;
+            bool written;
+            bool hasPrevious;
+            VerOffset prevStart; // VER_ANY if the previous blob is in the old format
+            VerOffset nextStart;
+    };
+
+    typedef intrusive_list<TransactionItem> TTransactionItemList;
+
     ~Storage();
 
-    Storage(const char *pName = NVS_DEFAULT_PART_NAME) : mPartitionName(pName) { };
+    Storage(const char *pName = NVS_DEFAULT_PART_NAME, size_t indexBudget = CONFIG_NVS_ITEM_INDEX_SIZE,
+            size_t gcReserve = CONFIG_NVS_GC_FREE_PAGE_RESERVE, bool mountSummary = MOUNT_SUMMARY_DEFAULT)
+        : mPartitionName(pName), mItemIndex(indexBudget), mGcReserve(gcReserve), mUseMountSummary(mountSummary) { };
 
     esp_err_t init(uint32_t baseSector, uint32_t sectorCount);
 
@@ -96,6 +133,8 @@ public:
     
     esp_err_t eraseNamespace(uint8_t nsIndex);
 
+    esp_err_t commitTransaction(uint8_t nsIndex, TTransactionItemList& items);
+
     const char *getPartName() const
     {
         return mPartitionName;
@@ -119,6 +158,26 @@ public:
 
     esp_err_t calcEntriesInNamespace(uint8_t nsIndex, size_t& usedEntries);
 
+    esp_err_t collectGarbage(size_t maxEntries, bool& done);
+
+    bool findEntry(nvs_opaque_iterator_t* it, const char* nsName);
+
+    bool nextEntry(nvs_opaque_iterator_t* it);
+
+    esp_err_t openBlob(nvs_opaque_blob_reader_t* reader, uint8_t nsIndex, const char* key);
+
+    esp_err_t readBlob(nvs_opaque_blob_reader_t* reader, size_t offset, void* data, size_t size);
+
+    esp_err_t findBlobData(nvs_opaque_blob_reader_t* reader, size_t offset, uint32_t& address, size_t& size);
+
+    esp_err_t openBlobWriter(nvs_opaque_blob_writer_t* writer, uint8_t nsIndex, const char* key);
+
+    esp_err_t appendBlob(nvs_opaque_blob_writer_t* writer, const void* data, size_t size);
+
+    esp_err_t commitBlob(nvs_opaque_blob_writer_t* writer);
+
+    esp_err_t abortBlob(nvs_opaque_blob_writer_t* writer);
+
 protected:
 
     Page& getCurrentPage()
@@ -128,12 +187,53 @@ protected:
 
     void clearNamespaces();
 
+    const MountSummary::Record* findSummaryRecords(Page& page, size_t& recordCount);
+
+    esp_err_t findItemOfType(Page& page, const MountSummary::Record* records, size_t recordCount, ItemType datatype, size_t& itemIndex, Item& item);
+
+    bool reserveMountSummarySector(uint32_t baseSector, uint32_t sectorCount);
+
+    esp_err_t updateMountSummary(size_t fullPageCount, size_t scannedPageCount);
+
     void populateBlobIndices(TBlobIndexList&);
 
     void eraseOrphanDataBlobs(TBlobIndexList&);
 
+    esp_err_t requestNewPage();
+
+    esp_err_t moveFreeingPageItems(size_t maxEntries, size_t& movedEntries, bool& empty);
+
+    esp_err_t finishFreeingPage();
 
-    esp_err_t findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx = Page::CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
+    size_t getMaxBlobSize();
+
+    esp_err_t eraseBlobChunks(uint8_t nsIndex, const char* key, VerOffset chunkStart, uint8_t chunkCount);
+
+    esp_err_t writeBlobChunk(nvs_opaque_blob_writer_t* writer);
+
+    esp_err_t writeSingleItem(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize, uint8_t chunkIdx = Page::CHUNK_ANY);
+
+    esp_err_t reserveEntries(size_t count);
+
+    esp_err_t findPreviousItem(uint8_t nsIndex, TransactionItem& txnItem);
+
+    esp_err_t writeTransactionItems(uint8_t nsIndex, TTransactionItemList& items);
+
+    esp_err_t erasePreviousItem(uint8_t nsIndex, const TransactionItem& txnItem);
+
+    bool findNextEntry(nvs_opaque_iterator_t* it);
+
+    esp_err_t eraseTransactionMark(const char* key);
+
+    esp_err_t findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, size_t& itemIndex, Item& item, uint8_t chunkIdx = Page::CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
+
+    esp_err_t findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx = Page::CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY)
+    {
+        size_t itemIndex;
+        return findItem(nsIndex, datatype, key, page, itemIndex, item, chunkIdx, chunkStart);
+    }
+
+    esp_err_t findBlobChunk(nvs_opaque_blob_reader_t* reader, size_t offset, Page* &page, size_t& itemIndex, size_t& chunkOffset, size_t& chunkSize);
 
 protected:
     const char *mPartitionName;
@@ -142,10 +242,71 @@ protected:
     TNamespaces mNamespaces;
     CompressedEnumTable<bool, 1, 256> mNamespaceUsage;
     StorageState mState = StorageState::INVALID;
+    ItemIndex mItemIndex;
+    bool mInTransaction = false;
+    size_t mGcReserve;
+    bool mUseMountSummary;
+    bool mHasMountSummarySector = false;
+    uint32_t mMountSummarySector = 0;
+    MountSummary mMountSummary;
+
+    // the summary takes a sector, which small partitions can't spare
+    static const uint32_t MIN_SECTORS_FOR_MOUNT_SUMMARY = 4;
 };
 
 } // namespace nvs
 
+struct nvs_opaque_iterator_t
+{
+    struct NamespaceName {
+        uint8_t index;
+        char name[nvs::Item::MAX_KEY_LENGTH + 1];
+    };
+
+    nvs_type_t type;
+    uint8_t nsIndex;
+    nvs::Storage* storage;
+    intrusive_list<nvs::Page>::iterator page;
+    uint32_t pageSeqNumber;
+    size_t entryIndex;
+    std::unique_ptr<NamespaceName[]> names; // sorted by index
+    size_t nameCount;
+    nvs_entry_info_t entry_info;
+};
+
+struct nvs_opaque_blob_reader_t
+{
+    struct Chunk {
+        uint32_t end;       // offset of the end of the chunk within the blob
+        uint32_t dataCrc32; // tells whether the chunk found later is still the same
+    };
+
+    nvs::Storage* storage;
+    uint8_t nsIndex;
+    char key[nvs::Item::MAX_KEY_LENGTH + 1];
+    nvs::ItemType chunkType; // BLOB_DATA, or BLOB for blobs stored without index
+    uint8_t chunkStart;
+    size_t chunkCount;
+    std::unique_ptr<Chunk[]> chunks;
+    size_t dataSize;
+    bool mapped = false;
+    uint32_t mapAddress;
+    const void* mapPtr;
+    spi_flash_mmap_handle_t mapHandle;
+};
 
+struct nvs_opaque_blob_writer_t
+{
+    nvs::Storage* storage;
+    uint8_t nsIndex;
+    char key[nvs::Item::MAX_KEY_LENGTH + 1];
+    bool hasPrevious;
+    nvs::VerOffset prevStart; // VER_ANY if there is no previous blob with an index
+    nvs::VerOffset nextStart;
+    uint8_t chunkCount;       // chunks written so far
+    size_t dataSize;          // bytes appended so far
+    std::unique_ptr<uint8_t[]> buffer; // holds data until it fills the rest of a page
+    size_t bufferSize;
+};
 
 #endif /* nvs_storage_hpp */
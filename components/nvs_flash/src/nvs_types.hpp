@@ -39,6 +39,7 @@ enum class ItemType : uint8_t {
     BLOB = 0x41,
     BLOB_DATA = 0x42,
     BLOB_IDX  = 0x48,
+    TXN_MARK  = 0x84,
     ANY  = 0xff
 };
 
@@ -0,0 +1,3 @@
+#define CONFIG_NVS_ITEM_INDEX_SIZE 16384
+#define CONFIG_NVS_ENTRY_CACHE_SIZE 4096
+#define CONFIG_NVS_GC_FREE_PAGE_RESERVE 3
@@ -61,6 +61,28 @@ esp_err_t spi_flash_read(size_t src_addr, void *des_addr, size_t size)
     return ESP_OK;
 }
 
+esp_err_t spi_flash_mmap(size_t src_addr, size_t size, spi_flash_mmap_memory_t memory,
+                         const void** out_ptr, spi_flash_mmap_handle_t* out_handle)
+{
+    if (!s_emulator) {
+        return ESP_ERR_FLASH_OP_TIMEOUT;
+    }
+
+    *out_ptr = s_emulator->mmap(src_addr, size);
+    if (*out_ptr == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out_handle = static_cast<spi_flash_mmap_handle_t>(src_addr);
+    return ESP_OK;
+}
+
+void spi_flash_munmap(spi_flash_mmap_handle_t handle)
+{
+    if (s_emulator) {
+        s_emulator->munmap();
+    }
+}
+
 // timing data for ESP8266, 160MHz CPU frequency, 80MHz flash requency
 // all values in microseconds
 // values are for block sizes starting at 4 bytes and going up to 4096 bytes
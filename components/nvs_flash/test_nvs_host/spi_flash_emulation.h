@@ -217,6 +217,27 @@ public:
         mFailCountdown = count;
     }
 
+    const void* mmap(size_t srcAddr, size_t size)
+    {
+        if (srcAddr % SPI_FLASH_MMU_PAGE_SIZE != 0 ||
+                srcAddr + size > mData.size() * 4) {
+            return nullptr;
+        }
+        ++mMmapCount;
+        return bytes() + srcAddr;
+    }
+
+    void munmap()
+    {
+        assert(mMmapCount > 0);
+        --mMmapCount;
+    }
+
+    size_t getMmapCount() const
+    {
+        return mMmapCount;
+    }
+
 protected:
     static size_t getReadOpTime(uint32_t bytes);
     static size_t getWriteOpTime(uint32_t bytes);
@@ -236,6 +257,8 @@ protected:
     
     size_t mFailCountdown = SIZE_MAX;
 
+    size_t mMmapCount = 0;
+
 };
 
 
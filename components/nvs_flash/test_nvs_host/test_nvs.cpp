@@ -18,11 +18,14 @@
 #include "nvs_encr.hpp"
 #endif
 #include "spi_flash_emulation.h"
+#include "esp_crc.h"
+#include "crc.h"
 #include <sstream>
 #include <iostream>
 #include <fstream>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <chrono>
 
 #define TEST_ESP_ERR(rc, res) CHECK((rc) == (res))
 #define TEST_ESP_OK(rc) CHECK((rc) == ESP_OK)
@@ -75,6 +78,58 @@ TEST_CASE("crc32 behaves as expected", "[nvs]")
     CHECK(crc32_1 != item2.calculateCrc32());
 }
 
+TEST_CASE("esp_crc32_le matches byte-at-a-time crc32_le of ROM", "[nvs][crc32]")
+{
+    // crc32_le in crc.cpp is the same algorithm and table as the ROM function
+    uint8_t buf[256 + 8];
+    srand(1);
+    generate(begin(buf), end(buf), []() -> uint8_t { return rand(); });
+    const uint32_t initValues[] = {0, 0xffffffff, 0x12345678};
+    for (uint32_t init : initValues) {
+        for (size_t offset = 0; offset < 8; ++offset) {
+            for (size_t len = 0; len <= 256; ++len) {
+                CHECK(esp_crc32_le(init, buf + offset, len) == crc32_le(init, buf + offset, len));
+            }
+        }
+    }
+
+    // a buffer processed in parts gives the same result
+    uint32_t crc = esp_crc32_le(0xffffffff, buf, 13);
+    crc = esp_crc32_le(crc, buf + 13, 100);
+    CHECK(crc == esp_crc32_le(0xffffffff, buf, 113));
+
+    // check value of CRC-32, the ROM function inverts the initial value
+    const char check[] = "123456789";
+    CHECK(esp_crc32_le(0, reinterpret_cast<const uint8_t*>(check), 9) == 0xcbf43926);
+}
+
+TEST_CASE("benchmark esp_crc32_le against byte-at-a-time crc32_le", "[nvs][crc32]")
+{
+    // parts of an item header, the entry state table and a blob data chunk
+    const size_t sizes[] = {8, 16, 32, Page::CHUNK_MAX_SIZE};
+    const size_t totalBytes = 64 * 1024 * 1024;
+    std::vector<uint8_t> buf(Page::CHUNK_MAX_SIZE, 0xa5);
+    for (size_t size : sizes) {
+        const size_t count = totalBytes / size;
+        uint32_t crc1 = 0;
+        uint32_t crc2 = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            crc1 = crc32_le(crc1, buf.data(), size);
+        }
+        auto byteTime = std::chrono::steady_clock::now() - start;
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            crc2 = esp_crc32_le(crc2, buf.data(), size);
+        }
+        auto sliceTime = std::chrono::steady_clock::now() - start;
+        CHECK(crc1 == crc2);
+        s_perf << "CRC32 of " << size << " bytes: byte-at-a-time "
+               << std::chrono::duration_cast<std::chrono::nanoseconds>(byteTime).count() / count << " ns, slice-by-8 "
+               << std::chrono::duration_cast<std::chrono::nanoseconds>(sliceTime).count() / count << " ns" << std::endl;
+    }
+}
+
 TEST_CASE("starting with empty flash, page is in uninitialized state", "[nvs]")
 {
     SpiFlashEmulator emu(1);
@@ -2396,6 +2451,1397 @@ TEST_CASE("test nvs apis for nvs partition generator utility with encryption ena
 }
 #endif
 
+TEST_CASE("item index follows items when pages are reclaimed", "[nvs][index]")
+{
+    SpiFlashEmulator emu(4);
+    Storage storage;
+    TEST_ESP_OK(storage.init(0, 4));
+    char key[16];
+    uint8_t blob[Page::CHUNK_MAX_SIZE / 3];
+    for (uint32_t i = 0; i < Page::ENTRY_COUNT * 8; ++i) {
+        sprintf(key, "key%u", i % 20);
+        TEST_ESP_OK(storage.writeItem(1, key, i));
+        if (i % 50 == 0) {
+            fill_n(blob, sizeof(blob), static_cast<uint8_t>(i));
+            TEST_ESP_OK(storage.writeItem(1, ItemType::BLOB, "blob", blob, sizeof(blob)));
+        }
+    }
+    CHECK(emu.getEraseOps() > 0);
+    for (uint32_t i = Page::ENTRY_COUNT * 8 - 20; i < Page::ENTRY_COUNT * 8; ++i) {
+        uint32_t value;
+        sprintf(key, "key%u", i % 20);
+        TEST_ESP_OK(storage.readItem(1, key, value));
+        CHECK(value == i);
+    }
+    uint8_t readBlob[sizeof(blob)];
+    TEST_ESP_OK(storage.readItem(1, ItemType::BLOB, "blob", readBlob, sizeof(readBlob)));
+    CHECK(memcmp(blob, readBlob, sizeof(blob)) == 0);
+    TEST_ESP_OK(storage.eraseItem(1, ItemType::BLOB, "blob"));
+    TEST_ESP_ERR(storage.readItem(1, ItemType::BLOB, "blob", readBlob, sizeof(readBlob)), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_OK(storage.eraseNamespace(1));
+    uint32_t value;
+    TEST_ESP_ERR(storage.readItem(1, "key0", value), ESP_ERR_NVS_NOT_FOUND);
+}
+
+TEST_CASE("storage searches every page once item index budget is exceeded", "[nvs][index]")
+{
+    SpiFlashEmulator emu(8);
+    Storage storage(NVS_DEFAULT_PART_NAME, 256);
+    TEST_ESP_OK(storage.init(0, 8));
+    char key[16];
+    for (uint32_t i = 0; i < 200; ++i) {
+        sprintf(key, "key%u", i);
+        TEST_ESP_OK(storage.writeItem(2, key, i));
+    }
+    for (uint32_t i = 0; i < 200; ++i) {
+        uint32_t value;
+        sprintf(key, "key%u", i);
+        TEST_ESP_OK(storage.readItem(2, key, value));
+        CHECK(value == i);
+    }
+    TEST_ESP_OK(storage.init(0, 8));
+    for (uint32_t i = 0; i < 200; ++i) {
+        uint32_t value;
+        sprintf(key, "key%u", i);
+        TEST_ESP_OK(storage.readItem(2, key, value));
+        CHECK(value == i);
+    }
+}
+
+TEST_CASE("benchmark key lookup with and without item index", "[nvs][index]")
+{
+    const size_t pageCounts[] = {8, 32, 64};
+    const size_t lookupCount = 2000;
+    const size_t itemsPerPage = 15;
+    char value[200];
+    fill_n(value, sizeof(value) - 1, 'v');
+    value[sizeof(value) - 1] = 0;
+
+    for (size_t pageCount : pageCounts) {
+        size_t indexBudgets[] = {0, 65536};
+        for (size_t budget : indexBudgets) {
+            SpiFlashEmulator emu(pageCount);
+            Storage storage(NVS_DEFAULT_PART_NAME, budget);
+            TEST_ESP_OK(storage.init(0, pageCount));
+            char key[16];
+            const size_t itemCount = (pageCount - 2) * itemsPerPage;
+            for (size_t i = 0; i < itemCount; ++i) {
+                sprintf(key, "k%u", static_cast<unsigned>(i));
+                TEST_ESP_OK(storage.writeItem(1, ItemType::SZ, key, value, sizeof(value)));
+            }
+            TEST_ESP_OK(storage.init(0, pageCount));
+
+            size_t dataSize;
+            sprintf(key, "k%u", static_cast<unsigned>(itemCount - 1));
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < lookupCount; ++i) {
+                TEST_ESP_OK(storage.getItemDataSize(1, ItemType::SZ, key, dataSize));
+                TEST_ESP_ERR(storage.getItemDataSize(1, ItemType::SZ, "missing", dataSize), ESP_ERR_NVS_NOT_FOUND);
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            s_perf << "Key lookup, " << pageCount << " pages, " << (budget ? "with" : "without") << " item index: "
+                   << elapsed.count() / (2 * lookupCount) << " ns" << std::endl;
+        }
+    }
+}
+
+TEST_CASE("transaction values are written on commit and discarded on abort", "[nvs][txn]")
+{
+    SpiFlashEmulator emu(3);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 3));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("txn", NVS_READWRITE, &handle));
+    TEST_ESP_ERR(nvs_transaction_abort(handle), ESP_ERR_NVS_INVALID_STATE);
+    TEST_ESP_OK(nvs_set_u32(handle, "a", 1));
+
+    uint8_t blob[200];
+    fill_n(blob, sizeof(blob), 0x5a);
+    TEST_ESP_OK(nvs_transaction_begin(handle));
+    TEST_ESP_ERR(nvs_transaction_begin(handle), ESP_ERR_NVS_INVALID_STATE);
+    TEST_ESP_OK(nvs_set_u32(handle, "a", 2));
+    TEST_ESP_OK(nvs_set_u32(handle, "a", 3));
+    TEST_ESP_OK(nvs_set_str(handle, "s", "transaction"));
+    TEST_ESP_OK(nvs_set_blob(handle, "b", blob, sizeof(blob)));
+    TEST_ESP_ERR(nvs_set_u8(handle, "key_is_too_long_", 1), ESP_ERR_NVS_KEY_TOO_LONG);
+
+    uint32_t a;
+    TEST_ESP_OK(nvs_get_u32(handle, "a", &a));
+    CHECK(a == 1);
+    size_t size;
+    TEST_ESP_ERR(nvs_get_str(handle, "s", NULL, &size), ESP_ERR_NVS_NOT_FOUND);
+
+    TEST_ESP_OK(nvs_commit(handle));
+    TEST_ESP_OK(nvs_get_u32(handle, "a", &a));
+    CHECK(a == 3);
+    char str[32];
+    size = sizeof(str);
+    TEST_ESP_OK(nvs_get_str(handle, "s", str, &size));
+    CHECK(strcmp(str, "transaction") == 0);
+    uint8_t readBlob[sizeof(blob)];
+    size = sizeof(readBlob);
+    TEST_ESP_OK(nvs_get_blob(handle, "b", readBlob, &size));
+    CHECK(memcmp(blob, readBlob, sizeof(blob)) == 0);
+
+    TEST_ESP_OK(nvs_transaction_begin(handle));
+    TEST_ESP_OK(nvs_set_u32(handle, "a", 4));
+    TEST_ESP_OK(nvs_transaction_abort(handle));
+    TEST_ESP_OK(nvs_commit(handle));
+    TEST_ESP_OK(nvs_get_u32(handle, "a", &a));
+    CHECK(a == 3);
+
+    nvs_handle readOnly;
+    TEST_ESP_OK(nvs_open("txn", NVS_READONLY, &readOnly));
+    TEST_ESP_ERR(nvs_transaction_begin(readOnly), ESP_ERR_NVS_READ_ONLY);
+    nvs_close(readOnly);
+
+    // closing the handle discards the transaction
+    TEST_ESP_OK(nvs_transaction_begin(handle));
+    TEST_ESP_OK(nvs_set_u32(handle, "a", 5));
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_open("txn", NVS_READWRITE, &handle));
+    TEST_ESP_OK(nvs_get_u32(handle, "a", &a));
+    CHECK(a == 3);
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("transaction doesn't write values which haven't changed", "[nvs][txn]")
+{
+    SpiFlashEmulator emu(3);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 3));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("txn", NVS_READWRITE, &handle));
+    uint8_t blob[Page::CHUNK_MAX_SIZE / 2];
+    fill_n(blob, sizeof(blob), 0x33);
+    char str[100];
+    fill_n(str, sizeof(str) - 1, 'x');
+    str[sizeof(str) - 1] = 0;
+
+    for (int i = 0; i < 2; ++i) {
+        TEST_ESP_OK(nvs_transaction_begin(handle));
+        TEST_ESP_OK(nvs_set_i8(handle, "i8", -1));
+        TEST_ESP_OK(nvs_set_u64(handle, "u64", 0x123456789abcdefULL));
+        TEST_ESP_OK(nvs_set_str(handle, "str", str));
+        TEST_ESP_OK(nvs_set_blob(handle, "blob", blob, sizeof(blob)));
+        emu.clearStats();
+        TEST_ESP_OK(nvs_commit(handle));
+        if (i == 0) {
+            CHECK(emu.getWriteOps() > 0);
+        } else {
+            CHECK(emu.getWriteOps() == 0);
+        }
+    }
+
+    // only the changed value is written, replacing the old one
+    size_t usedEntries;
+    TEST_ESP_OK(nvs_get_used_entry_count(handle, &usedEntries));
+    str[0] = 'y';
+    TEST_ESP_OK(nvs_transaction_begin(handle));
+    TEST_ESP_OK(nvs_set_i8(handle, "i8", -1));
+    TEST_ESP_OK(nvs_set_str(handle, "str", str));
+    TEST_ESP_OK(nvs_set_blob(handle, "blob", blob, sizeof(blob)));
+    TEST_ESP_OK(nvs_commit(handle));
+    size_t newUsedEntries;
+    TEST_ESP_OK(nvs_get_used_entry_count(handle, &newUsedEntries));
+    CHECK(newUsedEntries == usedEntries);
+    char readStr[sizeof(str)];
+    size_t size = sizeof(readStr);
+    TEST_ESP_OK(nvs_get_str(handle, "str", readStr, &size));
+    CHECK(strcmp(str, readStr) == 0);
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("transaction which doesn't fit leaves stored values unchanged", "[nvs][txn]")
+{
+    SpiFlashEmulator emu(3);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 3));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("txn", NVS_READWRITE, &handle));
+    char key[16];
+    for (uint32_t i = 0; i < 100; ++i) {
+        sprintf(key, "key%u", i);
+        TEST_ESP_OK(nvs_set_u32(handle, key, i));
+    }
+    TEST_ESP_OK(nvs_transaction_begin(handle));
+    for (uint32_t i = 0; i < 200; ++i) {
+        sprintf(key, "key%u", i);
+        TEST_ESP_OK(nvs_set_u32(handle, key, i + 1000));
+    }
+    TEST_ESP_ERR(nvs_commit(handle), ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+    for (uint32_t i = 0; i < 200; ++i) {
+        uint32_t value;
+        sprintf(key, "key%u", i);
+        if (i < 100) {
+            TEST_ESP_OK(nvs_get_u32(handle, key, &value));
+            CHECK(value == i);
+        } else {
+            TEST_ESP_ERR(nvs_get_u32(handle, key, &value), ESP_ERR_NVS_NOT_FOUND);
+        }
+    }
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("transaction is written completely or not at all if power goes off", "[nvs][txn]")
+{
+    const size_t keyCount = 8;
+    const char* oldStr = "old value";
+    const char* newStr = "new value, long enough to take a few entries";
+    uint8_t oldBlob[100];
+    uint8_t newBlob[Page::CHUNK_MAX_SIZE / 2];
+    fill_n(oldBlob, sizeof(oldBlob), 0x11);
+    fill_n(newBlob, sizeof(newBlob), 0x22);
+    char key[16];
+
+    // returns 0 if the old values are stored, 1 for the new ones, -1 if they are mixed
+    auto checkValues = [&](nvs_handle handle) -> int {
+        int state = -1;
+        auto update = [&](bool isNew) {
+            int s = isNew ? 1 : 0;
+            state = (state == -1 || state == s) ? s : -2;
+        };
+        for (size_t i = 0; i < keyCount; ++i) {
+            uint32_t value;
+            sprintf(key, "key%u", static_cast<unsigned>(i));
+            if (nvs_get_u32(handle, key, &value) != ESP_OK) {
+                return -1;
+            }
+            update(value == i + 1);
+        }
+        char str[64];
+        size_t size = sizeof(str);
+        if (nvs_get_str(handle, "str", str, &size) != ESP_OK) {
+            return -1;
+        }
+        update(strcmp(str, newStr) == 0);
+        uint8_t blob[sizeof(newBlob)];
+        size = sizeof(blob);
+        if (nvs_get_blob(handle, "blob", blob, &size) != ESP_OK) {
+            return -1;
+        }
+        update(size == sizeof(newBlob) && memcmp(blob, newBlob, size) == 0);
+        return (state == -2) ? -1 : state;
+    };
+
+    size_t attempts = 0;
+    for (uint32_t errDelay = 0; ; ++errDelay) {
+        INFO(errDelay);
+        SpiFlashEmulator emu(3);
+        TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 3));
+        nvs_handle handle;
+        TEST_ESP_OK(nvs_open("txn", NVS_READWRITE, &handle));
+        // fill the first page with erased entries, so that the transaction has to
+        // reclaim it before starting
+        for (uint32_t i = 0; i < Page::ENTRY_COUNT + 50; ++i) {
+            TEST_ESP_OK(nvs_set_u32(handle, "filler", i));
+        }
+        for (size_t i = 0; i < keyCount; ++i) {
+            sprintf(key, "key%u", static_cast<unsigned>(i));
+            TEST_ESP_OK(nvs_set_u32(handle, key, 0));
+        }
+        TEST_ESP_OK(nvs_set_str(handle, "str", oldStr));
+        TEST_ESP_OK(nvs_set_blob(handle, "blob", oldBlob, sizeof(oldBlob)));
+
+        emu.failAfter(errDelay);
+        TEST_ESP_OK(nvs_transaction_begin(handle));
+        for (size_t i = 0; i < keyCount; ++i) {
+            sprintf(key, "key%u", static_cast<unsigned>(i));
+            TEST_ESP_OK(nvs_set_u32(handle, key, i + 1));
+        }
+        TEST_ESP_OK(nvs_set_str(handle, "str", newStr));
+        TEST_ESP_OK(nvs_set_blob(handle, "blob", newBlob, sizeof(newBlob)));
+        auto err = nvs_commit(handle);
+        emu.failAfter(UINT32_MAX);
+        nvs_close(handle);
+
+        TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 3));
+        TEST_ESP_OK(nvs_open("txn", NVS_READWRITE, &handle));
+        int state = checkValues(handle);
+        CHECK(state != -1);
+        if (err == ESP_OK) {
+            CHECK(state == 1);
+        }
+        // storage is usable after recovery
+        TEST_ESP_OK(nvs_transaction_begin(handle));
+        TEST_ESP_OK(nvs_set_u32(handle, "key0", 42));
+        TEST_ESP_OK(nvs_commit(handle));
+        nvs_close(handle);
+        TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+        ++attempts;
+        if (err == ESP_OK) {
+            break;
+        }
+    }
+    CHECK(attempts > 10);
+}
+
+TEST_CASE("entry cache serves repeated reads from RAM", "[nvs][cache]")
+{
+    EntryCache& cache = Page::getEntryCache();
+    SpiFlashEmulator emu(4);
+    Storage storage;
+    TEST_ESP_OK(storage.init(0, 4));
+    char value[200];
+    fill_n(value, sizeof(value) - 1, 'v');
+    value[sizeof(value) - 1] = 0;
+    TEST_ESP_OK(storage.writeItem(1, "u32", static_cast<uint32_t>(42)));
+    TEST_ESP_OK(storage.writeItem(1, ItemType::SZ, "str", value, sizeof(value)));
+    TEST_ESP_OK(storage.init(0, 4));
+    REQUIRE(cache.isActive());
+
+    uint32_t u32;
+    TEST_ESP_OK(storage.readItem(1, "u32", u32));
+    emu.clearStats();
+    cache.resetStats();
+    for (size_t i = 0; i < 100; ++i) {
+        TEST_ESP_OK(storage.readItem(1, "u32", u32));
+        CHECK(u32 == 42);
+    }
+    CHECK(emu.getReadOps() == 0);
+    CHECK(cache.getHits() >= 100);
+    CHECK(cache.getMisses() == 0);
+
+    // item header comes from the cache, data takes one read for the full entries and one for the tail
+    char readValue[sizeof(value)];
+    TEST_ESP_OK(storage.readItem(1, ItemType::SZ, "str", readValue, sizeof(readValue)));
+    emu.clearStats();
+    TEST_ESP_OK(storage.readItem(1, ItemType::SZ, "str", readValue, sizeof(readValue)));
+    CHECK(strcmp(value, readValue) == 0);
+    CHECK(emu.getReadOps() == 2);
+
+    nvs_cache_stats_t stats;
+    TEST_ESP_ERR(nvs_get_cache_stats(NULL), ESP_ERR_INVALID_ARG);
+    TEST_ESP_OK(nvs_get_cache_stats(&stats));
+    CHECK(stats.hits == cache.getHits());
+    CHECK(stats.misses == cache.getMisses());
+}
+
+TEST_CASE("entry cache doesn't return stale entries", "[nvs][cache]")
+{
+    {
+        SpiFlashEmulator emu(3);
+        Storage storage;
+        TEST_ESP_OK(storage.init(0, 3));
+        char key[16];
+        // overwrite and erase values, reclaiming pages many times, reading back every value
+        for (uint32_t i = 0; i < Page::ENTRY_COUNT * 10; ++i) {
+            sprintf(key, "key%u", i % 7);
+            TEST_ESP_OK(storage.writeItem(1, key, i));
+            uint32_t value;
+            TEST_ESP_OK(storage.readItem(1, key, value));
+            CHECK(value == i);
+            if (i % 5 == 0) {
+                TEST_ESP_OK(storage.eraseItem(1, key));
+                TEST_ESP_ERR(storage.readItem(1, key, value), ESP_ERR_NVS_NOT_FOUND);
+            }
+        }
+        CHECK(emu.getEraseOps() > 0);
+        TEST_ESP_OK(storage.writeItem(1, "key", static_cast<uint32_t>(1)));
+    }
+    // same addresses, different flash contents: loading the pages drops cached entries
+    SpiFlashEmulator emu(3);
+    Storage storage;
+    TEST_ESP_OK(storage.init(0, 3));
+    uint32_t value;
+    TEST_ESP_ERR(storage.readItem(1, "key", value), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_OK(storage.writeItem(1, "key", static_cast<uint32_t>(2)));
+    TEST_ESP_OK(storage.readItem(1, "key", value));
+    CHECK(value == 2);
+}
+
+TEST_CASE("entry cache can be disabled", "[nvs][cache]")
+{
+    EntryCache& cache = Page::getEntryCache();
+    cache.resize(0);
+    SpiFlashEmulator emu(3);
+    Storage storage;
+    TEST_ESP_OK(storage.init(0, 3));
+    TEST_ESP_OK(storage.writeItem(1, "key", static_cast<uint32_t>(1)));
+    uint32_t value;
+    emu.clearStats();
+    for (size_t i = 0; i < 10; ++i) {
+        TEST_ESP_OK(storage.readItem(1, "key", value));
+    }
+    CHECK(emu.getReadOps() >= 10);
+    CHECK(cache.getHits() == 0);
+    CHECK(cache.getMisses() == 0);
+    CHECK(!cache.isActive());
+    cache.resize(CONFIG_NVS_ENTRY_CACHE_SIZE);
+}
+
+TEST_CASE("benchmark hot key reads with and without entry cache", "[nvs][cache]")
+{
+    const size_t pageCount = 16;
+    const size_t keyCount = 300;
+    const size_t hotKeyCount = 20;
+    const size_t lookupCount = 2000;
+    EntryCache& cache = Page::getEntryCache();
+    size_t cacheBudgets[] = {0, CONFIG_NVS_ENTRY_CACHE_SIZE};
+    for (size_t budget : cacheBudgets) {
+        cache.resize(budget);
+        SpiFlashEmulator emu(pageCount);
+        Storage storage;
+        TEST_ESP_OK(storage.init(0, pageCount));
+        char key[16];
+        for (size_t i = 0; i < keyCount; ++i) {
+            sprintf(key, "k%u", static_cast<unsigned>(i));
+            TEST_ESP_OK(storage.writeItem(1, key, static_cast<uint32_t>(i)));
+        }
+        TEST_ESP_OK(storage.init(0, pageCount));
+        emu.clearStats();
+        cache.resetStats();
+        for (size_t i = 0; i < lookupCount; ++i) {
+            uint32_t value;
+            sprintf(key, "k%u", static_cast<unsigned>(i % hotKeyCount));
+            TEST_ESP_OK(storage.readItem(1, key, value));
+        }
+        s_perf << "Hot key reads, " << (budget ? "with" : "without") << " entry cache: "
+               << emu.getReadOps() << " flash reads, " << cache.getHits() << " hits, "
+               << cache.getMisses() << " misses" << std::endl;
+    }
+    cache.resize(CONFIG_NVS_ENTRY_CACHE_SIZE);
+}
+
+TEST_CASE("incremental garbage collection keeps free pages for writes", "[nvs][gc]")
+{
+    const size_t pageCount = 6;
+    const size_t reserve = 3;
+    SpiFlashEmulator emu(pageCount);
+    Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, reserve);
+    TEST_ESP_OK(storage.init(0, pageCount));
+
+    char key[16];
+    char value[64];
+    const size_t keyCount = 40;
+    size_t foregroundErases = 0;
+    for (size_t i = 0; i < Page::ENTRY_COUNT * 20; ++i) {
+        sprintf(key, "key%u", static_cast<unsigned>(i % keyCount));
+        snprintf(value, sizeof(value), "value %u of the key", static_cast<unsigned>(i));
+        size_t erases = emu.getEraseOps();
+        TEST_ESP_OK(storage.writeItem(1, ItemType::SZ, key, value, strlen(value) + 1));
+        foregroundErases += emu.getEraseOps() - erases;
+
+        bool done = false;
+        for (size_t step = 0; step < 4 && !done; ++step) {
+            TEST_ESP_OK(storage.collectGarbage(16, done));
+        }
+    }
+    CHECK(foregroundErases == 0);
+    CHECK(emu.getEraseOps() > 0);
+
+    for (size_t i = Page::ENTRY_COUNT * 20 - keyCount; i < Page::ENTRY_COUNT * 20; ++i) {
+        sprintf(key, "key%u", static_cast<unsigned>(i % keyCount));
+        snprintf(value, sizeof(value), "value %u of the key", static_cast<unsigned>(i));
+        char readValue[sizeof(value)];
+        TEST_ESP_OK(storage.readItem(1, ItemType::SZ, key, readValue, sizeof(readValue)));
+        CHECK(strcmp(value, readValue) == 0);
+    }
+
+    // reloading doesn't find anything left to recover
+    TEST_ESP_OK(storage.init(0, pageCount));
+    for (size_t i = 0; i < keyCount; ++i) {
+        sprintf(key, "key%u", static_cast<unsigned>(i));
+        size_t dataSize;
+        TEST_ESP_OK(storage.getItemDataSize(1, ItemType::SZ, key, dataSize));
+    }
+}
+
+TEST_CASE("writes finish incremental garbage collection if it falls behind", "[nvs][gc]")
+{
+    const size_t pageCount = 4;
+    SpiFlashEmulator emu(pageCount);
+    Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0);
+    TEST_ESP_OK(storage.init(0, pageCount));
+
+    // one short step from time to time only
+    char key[16];
+    for (uint32_t i = 0; i < Page::ENTRY_COUNT * 12; ++i) {
+        sprintf(key, "key%u", i % 30);
+        TEST_ESP_OK(storage.writeItem(1, key, i));
+        if (i % 50 == 0) {
+            bool done;
+            TEST_ESP_OK(storage.collectGarbage(1, done));
+        }
+    }
+    for (uint32_t i = Page::ENTRY_COUNT * 12 - 30; i < Page::ENTRY_COUNT * 12; ++i) {
+        uint32_t value;
+        sprintf(key, "key%u", i % 30);
+        TEST_ESP_OK(storage.readItem(1, key, value));
+        CHECK(value == i);
+    }
+}
+
+TEST_CASE("nvs_gc_step reclaims pages", "[nvs][gc]")
+{
+    const size_t pageCount = 5;
+    SpiFlashEmulator emu(pageCount);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, pageCount));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("gc", NVS_READWRITE, &handle));
+    bool done = false;
+    TEST_ESP_OK(nvs_gc_step(NULL, 16, &done));
+    CHECK(done);
+
+    // fill all but two pages with erased entries
+    for (uint32_t i = 0; i < Page::ENTRY_COUNT * (pageCount - 2); ++i) {
+        TEST_ESP_OK(nvs_set_u32(handle, "key", i));
+    }
+    TEST_ESP_OK(nvs_gc_step(NULL, 16, &done));
+    CHECK(!done);
+    size_t steps = 0;
+    while (!done) {
+        TEST_ESP_OK(nvs_gc_step(NULL, 16, &done));
+        REQUIRE(++steps < 100);
+    }
+    CHECK(emu.getEraseOps() > 0);
+    uint32_t value;
+    TEST_ESP_OK(nvs_get_u32(handle, "key", &value));
+    CHECK(value == Page::ENTRY_COUNT * (pageCount - 2) - 1);
+
+    TEST_ESP_ERR(nvs_gc_step("no_such_part", 16, NULL), ESP_ERR_NVS_NOT_INITIALIZED);
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("recovery from power-off during incremental garbage collection", "[nvs][gc]")
+{
+    const size_t pageCount = 4;
+    const size_t reserve = 2;
+    const size_t keyCount = 12;
+    const size_t staticKeyCount = 40;
+    const uint32_t iterCount = 60;
+    char key[16];
+    char blobKey[16];
+    uint8_t blob[Page::ENTRY_SIZE * 3];
+    for (uint32_t errDelay = 0; ; errDelay += 5) {
+        INFO(errDelay);
+        SpiFlashEmulator emu(pageCount);
+        uint32_t values[keyCount];
+        bool written[keyCount] = {};
+        uint32_t pending = UINT32_MAX;
+        {
+            Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, reserve);
+            TEST_ESP_OK(storage.init(0, pageCount));
+            // keys which are never written again have to be moved by the garbage collection
+            for (uint32_t k = 0; k < staticKeyCount; ++k) {
+                sprintf(key, "static%u", static_cast<unsigned>(k));
+                TEST_ESP_OK(storage.writeItem(1, key, k));
+            }
+            emu.failAfter(errDelay);
+            uint32_t i;
+            for (i = 0; i < iterCount; ++i) {
+                sprintf(key, "key%u", static_cast<unsigned>(i % keyCount));
+                sprintf(blobKey, "blob%u", static_cast<unsigned>(i % keyCount));
+                fill_n(blob, sizeof(blob), static_cast<uint8_t>(i));
+                pending = i;
+                if (storage.writeItem(1, key, i) != ESP_OK ||
+                        storage.writeItem(1, ItemType::BLOB, blobKey, blob, sizeof(blob)) != ESP_OK) {
+                    break;
+                }
+                pending = UINT32_MAX;
+                values[i % keyCount] = i;
+                written[i % keyCount] = true;
+                bool done;
+                if (storage.collectGarbage(4, done) != ESP_OK) {
+                    break;
+                }
+            }
+            if (i == iterCount) {
+                break;
+            }
+        }
+        emu.failAfter(UINT32_MAX);
+
+        Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, reserve);
+        TEST_ESP_OK(storage.init(0, pageCount));
+        for (uint32_t k = 0; k < staticKeyCount; ++k) {
+            sprintf(key, "static%u", static_cast<unsigned>(k));
+            uint32_t value;
+            TEST_ESP_OK(storage.readItem(1, key, value));
+            CHECK(value == k);
+        }
+        for (size_t k = 0; k < keyCount; ++k) {
+            sprintf(key, "key%u", static_cast<unsigned>(k));
+            uint32_t value;
+            auto err = storage.readItem(1, key, value);
+            if (pending != UINT32_MAX && pending % keyCount == k) {
+                // the write which failed may or may not have been done
+                if (err == ESP_OK && value == pending) {
+                    continue;
+                }
+            }
+            INFO("key " << k << " pending " << pending << " value " << values[k]);
+            if (!written[k]) {
+                CHECK(err == ESP_ERR_NVS_NOT_FOUND);
+                continue;
+            }
+            TEST_ESP_OK(err);
+            CHECK(value == values[k]);
+            uint8_t readBlob[sizeof(blob)];
+            sprintf(blobKey, "blob%u", static_cast<unsigned>(k));
+            TEST_ESP_OK(storage.readItem(1, ItemType::BLOB, blobKey, readBlob, sizeof(readBlob)));
+            CHECK(readBlob[0] == static_cast<uint8_t>(values[k]));
+        }
+        bool done = false;
+        while (!done) {
+            TEST_ESP_OK(storage.collectGarbage(8, done));
+        }
+    }
+}
+
+TEST_CASE("benchmark write latency with and without incremental garbage collection", "[nvs][gc]")
+{
+    const size_t pageCount = 16;
+    const size_t writeCount = Page::ENTRY_COUNT * 40;
+    size_t reserves[] = {0, 4};
+    for (size_t reserve : reserves) {
+        SpiFlashEmulator emu(pageCount);
+        Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, reserve);
+        TEST_ESP_OK(storage.init(0, pageCount));
+        std::vector<size_t> latencies;
+        latencies.reserve(writeCount);
+        char key[16];
+        size_t foregroundErases = 0;
+        for (uint32_t i = 0; i < writeCount; ++i) {
+            sprintf(key, "key%u", i % 100);
+            size_t start = emu.getTotalTime();
+            size_t erases = emu.getEraseOps();
+            TEST_ESP_OK(storage.writeItem(1, key, i));
+            latencies.push_back(emu.getTotalTime() - start);
+            foregroundErases += emu.getEraseOps() - erases;
+            bool done;
+            TEST_ESP_OK(storage.collectGarbage(16, done));
+        }
+        std::sort(latencies.begin(), latencies.end());
+        s_perf << "Write latency, " << (reserve ? "with" : "without") << " incremental GC: p50 "
+               << latencies[latencies.size() / 2] << " us, p99 " << latencies[latencies.size() * 99 / 100]
+               << " us, max " << latencies.back() << " us" << std::endl;
+        if (reserve) {
+            CHECK(foregroundErases == 0);
+        }
+    }
+}
+
+TEST_CASE("blob reader reads any range of a multi-page blob", "[nvs][blob_reader]")
+{
+    const size_t pageCount = 8;
+    SpiFlashEmulator emu(pageCount);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, pageCount));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("reader", NVS_READWRITE, &handle));
+
+    // start on a partly used page, so that chunks have different sizes
+    TEST_ESP_OK(nvs_set_u32(handle, "before", 1));
+    std::vector<uint8_t> blob(Page::CHUNK_MAX_SIZE * 2 + 1000);
+    std::mt19937 gen(42);
+    std::generate(blob.begin(), blob.end(), [&]() { return static_cast<uint8_t>(gen()); });
+    TEST_ESP_OK(nvs_set_blob(handle, "bundle", blob.data(), blob.size()));
+
+    nvs_blob_reader_t reader;
+    size_t length;
+    TEST_ESP_ERR(nvs_blob_open(handle, "missing", &reader, &length), ESP_ERR_NVS_NOT_FOUND);
+    TEST_ESP_OK(nvs_blob_open(handle, "bundle", &reader, &length));
+    CHECK(length == blob.size());
+
+    // reading piece by piece needs no more than the piece
+    uint8_t buf[100];
+    for (size_t offset = 0; offset < length; offset += sizeof(buf)) {
+        size_t n = std::min(sizeof(buf), length - offset);
+        TEST_ESP_OK(nvs_blob_read(reader, offset, buf, n));
+        CHECK(memcmp(buf, blob.data() + offset, n) == 0);
+    }
+    std::uniform_int_distribution<size_t> offsetDist(0, length - 1);
+    for (size_t i = 0; i < 200; ++i) {
+        size_t offset = offsetDist(gen);
+        size_t n = std::min(sizeof(buf), length - offset);
+        TEST_ESP_OK(nvs_blob_read(reader, offset, buf, n));
+        CHECK(memcmp(buf, blob.data() + offset, n) == 0);
+    }
+    std::vector<uint8_t> whole(length);
+    TEST_ESP_OK(nvs_blob_read(reader, 0, whole.data(), length));
+    CHECK(whole == blob);
+    TEST_ESP_OK(nvs_blob_read(reader, length, buf, 0));
+    TEST_ESP_ERR(nvs_blob_read(reader, length - 10, buf, 11), ESP_ERR_NVS_INVALID_LENGTH);
+
+    // the reader notices that the blob has been written again
+    blob[0] ^= 0xff;
+    TEST_ESP_OK(nvs_set_blob(handle, "bundle", blob.data(), blob.size()));
+    TEST_ESP_ERR(nvs_blob_read(reader, 0, buf, 1), ESP_ERR_NVS_NOT_FOUND);
+    nvs_blob_close(reader);
+    nvs_blob_close(NULL);
+
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("blob reader finds chunks moved by garbage collection", "[nvs][blob_reader]")
+{
+    const size_t pageCount = 4;
+    SpiFlashEmulator emu(pageCount);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, pageCount));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("reader", NVS_READWRITE, &handle));
+
+    uint8_t blob[1000];
+    for (size_t i = 0; i < sizeof(blob); ++i) {
+        blob[i] = static_cast<uint8_t>(i * 7);
+    }
+    TEST_ESP_OK(nvs_set_blob(handle, "cert", blob, sizeof(blob)));
+    nvs_blob_reader_t reader;
+    TEST_ESP_OK(nvs_blob_open(handle, "cert", &reader, NULL));
+
+    // overwrite another key until the page holding the blob has been reclaimed
+    for (uint32_t i = 0; i < Page::ENTRY_COUNT * pageCount; ++i) {
+        TEST_ESP_OK(nvs_set_u32(handle, "counter", i));
+    }
+    CHECK(emu.getEraseOps() > 0);
+    uint8_t buf[sizeof(blob)];
+    TEST_ESP_OK(nvs_blob_read(reader, 0, buf, sizeof(buf)));
+    CHECK(memcmp(buf, blob, sizeof(blob)) == 0);
+    nvs_blob_close(reader);
+
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("blob reader maps blob data from flash", "[nvs][blob_reader]")
+{
+    const size_t pageCount = 8;
+    SpiFlashEmulator emu(pageCount);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, pageCount));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("reader", NVS_READWRITE, &handle));
+
+    std::vector<uint8_t> blob(Page::CHUNK_MAX_SIZE + 2000);
+    for (size_t i = 0; i < blob.size(); ++i) {
+        blob[i] = static_cast<uint8_t>(i ^ (i >> 8));
+    }
+    TEST_ESP_OK(nvs_set_blob(handle, "bundle", blob.data(), blob.size()));
+
+    nvs_blob_reader_t reader;
+    size_t length;
+    TEST_ESP_OK(nvs_blob_open(handle, "bundle", &reader, &length));
+
+    // each mapping covers the rest of a chunk
+    size_t offset = 0;
+    size_t chunks = 0;
+    size_t readOps = emu.getReadOps();
+    while (offset < length) {
+        const void* ptr;
+        size_t n;
+        TEST_ESP_OK(nvs_blob_mmap(reader, offset, &ptr, &n));
+        REQUIRE(n > 0);
+        REQUIRE(offset + n <= length);
+        CHECK(memcmp(ptr, blob.data() + offset, n) == 0);
+        offset += n;
+        ++chunks;
+        CHECK(emu.getMmapCount() == 1);
+    }
+    CHECK(chunks == 2);
+    // only the item headers of the chunks have been read
+    CHECK(emu.getReadOps() - readOps <= 2 * chunks);
+
+    const void* ptr;
+    size_t n;
+    TEST_ESP_OK(nvs_blob_mmap(reader, 100, &ptr, &n));
+    CHECK(memcmp(ptr, blob.data() + 100, 16) == 0);
+    TEST_ESP_ERR(nvs_blob_mmap(reader, length, &ptr, &n), ESP_ERR_NVS_INVALID_LENGTH);
+    nvs_blob_close(reader);
+    CHECK(emu.getMmapCount() == 0);
+
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+#if CONFIG_NVS_ENCRYPTION
+TEST_CASE("blob reader reads encrypted blobs, but doesn't map them", "[nvs][blob_reader]")
+{
+    const size_t pageCount = 4;
+    SpiFlashEmulator emu(pageCount);
+    nvs_sec_cfg_t xts_cfg;
+    for (int count = 0; count < NVS_KEY_SIZE; count++) {
+        xts_cfg.eky[count] = 0x11;
+        xts_cfg.tky[count] = 0x22;
+    }
+    TEST_ESP_OK(nvs_flash_secure_init_custom(NVS_DEFAULT_PART_NAME, 0, pageCount, &xts_cfg));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("reader", NVS_READWRITE, &handle));
+
+    uint8_t blob[500];
+    for (size_t i = 0; i < sizeof(blob); ++i) {
+        blob[i] = static_cast<uint8_t>(i * 3);
+    }
+    TEST_ESP_OK(nvs_set_blob(handle, "cert", blob, sizeof(blob)));
+    nvs_blob_reader_t reader;
+    TEST_ESP_OK(nvs_blob_open(handle, "cert", &reader, NULL));
+    uint8_t buf[45];
+    TEST_ESP_OK(nvs_blob_read(reader, 77, buf, sizeof(buf)));
+    CHECK(memcmp(buf, blob + 77, sizeof(buf)) == 0);
+    const void* ptr;
+    size_t n;
+    TEST_ESP_ERR(nvs_blob_mmap(reader, 0, &ptr, &n), ESP_ERR_NOT_SUPPORTED);
+    nvs_blob_close(reader);
+
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+#endif
+
+TEST_CASE("blob writer writes a multi-page blob appended in small pieces", "[nvs][blob_writer]")
+{
+    const size_t pageCount = 8;
+    SpiFlashEmulator emu(pageCount);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, pageCount));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("writer", NVS_READWRITE, &handle));
+
+    TEST_ESP_OK(nvs_set_u32(handle, "before", 1));
+    std::vector<uint8_t> blob(Page::CHUNK_MAX_SIZE * 2 + 1000);
+    std::mt19937 gen(7);
+    std::generate(blob.begin(), blob.end(), [&]() { return static_cast<uint8_t>(gen()); });
+    std::vector<uint8_t> old(100, 0x5a);
+    TEST_ESP_OK(nvs_set_blob(handle, "table", old.data(), old.size()));
+
+    nvs_blob_writer_t writer;
+    TEST_ESP_OK(nvs_blob_writer_open(handle, "table", &writer));
+    const size_t piece = 37;
+    for (size_t offset = 0; offset < blob.size(); offset += piece) {
+        TEST_ESP_OK(nvs_blob_append(writer, blob.data() + offset, std::min(piece, blob.size() - offset)));
+    }
+    // data has been written as it arrived, but the previous value is still the one visible
+    CHECK(emu.getWriteBytes() > Page::CHUNK_MAX_SIZE * 2);
+    std::vector<uint8_t> buf(blob.size());
+    size_t length = buf.size();
+    TEST_ESP_OK(nvs_get_blob(handle, "table", buf.data(), &length));
+    CHECK(length == old.size());
+    CHECK(memcmp(buf.data(), old.data(), old.size()) == 0);
+
+    TEST_ESP_OK(nvs_blob_writer_commit(writer));
+    length = buf.size();
+    TEST_ESP_OK(nvs_get_blob(handle, "table", buf.data(), &length));
+    CHECK(length == blob.size());
+    CHECK(buf == blob);
+
+    // the result is the same as written by nvs_set_blob
+    nvs_stats_t streamed;
+    TEST_ESP_OK(nvs_get_stats(NULL, &streamed));
+    TEST_ESP_OK(nvs_erase_key(handle, "table"));
+    TEST_ESP_OK(nvs_set_blob(handle, "table", blob.data(), blob.size()));
+    nvs_stats_t whole;
+    TEST_ESP_OK(nvs_get_stats(NULL, &whole));
+    CHECK(streamed.used_entries == whole.used_entries);
+
+    // an empty blob
+    TEST_ESP_OK(nvs_blob_writer_open(handle, "empty", &writer));
+    TEST_ESP_OK(nvs_blob_writer_commit(writer));
+    length = buf.size();
+    TEST_ESP_OK(nvs_get_blob(handle, "empty", buf.data(), &length));
+    CHECK(length == 0);
+
+    TEST_ESP_OK(nvs_blob_writer_open(handle, "big", &writer));
+    std::vector<uint8_t> tooBig(Page::CHUNK_MAX_SIZE * pageCount);
+    TEST_ESP_ERR(nvs_blob_append(writer, tooBig.data(), tooBig.size()), ESP_ERR_NVS_VALUE_TOO_LONG);
+    nvs_blob_writer_abort(writer);
+    nvs_blob_writer_abort(NULL);
+    TEST_ESP_ERR(nvs_blob_writer_open(handle, "this_key_is_too_long", &writer), ESP_ERR_NVS_KEY_TOO_LONG);
+
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_open("writer", NVS_READONLY, &handle));
+    TEST_ESP_ERR(nvs_blob_writer_open(handle, "table", &writer), ESP_ERR_NVS_READ_ONLY);
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("blob writer abort erases the chunks written so far", "[nvs][blob_writer]")
+{
+    const size_t pageCount = 8;
+    SpiFlashEmulator emu(pageCount);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, pageCount));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("writer", NVS_READWRITE, &handle));
+
+    uint8_t old[50];
+    memset(old, 0xa5, sizeof(old));
+    TEST_ESP_OK(nvs_set_blob(handle, "table", old, sizeof(old)));
+    nvs_stats_t before;
+    TEST_ESP_OK(nvs_get_stats(NULL, &before));
+
+    nvs_blob_writer_t writer;
+    TEST_ESP_OK(nvs_blob_writer_open(handle, "table", &writer));
+    std::vector<uint8_t> data(Page::CHUNK_MAX_SIZE * 2, 0x11);
+    TEST_ESP_OK(nvs_blob_append(writer, data.data(), data.size()));
+    nvs_blob_writer_abort(writer);
+
+    nvs_stats_t after;
+    TEST_ESP_OK(nvs_get_stats(NULL, &after));
+    CHECK(after.used_entries == before.used_entries);
+    uint8_t buf[sizeof(old)];
+    size_t length = sizeof(buf);
+    TEST_ESP_OK(nvs_get_blob(handle, "table", buf, &length));
+    CHECK(length == sizeof(old));
+    CHECK(memcmp(buf, old, sizeof(old)) == 0);
+
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("blob writer keeps the previous value if power is lost before commit", "[nvs][blob_writer]")
+{
+    SpiFlashEmulator emu(8);
+    emu.setBounds(0, 8);
+    uint8_t old[300];
+    memset(old, 0x3c, sizeof(old));
+    size_t usedEntries;
+    {
+        Storage storage;
+        TEST_ESP_OK(storage.init(0, 8));
+        TEST_ESP_OK(storage.writeItem(1, ItemType::BLOB, "table", old, sizeof(old)));
+        TEST_ESP_OK(storage.calcEntriesInNamespace(1, usedEntries));
+
+        nvs_opaque_blob_writer_t writer;
+        TEST_ESP_OK(storage.openBlobWriter(&writer, 1, "table"));
+        std::vector<uint8_t> data(Page::CHUNK_MAX_SIZE * 3, 0x77);
+        TEST_ESP_OK(storage.appendBlob(&writer, data.data(), data.size()));
+        size_t written;
+        TEST_ESP_OK(storage.calcEntriesInNamespace(1, written));
+        CHECK(written > usedEntries);
+    }
+
+    Storage storage;
+    TEST_ESP_OK(storage.init(0, 8));
+    uint8_t buf[sizeof(old)];
+    TEST_ESP_OK(storage.readItem(1, ItemType::BLOB, "table", buf, sizeof(buf)));
+    CHECK(memcmp(buf, old, sizeof(old)) == 0);
+    size_t afterInit;
+    TEST_ESP_OK(storage.calcEntriesInNamespace(1, afterInit));
+    CHECK(afterInit == usedEntries);
+}
+
+static void fill_summary_test_storage(Storage& storage, size_t itemCount, size_t valueSize)
+{
+    uint8_t nsIndex;
+    TEST_ESP_OK(storage.createOrOpenNamespace("summary", true, nsIndex));
+    std::vector<char> value(valueSize, 'v');
+    value.back() = 0;
+    char key[16];
+    for (size_t i = 0; i < itemCount; ++i) {
+        sprintf(key, "k%u", static_cast<unsigned>(i));
+        value[0] = static_cast<char>('a' + i % 26);
+        TEST_ESP_OK(storage.writeItem(nsIndex, ItemType::SZ, key, value.data(), value.size()));
+    }
+}
+
+static void check_summary_test_storage(Storage& storage, size_t itemCount, size_t valueSize)
+{
+    uint8_t nsIndex;
+    TEST_ESP_OK(storage.createOrOpenNamespace("summary", false, nsIndex));
+    std::vector<char> value(valueSize);
+    char key[16];
+    for (size_t i = 0; i < itemCount; ++i) {
+        sprintf(key, "k%u", static_cast<unsigned>(i));
+        TEST_ESP_OK(storage.readItem(nsIndex, ItemType::SZ, key, value.data(), value.size()));
+        CHECK(value[0] == static_cast<char>('a' + i % 26));
+    }
+}
+
+TEST_CASE("mount summary loads unchanged full pages without reading their items", "[nvs][summary]")
+{
+    const size_t sectorCount = 16;
+    const size_t itemCount = 60;
+    const size_t valueSize = 600;
+    SpiFlashEmulator emu(sectorCount);
+    {
+        Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, true);
+        TEST_ESP_OK(storage.init(0, sectorCount));
+        fill_summary_test_storage(storage, itemCount, valueSize);
+        // the last sector holds the summary, not a page
+        nvs_stats_t stats;
+        TEST_ESP_OK(storage.fillStats(stats));
+        CHECK(stats.total_entries == (sectorCount - 1) * Page::ENTRY_COUNT);
+    }
+
+    size_t scanReads;
+    {
+        // this init scans all pages and writes the summary
+        Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, true);
+        Page::getEntryCache().resize(0);
+        emu.clearStats();
+        TEST_ESP_OK(storage.init(0, sectorCount));
+        CHECK(emu.getEraseOps() == 1);
+        scanReads = emu.getReadOps();
+    }
+
+    Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, true);
+    emu.clearStats();
+    TEST_ESP_OK(storage.init(0, sectorCount));
+    CHECK(emu.getEraseOps() == 0);
+    CHECK(emu.getWriteOps() == 0);
+    size_t summaryReads = emu.getReadOps();
+    // on the host, init ends with debugCheck, which reads every item
+    emu.clearStats();
+    storage.debugCheck();
+    scanReads -= emu.getReadOps();
+    summaryReads -= emu.getReadOps();
+    // headers and entry tables, the summary, the namespace entry, the active page and free pages
+    CHECK(summaryReads * 3 < scanReads);
+    Page::getEntryCache().resize(CONFIG_NVS_ENTRY_CACHE_SIZE);
+    check_summary_test_storage(storage, itemCount, valueSize);
+}
+
+TEST_CASE("mount summary is ignored for pages changed since it was written", "[nvs][summary]")
+{
+    const size_t sectorCount = 8;
+    const size_t itemCount = 30;
+    const size_t valueSize = 600;
+    SpiFlashEmulator emu(sectorCount);
+    uint8_t nsIndex;
+    {
+        Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, true);
+        TEST_ESP_OK(storage.init(0, sectorCount));
+        fill_summary_test_storage(storage, itemCount, valueSize);
+        TEST_ESP_OK(storage.init(0, sectorCount));
+
+        // overwrite and erase items on full pages after the summary was written
+        TEST_ESP_OK(storage.createOrOpenNamespace("summary", false, nsIndex));
+        const char value[] = "new value";
+        TEST_ESP_OK(storage.writeItem(nsIndex, ItemType::SZ, "k0", value, sizeof(value)));
+        TEST_ESP_OK(storage.eraseItem(nsIndex, ItemType::SZ, "k1"));
+    }
+
+    Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, true);
+    TEST_ESP_OK(storage.init(0, sectorCount));
+    char buf[valueSize];
+    TEST_ESP_OK(storage.readItem(nsIndex, ItemType::SZ, "k0", buf, sizeof(buf)));
+    CHECK(strcmp(buf, "new value") == 0);
+    TEST_ESP_ERR(storage.readItem(nsIndex, ItemType::SZ, "k1", buf, sizeof(buf)), ESP_ERR_NVS_NOT_FOUND);
+    for (size_t i = 2; i < itemCount; ++i) {
+        char key[16];
+        sprintf(key, "k%u", static_cast<unsigned>(i));
+        TEST_ESP_OK(storage.readItem(nsIndex, ItemType::SZ, key, buf, sizeof(buf)));
+        CHECK(buf[0] == static_cast<char>('a' + i % 26));
+    }
+    storage.debugCheck();
+}
+
+TEST_CASE("mount summary still erases orphan blob chunks on summarized pages", "[nvs][summary]")
+{
+    const size_t sectorCount = 8;
+    SpiFlashEmulator emu(sectorCount);
+    std::vector<uint8_t> blob(Page::CHUNK_MAX_SIZE * 2 + 500, 0x42);
+    {
+        Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, true);
+        TEST_ESP_OK(storage.init(0, sectorCount));
+        TEST_ESP_OK(storage.writeItem(1, ItemType::BLOB, "blob", blob.data(), blob.size()));
+        TEST_ESP_OK(storage.writeItem(1, "u32", static_cast<uint32_t>(1)));
+        TEST_ESP_OK(storage.init(0, sectorCount));
+    }
+
+    // power went out after the index of the blob had been erased, but not its chunks
+    for (uint32_t sector = 0; sector < sectorCount - 1; ++sector) {
+        Page page;
+        TEST_ESP_OK(page.load(sector));
+        if (page.findItem(1, ItemType::BLOB_IDX, "blob") == ESP_OK) {
+            TEST_ESP_OK(page.eraseItem(1, ItemType::BLOB_IDX, "blob"));
+        }
+    }
+
+    Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, true);
+    TEST_ESP_OK(storage.init(0, sectorCount));
+    size_t usedEntries;
+    TEST_ESP_OK(storage.calcEntriesInNamespace(1, usedEntries));
+    CHECK(usedEntries == 1);
+    uint32_t value;
+    TEST_ESP_OK(storage.readItem(1, "u32", value));
+    CHECK(value == 1);
+}
+
+TEST_CASE("mount summary doesn't take a sector which holds a page", "[nvs][summary]")
+{
+    const size_t sectorCount = 5;
+    SpiFlashEmulator emu(sectorCount);
+    {
+        Storage storage;
+        TEST_ESP_OK(storage.init(0, sectorCount));
+        // fill all pages, so that the last sector is used
+        for (uint32_t i = 0; i < Page::ENTRY_COUNT * sectorCount; ++i) {
+            TEST_ESP_OK(storage.writeItem(1, "i", i));
+        }
+    }
+    Page lastPage;
+    TEST_ESP_OK(lastPage.load(sectorCount - 1));
+    REQUIRE(lastPage.state() != Page::PageState::UNINITIALIZED);
+
+    Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, true);
+    TEST_ESP_OK(storage.init(0, sectorCount));
+    nvs_stats_t stats;
+    TEST_ESP_OK(storage.fillStats(stats));
+    CHECK(stats.total_entries == sectorCount * Page::ENTRY_COUNT);
+    uint32_t value;
+    TEST_ESP_OK(storage.readItem(1, "i", value));
+    CHECK(value == Page::ENTRY_COUNT * sectorCount - 1);
+}
+
+TEST_CASE("mount summary doesn't take the only free page", "[nvs][summary]")
+{
+    const size_t sectorCount = 5;
+    SpiFlashEmulator emu(sectorCount);
+    uint32_t lastValue = 0;
+    {
+        Storage storage;
+        TEST_ESP_OK(storage.init(0, sectorCount));
+        // fill pages until only the last sector is free
+        for (uint32_t i = 0; ; ++i) {
+            TEST_ESP_OK(storage.writeItem(1, "i", i));
+            lastValue = i;
+            Page page;
+            TEST_ESP_OK(page.load(sectorCount - 2));
+            if (page.state() != Page::PageState::UNINITIALIZED) {
+                break;
+            }
+        }
+    }
+    Page lastPage;
+    TEST_ESP_OK(lastPage.load(sectorCount - 1));
+    REQUIRE(lastPage.state() == Page::PageState::UNINITIALIZED);
+
+    Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, true);
+    TEST_ESP_OK(storage.init(0, sectorCount));
+    nvs_stats_t stats;
+    TEST_ESP_OK(storage.fillStats(stats));
+    CHECK(stats.total_entries == sectorCount * Page::ENTRY_COUNT);
+    uint32_t value;
+    TEST_ESP_OK(storage.readItem(1, "i", value));
+    CHECK(value == lastValue);
+    TEST_ESP_OK(storage.writeItem(1, "i", lastValue + 1));
+}
+
+TEST_CASE("mount summary which is corrupted or partly written is ignored", "[nvs][summary]")
+{
+    const size_t sectorCount = 8;
+    const size_t itemCount = 30;
+    const size_t valueSize = 600;
+    SpiFlashEmulator emu(sectorCount);
+    {
+        Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, true);
+        TEST_ESP_OK(storage.init(0, sectorCount));
+        fill_summary_test_storage(storage, itemCount, valueSize);
+    }
+
+    // power goes out at every flash operation of the init which writes the summary
+    size_t opCount;
+    {
+        Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, true);
+        emu.clearStats();
+        TEST_ESP_OK(storage.init(0, sectorCount));
+        opCount = emu.getWriteOps() + emu.getEraseOps();
+        CHECK(opCount > 0);
+    }
+    for (size_t failAfter = 0; failAfter < opCount; ++failAfter) {
+        emu.erase(sectorCount - 1);
+        {
+            Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, true);
+            emu.failAfter(failAfter);
+            storage.init(0, sectorCount);
+        }
+        emu.failAfter(UINT32_MAX);
+        Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, true);
+        TEST_ESP_OK(storage.init(0, sectorCount));
+        check_summary_test_storage(storage, itemCount, valueSize);
+    }
+
+    // a bit flipped in the summary
+    uint32_t word;
+    const uint32_t address = (sectorCount - 1) * SPI_FLASH_SEC_SIZE + 64;
+    TEST_ESP_OK(spi_flash_read(address, &word, sizeof(word)));
+    word &= ~(word & (0 - word)); // clear the lowest set bit
+    TEST_ESP_OK(spi_flash_write(address, &word, sizeof(word)));
+    Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, true);
+    TEST_ESP_OK(storage.init(0, sectorCount));
+    check_summary_test_storage(storage, itemCount, valueSize);
+}
+
+TEST_CASE("benchmark mount time with and without mount summary", "[nvs][summary]")
+{
+    const size_t sectorCounts[] = {16, 32, 64};
+    const size_t valueSize = 600; // about 6 items per page
+    for (size_t sectorCount : sectorCounts) {
+        const size_t itemCount = (sectorCount - 4) * 6;
+        for (bool summary : {false, true}) {
+            SpiFlashEmulator emu(sectorCount);
+            {
+                Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, summary);
+                TEST_ESP_OK(storage.init(0, sectorCount));
+                fill_summary_test_storage(storage, itemCount, valueSize);
+            }
+            {
+                Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, summary);
+                TEST_ESP_OK(storage.init(0, sectorCount));
+            }
+
+            Storage storage(NVS_DEFAULT_PART_NAME, CONFIG_NVS_ITEM_INDEX_SIZE, 0, summary);
+            Page::getEntryCache().resize(0);
+            emu.clearStats();
+            TEST_ESP_OK(storage.init(0, sectorCount));
+            size_t time = emu.getTotalTime();
+            size_t readOps = emu.getReadOps();
+            // leave out debugCheck, which init only does on the host
+            emu.clearStats();
+            storage.debugCheck();
+            time -= emu.getTotalTime();
+            readOps -= emu.getReadOps();
+            s_perf << "Mount, " << sectorCount << " sectors, " << itemCount << " items, "
+                   << (summary ? "with" : "without") << " mount summary: " << time << " us ("
+                   << readOps << " reads)" << std::endl;
+            Page::getEntryCache().resize(CONFIG_NVS_ENTRY_CACHE_SIZE);
+            check_summary_test_storage(storage, itemCount, valueSize);
+        }
+    }
+}
+
+static size_t count_entries(const char* namespace_name, nvs_type_t type)
+{
+    size_t count = 0;
+    nvs_iterator_t it = nvs_entry_find(NVS_DEFAULT_PART_NAME, namespace_name, type);
+    while (it != NULL) {
+        ++count;
+        it = nvs_entry_next(it);
+    }
+    return count;
+}
+
+TEST_CASE("iterator returns entries filtered by namespace and type", "[nvs][iterator]")
+{
+    SpiFlashEmulator emu(5);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 5));
+    nvs_handle handle_1, handle_2;
+    TEST_ESP_OK(nvs_open("ns_1", NVS_READWRITE, &handle_1));
+    TEST_ESP_OK(nvs_open("ns_2", NVS_READWRITE, &handle_2));
+
+    TEST_ESP_OK(nvs_set_u8(handle_1, "u8", 1));
+    TEST_ESP_OK(nvs_set_i32(handle_1, "i32", -1));
+    TEST_ESP_OK(nvs_set_u32(handle_1, "u32", 1));
+    TEST_ESP_OK(nvs_set_str(handle_1, "str", "iterator"));
+    uint8_t blob[Page::CHUNK_MAX_SIZE * 3 / 2];
+    fill_n(blob, sizeof(blob), 0xa5);
+    TEST_ESP_OK(nvs_set_blob(handle_1, "blob", blob, sizeof(blob)));
+    TEST_ESP_OK(nvs_set_u32(handle_1, "u32", 2));
+    TEST_ESP_OK(nvs_erase_key(handle_1, "u8"));
+    TEST_ESP_OK(nvs_set_u32(handle_2, "u32", 3));
+    TEST_ESP_OK(nvs_set_u64(handle_2, "u64", 4));
+
+    CHECK(count_entries(NULL, NVS_TYPE_ANY) == 6);
+    CHECK(count_entries("ns_1", NVS_TYPE_ANY) == 4);
+    CHECK(count_entries("ns_2", NVS_TYPE_ANY) == 2);
+    CHECK(count_entries(NULL, NVS_TYPE_U32) == 2);
+    CHECK(count_entries("ns_2", NVS_TYPE_U32) == 1);
+    CHECK(count_entries(NULL, NVS_TYPE_U8) == 0);
+    CHECK(count_entries("ns_1", NVS_TYPE_BLOB) == 1);
+    CHECK(count_entries("ns_1", NVS_TYPE_STR) == 1);
+
+    bool seen[6] = {};
+    nvs_iterator_t it = nvs_entry_find(NVS_DEFAULT_PART_NAME, NULL, NVS_TYPE_ANY);
+    for (; it != NULL; it = nvs_entry_next(it)) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        const struct {
+            const char* ns;
+            const char* key;
+            nvs_type_t type;
+        } expected[] = {
+            {"ns_1", "i32", NVS_TYPE_I32},
+            {"ns_1", "u32", NVS_TYPE_U32},
+            {"ns_1", "str", NVS_TYPE_STR},
+            {"ns_1", "blob", NVS_TYPE_BLOB},
+            {"ns_2", "u32", NVS_TYPE_U32},
+            {"ns_2", "u64", NVS_TYPE_U64},
+        };
+        bool found = false;
+        for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+            if (strcmp(info.namespace_name, expected[i].ns) == 0 && strcmp(info.key, expected[i].key) == 0) {
+                CHECK(info.type == expected[i].type);
+                CHECK(!seen[i]);
+                seen[i] = true;
+                found = true;
+            }
+        }
+        CHECK(found);
+    }
+    CHECK(all_of(begin(seen), end(seen), [](bool b) { return b; }));
+
+    // releasing the iterator before reaching the end
+    it = nvs_entry_find(NVS_DEFAULT_PART_NAME, "ns_1", NVS_TYPE_ANY);
+    CHECK(it != NULL);
+    nvs_release_iterator(it);
+
+    CHECK(nvs_entry_find(NVS_DEFAULT_PART_NAME, "no_such_ns", NVS_TYPE_ANY) == NULL);
+    CHECK(nvs_entry_find("no_such_part", NULL, NVS_TYPE_ANY) == NULL);
+
+    nvs_close(handle_1);
+    nvs_close(handle_2);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("iterating over all entries reads each entry once", "[nvs][iterator]")
+{
+    const size_t pageCount = 8;
+    SpiFlashEmulator emu(pageCount);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, pageCount));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("iter", NVS_READWRITE, &handle));
+    const size_t itemCount = Page::ENTRY_COUNT * 4;
+    char key[16];
+    for (size_t i = 0; i < itemCount; ++i) {
+        sprintf(key, "key%u", static_cast<unsigned>(i));
+        TEST_ESP_OK(nvs_set_u32(handle, key, i));
+    }
+
+    emu.clearStats();
+    CHECK(count_entries(NULL, NVS_TYPE_ANY) == itemCount);
+    // one read per entry, plus the namespace entry
+    CHECK(emu.getReadOps() <= itemCount + 1);
+    s_perf << "Iterating over " << itemCount << " entries: " << emu.getReadOps() << " reads, "
+           << emu.getReadBytes() << " bytes" << std::endl;
+
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("iterator carries on after pages are reclaimed", "[nvs][iterator]")
+{
+    SpiFlashEmulator emu(3);
+    TEST_ESP_OK(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, 0, 3));
+    nvs_handle handle;
+    TEST_ESP_OK(nvs_open("iter", NVS_READWRITE, &handle));
+    nvs_handle filler;
+    TEST_ESP_OK(nvs_open("filler", NVS_READWRITE, &filler));
+    char key[16];
+    for (uint32_t i = 0; i < 16; ++i) {
+        sprintf(key, "key%u", i);
+        TEST_ESP_OK(nvs_set_u32(handle, key, i));
+    }
+
+    // keep rewriting values while iterating, so that pages are erased under the iterator
+    size_t count = 0;
+    nvs_iterator_t it = nvs_entry_find(NVS_DEFAULT_PART_NAME, "iter", NVS_TYPE_U32);
+    for (; it != NULL; it = nvs_entry_next(it)) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        CHECK(strncmp(info.key, "key", 3) == 0);
+        for (uint32_t i = 0; i < Page::ENTRY_COUNT; ++i) {
+            TEST_ESP_OK(nvs_set_u32(filler, "filler", i));
+        }
+        ++count;
+        REQUIRE(count <= 16);
+    }
+    CHECK(emu.getEraseOps() > 0);
+    CHECK(count > 0);
+
+    nvs_close(filler);
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
 /* Add new tests above */
 /* This test has to be the final one */
 
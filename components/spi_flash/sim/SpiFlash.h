@@ -54,6 +54,14 @@ public:
     void reset_erase_cycles();
     void reset_total_erase_cycles();
 
+    uint32_t get_erase_ops();
+    uint32_t get_write_ops();
+    uint64_t get_write_bytes();
+    uint32_t get_read_ops();
+    uint64_t get_read_bytes();
+
+    void reset_access_counters();
+
     uint8_t* get_memory_ptr(uint32_t src_address);
 
 private:
@@ -75,6 +83,13 @@ private:
     uint32_t total_erase_cycles;
     uint32_t total_erase_cycles_limit;
 
+    // Accesses since the last reset_access_counters, erases include already erased sectors
+    uint32_t erase_ops;
+    uint32_t write_ops;
+    uint64_t write_bytes;
+    uint32_t read_ops;
+    uint64_t read_bytes;
+
     void deinit();
 };
 
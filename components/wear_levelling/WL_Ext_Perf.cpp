@@ -13,6 +13,7 @@
 
 #include "WL_Ext_Perf.h"
 #include <stdlib.h>
+#include <string.h>
 #include "esp_log.h"
 
 static const char *TAG = "wl_ext_perf";
@@ -166,3 +167,67 @@ esp_err_t WL_Ext_Perf::erase_range(size_t start_address, size_t size)
     }
     return ESP_OK;
 }
+
+esp_err_t WL_Ext_Perf::erase_write_fit(uint32_t start_sector, uint32_t count, const void *src)
+{
+    ESP_LOGV(TAG, "%s begin, start_sector = 0x%08x, count = %i", __func__, start_sector, count);
+    // Same as erase_sector_fit followed by write, but the new data is merged with the
+    // data which is kept, and the flash sector is written at once
+    esp_err_t result = ESP_OK;
+    uint8_t *buffer = (uint8_t *)this->sector_buffer;
+    size_t base_addr = start_sector / this->size_factor * this->flash_sector_size;
+    uint32_t pre_check_start = start_sector % this->size_factor;
+    uint32_t post_check_start = pre_check_start + count;
+
+    if (pre_check_start > 0) {
+        result = this->read(base_addr, buffer, pre_check_start * this->fat_sector_size);
+        WL_EXT_RESULT_CHECK(result);
+    }
+    if (post_check_start < this->size_factor) {
+        result = this->read(base_addr + post_check_start * this->fat_sector_size, buffer + post_check_start * this->fat_sector_size, (this->size_factor - post_check_start) * this->fat_sector_size);
+        WL_EXT_RESULT_CHECK(result);
+    }
+    memcpy(buffer + pre_check_start * this->fat_sector_size, src, count * this->fat_sector_size);
+
+    result = WL_Flash::erase_sector(start_sector / this->size_factor);
+    WL_EXT_RESULT_CHECK(result);
+    result = WL_Flash::write(base_addr, buffer, this->flash_sector_size);
+    WL_EXT_RESULT_CHECK(result);
+    return ESP_OK;
+}
+
+esp_err_t WL_Ext_Perf::erase_write(size_t start_address, const void *src, size_t size)
+{
+    esp_err_t result = ESP_OK;
+    if ((start_address % this->fat_sector_size) != 0) {
+        result = ESP_ERR_INVALID_ARG;
+    }
+    if (((size % this->fat_sector_size) != 0) || (size == 0)) {
+        result = ESP_ERR_INVALID_ARG;
+    }
+    WL_EXT_RESULT_CHECK(result);
+
+    ESP_LOGV(TAG, "%s begin, addr = 0x%08x, size = %i", __func__, start_address, size);
+    // Every flash sector in the range is erased and written once: sectors which are
+    // covered completely are written from src, the others are merged by erase_write_fit
+    const uint8_t *data = (const uint8_t *)src;
+    uint32_t sector = start_address / this->fat_sector_size;
+    uint32_t end_sector = sector + size / this->fat_sector_size;
+    while (sector < end_sector) {
+        uint32_t count = this->size_factor - sector % this->size_factor;
+        if (count > end_sector - sector) {
+            count = end_sector - sector;
+        }
+        if (count == this->size_factor) {
+            result = WL_Flash::erase_sector(sector / this->size_factor);
+            WL_EXT_RESULT_CHECK(result);
+            result = WL_Flash::write(sector * this->fat_sector_size, data, this->flash_sector_size);
+        } else {
+            result = this->erase_write_fit(sector, count, data);
+        }
+        WL_EXT_RESULT_CHECK(result);
+        data += count * this->fat_sector_size;
+        sector += count;
+    }
+    return ESP_OK;
+}
@@ -159,3 +159,11 @@ esp_err_t WL_Ext_Safe::erase_sector_fit(uint32_t start_sector, uint32_t count)
 
     return ESP_OK;
 }
+
+esp_err_t WL_Ext_Safe::erase_write_fit(uint32_t start_sector, uint32_t count, const void *src)
+{
+    // The data which is kept goes through the dump sector, so that it survives a power off
+    esp_err_t result = this->erase_sector_fit(start_sector, count);
+    WL_EXT_RESULT_CHECK(result);
+    return this->write(start_sector * this->fat_sector_size, src, count * this->fat_sector_size);
+}
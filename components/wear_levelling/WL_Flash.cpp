@@ -25,6 +25,9 @@ static const char *TAG = "wl_flash";
 #define WL_CFG_CRC_CONST UINT32_MAX
 #endif // WL_CFG_CRC_CONST 
 
+// Size of the buffer used to copy position records between the state copies
+#define WL_POS_BURST_SIZE 512
+
 #define WL_RESULT_CHECK(result) \
     if (result != ESP_OK) { \
         ESP_LOGE(TAG,"%s(%d): result = 0x%08x", __FUNCTION__, __LINE__, result); \
@@ -42,6 +45,7 @@ WL_Flash::WL_Flash()
 
 WL_Flash::~WL_Flash()
 {
+    this->freeCache();
     free(this->temp_buff);
 }
 
@@ -131,6 +135,7 @@ esp_err_t WL_Flash::init()
     wl_state_t *state_copy = &sa_copy;
     result = this->flash_drv->read(this->addr_state2, state_copy, sizeof(wl_state_t));
     WL_RESULT_CHECK(result);
+    size_t pos_count = 0;
 
     int check_size = WL_STATE_CRC_LEN_V2;
     // Chech CRC and recover state
@@ -161,17 +166,10 @@ esp_err_t WL_Flash::init()
                 WL_RESULT_CHECK(result);
                 result = this->flash_drv->write(this->addr_state2, &this->state, sizeof(wl_state_t));
                 WL_RESULT_CHECK(result);
-                for (size_t i = 0; i < ((this->cfg.full_mem_size / this->cfg.sector_size)*this->cfg.wr_size); i++) {
-                    bool pos_bits;
-                    result = this->flash_drv->read(this->addr_state1 + sizeof(wl_state_t) + i * this->cfg.wr_size, this->temp_buff, this->cfg.wr_size);
-                    WL_RESULT_CHECK(result);
-                    pos_bits = this->OkBuffSet(i);
-                    if (pos_bits == true) {
-                        //this->fillOkBuff(i);
-                        result = this->flash_drv->write(this->addr_state2 + sizeof(wl_state_t) + i * this->cfg.wr_size, this->temp_buff, this->cfg.wr_size);
-                        WL_RESULT_CHECK(result);
-                    }
-                }
+                result = this->findPosCount(this->addr_state1, this->cfg.full_mem_size / this->cfg.sector_size, &pos_count);
+                WL_RESULT_CHECK(result);
+                result = this->copyPosRecords(this->addr_state1, this->addr_state2, pos_count);
+                WL_RESULT_CHECK(result);
             }
             ESP_LOGD(TAG, "%s: crc1=0x%08x, crc2 = 0x%08x, result= 0x%08x", __func__, crc1, crc2, (uint32_t)result);
             result = this->recoverPos();
@@ -195,34 +193,24 @@ esp_err_t WL_Flash::init()
             WL_RESULT_CHECK(result);
             result = this->flash_drv->write(this->addr_state2, &this->state, sizeof(wl_state_t));
             WL_RESULT_CHECK(result);
-            for (size_t i = 0; i < ((this->cfg.full_mem_size / this->cfg.sector_size) * this->cfg.wr_size); i++) {
-                bool pos_bits;
-                result = this->flash_drv->read(this->addr_state1 + sizeof(wl_state_t) + i * this->cfg.wr_size, this->temp_buff, this->cfg.wr_size);
-                WL_RESULT_CHECK(result);
-                pos_bits = this->OkBuffSet(i);
-                if (pos_bits == true) {
-                    result = this->flash_drv->write(this->addr_state2 + sizeof(wl_state_t) + i * this->cfg.wr_size, this->temp_buff, this->cfg.wr_size);
-                    WL_RESULT_CHECK(result);
-                }
-            }
+            result = this->findPosCount(this->addr_state1, this->cfg.full_mem_size / this->cfg.sector_size, &pos_count);
+            WL_RESULT_CHECK(result);
+            result = this->copyPosRecords(this->addr_state1, this->addr_state2, pos_count);
+            WL_RESULT_CHECK(result);
             result = this->flash_drv->read(this->addr_state2, &this->state, sizeof(wl_state_t));
             WL_RESULT_CHECK(result);
+            // the stored state doesn't hold the position, it is given by the records
+            result = this->recoverPos();
+            WL_RESULT_CHECK(result);
         } else { // we have to recover state 1
             result = this->flash_drv->erase_range(this->addr_state1, this->state_size);
             WL_RESULT_CHECK(result);
             result = this->flash_drv->write(this->addr_state1, state_copy, sizeof(wl_state_t));
             WL_RESULT_CHECK(result);
-            for (size_t i = 0; i < ((this->cfg.full_mem_size / this->cfg.sector_size) * this->cfg.wr_size); i++) {
-                bool pos_bits;
-                result = this->flash_drv->read(this->addr_state2 + sizeof(wl_state_t) + i * this->cfg.wr_size, this->temp_buff, this->cfg.wr_size);
-
-                WL_RESULT_CHECK(result);
-                pos_bits = this->OkBuffSet(i);
-                if (pos_bits == true) {
-                    result = this->flash_drv->write(this->addr_state1 + sizeof(wl_state_t) + i * this->cfg.wr_size, this->temp_buff, this->cfg.wr_size);
-                    WL_RESULT_CHECK(result);
-                }
-            }
+            result = this->findPosCount(this->addr_state2, this->cfg.full_mem_size / this->cfg.sector_size, &pos_count);
+            WL_RESULT_CHECK(result);
+            result = this->copyPosRecords(this->addr_state2, this->addr_state1, pos_count);
+            WL_RESULT_CHECK(result);
             result = this->flash_drv->read(this->addr_state1, &this->state, sizeof(wl_state_t));
             WL_RESULT_CHECK(result);
             this->state.pos = this->state.max_pos - 1;
@@ -249,17 +237,8 @@ esp_err_t WL_Flash::recoverPos()
     esp_err_t result = ESP_OK;
     size_t position = 0;
     ESP_LOGV(TAG, "%s start", __func__);
-    for (size_t i = 0; i < this->state.max_pos; i++) {
-        bool pos_bits;
-        position = i;
-        result = this->flash_drv->read(this->addr_state1 + sizeof(wl_state_t) + i * this->cfg.wr_size, this->temp_buff, this->cfg.wr_size);
-        pos_bits = this->OkBuffSet(i);
-        WL_RESULT_CHECK(result);
-        ESP_LOGV(TAG, "%s - check pos: result=0x%08x, position= %i, pos_bits= 0x%08x", __func__, (uint32_t)result, (uint32_t)position, (uint32_t)pos_bits);
-        if (pos_bits == false) {
-            break; // we have found position
-        }
-    }
+    result = this->findPosCount(this->addr_state1, this->state.max_pos, &position);
+    WL_RESULT_CHECK(result);
 
     this->state.pos = position;
     if (this->state.pos == this->state.max_pos) {
@@ -270,6 +249,59 @@ esp_err_t WL_Flash::recoverPos()
     return result;
 }
 
+esp_err_t WL_Flash::findPosCount(size_t state_addr, size_t max_count, size_t *out_count)
+{
+    // updateWL sets the position records one after another, and they are only
+    // cleared all together when the state is erased, so the records which are set
+    // always come first and the first record which is not set can be found by bisection
+    esp_err_t result = ESP_OK;
+    size_t low = 0;
+    size_t high = max_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        result = this->flash_drv->read(state_addr + sizeof(wl_state_t) + middle * this->cfg.wr_size, this->temp_buff, this->cfg.wr_size);
+        WL_RESULT_CHECK(result);
+        bool pos_bits = this->OkBuffSet(middle);
+        ESP_LOGV(TAG, "%s - check pos: position= %i, pos_bits= 0x%08x", __func__, (uint32_t)middle, (uint32_t)pos_bits);
+        if (pos_bits == true) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    *out_count = low;
+    return result;
+}
+
+esp_err_t WL_Flash::copyPosRecords(size_t src_state_addr, size_t dst_state_addr, size_t count)
+{
+    esp_err_t result = ESP_OK;
+    size_t size = count * this->cfg.wr_size;
+    size_t burst_size = size < WL_POS_BURST_SIZE ? size : WL_POS_BURST_SIZE;
+    uint8_t *buff = (uint8_t *)malloc(burst_size);
+    if (buff == NULL) {
+        // copy through the temporary buffer, which holds at least one record
+        buff = this->temp_buff;
+        burst_size = this->cfg.temp_buff_size / this->cfg.wr_size * this->cfg.wr_size;
+    }
+    for (size_t offset = 0; offset < size; offset += burst_size) {
+        size_t chunk_size = size - offset < burst_size ? size - offset : burst_size;
+        result = this->flash_drv->read(src_state_addr + sizeof(wl_state_t) + offset, buff, chunk_size);
+        if (result != ESP_OK) {
+            break;
+        }
+        result = this->flash_drv->write(dst_state_addr + sizeof(wl_state_t) + offset, buff, chunk_size);
+        if (result != ESP_OK) {
+            break;
+        }
+    }
+    if (buff != this->temp_buff) {
+        free(buff);
+    }
+    WL_RESULT_CHECK(result);
+    return result;
+}
+
 esp_err_t WL_Flash::initSections()
 {
     esp_err_t result = ESP_OK;
@@ -550,7 +582,20 @@ esp_err_t WL_Flash::erase_sector(size_t sector)
         return ESP_ERR_INVALID_STATE;
     }
     ESP_LOGD(TAG, "%s - sector= 0x%08x", __func__, (uint32_t) sector);
-    result = this->updateWL();
+    if (this->cache_size != 0) {
+        wl_cache_entry_t *entry;
+        result = this->allocCacheEntry(sector, &entry);
+        WL_RESULT_CHECK(result);
+        memset(entry->data, 0xff, this->cfg.sector_size);
+        entry->dirty = true;
+        return result;
+    }
+    return this->eraseFlashSector(sector);
+}
+
+esp_err_t WL_Flash::eraseFlashSector(size_t sector)
+{
+    esp_err_t result = this->updateWL();
     WL_RESULT_CHECK(result);
     size_t virt_addr = this->calcAddr(sector * this->cfg.sector_size);
     result = this->flash_drv->erase_sector((this->cfg.start_addr + virt_addr) / this->cfg.sector_size);
@@ -581,6 +626,33 @@ esp_err_t WL_Flash::write(size_t dest_addr, const void *src, size_t size)
         return ESP_ERR_INVALID_STATE;
     }
     ESP_LOGD(TAG, "%s - dest_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) dest_addr, (uint32_t) size);
+    if (this->cache_size != 0) {
+        const uint8_t *src_data = (const uint8_t *)src;
+        while (size > 0) {
+            size_t sector = dest_addr / this->cfg.sector_size;
+            size_t offset = dest_addr % this->cfg.sector_size;
+            size_t chunk = this->cfg.sector_size - offset;
+            if (chunk > size) {
+                chunk = size;
+            }
+            wl_cache_entry_t *entry = this->findCacheEntry(sector);
+            if (entry != NULL) {
+                // writing to flash can only clear bits, do the same in RAM
+                for (size_t i = 0; i < chunk; i++) {
+                    entry->data[offset + i] &= src_data[i];
+                }
+                entry->dirty = true;
+            } else {
+                size_t virt_addr = this->calcAddr(dest_addr);
+                result = this->flash_drv->write(this->cfg.start_addr + virt_addr, src_data, chunk);
+                WL_RESULT_CHECK(result);
+            }
+            dest_addr += chunk;
+            src_data += chunk;
+            size -= chunk;
+        }
+        return result;
+    }
     uint32_t count = (size - 1) / this->cfg.page_size;
     for (size_t i = 0; i < count; i++) {
         size_t virt_addr = this->calcAddr(dest_addr + i * this->cfg.page_size);
@@ -600,6 +672,29 @@ esp_err_t WL_Flash::read(size_t src_addr, void *dest, size_t size)
         return ESP_ERR_INVALID_STATE;
     }
     ESP_LOGD(TAG, "%s - src_addr= 0x%08x, size= 0x%08x", __func__, (uint32_t) src_addr, (uint32_t) size);
+    if (this->cache_size != 0) {
+        uint8_t *dest_data = (uint8_t *)dest;
+        while (size > 0) {
+            size_t sector = src_addr / this->cfg.sector_size;
+            size_t offset = src_addr % this->cfg.sector_size;
+            size_t chunk = this->cfg.sector_size - offset;
+            if (chunk > size) {
+                chunk = size;
+            }
+            wl_cache_entry_t *entry = this->findCacheEntry(sector);
+            if (entry != NULL) {
+                memcpy(dest_data, entry->data + offset, chunk);
+            } else {
+                size_t virt_addr = this->calcAddr(src_addr);
+                result = this->flash_drv->read(this->cfg.start_addr + virt_addr, dest_data, chunk);
+                WL_RESULT_CHECK(result);
+            }
+            src_addr += chunk;
+            dest_data += chunk;
+            size -= chunk;
+        }
+        return result;
+    }
     uint32_t count = (size - 1) / this->cfg.page_size;
     for (size_t i = 0; i < count; i++) {
         size_t virt_addr = this->calcAddr(src_addr + i * this->cfg.page_size);
@@ -624,9 +719,117 @@ wl_config_t *WL_Flash::get_cfg()
 
 esp_err_t WL_Flash::flush()
 {
-    esp_err_t result = ESP_OK;
+    esp_err_t result = this->sync();
+    WL_RESULT_CHECK(result);
     this->state.access_count = this->state.max_count - 1;
     result = this->updateWL();
     ESP_LOGD(TAG, "%s - result= 0x%08x, move_count= 0x%08x", __func__, result, this->state.move_count);
     return result;
 }
+
+esp_err_t WL_Flash::set_cache_size(size_t sector_count)
+{
+    if (!this->configured || this->initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    this->freeCache();
+    if (sector_count == 0) {
+        return ESP_OK;
+    }
+    this->cache = (wl_cache_entry_t *)calloc(sector_count, sizeof(wl_cache_entry_t));
+    if (this->cache == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    this->cache_size = sector_count;
+    for (size_t i = 0; i < sector_count; i++) {
+        this->cache[i].data = (uint8_t *)malloc(this->cfg.sector_size);
+        if (this->cache[i].data == NULL) {
+            this->freeCache();
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    ESP_LOGD(TAG, "%s - sector_count= %i", __func__, (uint32_t) sector_count);
+    return ESP_OK;
+}
+
+void WL_Flash::freeCache()
+{
+    for (size_t i = 0; i < this->cache_size; i++) {
+        free(this->cache[i].data);
+    }
+    free(this->cache);
+    this->cache = NULL;
+    this->cache_size = 0;
+}
+
+WL_Flash::wl_cache_entry_t *WL_Flash::findCacheEntry(size_t sector)
+{
+    for (size_t i = 0; i < this->cache_size; i++) {
+        wl_cache_entry_t *entry = &this->cache[i];
+        if (entry->valid && entry->sector == sector) {
+            entry->last_use = ++this->cache_tick;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t WL_Flash::allocCacheEntry(size_t sector, wl_cache_entry_t **out_entry)
+{
+    esp_err_t result = ESP_OK;
+    wl_cache_entry_t *entry = this->findCacheEntry(sector);
+    if (entry == NULL) {
+        // take a free entry, or write back the least recently used one
+        for (size_t i = 0; i < this->cache_size; i++) {
+            if (!this->cache[i].valid) {
+                entry = &this->cache[i];
+                break;
+            }
+            if (entry == NULL || this->cache[i].last_use < entry->last_use) {
+                entry = &this->cache[i];
+            }
+        }
+        result = this->writeBackCacheEntry(entry);
+        WL_RESULT_CHECK(result);
+        entry->sector = sector;
+        entry->valid = true;
+        entry->last_use = ++this->cache_tick;
+    }
+    *out_entry = entry;
+    return result;
+}
+
+esp_err_t WL_Flash::writeBackCacheEntry(wl_cache_entry_t *entry)
+{
+    esp_err_t result = ESP_OK;
+    if (!entry->valid || !entry->dirty) {
+        return result;
+    }
+    ESP_LOGV(TAG, "%s - sector= 0x%08x", __func__, (uint32_t) entry->sector);
+    result = this->eraseFlashSector(entry->sector);
+    WL_RESULT_CHECK(result);
+    // a sector which was only erased doesn't need to be written
+    const uint32_t *words = (const uint32_t *)entry->data;
+    size_t word_count = this->cfg.sector_size / sizeof(uint32_t);
+    size_t i = 0;
+    while (i < word_count && words[i] == UINT32_MAX) {
+        i++;
+    }
+    if (i < word_count) {
+        size_t virt_addr = this->calcAddr(entry->sector * this->cfg.sector_size);
+        result = this->flash_drv->write(this->cfg.start_addr + virt_addr, entry->data, this->cfg.sector_size);
+        WL_RESULT_CHECK(result);
+    }
+    entry->dirty = false;
+    return result;
+}
+
+esp_err_t WL_Flash::sync()
+{
+    esp_err_t result = ESP_OK;
+    for (size_t i = 0; i < this->cache_size; i++) {
+        result = this->writeBackCacheEntry(&this->cache[i]);
+        WL_RESULT_CHECK(result);
+    }
+    return result;
+}
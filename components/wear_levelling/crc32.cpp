@@ -12,9 +12,9 @@
 // limitations under the License.
 
 #include "crc32.h"
-#include "rom/crc.h"
+#include "esp_crc.h"
 
 unsigned int crc32::crc32_le(unsigned int crc, unsigned char const *buf, unsigned int len)
 {
-    return ::crc32_le(crc, buf, len);
+    return esp_crc32_le(crc, buf, len);
 }
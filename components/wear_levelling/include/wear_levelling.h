@@ -94,6 +94,30 @@ esp_err_t wl_erase_range(wl_handle_t handle, size_t start_addr, size_t size);
 */
 esp_err_t wl_write(wl_handle_t handle, size_t dest_addr, const void *src, size_t size);
 
+/**
+* @brief Erase part of the WL storage and write data to it
+*
+* Same as wl_erase_range followed by wl_write on the same range, but when the
+* sector size is smaller than the flash sector size, each flash sector of the
+* range is erased and written once, instead of once per sector.
+*
+* @param handle WL handle that are related to the partition
+* @param start_addr Address where the data should be written, relative to the
+*                   beginning of the partition. Must be aligned to the result
+*                   of function wl_sector_size(...).
+* @param src Pointer to the source buffer.  Pointer must be non-NULL and
+*            buffer must be at least 'size' bytes long.
+* @param size Size of data to be written, in bytes. Must be divisible by result
+*             of function wl_sector_size(...).
+*
+* @return
+*       - ESP_OK, if the range was erased and written successfully;
+*       - ESP_ERR_INVALID_ARG, if start_addr or size are not aligned;
+*       - ESP_ERR_INVALID_SIZE, if write would go out of bounds of the partition;
+*       - or one of error codes from lower-level flash driver.
+*/
+esp_err_t wl_erase_write(wl_handle_t handle, size_t start_addr, const void *src, size_t size);
+
 /**
 * @brief Read data from the WL storage
 *
@@ -112,6 +136,22 @@ esp_err_t wl_write(wl_handle_t handle, size_t dest_addr, const void *src, size_t
 */
 esp_err_t wl_read(wl_handle_t handle, size_t src_addr, void *dest, size_t size);
 
+/**
+* @brief Write data buffered by the write cache to the flash
+*
+* With CONFIG_WL_WRITE_CACHE_SECTORS set, erased and written sectors are kept
+* in RAM, and written to flash when other sectors need the space, or when this
+* function or wl_unmount is called. Data which is not synced is lost if power
+* goes off. Without the write cache this function does nothing.
+*
+* @param handle WL module handle that was initialized before
+*
+* @return
+*       - ESP_OK, if buffered data was written successfully;
+*       - or one of error codes from lower-level flash driver.
+*/
+esp_err_t wl_sync(wl_handle_t handle);
+
 /**
 * @brief Get size of the WL storage
 *
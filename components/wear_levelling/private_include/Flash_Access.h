@@ -31,6 +31,17 @@ public:
     virtual esp_err_t write(size_t dest_addr, const void *src, size_t size) = 0;
     virtual esp_err_t read(size_t src_addr, void *dest, size_t size) = 0;
 
+    // Erase the range and write new data to it. Implementations which erase more than
+    // the range may merge the erase and the write of the same flash sector.
+    virtual esp_err_t erase_write(size_t start_address, const void *src, size_t size)
+    {
+        esp_err_t result = this->erase_range(start_address, size);
+        if (result != ESP_OK) {
+            return result;
+        }
+        return this->write(start_address, src, size);
+    };
+
     virtual size_t sector_size() = 0;
 
     virtual esp_err_t flush()
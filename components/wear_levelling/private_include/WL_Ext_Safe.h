@@ -31,6 +31,7 @@ public:
 
 protected:
     esp_err_t erase_sector_fit(uint32_t start_sector, uint32_t count) override;
+    esp_err_t erase_write_fit(uint32_t start_sector, uint32_t count, const void *src) override;
 
     // Dump Sector
     uint32_t dump_addr; // dump buffer address
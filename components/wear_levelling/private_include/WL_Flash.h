@@ -44,6 +44,19 @@ public :
 
     esp_err_t flush() override;
 
+    /**
+    * @brief Enable write cache, which keeps erased and written sectors in RAM until they are synced
+    *
+    * Must be called after config() and before init().
+    *
+    * @param sector_count number of sectors to keep, 0 to disable the cache
+    */
+    esp_err_t set_cache_size(size_t sector_count);
+    /**
+    * @brief Write sectors modified in the write cache to the flash
+    */
+    esp_err_t sync();
+
     Flash_Access *get_drv();
     wl_config_t *get_cfg();
 
@@ -70,12 +83,35 @@ protected:
     esp_err_t initSections();
     esp_err_t updateWL();
     esp_err_t recoverPos();
+    esp_err_t findPosCount(size_t state_addr, size_t max_count, size_t *out_count);
+    esp_err_t copyPosRecords(size_t src_state_addr, size_t dst_state_addr, size_t count);
     size_t calcAddr(size_t addr);
 
     esp_err_t updateVersion();
     esp_err_t updateV1_V2();
     void fillOkBuff(int n);
     bool OkBuffSet(int n);
+
+    esp_err_t eraseFlashSector(size_t sector);
+
+    // Write cache: the sector is erased and written to the flash only when it is
+    // evicted or synced, so repeated erase and write of the same sector are merged
+    typedef struct {
+        size_t sector;      // logical sector number
+        bool valid;
+        bool dirty;         // modified since it was last written to the flash
+        uint32_t last_use;
+        uint8_t *data;
+    } wl_cache_entry_t;
+
+    wl_cache_entry_t *cache = NULL;
+    size_t cache_size = 0;
+    uint32_t cache_tick = 0;
+
+    wl_cache_entry_t *findCacheEntry(size_t sector);
+    esp_err_t allocCacheEntry(size_t sector, wl_cache_entry_t **out_entry);
+    esp_err_t writeBackCacheEntry(wl_cache_entry_t *entry);
+    void freeCache();
 };
 
 #endif // _WL_Flash_H_
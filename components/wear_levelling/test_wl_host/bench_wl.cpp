@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_spi_flash.h"
+#include "esp_partition.h"
+#include "WL_Flash.h"
+#include "WL_Ext_Perf.h"
+#include "WL_Ext_Safe.h"
+#include "Partition.h"
+#include "SpiFlash.h"
+
+#include "catch.hpp"
+
+#include "sdkconfig.h"
+
+// Endurance and throughput benchmark of the wear levelling variants on the flash emulator.
+// The tests are hidden, run them with "make bench" or "./test_wl [bench]".
+//
+// Flash timings used for the simulated time can be changed with environment variables:
+// WL_BENCH_ERASE_US       time of one sector erase, in us
+// WL_BENCH_OP_US          fixed cost of one read or write operation, in us
+// WL_BENCH_WRITE_NS       program time per byte, in ns
+// WL_BENCH_READ_NS        read time per byte, in ns
+
+extern "C" void init_spi_flash(const char* chip_size, size_t block_size, size_t sector_size, size_t page_size, const char* partition_bin);
+extern SpiFlash spiflash;
+
+typedef struct {
+    uint32_t erase_us;
+    uint32_t op_us;
+    uint32_t write_ns;
+    uint32_t read_ns;
+} flash_timing_t;
+
+typedef enum {
+    WL_VARIANT_FLASH,
+    WL_VARIANT_PERF,
+    WL_VARIANT_SAFE,
+} wl_variant_t;
+
+typedef struct {
+    const char *name;
+    wl_variant_t variant;
+    uint32_t fat_sector_size;
+    size_t cache_sectors;
+} bench_config_t;
+
+typedef struct {
+    const char *name;
+    // returns the number of bytes the application asked to store
+    esp_err_t (*run)(WL_Flash *wl, uint64_t *app_bytes);
+} bench_workload_t;
+
+static const bench_config_t s_configs[] = {
+    { "WL_Flash 4096",          WL_VARIANT_FLASH, 4096, 0 },
+    { "WL_Flash 4096 cache 4",  WL_VARIANT_FLASH, 4096, 4 },
+    { "WL_Ext_Perf 512",        WL_VARIANT_PERF,  512,  0 },
+    { "WL_Ext_Perf 512 cache 4", WL_VARIANT_PERF, 512,  4 },
+    { "WL_Ext_Safe 512",        WL_VARIANT_SAFE,  512,  0 },
+};
+
+static const uint32_t s_updaterates[] = { 16, 64 };
+
+static uint32_t s_rand_state;
+
+static uint32_t bench_rand()
+{
+    // fixed sequence, so that every configuration gets the same workload
+    s_rand_state = s_rand_state * 1103515245 + 12345;
+    return s_rand_state >> 8;
+}
+
+static uint32_t timing_from_env(const char *name, uint32_t default_value)
+{
+    const char *value = getenv(name);
+    if (value == NULL || *value == '\0') {
+        return default_value;
+    }
+    return strtoul(value, NULL, 0);
+}
+
+static void get_flash_timing(flash_timing_t *timing)
+{
+    // typical values of a 40 MHz quad SPI flash chip
+    timing->erase_us = timing_from_env("WL_BENCH_ERASE_US", 45000);
+    timing->op_us = timing_from_env("WL_BENCH_OP_US", 20);
+    timing->write_ns = timing_from_env("WL_BENCH_WRITE_NS", 2500);
+    timing->read_ns = timing_from_env("WL_BENCH_READ_NS", 100);
+}
+
+// Sector writes as the FAT driver does them, see ff_wl_write
+static esp_err_t disk_write(WL_Flash *wl, size_t sector, const void *data, size_t count)
+{
+    size_t sector_size = wl->sector_size();
+    return wl->erase_write(sector * sector_size, data, count * sector_size);
+}
+
+// A file is appended in 4 kB chunks; every chunk also updates a FAT sector and the
+// directory entry. The file is deleted and written again when the data area is full.
+static esp_err_t workload_fat_append(WL_Flash *wl, uint64_t *app_bytes)
+{
+    const size_t chunk_size = 4096;
+    const size_t file_size = 256 * 1024;
+    const size_t total_size = 2 * 1024 * 1024;
+    const size_t fat_sector = 1;
+    const size_t dir_sector = 2;
+    const size_t data_start = 8 * 4096;
+
+    size_t sector_size = wl->sector_size();
+    uint8_t *buf = new uint8_t[chunk_size];
+    esp_err_t result = ESP_OK;
+    size_t file_pos = 0;
+    for (size_t written = 0; written < total_size && result == ESP_OK; written += chunk_size) {
+        memset(buf, (uint8_t) written, chunk_size);
+        result = disk_write(wl, (data_start + file_pos) / sector_size, buf, chunk_size / sector_size);
+        file_pos = (file_pos + chunk_size) % file_size;
+        if (result == ESP_OK) {
+            result = disk_write(wl, fat_sector, buf, 1);
+        }
+        if (result == ESP_OK) {
+            result = disk_write(wl, dir_sector, buf, 1);
+        }
+        *app_bytes += chunk_size;
+    }
+    delete[] buf;
+    return result;
+}
+
+// 64 byte records at random positions in a 256 kB area are updated in place,
+// each one a read-modify-write of the sector which holds it.
+static esp_err_t workload_random_overwrite(WL_Flash *wl, uint64_t *app_bytes)
+{
+    const size_t record_size = 64;
+    const size_t area_size = 256 * 1024;
+    const size_t update_count = 4000;
+
+    size_t sector_size = wl->sector_size();
+    uint8_t *buf = new uint8_t[sector_size];
+    esp_err_t result = ESP_OK;
+    for (size_t i = 0; i < update_count && result == ESP_OK; i++) {
+        size_t offset = (bench_rand() % (area_size / record_size)) * record_size;
+        size_t sector = offset / sector_size;
+        result = wl->read(sector * sector_size, buf, sector_size);
+        if (result == ESP_OK) {
+            memset(buf + offset % sector_size, (uint8_t) i, record_size);
+            result = disk_write(wl, sector, buf, 1);
+        }
+        *app_bytes += record_size;
+    }
+    delete[] buf;
+    return result;
+}
+
+// Lines are appended to a ring of log files without a file system. Every sector is
+// erased once when the log enters it, lines are written to the erased flash.
+static esp_err_t workload_log_rotation(WL_Flash *wl, uint64_t *app_bytes)
+{
+    const size_t line_size = 100;
+    const size_t file_size = 64 * 1024;
+    const size_t file_count = 4;
+    const size_t total_size = 2 * 1024 * 1024;
+
+    size_t sector_size = wl->sector_size();
+    uint8_t line[line_size];
+    esp_err_t result = ESP_OK;
+    size_t pos = 0;
+    for (size_t written = 0; written < total_size && result == ESP_OK; written += line_size) {
+        if (pos % sector_size + line_size > sector_size) {
+            pos += sector_size - pos % sector_size;
+        }
+        pos %= file_size * file_count;
+        if (pos % sector_size == 0) {
+            result = wl->erase_range(pos, sector_size);
+        }
+        if (result == ESP_OK) {
+            memset(line, (uint8_t) written, line_size);
+            result = wl->write(pos, line, line_size);
+        }
+        pos += line_size;
+        *app_bytes += line_size;
+    }
+    return result;
+}
+
+static const bench_workload_t s_workloads[] = {
+    { "fat append",         &workload_fat_append },
+    { "random overwrite",   &workload_random_overwrite },
+    { "log rotation",       &workload_log_rotation },
+};
+
+static WL_Flash *create_instance(wl_variant_t variant)
+{
+    switch (variant) {
+    case WL_VARIANT_PERF:
+        return new WL_Ext_Perf();
+    case WL_VARIANT_SAFE:
+        return new WL_Ext_Safe();
+    default:
+        return new WL_Flash();
+    }
+}
+
+static void run_benchmark(const bench_config_t *config, uint32_t updaterate, const bench_workload_t *workload, const flash_timing_t *timing)
+{
+    init_spi_flash(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+    REQUIRE(partition != NULL);
+    Partition part(partition);
+
+    // the same configuration as wl_mount uses, apart from the sector size and update rate
+    wl_ext_cfg_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.full_mem_size = partition->size;
+    cfg.start_addr = 0;
+    cfg.version = 2;
+    cfg.sector_size = SPI_FLASH_SEC_SIZE;
+    cfg.page_size = SPI_FLASH_SEC_SIZE;
+    cfg.updaterate = updaterate;
+    cfg.temp_buff_size = 32;
+    cfg.wr_size = 16;
+    cfg.fat_sector_size = config->fat_sector_size;
+
+    WL_Flash *wl = create_instance(config->variant);
+    REQUIRE(wl->config(&cfg, &part) == ESP_OK);
+    if (config->cache_sectors > 0) {
+        REQUIRE(wl->set_cache_size(config->cache_sectors) == ESP_OK);
+    }
+    REQUIRE(wl->init() == ESP_OK);
+
+    // count only the accesses of the workload, not those of formatting
+    spiflash.reset_access_counters();
+    spiflash.reset_erase_cycles();
+    s_rand_state = 1;
+
+    uint64_t app_bytes = 0;
+    REQUIRE(workload->run(wl, &app_bytes) == ESP_OK);
+    REQUIRE(wl->flush() == ESP_OK);
+
+    uint32_t first_sector = partition->address / SPI_FLASH_SEC_SIZE;
+    uint32_t sector_count = partition->size / SPI_FLASH_SEC_SIZE;
+    uint32_t max_erases = 0;
+    uint64_t sum_erases = 0;
+    for (uint32_t i = first_sector; i < first_sector + sector_count; i++) {
+        uint32_t erases = spiflash.get_erase_cycles(i);
+        max_erases = erases > max_erases ? erases : max_erases;
+        sum_erases += erases;
+    }
+
+    uint64_t time_us = (uint64_t) spiflash.get_erase_ops() * timing->erase_us
+                       + (uint64_t) (spiflash.get_write_ops() + spiflash.get_read_ops()) * timing->op_us
+                       + (spiflash.get_write_bytes() * timing->write_ns + spiflash.get_read_bytes() * timing->read_ns) / 1000;
+
+    printf("%-24s %4u  %-17s %8.2f %8.2f %7u %7.2f %9.1f %9.1f\n",
+           config->name, updaterate, workload->name,
+           (double) spiflash.get_write_bytes() / app_bytes,
+           (double) spiflash.get_erase_ops() * SPI_FLASH_SEC_SIZE / app_bytes,
+           max_erases, (double) sum_erases / sector_count,
+           time_us / 1e6, app_bytes / 1024.0 / (time_us / 1e6));
+
+    delete wl;
+}
+
+TEST_CASE("benchmark wear levelling variants", "[wear_levelling][bench][.]")
+{
+    flash_timing_t timing;
+    get_flash_timing(&timing);
+    printf("flash timing: erase %u us, operation %u us, write %u ns/byte, read %u ns/byte\n",
+           timing.erase_us, timing.op_us, timing.write_ns, timing.read_ns);
+    printf("write amp.: flash bytes written per application byte, erase amp.: flash bytes erased per application byte\n");
+    printf("%-24s %4s  %-17s %8s %8s %7s %7s %9s %9s\n",
+           "variant", "rate", "workload", "wr.amp", "er.amp", "max.er", "mean.er", "time, s", "kB/s");
+    for (size_t c = 0; c < sizeof(s_configs) / sizeof(s_configs[0]); c++) {
+        for (size_t u = 0; u < sizeof(s_updaterates) / sizeof(s_updaterates[0]); u++) {
+            for (size_t w = 0; w < sizeof(s_workloads) / sizeof(s_workloads[0]); w++) {
+                run_benchmark(&s_configs[c], s_updaterates[u], &s_workloads[w], &timing);
+            }
+        }
+    }
+}
@@ -6,6 +6,9 @@
 #include "esp_partition.h"
 #include "wear_levelling.h"
 #include "WL_Flash.h"
+#include "WL_Ext_Perf.h"
+#include "WL_Ext_Safe.h"
+#include "Partition.h"
 #include "SpiFlash.h"
 
 #include "catch.hpp"
@@ -207,4 +210,306 @@ TEST_CASE("power down test", "[wear_levelling]")
     // Unmount
     result = wl_unmount(wl_handle);
     REQUIRE(result == ESP_OK);
-}
\ No newline at end of file
+}
+
+static void init_wl_config(wl_config_t *cfg, const esp_partition_t *partition)
+{
+    // the same configuration as wl_mount uses
+    memset(cfg, 0, sizeof(wl_config_t));
+    cfg->full_mem_size = partition->size;
+    cfg->start_addr = 0;
+    cfg->version = 2;
+    cfg->sector_size = SPI_FLASH_SEC_SIZE;
+    cfg->page_size = SPI_FLASH_SEC_SIZE;
+    cfg->updaterate = 16;
+    cfg->temp_buff_size = 32;
+    cfg->wr_size = 16;
+}
+
+static void fill_sector(uint32_t *data, size_t sector_size, uint32_t value)
+{
+    for (uint32_t i = 0; i < sector_size / sizeof(uint32_t); i++) {
+        data[i] = value + i;
+    }
+}
+
+static bool check_sector(WL_Flash *wl, size_t sector, uint32_t value)
+{
+    size_t sector_size = wl->sector_size();
+    uint32_t *data = new uint32_t[sector_size / sizeof(uint32_t)];
+    REQUIRE(wl->read(sector * sector_size, data, sector_size) == ESP_OK);
+    bool result = true;
+    for (uint32_t i = 0; i < sector_size / sizeof(uint32_t); i++) {
+        if (data[i] != value + i) {
+            result = false;
+            break;
+        }
+    }
+    delete[] data;
+    return result;
+}
+
+TEST_CASE("write cache merges repeated writes to the same sector", "[wear_levelling][cache]")
+{
+    init_spi_flash(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+    Partition part(partition);
+    wl_config_t cfg;
+    init_wl_config(&cfg, partition);
+
+    WL_Flash wl;
+    REQUIRE(wl.config(&cfg, &part) == ESP_OK);
+    REQUIRE(wl.set_cache_size(2) == ESP_OK);
+    REQUIRE(wl.init() == ESP_OK);
+
+    size_t sector_size = wl.sector_size();
+    uint32_t *data = new uint32_t[sector_size / sizeof(uint32_t)];
+    // the emulator doesn't count erases of sectors which are already erased
+    fill_sector(data, sector_size, 0);
+    REQUIRE(wl.erase_sector(1) == ESP_OK);
+    REQUIRE(wl.write(1 * sector_size, data, sector_size) == ESP_OK);
+    REQUIRE(wl.sync() == ESP_OK);
+
+    uint32_t erase_cycles = spiflash.get_total_erase_cycles();
+    for (uint32_t k = 0; k < 100; k++) {
+        fill_sector(data, sector_size, k);
+        REQUIRE(wl.erase_sector(1) == ESP_OK);
+        REQUIRE(wl.write(1 * sector_size, data, sector_size) == ESP_OK);
+    }
+    CHECK(spiflash.get_total_erase_cycles() == erase_cycles);
+    CHECK(check_sector(&wl, 1, 99));
+
+    // one erase of the sector, and possibly one of the dummy block
+    REQUIRE(wl.sync() == ESP_OK);
+    CHECK(spiflash.get_total_erase_cycles() - erase_cycles >= 1);
+    CHECK(spiflash.get_total_erase_cycles() - erase_cycles <= 2);
+
+    WL_Flash wl_check;
+    REQUIRE(wl_check.config(&cfg, &part) == ESP_OK);
+    REQUIRE(wl_check.init() == ESP_OK);
+    CHECK(check_sector(&wl_check, 1, 99));
+
+    delete[] data;
+}
+
+TEST_CASE("write cache writes back least recently used sectors", "[wear_levelling][cache]")
+{
+    init_spi_flash(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+    Partition part(partition);
+    wl_config_t cfg;
+    init_wl_config(&cfg, partition);
+
+    WL_Flash wl;
+    REQUIRE(wl.config(&cfg, &part) == ESP_OK);
+    REQUIRE(wl.set_cache_size(2) == ESP_OK);
+    REQUIRE(wl.init() == ESP_OK);
+
+    size_t sector_size = wl.sector_size();
+    uint32_t *data = new uint32_t[sector_size / sizeof(uint32_t)];
+    for (uint32_t sector = 0; sector < 5; sector++) {
+        fill_sector(data, sector_size, sector * 0x1000);
+        REQUIRE(wl.erase_sector(sector) == ESP_OK);
+        REQUIRE(wl.write(sector * sector_size, data, sector_size) == ESP_OK);
+    }
+    for (uint32_t sector = 0; sector < 5; sector++) {
+        CHECK(check_sector(&wl, sector, sector * 0x1000));
+    }
+
+    // sectors 3 and 4 are still in the cache
+    WL_Flash wl_check;
+    REQUIRE(wl_check.config(&cfg, &part) == ESP_OK);
+    REQUIRE(wl_check.init() == ESP_OK);
+    for (uint32_t sector = 0; sector < 3; sector++) {
+        CHECK(check_sector(&wl_check, sector, sector * 0x1000));
+    }
+    CHECK_FALSE(check_sector(&wl_check, 3, 3 * 0x1000));
+    CHECK_FALSE(check_sector(&wl_check, 4, 4 * 0x1000));
+
+    delete[] data;
+}
+
+TEST_CASE("write cache loses only data which was not synced on power off", "[wear_levelling][cache]")
+{
+    init_spi_flash(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+    Partition part(partition);
+    wl_config_t cfg;
+    init_wl_config(&cfg, partition);
+
+    size_t sector_size = SPI_FLASH_SEC_SIZE;
+    uint32_t *data = new uint32_t[sector_size / sizeof(uint32_t)];
+    {
+        WL_Flash wl;
+        REQUIRE(wl.config(&cfg, &part) == ESP_OK);
+        REQUIRE(wl.set_cache_size(4) == ESP_OK);
+        REQUIRE(wl.init() == ESP_OK);
+        for (uint32_t sector = 0; sector < 2; sector++) {
+            fill_sector(data, sector_size, 0xa000 + sector);
+            REQUIRE(wl.erase_sector(sector) == ESP_OK);
+            REQUIRE(wl.write(sector * sector_size, data, sector_size) == ESP_OK);
+        }
+        REQUIRE(wl.sync() == ESP_OK);
+
+        fill_sector(data, sector_size, 0xb000);
+        REQUIRE(wl.erase_sector(0) == ESP_OK);
+        REQUIRE(wl.write(0, data, sector_size) == ESP_OK);
+        // power goes off here: the instance is gone without flush
+    }
+
+    WL_Flash wl;
+    REQUIRE(wl.config(&cfg, &part) == ESP_OK);
+    REQUIRE(wl.init() == ESP_OK);
+    CHECK(check_sector(&wl, 0, 0xa000));
+    CHECK(check_sector(&wl, 1, 0xa001));
+
+    // a power off while sectors are written back may lose the sector which was
+    // erased, as without the cache, but not the sectors which were not written yet
+    {
+        WL_Flash wl_cached;
+        REQUIRE(wl_cached.config(&cfg, &part) == ESP_OK);
+        REQUIRE(wl_cached.set_cache_size(4) == ESP_OK);
+        REQUIRE(wl_cached.init() == ESP_OK);
+        for (uint32_t sector = 0; sector < 2; sector++) {
+            fill_sector(data, sector_size, 0xc000 + sector);
+            REQUIRE(wl_cached.erase_sector(sector) == ESP_OK);
+            REQUIRE(wl_cached.write(sector * sector_size, data, sector_size) == ESP_OK);
+        }
+        spiflash.set_total_erase_cycles_limit(spiflash.get_total_erase_cycles() + 1);
+        CHECK(wl_cached.sync() != ESP_OK);
+        spiflash.set_total_erase_cycles_limit(0);
+    }
+    WL_Flash wl_check;
+    REQUIRE(wl_check.config(&cfg, &part) == ESP_OK);
+    REQUIRE(wl_check.init() == ESP_OK);
+    CHECK(check_sector(&wl_check, 1, 0xa001));
+
+    delete[] data;
+}
+
+class WL_Flash_Test : public WL_Flash
+{
+public:
+    size_t get_pos()
+    {
+        return this->state.pos;
+    }
+
+    size_t get_addr_state1()
+    {
+        return this->addr_state1;
+    }
+
+    size_t get_addr_state2()
+    {
+        return this->addr_state2;
+    }
+};
+
+TEST_CASE("position of the dummy block is recovered with few flash reads", "[wear_levelling][mount]")
+{
+    init_spi_flash(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+    Partition part(partition);
+    wl_config_t cfg;
+    init_wl_config(&cfg, partition);
+
+    WL_Flash_Test wl;
+    REQUIRE(wl.config(&cfg, &part) == ESP_OK);
+    REQUIRE(wl.init() == ESP_OK);
+
+    size_t sector_size = wl.sector_size();
+    uint32_t *data = new uint32_t[sector_size / sizeof(uint32_t)];
+    fill_sector(data, sector_size, 0x5000);
+    REQUIRE(wl.erase_sector(0) == ESP_OK);
+    REQUIRE(wl.write(0, data, sector_size) == ESP_OK);
+    // move the dummy block well into the partition, every erase counts towards a move
+    for (uint32_t i = 0; i < cfg.updaterate * 150; i++) {
+        REQUIRE(wl.erase_sector(1) == ESP_OK);
+    }
+    REQUIRE(wl.get_pos() == 150);
+
+    // a linear scan would read one position record per moved block
+    spiflash.reset_access_counters();
+    WL_Flash_Test wl_mounted;
+    REQUIRE(wl_mounted.config(&cfg, &part) == ESP_OK);
+    REQUIRE(wl_mounted.init() == ESP_OK);
+    CHECK(spiflash.get_read_ops() <= 16);
+    CHECK(wl_mounted.get_pos() == wl.get_pos());
+    CHECK(check_sector(&wl_mounted, 0, 0x5000));
+
+    // the records are copied in bursts when the second state copy is repaired
+    REQUIRE(part.erase_range(wl.get_addr_state2(), SPI_FLASH_SEC_SIZE) == ESP_OK);
+    spiflash.reset_access_counters();
+    WL_Flash_Test wl_repaired;
+    REQUIRE(wl_repaired.config(&cfg, &part) == ESP_OK);
+    REQUIRE(wl_repaired.init() == ESP_OK);
+    CHECK(spiflash.get_read_ops() <= 32);
+    CHECK(spiflash.get_write_ops() <= 16);
+    CHECK(wl_repaired.get_pos() == wl.get_pos());
+
+    // the repaired copy holds the same position records
+    size_t records_size = (wl.get_pos() + 1) * cfg.wr_size;
+    uint8_t *records1 = new uint8_t[records_size];
+    uint8_t *records2 = new uint8_t[records_size];
+    REQUIRE(part.read(wl.get_addr_state1() + sizeof(wl_state_t), records1, records_size) == ESP_OK);
+    REQUIRE(part.read(wl.get_addr_state2() + sizeof(wl_state_t), records2, records_size) == ESP_OK);
+    CHECK(memcmp(records1, records2, records_size) == 0);
+    CHECK(check_sector(&wl_repaired, 0, 0x5000));
+    delete[] records1;
+    delete[] records2;
+
+    delete[] data;
+}
+
+static void check_erase_write(WL_Flash *wl, uint32_t max_erases)
+{
+    // 512 byte sectors 5 to 24: part of the first flash sector, the second one and part of the third one
+    const size_t fat_sector_size = wl->sector_size();
+    const size_t first = 5;
+    const size_t count = 20;
+    const size_t size = 4 * SPI_FLASH_SEC_SIZE;
+    uint8_t *expected = new uint8_t[size];
+    uint8_t *data = new uint8_t[size];
+    for (size_t i = 0; i < size; i++) {
+        expected[i] = (uint8_t) i;
+    }
+    REQUIRE(wl->erase_range(0, size) == ESP_OK);
+    REQUIRE(wl->write(0, expected, size) == ESP_OK);
+
+    memset(expected + first * fat_sector_size, 0x5a, count * fat_sector_size);
+    spiflash.reset_access_counters();
+    REQUIRE(wl->erase_write(first * fat_sector_size, expected + first * fat_sector_size, count * fat_sector_size) == ESP_OK);
+    CHECK(spiflash.get_erase_ops() <= max_erases);
+
+    REQUIRE(wl->read(0, data, size) == ESP_OK);
+    CHECK(memcmp(expected, data, size) == 0);
+
+    CHECK(wl->erase_write(first * fat_sector_size + 1, expected, fat_sector_size) == ESP_ERR_INVALID_ARG);
+    CHECK(wl->erase_write(0, expected, fat_sector_size + 1) == ESP_ERR_INVALID_ARG);
+
+    delete[] expected;
+    delete[] data;
+}
+
+TEST_CASE("erase_write of several sectors erases each flash sector once", "[wear_levelling][erase_write]")
+{
+    init_spi_flash(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+    Partition part(partition);
+    wl_ext_cfg_t cfg;
+    init_wl_config(&cfg, partition);
+    cfg.fat_sector_size = 512;
+
+    // three flash sectors, and the dummy block may move once
+    WL_Ext_Perf wl_perf;
+    REQUIRE(wl_perf.config(&cfg, &part) == ESP_OK);
+    REQUIRE(wl_perf.init() == ESP_OK);
+    check_erase_write(&wl_perf, 3 + 1);
+
+    // a flash sector which is kept in part also erases the dump sector and twice the state sector
+    WL_Ext_Safe wl_safe;
+    REQUIRE(wl_safe.config(&cfg, &part) == ESP_OK);
+    REQUIRE(wl_safe.init() == ESP_OK);
+    check_erase_write(&wl_safe, 3 + 2 * 3 + 1);
+}
@@ -144,6 +144,13 @@ esp_err_t wl_mount(const esp_partition_t *partition, wl_handle_t *out_handle)
         ESP_LOGE(TAG, "%s: config instance=0x%08x, result=0x%x", __func__, *out_handle, result);
         goto out;
     }
+#if CONFIG_WL_WRITE_CACHE_SECTORS > 0
+    // The cache only makes writes faster, mount without it if there is not enough memory
+    result = wl_flash->set_cache_size(CONFIG_WL_WRITE_CACHE_SECTORS);
+    if (ESP_OK != result) {
+        ESP_LOGW(TAG, "%s: write cache disabled, instance=0x%08x, result=0x%x", __func__, *out_handle, result);
+    }
+#endif // CONFIG_WL_WRITE_CACHE_SECTORS
     result = wl_flash->init();
     if (ESP_OK != result) {
         ESP_LOGE(TAG, "%s: init instance=0x%08x, result=0x%x", __func__, *out_handle, result);
@@ -189,6 +196,18 @@ esp_err_t wl_unmount(wl_handle_t handle)
     return result;
 }
 
+esp_err_t wl_sync(wl_handle_t handle)
+{
+    esp_err_t result = check_handle(handle, __func__);
+    if (result != ESP_OK) {
+        return result;
+    }
+    _lock_acquire(&s_instances[handle].lock);
+    result = s_instances[handle].instance->sync();
+    _lock_release(&s_instances[handle].lock);
+    return result;
+}
+
 esp_err_t wl_erase_range(wl_handle_t handle, size_t start_addr, size_t size)
 {
     esp_err_t result = check_handle(handle, __func__);
@@ -213,6 +232,18 @@ esp_err_t wl_write(wl_handle_t handle, size_t dest_addr, const void *src, size_t
     return result;
 }
 
+esp_err_t wl_erase_write(wl_handle_t handle, size_t start_addr, const void *src, size_t size)
+{
+    esp_err_t result = check_handle(handle, __func__);
+    if (result != ESP_OK) {
+        return result;
+    }
+    _lock_acquire(&s_instances[handle].lock);
+    result = s_instances[handle].instance->erase_write(start_addr, src, size);
+    _lock_release(&s_instances[handle].lock);
+    return result;
+}
+
 esp_err_t wl_read(wl_handle_t handle, size_t src_addr, void *dest, size_t size)
 {
     esp_err_t result = check_handle(handle, __func__);
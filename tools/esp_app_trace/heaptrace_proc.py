@@ -0,0 +1,306 @@
+#!/usr/bin/env python
+#
+# Decodes heap trace data sent to the host after heap_trace_init_tohost(),
+# see components/heap/heap_trace_tohost.h for the format of the events.
+#
+
+from __future__ import print_function
+import argparse
+import struct
+import subprocess
+import sys
+
+
+ESP32_HEAPTRACE_MAGIC = 0x52544845
+
+ESP32_HEAPTRACE_EVT_START = 1
+ESP32_HEAPTRACE_EVT_ALLOC = 2
+ESP32_HEAPTRACE_EVT_FREE = 3
+ESP32_HEAPTRACE_EVT_INFO = 4
+ESP32_HEAPTRACE_EVT_LOST = 5
+ESP32_HEAPTRACE_EVT_STOP = 6
+
+ESP32_HEAPTRACE_HDR_FMT = '<BBHL'
+ESP32_HEAPTRACE_HDR_SZ = struct.calcsize(ESP32_HEAPTRACE_HDR_FMT)
+
+ESP32_HEAPTRACE_EVT_FMTS = {
+    ESP32_HEAPTRACE_EVT_START: '<LBBBB',
+    ESP32_HEAPTRACE_EVT_ALLOC: '<LLL',
+    ESP32_HEAPTRACE_EVT_FREE: '<L',
+    ESP32_HEAPTRACE_EVT_INFO: '<LLLLL',
+    ESP32_HEAPTRACE_EVT_LOST: '<L',
+    ESP32_HEAPTRACE_EVT_STOP: '<LLL',
+}
+
+HEAP_TRACE_MODES = ['all', 'leaks']
+
+
+class ESPHeapTraceParserError(RuntimeError):
+    def __init__(self, message):
+        RuntimeError.__init__(self, message)
+
+
+class ESPHeapTraceEvent(object):
+    def __init__(self, evt_type, cpu, timestamp, fields, callers):
+        super(ESPHeapTraceEvent, self).__init__()
+        self.type = evt_type
+        self.cpu = cpu
+        self.timestamp = timestamp  # in us since the first event, not wrapped around
+        self.fields = fields
+        self.callers = callers
+
+
+class ESPHeapTraceAlloc(object):
+    def __init__(self, evt):
+        super(ESPHeapTraceAlloc, self).__init__()
+        self.address, self.size, self.caps = evt.fields
+        self.timestamp = evt.timestamp
+        self.cpu = evt.cpu
+        self.callers = evt.callers
+
+
+def heaptrace_is_start(data, pos):
+    """Returns True if there is the header of a START event at 'pos'"""
+    return pos + ESP32_HEAPTRACE_HDR_SZ + 4 <= len(data) and \
+        struct.unpack_from('<B', data, pos)[0] == ESP32_HEAPTRACE_EVT_START and \
+        struct.unpack_from('<L', data, pos + ESP32_HEAPTRACE_HDR_SZ)[0] == ESP32_HEAPTRACE_MAGIC
+
+
+def heaptrace_find_start(data, pos):
+    """Returns the position of the next START event after 'pos', or -1"""
+    magic = struct.pack('<L', ESP32_HEAPTRACE_MAGIC)
+    while True:
+        # a START at 'pos' itself is skipped, so the search always moves forward
+        pos = data.find(magic, pos + 1 + ESP32_HEAPTRACE_HDR_SZ)
+        if pos == -1:
+            return -1
+        start = pos - ESP32_HEAPTRACE_HDR_SZ
+        if struct.unpack_from('<B', data, start)[0] == ESP32_HEAPTRACE_EVT_START:
+            return start
+
+
+def heaptrace_parse(fname):
+    try:
+        with open(fname, 'rb') as ftrc:
+            data = ftrc.read()
+    except (OSError, IOError) as e:
+        raise ESPHeapTraceParserError("Failed to open trace file (%s)!" % e)
+
+    evts = []
+    resyncs = 0
+    stack_depth = None
+    last_ts = None
+    timestamp = 0
+    pos = 0
+    while pos + ESP32_HEAPTRACE_HDR_SZ <= len(data):
+        evt_type, cpu, length, ts = struct.unpack_from(ESP32_HEAPTRACE_HDR_FMT, data, pos)
+        fmt = ESP32_HEAPTRACE_EVT_FMTS.get(evt_type)
+        ncallers = 0
+        if fmt is not None and evt_type in (ESP32_HEAPTRACE_EVT_ALLOC, ESP32_HEAPTRACE_EVT_FREE):
+            ncallers = stack_depth if stack_depth is not None else -1
+        expected_length = ESP32_HEAPTRACE_HDR_SZ + struct.calcsize(fmt) + 4 * ncallers if fmt is not None else None
+        if heaptrace_is_start(data, pos) and length != expected_length:
+            # a START from a newer version of the format, it can't be skipped
+            version = struct.unpack_from('<B', data, pos + ESP32_HEAPTRACE_HDR_SZ + 4)[0] \
+                if pos + ESP32_HEAPTRACE_HDR_SZ + 5 <= len(data) else -1
+            raise ESPHeapTraceParserError("Unsupported heap trace version %d (START event of %d bytes)!" %
+                                          (version, length))
+        if fmt is None or ncallers < 0 or length != expected_length:
+            # not an event, or an event before the first START: skip to the next START
+            next_pos = heaptrace_find_start(data, pos)
+            if next_pos == -1:
+                print("Skipped %d bytes of unknown data at the end of the trace!" % (len(data) - pos))
+                break
+            print("Skipped %d bytes of unknown data at offset %d!" % (next_pos - pos, pos))
+            resyncs += 1
+            pos = next_pos
+            continue
+        if pos + length > len(data):
+            print("Unprocessed %d bytes of event at the end of the trace!" % (len(data) - pos))
+            break
+
+        fields = struct.unpack_from(fmt, data, pos + ESP32_HEAPTRACE_HDR_SZ)
+        callers = list(struct.unpack_from('<%dL' % ncallers, data, pos + length - 4 * ncallers))
+        pos += length
+
+        if evt_type == ESP32_HEAPTRACE_EVT_START:
+            _, version, _, stack_depth, _ = fields
+            if version != 1:
+                raise ESPHeapTraceParserError("Unsupported heap trace version %d!" % version)
+
+        # timestamps wrap around every 2^32 us, and events from the two CPUs may be a little out of order
+        if last_ts is not None:
+            delta = (ts - last_ts) & 0xFFFFFFFF
+            if delta >= 0x80000000:
+                delta -= 0x100000000
+            timestamp += delta
+        last_ts = ts
+        evts.append(ESPHeapTraceEvent(evt_type, cpu, timestamp, fields, [c for c in callers if c != 0]))
+
+    return evts, resyncs
+
+
+class ESPHeapTraceState(object):
+    """Replays heap trace events, keeping the live allocations and statistics"""
+
+    def __init__(self):
+        super(ESPHeapTraceState, self).__init__()
+        self.live = {}
+        self.live_bytes = 0
+        self.peak_bytes = 0
+        self.peak_time = 0
+        self.allocs = 0
+        self.frees = 0
+        self.unknown_frees = 0
+        self.lost = 0
+        self.info = None
+        self.mode = None
+
+    def process(self, evt):
+        if evt.type == ESP32_HEAPTRACE_EVT_START:
+            # heap_trace_start() resets the trace
+            self.__init__()
+            self.mode = HEAP_TRACE_MODES[evt.fields[2]] if evt.fields[2] < len(HEAP_TRACE_MODES) else '?'
+        elif evt.type == ESP32_HEAPTRACE_EVT_ALLOC:
+            self.allocs += 1
+            alloc = ESPHeapTraceAlloc(evt)
+            old = self.live.get(alloc.address)
+            if old is not None:
+                # its free was lost
+                self.live_bytes -= old.size
+            self.live[alloc.address] = alloc
+            self.live_bytes += alloc.size
+            if self.live_bytes > self.peak_bytes:
+                self.peak_bytes = self.live_bytes
+                self.peak_time = evt.timestamp
+        elif evt.type == ESP32_HEAPTRACE_EVT_FREE:
+            self.frees += 1
+            alloc = self.live.pop(evt.fields[0], None)
+            if alloc is None:
+                # allocated before tracing started
+                self.unknown_frees += 1
+            else:
+                self.live_bytes -= alloc.size
+        elif evt.type == ESP32_HEAPTRACE_EVT_INFO:
+            self.info = evt.fields
+        elif evt.type == ESP32_HEAPTRACE_EVT_LOST:
+            self.lost += evt.fields[0]
+
+
+def heaptrace_fragmentation(info):
+    free_bytes, largest_free_block = info[0], info[1]
+    if free_bytes == 0:
+        return 0.0
+    return 100.0 * (1.0 - float(largest_free_block) / free_bytes)
+
+
+class ESPAddr2Line(object):
+    def __init__(self, elf_file, toolchain_prefix):
+        super(ESPAddr2Line, self).__init__()
+        self.elf_file = elf_file
+        self.toolchain_prefix = toolchain_prefix
+        self.cache = {}
+
+    def lookup(self, addrs):
+        missing = [a for a in addrs if a not in self.cache]
+        if self.elf_file is not None and len(missing) > 0:
+            try:
+                out = subprocess.check_output([self.toolchain_prefix + 'addr2line', '-pfiaC', '-e', self.elf_file] +
+                                              ['0x%08x' % a for a in missing])
+                lines = [l for l in out.decode('utf-8', 'replace').split('\n') if l.startswith('0x')]
+                for a, line in zip(missing, lines):
+                    self.cache[a] = line.split(': ', 1)[-1]
+            except (OSError, subprocess.CalledProcessError) as e:
+                print("Failed to run addr2line (%s)!" % e)
+                self.elf_file = None
+        return ['0x%08x%s' % (a, (' ' + self.cache[a]) if a in self.cache else '') for a in addrs]
+
+
+def heaptrace_print_timeline(evts, interval):
+    print("%10s %12s %10s %12s %12s %8s" % ("time (s)", "live bytes", "live blks", "free bytes", "largest free", "frag %"))
+    state = ESPHeapTraceState()
+    next_time = None
+    for evt in evts:
+        state.process(evt)
+        if next_time is None or evt.timestamp >= next_time:
+            if state.info is not None:
+                info_str = "%12d %12d %8.1f" % (state.info[0], state.info[1], heaptrace_fragmentation(state.info))
+            else:
+                info_str = "%12s %12s %8s" % ("-", "-", "-")
+            print("%10.3f %12d %10d %s" % (evt.timestamp / 1e6, state.live_bytes, len(state.live), info_str))
+            next_time = evt.timestamp + interval * 1e6
+
+
+def heaptrace_print_live(state, a2l, max_callers):
+    # group the allocations by call stack, biggest first
+    groups = {}
+    for alloc in state.live.values():
+        group = groups.setdefault(tuple(alloc.callers), [0, 0, []])
+        group[0] += alloc.size
+        group[1] += 1
+        group[2].append(alloc)
+    ordered = sorted(groups.items(), key=lambda g: g[1][0], reverse=True)
+    for callers, (size, count, allocs) in ordered[:max_callers]:
+        print("%d bytes in %d allocations, e.g. %d bytes @ 0x%08x at %.3f s, allocated by:" %
+              (size, count, allocs[0].size, allocs[0].address, allocs[0].timestamp / 1e6))
+        for line in a2l.lookup(list(callers)):
+            print("    %s" % line)
+    if len(ordered) > max_callers:
+        print("... and %d more call stacks" % (len(ordered) - max_callers))
+
+
+def main():
+
+    parser = argparse.ArgumentParser(description='ESP32 Heap Trace Parsing Tool')
+
+    parser.add_argument('trace_file', help='Path to heap trace file', type=str)
+    parser.add_argument('elf_file', help='Path to program ELF file, to print the callers', type=str, nargs='?')
+    parser.add_argument('--toolchain-prefix', help='Triplet prefix to add before cross-toolchain names',
+                        default='xtensa-esp32-elf-')
+    parser.add_argument('--interval', '-i', help='Interval of the timeline, in seconds (0 to disable)',
+                        type=float, default=10.0)
+    parser.add_argument('--max-callers', '-m', help='Number of call stacks of live allocations to print',
+                        type=int, default=20)
+    args = parser.parse_args()
+
+    # parse trace file
+    try:
+        print("Parse trace file '%s'..." % args.trace_file)
+        evts, resyncs = heaptrace_parse(args.trace_file)
+        print("Parsing completed.")
+    except ESPHeapTraceParserError as e:
+        print("Failed to parse heap trace (%s)!" % e)
+        sys.exit(2)
+
+    if args.interval > 0:
+        print("====================================================================")
+        heaptrace_print_timeline(evts, args.interval)
+
+    state = ESPHeapTraceState()
+    for evt in evts:
+        state.process(evt)
+
+    print("====================================================================")
+    if state.mode == 'leaks':
+        print("%d bytes 'leaked' in trace (%d allocations):" % (state.live_bytes, len(state.live)))
+    else:
+        print("%d bytes alive in trace (%d allocations):" % (state.live_bytes, len(state.live)))
+    heaptrace_print_live(state, ESPAddr2Line(args.elf_file, args.toolchain_prefix), args.max_callers)
+
+    print("====================================================================\n")
+    print("Events count: %d" % len(evts))
+    print("total allocations %d total frees %d" % (state.allocs, state.frees))
+    print("peak %d bytes alive in trace at %.3f s" % (state.peak_bytes, state.peak_time / 1e6))
+    if state.info is not None:
+        print("last heap info: %d bytes free, largest free block %d bytes (%.1f%% fragmentation), minimum free %d bytes" %
+              (state.info[0], state.info[1], heaptrace_fragmentation(state.info), state.info[2]))
+    if state.unknown_frees > 0:
+        print("(NB: %d frees of memory allocated before the trace started.)" % state.unknown_frees)
+    if state.lost > 0:
+        print("(NB: %d events were lost, so trace data is incomplete.)" % state.lost)
+    if resyncs > 0:
+        print("(NB: Unknown data was skipped %d times, so trace data may be incomplete.)" % resyncs)
+
+
+if __name__ == '__main__':
+    main()
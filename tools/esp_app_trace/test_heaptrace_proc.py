@@ -0,0 +1,79 @@
+#!/usr/bin/env python
+#
+# Host tests of the heap trace decoder, run with ./test_heaptrace_proc.py
+#
+
+import os
+import struct
+import tempfile
+import unittest
+
+from heaptrace_proc import ESP32_HEAPTRACE_EVT_ALLOC, ESP32_HEAPTRACE_EVT_FREE, ESP32_HEAPTRACE_EVT_START
+from heaptrace_proc import ESP32_HEAPTRACE_EVT_FMTS, ESP32_HEAPTRACE_HDR_FMT, ESP32_HEAPTRACE_HDR_SZ
+from heaptrace_proc import ESP32_HEAPTRACE_MAGIC, ESPHeapTraceParserError, heaptrace_parse
+
+STACK_DEPTH = 2
+
+
+def event(evt_type, ts, fields, callers=(), length=None, fmt=None):
+    fmt = fmt or ESP32_HEAPTRACE_EVT_FMTS[evt_type]
+    body = struct.pack(fmt, *fields) + struct.pack('<%dL' % len(callers), *callers)
+    if length is None:
+        length = ESP32_HEAPTRACE_HDR_SZ + len(body)
+    return struct.pack(ESP32_HEAPTRACE_HDR_FMT, evt_type, 0, length, ts) + body
+
+
+def start(ts, version=1):
+    return event(ESP32_HEAPTRACE_EVT_START, ts, (ESP32_HEAPTRACE_MAGIC, version, 0, STACK_DEPTH, 0))
+
+
+def alloc(ts, address, size):
+    return event(ESP32_HEAPTRACE_EVT_ALLOC, ts, (address, size, 0), (0x400d0000, 0x400d0010))
+
+
+def free(ts, address):
+    return event(ESP32_HEAPTRACE_EVT_FREE, ts, (address,), (0x400d0020, 0))
+
+
+class HeapTraceParseTest(unittest.TestCase):
+    def parse(self, data):
+        fd, fname = tempfile.mkstemp()
+        try:
+            os.write(fd, data)
+            os.close(fd)
+            return heaptrace_parse(fname)
+        finally:
+            os.remove(fname)
+
+    def test_events(self):
+        evts, resyncs = self.parse(start(100) + alloc(110, 0x3ffb0000, 32) + free(130, 0x3ffb0000))
+        self.assertEqual(resyncs, 0)
+        self.assertEqual([e.type for e in evts],
+                         [ESP32_HEAPTRACE_EVT_START, ESP32_HEAPTRACE_EVT_ALLOC, ESP32_HEAPTRACE_EVT_FREE])
+        self.assertEqual([e.timestamp for e in evts], [0, 10, 30])
+        self.assertEqual(evts[1].callers, [0x400d0000, 0x400d0010])
+        self.assertEqual(evts[2].callers, [0x400d0020])
+
+    def test_skips_data_before_start(self):
+        evts, resyncs = self.parse(b'\x02\x00garbage' + start(0) + alloc(5, 0x3ffb0000, 8))
+        self.assertEqual(resyncs, 1)
+        self.assertEqual(len(evts), 2)
+
+    def test_start_with_wrong_length(self):
+        # a START with more fields, as a newer version of the format could send
+        data = event(ESP32_HEAPTRACE_EVT_START, 0, (ESP32_HEAPTRACE_MAGIC, 2, 0, STACK_DEPTH, 0, 0), fmt='<LBBBBL')
+        with self.assertRaises(ESPHeapTraceParserError):
+            self.parse(data + alloc(5, 0x3ffb0000, 8))
+        # a START whose length field is corrupted
+        data = start(0)
+        data = data[:2] + struct.pack('<H', 0xffff) + data[4:]
+        with self.assertRaises(ESPHeapTraceParserError):
+            self.parse(data + alloc(5, 0x3ffb0000, 8))
+
+    def test_start_with_unsupported_version(self):
+        with self.assertRaises(ESPHeapTraceParserError):
+            self.parse(start(0, version=2) + alloc(5, 0x3ffb0000, 8))
+
+
+if __name__ == '__main__':
+    unittest.main()
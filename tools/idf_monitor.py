@@ -6,6 +6,7 @@
 # - Run "make (or idf.py) flash" (Ctrl-T Ctrl-F)
 # - Run "make (or idf.py) app-flash" (Ctrl-T Ctrl-A)
 # - If gdbstub output is detected, gdb is automatically loaded
+# - Decodes binary log output (see esp_log_async.h) using format strings from the ELF file
 #
 # Copyright 2015-2016 Espressif Systems (Shanghai) PTE LTD
 #
@@ -44,6 +45,8 @@ except ImportError:
 import shlex
 import time
 import sys
+import base64
+import struct
 import serial
 import serial.tools.miniterm as miniterm
 import threading
@@ -97,6 +100,15 @@ DEFAULT_TOOLCHAIN_PREFIX = "xtensa-esp32-elf-"
 
 DEFAULT_PRINT_FILTER = ""
 
+# Binary log lines (see esp_log_async.h) start with this byte, followed by base64 encoded log records
+BINARY_LOG_START = b'\x1e'
+
+# base64 data of a binary log line, anything else (like output interleaved with it) makes it undecodable
+BINARY_LOG_BASE64 = re.compile(br'^[A-Za-z0-9+/]*={0,2}$')
+
+# Format strings and string arguments in flash are sent as offsets from the start of the DROM region
+BINARY_LOG_DROM_BASE = 0x3F400000
+
 
 class StoppableThread(object):
     """
@@ -291,6 +303,164 @@ class LineMatcher(object):
         return self._dict.get("*", self.LEVEL_N) > self.LEVEL_N
 
 
+class ElfStrings(object):
+    """
+    Reads zero terminated strings from the sections of an ELF file which are loaded into memory.
+    """
+    SHF_ALLOC = 0x2
+    SHT_NOBITS = 8
+
+    def __init__(self, elf_file):
+        with open(elf_file, 'rb') as f:
+            self._data = bytearray(f.read())
+        if self._data[:4] != b'\x7fELF':
+            raise ValueError('%s is not an ELF file' % elf_file)
+        if self._data[4] == 1:  # ELFCLASS32
+            (shoff,) = struct.unpack_from('<I', self._data, 0x20)
+            (shentsize, shnum) = struct.unpack_from('<HH', self._data, 0x2e)
+            section_format = '<IIIIII'      # name, type, flags, addr, offset, size
+        else:
+            (shoff,) = struct.unpack_from('<Q', self._data, 0x28)
+            (shentsize, shnum) = struct.unpack_from('<HH', self._data, 0x3a)
+            section_format = '<IIQQQQ'
+        self._sections = []
+        for n in range(shnum):
+            (_, sh_type, flags, addr, offset, size) = struct.unpack_from(section_format, self._data, shoff + n * shentsize)
+            if flags & self.SHF_ALLOC and sh_type != self.SHT_NOBITS and size > 0:
+                self._sections.append((addr, offset, size))
+
+    def read_string(self, address):
+        """ Returns the string at the address as bytes, or None if no section holds the address """
+        for (addr, offset, size) in self._sections:
+            if addr <= address < addr + size:
+                start = offset + address - addr
+                end = self._data.find(b'\0', start, offset + size)
+                return bytes(self._data[start:end if end >= 0 else offset + size])
+        return None
+
+
+class BinaryLogDecoder(object):
+    """
+    Decodes the binary log lines of esp_log_async_init() into text. Each line holds base64 encoded records: the
+    offset of the format string in DROM plus one (0 is for a record formatted by the application, followed by its
+    length and text), then the arguments of each conversion of the format string. Integers are LEB128 numbers, signed
+    ones zigzag encoded, doubles are 8 bytes. A string is a kind byte followed by the length and the string (0), the
+    DROM offset of the string (1) or nothing for NULL (2).
+    """
+    RE_CONVERSION = re.compile(r'%([-+ #0]*)(\*|[0-9]*)(?:\.(\*|[0-9]*))?(hh|h|ll|l|q|z|j|t|L)?([diouxXcspfFeEgGaA%])')
+
+    def __init__(self, elf_file, drom_base=BINARY_LOG_DROM_BASE, long_bits=32):
+        self._elf_file = elf_file
+        self._elf_mtime = None
+        self._strings = None
+        self._drom_base = drom_base
+        self._long_bits = long_bits
+
+    def _read_string(self, offset):
+        mtime = os.path.getmtime(self._elf_file)
+        if mtime != self._elf_mtime:
+            # the application may have been rebuilt and flashed
+            self._strings = ElfStrings(self._elf_file)
+            self._elf_mtime = mtime
+        s = self._strings.read_string(self._drom_base + offset)
+        if s is None:
+            raise ValueError('no string at 0x%08x in %s' % (self._drom_base + offset, self._elf_file))
+        return s.decode('latin-1')
+
+    def _unsigned(self, data, pos):
+        value = 0
+        shift = 0
+        while True:
+            b = data[pos]
+            pos += 1
+            value |= (b & 0x7f) << shift
+            shift += 7
+            if not b & 0x80:
+                return (value, pos)
+
+    def _signed(self, data, pos):
+        (value, pos) = self._unsigned(data, pos)
+        return ((value >> 1) ^ -(value & 1), pos)
+
+    def _format_record(self, fmt, data, pos):
+        text = ''
+        last = 0
+        for m in self.RE_CONVERSION.finditer(fmt):
+            text += fmt[last:m.start()]
+            last = m.end()
+            (flags, width, precision, length, conv) = m.groups()
+            if conv == '%':
+                text += '%'
+                continue
+            if width == '*':
+                (width, pos) = self._signed(data, pos)
+                if width < 0:
+                    flags += '-'
+                width = str(abs(width))
+            if precision == '*':
+                (precision, pos) = self._signed(data, pos)
+                precision = str(precision) if precision >= 0 else None
+            bits = {'hh': 8, 'h': 16, 'l': self._long_bits, 'll': 64, 'q': 64}.get(length, 32)
+            if conv in 'diouxXc' and length == 'z':
+                (value, pos) = self._unsigned(data, pos)
+            elif conv in 'diouxXc':
+                (value, pos) = self._signed(data, pos)
+                value &= (1 << bits) - 1
+                if conv in 'di' and value >= 1 << (bits - 1):
+                    value -= 1 << bits
+            elif conv == 'p':
+                (value, pos) = self._unsigned(data, pos)
+            elif conv == 's':
+                kind = data[pos]
+                pos += 1
+                if kind == 0:
+                    (size, pos) = self._unsigned(data, pos)
+                    value = bytes(data[pos:pos + size]).decode('latin-1')
+                    pos += size
+                elif kind == 1:
+                    (offset, pos) = self._unsigned(data, pos)
+                    value = self._read_string(offset)
+                else:
+                    value = '(null)'
+            else:
+                (value,) = struct.unpack_from('<d', data, pos)
+                pos += 8
+            if conv in 'iu':
+                conv = 'd'
+            elif conv == 'c':
+                value &= 0xff
+            elif conv == 'p':
+                (conv, value) = ('s', '0x%x' % value)
+            elif conv in 'aA':
+                (conv, value) = ('s', value.hex())
+            spec = '%' + flags + (width or '') + ('.' + precision if precision is not None else '') + conv
+            text += spec % value
+        return (text + fmt[last:], pos)
+
+    def decode(self, line):
+        """ Returns the text of the records in a binary log line, as a list of lines """
+        text = ''
+        try:
+            encoded = line[len(BINARY_LOG_START):].strip()
+            # b64decode() silently skips characters which are not base64
+            if not BINARY_LOG_BASE64.match(encoded):
+                raise ValueError('not base64 data')
+            data = bytearray(base64.b64decode(encoded))
+            pos = 0
+            while pos < len(data):
+                (format_id, pos) = self._unsigned(data, pos)
+                if format_id == 0:
+                    (size, pos) = self._unsigned(data, pos)
+                    text += bytes(data[pos:pos + size]).decode('latin-1')
+                    pos += size
+                else:
+                    (record, pos) = self._format_record(self._read_string(format_id - 1), data, pos)
+                    text += record
+        except (ValueError, TypeError, IndexError, struct.error, EnvironmentError) as e:
+            text += '\n--- binary log line could not be decoded: %s\n' % e
+        return [t.encode('latin-1') for t in text.rstrip('\n').split('\n')]
+
+
 class SerialStopException(Exception):
     """
     This exception is used for stopping the IDF monitor in testing mode.
@@ -351,6 +521,7 @@ class Monitor(object):
         self._gdb_buffer = b""
         self._pc_address_buffer = b""
         self._line_matcher = LineMatcher(print_filter)
+        self._binary_log = BinaryLogDecoder(elf_file)
         self._invoke_processing_last_line_timer = None
         self._force_line_print = False
         self._output_enabled = True
@@ -422,20 +593,26 @@ class Monitor(object):
         if sp[-1] != b"":
             # last part is not a full line
             self._last_line_part = sp.pop()
-        for line in sp:
-            if line != b"":
-                if self._serial_check_exit and line == self.exit_key.encode('latin-1'):
-                    raise SerialStopException()
-                if self._output_enabled and (self._force_line_print or self._line_matcher.match(line.decode(errors="ignore"))):
-                    self.console.write_bytes(line + b'\n')
-                    self.handle_possible_pc_address_in_line(line)
-                self.check_gdbstub_trigger(line)
-                self._force_line_print = False
+        for serial_line in sp:
+            if serial_line.startswith(BINARY_LOG_START):
+                lines = self._binary_log.decode(serial_line)
+            else:
+                lines = [serial_line]
+            for line in lines:
+                if line != b"":
+                    if self._serial_check_exit and line == self.exit_key.encode('latin-1'):
+                        raise SerialStopException()
+                    if self._output_enabled and (self._force_line_print or self._line_matcher.match(line.decode(errors="ignore"))):
+                        self.console.write_bytes(line + b'\n')
+                        self.handle_possible_pc_address_in_line(line)
+                    self.check_gdbstub_trigger(line)
+                    self._force_line_print = False
         # Now we have the last part (incomplete line) in _last_line_part. By
         # default we don't touch it and just wait for the arrival of the rest
         # of the line. But after some time when we didn't received it we need
         # to make a decision.
-        if self._last_line_part != b"":
+        # A binary log line can only be decoded once it is complete.
+        if self._last_line_part != b"" and not self._last_line_part.startswith(BINARY_LOG_START):
             if self._force_line_print or (finalize_line and self._line_matcher.match(self._last_line_part.decode(errors="ignore"))):
                 self._force_line_print = True
                 if self._output_enabled:
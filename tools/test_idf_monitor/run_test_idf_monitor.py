@@ -30,19 +30,20 @@ import errno
 
 test_list = (
     # Add new tests here. All files should be placed in IN_DIR. Columns are:
-    # Input file            Filter string                                               File with expected output   Timeout
-    ('in1.txt',             '',                                                         'in1f1.txt',                60),
-    ('in1.txt',             '*:V',                                                      'in1f1.txt',                60),
-    ('in1.txt',             'hello_world',                                              'in1f2.txt',                60),
-    ('in1.txt',             '*:N',                                                      'in1f3.txt',                60),
-    ('in2.txt',             'boot mdf_device_handle:I mesh:E vfs:I',                    'in2f1.txt',               240),
-    ('in2.txt',             'vfs',                                                      'in2f2.txt',               240),
+    # Input file            Filter string                                               File with expected output   Timeout  ELF file
+    ('in1.txt',             '',                                                         'in1f1.txt',                60,      './dummy.elf'),
+    ('in1.txt',             '*:V',                                                      'in1f1.txt',                60,      './dummy.elf'),
+    ('in1.txt',             'hello_world',                                              'in1f2.txt',                60,      './dummy.elf'),
+    ('in1.txt',             '*:N',                                                      'in1f3.txt',                60,      './dummy.elf'),
+    ('in2.txt',             'boot mdf_device_handle:I mesh:E vfs:I',                    'in2f1.txt',               240,      './dummy.elf'),
+    ('in2.txt',             'vfs',                                                      'in2f2.txt',               240,      './dummy.elf'),
+    ('in3.txt',             '',                                                         'in3f1.txt',                60,      './binary_log.elf'),
+    ('in3.txt',             'example:E',                                                'in3f2.txt',                60,      './binary_log.elf'),
 )
 
 IN_DIR = 'tests/'       # tests are in this directory
 OUT_DIR = 'outputs/'    # test results are written to this directory (kept only for debugging purposes)
 ERR_OUT = OUT_DIR + 'monitor_error_output'
-ELF_FILE = './dummy.elf'  # ELF file used for starting the monitor
 IDF_MONITOR = '{}/tools/idf_monitor.py'.format(os.getenv("IDF_PATH"))
 
 # connection related to communicating with idf_monitor through sockets
@@ -94,7 +95,7 @@ def test_iteration(runner, test, startup_timeout):
     try:
         with open(OUT_DIR + test[2], "w", encoding='utf-8') as o_f, open(ERR_OUT, "w", encoding='utf-8') as e_f:
             monitor_cmd = [sys.executable,
-                           IDF_MONITOR, '--port', 'socket://{}:{}'.format(HOST, runner.port), '--print_filter', test[1], ELF_FILE]
+                           IDF_MONITOR, '--port', 'socket://{}:{}'.format(HOST, runner.port), '--print_filter', test[1], test[4]]
             (master_fd, slave_fd) = pty.openpty()
             print('\t', ' '.join(monitor_cmd), sep='')
             print('\tstdout="{}" stderr="{}" stdin="{}"'.format(o_f.name, e_f.name, os.ttyname(slave_fd)))